@@ -30,6 +30,9 @@
 #endif
 
 #include <unistd.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 
 #ifndef	O_BINARY
 #define O_BINARY 0
@@ -56,6 +59,14 @@ extern int lav_detect_endian(void);
 
 long AVI_errno = 0;
 
+/* Map input files into memory (see AVI_set_mmap) */
+
+static int avi_use_mmap = 0;
+
+/* Number of video frames to hint ahead when reading linearly */
+
+#define AVI_READAHEAD_FRAMES 32
+
 #define MAX_INFO_STRLEN 64
 static char id_str[MAX_INFO_STRLEN];
 
@@ -552,13 +563,16 @@ static int avi_add_index_entry(avi_t *AVI, unsigned char *tag, long flags, unsig
    void *ptr;
 
    if(AVI->n_idx>=AVI->max_idx) {
-     ptr = realloc((void *)AVI->idx,(AVI->max_idx+4096)*16);
+     /* grow geometrically, long captures have millions of entries */
+     long max_idx = AVI->max_idx < 4096 ? 4096 : 2*AVI->max_idx;
+
+     ptr = realloc((void *)AVI->idx,max_idx*16);
      
      if(ptr == 0) {
        AVI_errno = AVI_ERR_NO_MEM;
        return -1;
      }
-     AVI->max_idx += 4096;
+     AVI->max_idx = max_idx;
      AVI->idx = (unsigned char((*)[16]) ) ptr;
    }
    
@@ -1858,6 +1872,19 @@ void AVI_set_comment_fd(avi_t *AVI, int fd)
 {
     AVI->comment_fd = fd;
 }
+/* AVI_set_mmap: Map subsequently opened input files into memory.
+   The idx1 and OpenDML index chunks are then parsed in place and
+   frames and audio are copied out of the mapping, without any system
+   call per chunk.  The file size is only checked again when a read
+   falls past the end of the mapping.  Files that cannot be mapped are
+   read as usual.  Only map files that are not being modified: a file
+   truncated while it is mapped can crash the program with SIGBUS. */
+
+void AVI_set_mmap(int enable)
+{
+    avi_use_mmap = enable;
+}
+
 int  AVI_get_comment_fd(avi_t *AVI)
 {
     return AVI->comment_fd;
@@ -1889,7 +1916,10 @@ int AVI_close(avi_t *AVI)
        close(AVI->comment_fd);
    AVI->comment_fd = -1;
    close(AVI->fdes);
-   if(AVI->idx) free(AVI->idx);
+   if(AVI->idx && !AVI->idx_mapped) free(AVI->idx);
+#ifdef HAVE_MMAP
+   if(AVI->map) munmap(AVI->map, AVI->map_len);
+#endif
    if(AVI->video_index) free(AVI->video_index);
    if(AVI->video_superindex) {
        for (j = 0; j < NR_IXNN_CHUNKS; j++) {
@@ -2210,6 +2240,122 @@ int avi_parse_index_from_file(avi_t *AVI, char *filename)
     return 0;
 }
 
+static void avi_map_input(avi_t *AVI)
+{
+#ifdef HAVE_MMAP
+   struct stat st;
+   void *map;
+
+   if(!avi_use_mmap || AVI->map) return;
+   if(fstat(AVI->fdes, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+      return;
+   if((off_t)(size_t)st.st_size != st.st_size) return; /* too big to map */
+
+   map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, AVI->fdes, 0);
+   if(map == MAP_FAILED) return;
+
+   AVI->map = (char *) map;
+   AVI->map_len = st.st_size;
+#endif
+}
+
+/* A read falls past the end of the mapping: check the file size
+   again.  A file that has grown is mapped afresh (an index used in
+   place moves with the mapping).  A file that has shrunk is unmapped
+   and read() is used from then on.  A file truncated between these
+   checks can still raise SIGBUS, which is why mapping is opt-in. */
+
+static void avi_map_remap(avi_t *AVI)
+{
+#ifdef HAVE_MMAP
+   struct stat st;
+   void *map = MAP_FAILED;
+
+   if(fstat(AVI->fdes, &st) == 0) {
+      if(st.st_size == AVI->map_len) return;
+      if(st.st_size > AVI->map_len &&
+         (off_t)(size_t)st.st_size == st.st_size)
+         map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, AVI->fdes, 0);
+   }
+
+   if(AVI->idx_mapped) {
+      if(map != MAP_FAILED)
+         AVI->idx = (unsigned  char((*)[16]) )
+            ((char *) map + ((char *) AVI->idx - AVI->map));
+      else {
+         AVI->idx = NULL;
+         AVI->idx_mapped = 0;
+         AVI->n_idx = AVI->max_idx = 0;
+      }
+   }
+   munmap(AVI->map, AVI->map_len);
+   if(map != MAP_FAILED) {
+      AVI->map = (char *) map;
+      AVI->map_len = st.st_size;
+   } else {
+      AVI->map = NULL;
+      AVI->map_len = 0;
+   }
+#endif
+}
+
+/* Check whether len bytes at pos can be taken from the mapping */
+
+static int avi_mapped(avi_t *AVI, off_t pos, off_t len)
+{
+   if(!AVI->map || pos < 0) return 0;
+   if(pos + len > AVI->map_len) avi_map_remap(AVI);
+   return AVI->map && pos + len <= AVI->map_len;
+}
+
+/* Read len bytes at pos, from the mapping if the file is mapped */
+
+static ssize_t avi_read_at(avi_t *AVI, off_t pos, char *buf, size_t len)
+{
+   if(avi_mapped(AVI, pos, len)) {
+      memcpy(buf, AVI->map + pos, len);
+      return len;
+   }
+   if(lseek(AVI->fdes, pos, SEEK_SET) == (off_t)-1) return -1;
+   return avi_read(AVI->fdes, buf, len);
+}
+
+/* Tell the kernel which part of the file the next frames are in, once
+   every AVI_READAHEAD_FRAMES/2 frames while frames are read in order */
+
+static void avi_read_ahead(avi_t *AVI)
+{
+#if defined(HAVE_MADVISE) || defined(HAVE_POSIX_FADVISE)
+   long last;
+   off_t start, end;
+
+   if(AVI->video_pos < AVI->readahead_frame) return;
+
+   last = AVI->video_pos + AVI_READAHEAD_FRAMES;
+   if(last >= AVI->video_frames) last = AVI->video_frames - 1;
+   AVI->readahead_frame = AVI->video_pos + AVI_READAHEAD_FRAMES/2;
+
+   start = AVI->video_index[AVI->video_pos].pos;
+   end = AVI->video_index[last].pos + AVI->video_index[last].len;
+   if(end <= start) return;
+
+#ifdef HAVE_MADVISE
+   if(AVI->map) {
+      long page = sysconf(_SC_PAGESIZE);
+      off_t first = start & ~((off_t)page - 1);
+
+      if(end > AVI->map_len) end = AVI->map_len;
+      if(end > first)
+         madvise(AVI->map + first, end - first, MADV_WILLNEED);
+      return;
+   }
+#endif
+#ifdef HAVE_POSIX_FADVISE
+   posix_fadvise(AVI->fdes, start, end - start, POSIX_FADV_WILLNEED);
+#endif
+#endif
+}
+
 int avi_parse_input_file(avi_t *AVI, int getIndex)
 {
   long i, rate, scale, idx_type;
@@ -2227,6 +2373,9 @@ int avi_parse_input_file(avi_t *AVI, int getIndex)
   int num_stream = 0;
   char data[256];
   off_t oldpos=-1, newpos=-1;
+
+  avi_map_input(AVI);
+  AVI->last_read_frame = -1;
   
   /* Read first 12 bytes and check that this is an AVI file */
 
@@ -2285,6 +2434,16 @@ int avi_parse_input_file(avi_t *AVI, int getIndex)
             break if this is not the case */
 
          AVI->n_idx = AVI->max_idx = n/16;
+
+         if(avi_mapped(AVI, newpos, n))
+         {
+            /* use the index in place */
+            AVI->idx = (unsigned  char((*)[16]) ) (AVI->map + newpos);
+            AVI->idx_mapped = 1;
+            lseek(AVI->fdes,n,SEEK_CUR);
+            continue;
+         }
+
          AVI->idx = (unsigned  char((*)[16]) ) malloc(n);
          if(AVI->idx==0) ERR_EXIT(AVI_ERR_NO_MEM)
          if(avi_read(AVI->fdes, (char *) AVI->idx, n) != n ) {
@@ -2662,6 +2821,12 @@ int avi_parse_input_file(avi_t *AVI, int getIndex)
 
       lseek(AVI->fdes, AVI->movi_start, SEEK_SET);
 
+      if(AVI->idx_mapped) {
+         /* the rebuilt index must be growable */
+         AVI->idx = NULL;
+         AVI->idx_mapped = 0;
+         AVI->max_idx = 0;
+      }
       AVI->n_idx = 0;
 
       while(1)
@@ -2715,6 +2880,13 @@ int avi_parse_input_file(avi_t *AVI, int getIndex)
 
       for (j=0; j<AVI->video_superindex->nEntriesInUse; j++) {
 
+	 if (avi_mapped(AVI, AVI->video_superindex->aIndex[j].qwOffset,
+			AVI->video_superindex->aIndex[j].dwSize+hdrl_len)) {
+	    // parse in place
+	    chunk_start = NULL;
+	    en = AVI->map + AVI->video_superindex->aIndex[j].qwOffset;
+	 } else {
+
 	 // read from file
 	 chunk_start = en = malloc (AVI->video_superindex->aIndex[j].dwSize+hdrl_len);
 
@@ -2732,6 +2904,7 @@ int avi_parse_input_file(avi_t *AVI, int getIndex)
 	    free(chunk_start);
 	    continue;
 	 }
+	 }
 
 	 nrEntries = str2ulong(en + 12);
 #ifdef DEBUG_ODML
@@ -2796,6 +2969,13 @@ int avi_parse_input_file(avi_t *AVI, int getIndex)
 	 }
 	 for (j=0; j<AVI->track[audtr].audio_superindex->nEntriesInUse; j++) {
 
+	    if (avi_mapped(AVI, AVI->track[audtr].audio_superindex->aIndex[j].qwOffset,
+			   AVI->track[audtr].audio_superindex->aIndex[j].dwSize+hdrl_len)) {
+	       // parse in place
+	       chunk_start = NULL;
+	       en = AVI->map + AVI->track[audtr].audio_superindex->aIndex[j].qwOffset;
+	    } else {
+
 	    // read from file
 	    chunk_start = en = malloc (AVI->track[audtr].audio_superindex->aIndex[j].dwSize+hdrl_len);
 
@@ -2811,6 +2991,7 @@ int avi_parse_input_file(avi_t *AVI, int getIndex)
 	       free(chunk_start);
 	       continue;
 	    }
+	    }
 
 	    nrEntries = str2ulong(en + 12);
 	    //if (nrEntries > 50) nrEntries = 2; // XXX
@@ -3204,14 +3385,18 @@ long AVI_read_frame(avi_t *AVI, char *vidbuf, int *keyframe)
      return n;
    }
 
-   lseek(AVI->fdes, AVI->video_index[AVI->video_pos].pos, SEEK_SET);
+   if (AVI->video_pos == AVI->last_read_frame + 1)
+      avi_read_ahead(AVI);
+   else
+      AVI->readahead_frame = 0;   /* seek: hint again from here */
 
-   if (avi_read(AVI->fdes,vidbuf,n) != n)
+   if (avi_read_at(AVI, AVI->video_index[AVI->video_pos].pos, vidbuf, n) != n)
    {
       AVI_errno = AVI_ERR_READ;
       return -1;
    }
 
+   AVI->last_read_frame = AVI->video_pos;
    AVI->video_pos++;
 
    return n;
@@ -3298,8 +3483,7 @@ long AVI_read_audio(avi_t *AVI, char *audbuf, long bytes)
       else
          todo = left;
       pos = AVI->track[AVI->aptr].audio_index[AVI->track[AVI->aptr].audio_posc].pos + AVI->track[AVI->aptr].audio_posb;
-      lseek(AVI->fdes, pos, SEEK_SET);
-      if ( (ret = avi_read(AVI->fdes,audbuf+nr,todo)) != todo)
+      if ( (ret = avi_read_at(AVI,pos,audbuf+nr,todo)) != todo)
       {
 	 fprintf(stderr, "XXX pos = %lld, ret = %lld, todo = %ld\n", pos, ret, todo);
          AVI_errno = AVI_ERR_READ;
@@ -3334,8 +3518,7 @@ long AVI_read_audio_chunk(avi_t *AVI, char *audbuf)
    }
 
    pos = AVI->track[AVI->aptr].audio_index[AVI->track[AVI->aptr].audio_posc].pos + AVI->track[AVI->aptr].audio_posb;
-   lseek(AVI->fdes, pos, SEEK_SET);
-   if (avi_read(AVI->fdes,audbuf,left) != left)
+   if (avi_read_at(AVI,pos,audbuf,left) != left)
    {
       AVI_errno = AVI_ERR_READ;
       return -1;
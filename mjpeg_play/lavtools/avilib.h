@@ -244,6 +244,12 @@ typedef struct
 
   void*		extradata;
   unsigned long	extradata_size;
+
+  char  *map;               /* read-only mapping of the input file, or NULL */
+  off_t  map_len;
+  int    idx_mapped;        /* idx points into map, don't free it */
+  long   last_read_frame;   /* to detect linear reading */
+  long   readahead_frame;   /* hint the next batch when video_pos gets here */
 } avi_t;
 
 #define AVI_fileno(a) (a->fdes)
@@ -397,6 +403,7 @@ void AVI_set_audio_vbr(avi_t *AVI, long is_vbr);
 long AVI_get_audio_vbr(avi_t *AVI);
 
 void AVI_set_comment_fd(avi_t *AVI, int fd);
+void AVI_set_mmap(int enable);
 int  AVI_get_comment_fd(avi_t *AVI);
 
 struct riff_struct 
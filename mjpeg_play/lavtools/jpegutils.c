@@ -1041,10 +1041,11 @@ int decode_jpeg_gray_raw (unsigned char *jpeg_data, int len,
  *                  Currently only Y4M_CHROMA_{420JPEG,422} are available
  */
 
-int encode_jpeg_raw (unsigned char *jpeg_data, int len, int quality,
-                     int itype, int ctype, int width, int height,
-                     unsigned char *raw0, unsigned char *raw1,
-                     unsigned char *raw2)
+static int encode_jpeg_fields (unsigned char *jpeg_data, int len, int quality,
+                               int itype, int ctype, int width, int height,
+                               int first_field, int last_field,
+                               unsigned char *raw0, unsigned char *raw1,
+                               unsigned char *raw2)
 {
    int numfields, field, yl, yc, y, i;
 
@@ -1122,9 +1123,22 @@ int encode_jpeg_raw (unsigned char *jpeg_data, int len, int quality,
    }
    cinfo.image_height = height/numfields;
 
+   if (last_field >= numfields || first_field > last_field) {
+      mjpeg_error( "Field range %d..%d invalid for a %d field frame",
+                   first_field, last_field, numfields);
+      goto ERR_EXIT;
+   }
+
+   /* The quantisation and Huffman tables are only written with the first
+    * field of a frame.  Leave them out when encoding a later field on its
+    * own, so separately encoded fields concatenate to the same bytes.
+    */
+   if (first_field > 0)
+      jpeg_suppress_tables (&cinfo, TRUE);
+
    yl = yc = 0;                 /* y luma, chroma */
 
-   for (field = 0; field < numfields; field++) {
+   for (field = first_field; field <= last_field; field++) {
 
       jpeg_start_compress (&cinfo, FALSE);
       
@@ -1181,3 +1195,35 @@ int encode_jpeg_raw (unsigned char *jpeg_data, int len, int quality,
    jpeg_destroy_compress (&cinfo);
    return -1;
 }
+
+int encode_jpeg_raw (unsigned char *jpeg_data, int len, int quality,
+                     int itype, int ctype, int width, int height,
+                     unsigned char *raw0, unsigned char *raw1,
+                     unsigned char *raw2)
+{
+   int last_field = (itype == Y4M_ILACE_TOP_FIRST ||
+                     itype == Y4M_ILACE_BOTTOM_FIRST) ? 1 : 0;
+
+   return encode_jpeg_fields (jpeg_data, len, quality, itype, ctype,
+                              width, height, 0, last_field,
+                              raw0, raw1, raw2);
+}
+
+/*
+ * Encode only one field (0 = first field in output order) of an
+ * interlaced frame.  The fields of a frame are independent JPEG
+ * images, so they may be compressed concurrently into separate
+ * buffers and concatenated afterwards.  No static state is touched,
+ * so this (like encode_jpeg_raw) is safe to call from several threads.
+ */
+
+int encode_jpeg_raw_field (unsigned char *jpeg_data, int len, int quality,
+                           int itype, int ctype, int width, int height,
+                           int field,
+                           unsigned char *raw0, unsigned char *raw1,
+                           unsigned char *raw2)
+{
+   return encode_jpeg_fields (jpeg_data, len, quality, itype, ctype,
+                              width, height, field, field,
+                              raw0, raw1, raw2);
+}
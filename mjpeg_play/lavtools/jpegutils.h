@@ -52,6 +52,15 @@ int encode_jpeg_raw (unsigned char *jpeg_data, int len, int quality,
                      int itype, int ctype, int width, int height,
                      unsigned char *raw0, unsigned char *raw1,
                      unsigned char *raw2);
+/*
+ * field:           0 = first, 1 = second field (in output order) of an
+ *                  interlaced frame; must be 0 if itype is Y4M_ILACE_NONE
+ */
+int encode_jpeg_raw_field (unsigned char *jpeg_data, int len, int quality,
+                           int itype, int ctype, int width, int height,
+                           int field,
+                           unsigned char *raw0, unsigned char *raw1,
+                           unsigned char *raw2);
 /*
 void jpeg_skip_ff   (j_decompress_ptr cinfo);
 */
@@ -38,6 +38,7 @@ extern int AVI_errno;
 
 static char video_format=' ';
 static int  internal_error=0;
+static int  use_mmap=-1;	/* map AVI input files, -1: not decided yet */
 int libdv_pal_yv12 = -1;
 uint16_t reorder_16(uint16_t todo, int big_endian);
 
@@ -871,6 +872,18 @@ out:
    return -1;
 }
 
+/*
+ * Select whether AVI input files are memory mapped (default: no, unless
+ * the environment variable LAV_MMAP is set to 1).  Mapped files have their
+ * index parsed in place and frames copied straight out of the page cache,
+ * with read-ahead hints while frames are read in order.  A mapped file
+ * that is truncated while being read crashes the program (SIGBUS).
+ */
+void lav_set_mmap(int enable)
+{
+   use_mmap = enable;
+}
+
 lav_file_t *lav_open_input_file(char *filename)
 {
    int n;
@@ -901,6 +914,9 @@ lav_file_t *lav_open_input_file(char *filename)
 
    /* open video file, try AVI first */
 
+   if (use_mmap < 0)
+      use_mmap = getenv("LAV_MMAP") ? atoi(getenv("LAV_MMAP")) : 0;
+   AVI_set_mmap(use_mmap);
    lav_fd->avi_fd = AVI_open_input_file(filename,1);
    video_format = 'a'; /* for error messages */
 
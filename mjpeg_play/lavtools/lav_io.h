@@ -84,6 +84,7 @@ int  lav_set_video_position(lav_file_t *lav_file, long frame);
 int  lav_read_frame(lav_file_t *lav_file, uint8_t *vidbuf);
 int  lav_set_audio_position(lav_file_t *lav_file, long sample);
 long lav_read_audio(lav_file_t *lav_file, uint8_t *audbuf, long samps);
+void lav_set_mmap(int enable);
 lav_file_t *lav_open_input_file(char *filename);
 int  lav_get_field_size(uint8_t * jpegdata, long jpeglen);
 const char *lav_strerror(void);
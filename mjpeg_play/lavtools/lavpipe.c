@@ -33,6 +33,7 @@
 #include <ctype.h>
 #include <string.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <signal.h>
 
 #include "mjpeg_logging.h"
@@ -48,6 +49,10 @@ static void usage(void)
   "                  if num is negative, all but the last num frames are skipped\n"
   "         -n num   Only num frames are processed (0 means all frames)\n"
   "         -v num  Verbosity of output [0..2]\n"
+  "         -j num   Process up to num segments in parallel [1]\n"
+  "         -t dir   Directory for temporary segment results [$TMPDIR or /tmp]\n"
+  "         -e cmd   Encode each segment separately with cmd (reads YUV4MPEG\n"
+  "                  on stdin, writes to stdout) and concatenate the results\n"
   );
 }
 
@@ -546,10 +551,13 @@ void parse_command_line(int argc, char *argv[], commandline_params_t *cl)
   cl->verbose = 1;
   cl->offset = 0;
   cl->frames = 0; 
+  cl->jobs = 1;
+  cl->tmpdir = getenv("TMPDIR");
+  cl->encoder = NULL;
   cl->listfile = NULL;
   
   err = 0;
-  while ((c = getopt(argc, argv, "o:n:v:")) != EOF) {
+  while ((c = getopt(argc, argv, "o:n:v:j:t:e:")) != EOF) {
     switch (c) {
     case 'o':
       cl->offset = atoi(optarg);
@@ -564,6 +572,19 @@ void parse_command_line(int argc, char *argv[], commandline_params_t *cl)
 	exit(1);
       }
       break;
+    case 'j':
+      cl->jobs = atoi(optarg);
+      if (cl->jobs < 1) {
+	usage();
+	exit(1);
+      }
+      break;
+    case 't':
+      cl->tmpdir = optarg;
+      break;
+    case 'e':
+      cl->encoder = optarg;
+      break;
     default:
       err++;
     }
@@ -573,6 +594,8 @@ void parse_command_line(int argc, char *argv[], commandline_params_t *cl)
     exit(1);
   }
   cl->listfile = strdup(argv[optind]);
+  if (cl->tmpdir == NULL)
+    cl->tmpdir = "/tmp";
 }
 
 static
@@ -697,6 +720,214 @@ void process_pipe_sequence(pipe_sequence_t *ps)
   }
 }
 
+/*
+ * Parallel execution:
+ *
+ * Every segment of the requested frame range becomes a job, run in a
+ *  forked copy of lavpipe which processes just that frame range with the
+ *  ordinary serial code and writes the result to an (already unlinked)
+ *  temporary file.  Sources are spawned per job with the segment's own
+ *  offsets, so the frames are exactly those of a serial run.
+ * The parent keeps up to 'jobs' children busy and appends finished
+ *  results to stdout in segment order, as soon as all earlier ones are out.
+ *
+ * With an encoder command each job pipes its frames through a separate
+ *  encoder instance (e.g. mpeg2enc, whose first GOP is always closed) and
+ *  the resulting elementary streams are concatenated byte for byte.
+ */
+
+typedef struct _segment_job {
+  int offset;      /* first frame (of the whole sequence) */
+  int frames;      /* number of frames */
+  int fd;          /* temporary result file */
+  pid_t pid;       /* worker process, or -1 */
+  int done;
+} segment_job_t;
+
+static
+int open_segment_tmpfile(const char *dir)
+{
+  char name[1024];
+  int fd;
+
+  snprintf(name, sizeof(name), "%s/lavpipe-XXXXXX", dir);
+  if ((fd = mkstemp(name)) < 0)
+    mjpeg_error_exit1("Couldn't create temporary file in %s: %s",
+		      dir, strerror(errno));
+  unlink(name);
+  return fd;
+}
+
+static
+void run_segment_job(pipe_sequence_t *ps, segment_job_t *job)
+{
+  pid_t enc_pid = -1;
+  int status, i;
+
+  ps->cl.offset = job->offset;
+  ps->cl.frames = job->frames;
+
+  if (ps->cl.encoder != NULL) {
+    /* the encoder inherits the temporary file as its stdout */
+    if (dup2(job->fd, 1) != 1)
+      mjpeg_error_exit1("Couldn't redirect encoder output");
+    enc_pid = fork_child(ps->cl.encoder, job->offset, job->frames,
+			 NULL, &(ps->output.out_fd));
+    /* sources must not hold the encoder's input open */
+    fcntl(ps->output.out_fd, F_SETFD, FD_CLOEXEC);
+  } else {
+    ps->output.out_fd = job->fd;
+  }
+
+  process_pipe_sequence(ps);
+
+  for (i = 0; i < ps->pl.source_count; i++)
+    decommission_pipe_source(&(ps->sources[i]));
+  if (enc_pid > 0) {
+    close(ps->output.out_fd);
+    if (waitpid(enc_pid, &status, 0) < 0 ||
+	!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      mjpeg_error_exit1("Encoder for frames %d..%d failed",
+			job->offset, job->offset + job->frames - 1);
+  }
+}
+
+static
+void copy_fd(int from, int to)
+{
+  char buf[65536];
+  ssize_t n;
+
+  while ((n = read(from, buf, sizeof(buf))) > 0) {
+    if (y4m_write(to, buf, n) != 0)
+      mjpeg_error_exit1("Error writing output: %s", strerror(errno));
+  }
+  if (n < 0)
+    mjpeg_error_exit1("Error reading segment result: %s", strerror(errno));
+}
+
+static
+void output_segment_job(pipe_sequence_t *ps, segment_job_t *job, int first)
+{
+  y4m_stream_info_t si;
+
+  if (lseek(job->fd, 0, SEEK_SET) < 0)
+    mjpeg_error_exit1("Couldn't rewind segment result: %s", strerror(errno));
+
+  if (ps->cl.encoder == NULL) {
+    /* keep the first stream header, check and drop all later ones */
+    y4m_init_stream_info(&si);
+    if (y4m_read_stream_header(job->fd, &si) != Y4M_OK)
+      mjpeg_error_exit1("Bad segment result header (frame %d)", job->offset);
+    if (first) {
+      y4m_copy_stream_info(&(ps->output.out_streaminfo), &si);
+      y4m_write_stream_header(1, &si);
+    } else {
+      if (y4m_si_get_width(&si) != 
+	  y4m_si_get_width(&(ps->output.out_streaminfo)))
+	mjpeg_error_exit1("Stream mismatch:  frame width");
+      if (y4m_si_get_height(&si) != 
+	  y4m_si_get_height(&(ps->output.out_streaminfo)))
+	mjpeg_error_exit1("Stream mismatch:  frame height");
+      if (y4m_si_get_interlace(&si) != 
+	  y4m_si_get_interlace(&(ps->output.out_streaminfo)))
+	mjpeg_error_exit1("Stream mismatch:  interlace");
+    }
+    y4m_fini_stream_info(&si);
+  }
+  copy_fd(job->fd, 1);
+  close(job->fd);
+  job->fd = -1;
+}
+
+static
+void process_pipe_sequence_parallel(pipe_sequence_t *ps)
+{
+  segment_job_t *jobs;
+  int job_count, running, started, written;
+  int segm_num, segm_frame, frame, remaining, i;
+  pid_t pid;
+  int status;
+
+  /* cut the requested frame range at the segment boundaries */
+  jobs = malloc(ps->pl.segment_count * sizeof(jobs[0]));
+  job_count = 0;
+  frame = 0;
+  remaining = ps->cl.frames;
+  for (segm_num = 0;
+       (segm_num < ps->pl.segment_count) && (remaining > 0);
+       segm_num++) {
+    int seg_frames = ps->pl.segments[segm_num]->frame_count;
+
+    if (frame + seg_frames > ps->cl.offset) {
+      segm_frame = (ps->cl.offset > frame) ? (ps->cl.offset - frame) : 0;
+      jobs[job_count].offset = frame + segm_frame;
+      jobs[job_count].frames = seg_frames - segm_frame;
+      if (jobs[job_count].frames > remaining)
+	jobs[job_count].frames = remaining;
+      remaining -= jobs[job_count].frames;
+      jobs[job_count].fd = -1;
+      jobs[job_count].pid = -1;
+      jobs[job_count].done = 0;
+      job_count++;
+    }
+    frame += seg_frames;
+  }
+  mjpeg_info("processing %d segments with up to %d jobs",
+	     job_count, ps->cl.jobs);
+
+  running = started = written = 0;
+  while (written < job_count) {
+    /* keep the workers busy */
+    while ((running < ps->cl.jobs) && (started < job_count)) {
+      segment_job_t *job = &jobs[started];
+
+      job->fd = open_segment_tmpfile(ps->cl.tmpdir);
+      if ((pid = fork()) < 0)
+	mjpeg_error_exit1("Couldn't fork segment worker");
+      if (pid == 0) {
+	run_segment_job(ps, job);
+	exit(0);
+      }
+      mjpeg_debug("segment job %d (frames %d..%d) is pid %d", started,
+		  job->offset, job->offset + job->frames - 1, pid);
+      job->pid = pid;
+      running++;
+      started++;
+    }
+
+    /* write out everything that is finished, in order */
+    while ((written < job_count) && jobs[written].done) {
+      output_segment_job(ps, &jobs[written], (written == 0));
+      mjpeg_info("segment job %d written", written);
+      written++;
+    }
+    if (written == job_count)
+      break;
+
+    /* wait for the next worker to finish */
+    pid = waitpid(-1, &status, 0);
+    if (pid < 0) {
+      if (errno == EINTR)
+	continue;
+      mjpeg_error_exit1("waitpid failed: %s", strerror(errno));
+    }
+    for (i = 0; i < started; i++) {
+      if (jobs[i].pid == pid) {
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+	  mjpeg_error_exit1("segment job %d (frames %d..%d) failed", i,
+			    jobs[i].offset, jobs[i].offset + jobs[i].frames - 1);
+	jobs[i].pid = -1;
+	jobs[i].done = 1;
+	running--;
+	break;
+      }
+    }
+    /* any other pid is a reaped source or filter; ignore it */
+  }
+  free(jobs);
+}
+
 static
 void cleanup_pipe_sequence(pipe_sequence_t *ps)
 {
@@ -719,7 +950,10 @@ int main (int argc, char *argv[])
   pipe_sequence_t ps;
 
   initialize_pipe_sequence(&ps, argc, argv);
-  process_pipe_sequence(&ps);
+  if ((ps.cl.jobs > 1) || (ps.cl.encoder != NULL))
+    process_pipe_sequence_parallel(&ps);
+  else
+    process_pipe_sequence(&ps);
   cleanup_pipe_sequence(&ps);
   return 0;
 }
@@ -49,6 +49,9 @@ typedef struct _commandline_params {
   int verbose;
   int offset;
   int frames;
+  int jobs;        /* segments processed concurrently */
+  char *tmpdir;    /* where segment results are kept until concatenated */
+  char *encoder;   /* per-segment encoder command, or NULL for YUV4MPEG */
   char *listfile;
 } commandline_params_t;
 
@@ -27,6 +27,7 @@
 #include <signal.h>
 #include <string.h>
 #include <math.h>
+#include <pthread.h>
 
 #include "mjpeg_logging.h"
 
@@ -49,6 +50,7 @@ static char *param_inputwav = NULL;
 static int   param_bufsize = 256*1024; /* 256 kBytes */
 static int   param_interlace = -1;
 static int   param_maxfilesize = 0;
+static int   param_threads = 0;
 
 static int got_sigint = 0;
 
@@ -75,10 +77,12 @@ static void usage(void)
 	  "   -I num      force output interlacing 0:no 1:top 2:bottom field first\n"
 	  "   -q num      JPEG encoding quality [%d%%]\n"
 	  "   -b num      size of MJPEG buffer [%d kB]\n"
-          "   -m num      maximum size per file [%d MB]\n"
+	  "   -m num      maximum size per file [%d MB]\n"
+	  "   -T num      number of JPEG encoding threads (0: none) [%d]\n"
 	  "   -w file     WAVE file - audio data to be added to output file\n"
 	  "   -o file     output mjpeg file (REQUIRED!)\n",
-	  param_format, param_quality, param_bufsize/1024, param_maxfilesize);
+	  param_format, param_quality, param_bufsize/1024, param_maxfilesize,
+	  param_threads);
 }
 
 static void sigint_handler (int signal) {
@@ -88,6 +92,225 @@ static void sigint_handler (int signal) {
    
 }
 
+/*
+ * Parallel encoding.
+ *
+ * A window of frame slots is read ahead from the input and compressed by
+ * a pool of worker threads.  Each slot is one job (progressive) or two
+ * jobs, one per field (interlaced), so both fields of a frame may be
+ * compressed at the same time.  Frames are handed back strictly in input
+ * order so the output file is identical to the single threaded one.
+ */
+
+#define MAX_ENCODE_THREADS 32
+
+typedef struct {
+   unsigned char *yuv[3];
+   uint8_t *jpeg[2];       /* per field compressed data */
+   int      jpegsize[2];
+   int      pending;       /* jobs not yet finished */
+} encode_slot_t;
+
+typedef struct {
+   int fd_in;
+   y4m_stream_info_t *streaminfo;
+   y4m_frame_info_t  *frameinfo;
+   int numfields;
+
+   int nslots;
+   encode_slot_t *slots;
+   int head;               /* oldest slot not yet returned */
+   int queued;             /* slots read but not yet returned */
+   int eof;
+   int frame;
+
+   int *jobs;              /* ring of (slot * 2 + field) */
+   int jobring;            /* ring size, one more than jobs in flight */
+   int job_head;
+   int job_tail;
+   int quit;
+
+   int nthreads;
+   pthread_t threads[MAX_ENCODE_THREADS];
+   pthread_mutex_t lock;
+   pthread_cond_t work_cond;
+   pthread_cond_t done_cond;
+} encode_pool_t;
+
+static void *encode_worker(void *arg)
+{
+   encode_pool_t *pool = (encode_pool_t *)arg;
+   y4m_stream_info_t *si = pool->streaminfo;
+   encode_slot_t *slot;
+   int job, field;
+
+   for (;;) {
+      pthread_mutex_lock(&pool->lock);
+      while (pool->job_head == pool->job_tail && !pool->quit)
+         pthread_cond_wait(&pool->work_cond, &pool->lock);
+      if (pool->quit) {
+         pthread_mutex_unlock(&pool->lock);
+         return NULL;
+      }
+      job = pool->jobs[pool->job_head];
+      pool->job_head = (pool->job_head + 1) % pool->jobring;
+      pthread_mutex_unlock(&pool->lock);
+
+      slot = &pool->slots[job / 2];
+      field = job % 2;
+      slot->jpegsize[field] =
+         encode_jpeg_raw_field(slot->jpeg[field], param_bufsize,
+                               param_quality, param_interlace,
+                               y4m_si_get_chroma(si),
+                               y4m_si_get_width(si), y4m_si_get_height(si),
+                               field, slot->yuv[0], slot->yuv[1], slot->yuv[2]);
+
+      pthread_mutex_lock(&pool->lock);
+      if (--slot->pending == 0)
+         pthread_cond_broadcast(&pool->done_cond);
+      pthread_mutex_unlock(&pool->lock);
+   }
+}
+
+static encode_pool_t *encode_pool_new(int nthreads, int fd_in,
+                                      y4m_stream_info_t *si,
+                                      y4m_frame_info_t *fi)
+{
+   encode_pool_t *pool;
+   int i, f, lumasize, chromasize;
+
+   pool = (encode_pool_t *)calloc(1, sizeof(encode_pool_t));
+   if (pool == NULL)
+      mjpeg_error_exit1("Out of Memory - malloc failed");
+   pool->fd_in = fd_in;
+   pool->streaminfo = si;
+   pool->frameinfo = fi;
+   pool->numfields = (param_interlace == Y4M_ILACE_TOP_FIRST ||
+                      param_interlace == Y4M_ILACE_BOTTOM_FIRST) ? 2 : 1;
+   pool->nthreads = nthreads;
+   pool->nslots = 2 * nthreads;
+   pool->jobring = pool->nslots * 2 + 1;
+
+   lumasize = y4m_si_get_width(si) * y4m_si_get_height(si);
+   chromasize = lumasize /
+      ((y4m_si_get_chroma(si) == Y4M_CHROMA_422) ? 2 : 4);
+
+   pool->slots = (encode_slot_t *)calloc(pool->nslots, sizeof(encode_slot_t));
+   pool->jobs = (int *)malloc(pool->jobring * sizeof(int));
+   if (pool->slots == NULL || pool->jobs == NULL)
+      mjpeg_error_exit1("Out of Memory - malloc failed");
+   for (i = 0; i < pool->nslots; i++) {
+      pool->slots[i].yuv[0] = malloc(lumasize);
+      pool->slots[i].yuv[1] = malloc(chromasize);
+      pool->slots[i].yuv[2] = malloc(chromasize);
+      for (f = 0; f < pool->numfields; f++)
+         pool->slots[i].jpeg[f] = (uint8_t *)malloc(param_bufsize);
+      if (pool->slots[i].yuv[0] == NULL || pool->slots[i].yuv[1] == NULL ||
+          pool->slots[i].yuv[2] == NULL || pool->slots[i].jpeg[0] == NULL ||
+          (pool->numfields == 2 && pool->slots[i].jpeg[1] == NULL))
+         mjpeg_error_exit1("Out of Memory - malloc failed");
+   }
+
+   pthread_mutex_init(&pool->lock, NULL);
+   pthread_cond_init(&pool->work_cond, NULL);
+   pthread_cond_init(&pool->done_cond, NULL);
+   for (i = 0; i < nthreads; i++) {
+      if (pthread_create(&pool->threads[i], NULL, encode_worker, pool) != 0)
+         mjpeg_error_exit1("Could not create encoding thread");
+   }
+   mjpeg_info("Encoding with %d threads, %d frames in flight",
+              nthreads, pool->nslots);
+   return pool;
+}
+
+/*
+ * Return the next compressed frame in input order, reading and queueing
+ * further input frames to keep the workers busy.  The returned buffer
+ * stays valid until the next call.  Returns 0 once the input is exhausted
+ * (or SIGINT was caught) and all queued frames have been returned.
+ */
+
+static int encode_pool_next(encode_pool_t *pool, uint8_t **jpeg, int *jpegsize)
+{
+   encode_slot_t *slot;
+   int s, f, size;
+
+   while (!pool->eof && pool->queued < pool->nslots) {
+      s = (pool->head + pool->queued) % pool->nslots;
+      slot = &pool->slots[s];
+      if (got_sigint ||
+          y4m_read_frame(pool->fd_in, pool->streaminfo, pool->frameinfo,
+                         slot->yuv) != Y4M_OK) {
+         pool->eof = 1;
+         break;
+      }
+      pthread_mutex_lock(&pool->lock);
+      slot->pending = pool->numfields;
+      for (f = 0; f < pool->numfields; f++) {
+         pool->jobs[pool->job_tail] = s * 2 + f;
+         pool->job_tail = (pool->job_tail + 1) % pool->jobring;
+      }
+      pthread_cond_broadcast(&pool->work_cond);
+      pthread_mutex_unlock(&pool->lock);
+      pool->queued++;
+   }
+
+   if (pool->queued == 0)
+      return 0;
+
+   slot = &pool->slots[pool->head];
+   pthread_mutex_lock(&pool->lock);
+   while (slot->pending > 0)
+      pthread_cond_wait(&pool->done_cond, &pool->lock);
+   pthread_mutex_unlock(&pool->lock);
+
+   size = slot->jpegsize[0];
+   if (pool->numfields == 2 && size != -1) {
+      if (slot->jpegsize[1] == -1 || size + slot->jpegsize[1] > param_bufsize) {
+         if (slot->jpegsize[1] != -1)
+            mjpeg_error( "Given jpeg buffer was too small!");
+         size = -1;
+      } else {
+         memcpy(slot->jpeg[0] + size, slot->jpeg[1], slot->jpegsize[1]);
+         size += slot->jpegsize[1];
+      }
+   }
+
+   fprintf (stdout, "frame %d\r", pool->frame++);
+   fflush (stdout);
+
+   *jpeg = slot->jpeg[0];
+   *jpegsize = size;
+   pool->head = (pool->head + 1) % pool->nslots;
+   pool->queued--;
+   return 1;
+}
+
+static void encode_pool_free(encode_pool_t *pool)
+{
+   int i, f;
+
+   pthread_mutex_lock(&pool->lock);
+   pool->quit = 1;
+   pthread_cond_broadcast(&pool->work_cond);
+   pthread_mutex_unlock(&pool->lock);
+   for (i = 0; i < pool->nthreads; i++)
+      pthread_join(pool->threads[i], NULL);
+
+   for (i = 0; i < pool->nslots; i++) {
+      for (f = 0; f < 3; f++)
+         free(pool->slots[i].yuv[f]);
+      for (f = 0; f < pool->numfields; f++)
+         free(pool->slots[i].jpeg[f]);
+   }
+   pthread_mutex_destroy(&pool->lock);
+   pthread_cond_destroy(&pool->work_cond);
+   pthread_cond_destroy(&pool->done_cond);
+   free(pool->slots);
+   free(pool->jobs);
+   free(pool);
+}
+
 int main(int argc, char *argv[])
 {
 
@@ -112,15 +335,16 @@ int main(int argc, char *argv[])
    unsigned long filesize_cur = 0;
 	char *dotptr;
    
-   uint8_t *jpeg;
+   uint8_t *jpeg = NULL;
    int   jpegsize = 0;
    unsigned char *yuv[3];
+   encode_pool_t *pool = NULL;
 
    y4m_frame_info_t frameinfo;
    y4m_stream_info_t streaminfo;
 
 
-   while ((n = getopt(argc, argv, "v:f:I:q:b:m:o:w:")) != -1) {
+   while ((n = getopt(argc, argv, "v:f:I:q:b:m:T:o:w:")) != -1) {
       switch (n) {
       case 'v':
          verbose = atoi(optarg);
@@ -170,6 +394,13 @@ int main(int argc, char *argv[])
       case 'm':
          param_maxfilesize = atoi(optarg);
          break;
+      case 'T':
+         param_threads = atoi(optarg);
+         if (param_threads < 0 || param_threads > MAX_ENCODE_THREADS) {
+            mjpeg_error("-T option requires arg 0..%d", MAX_ENCODE_THREADS);
+            exit (1);
+         }
+         break;
       case 'o':
          param_output = optarg;
          break;
@@ -378,21 +609,33 @@ int main(int argc, char *argv[])
 		   y4m_si_get_height(&streaminfo) *
 		   sizeof(unsigned char) /
 		   ((y4m_si_get_chroma(&streaminfo) == Y4M_CHROMA_422)? 2: 4));
-   jpeg = (uint8_t*)malloc(param_bufsize);
-   
    signal (SIGINT, sigint_handler);
 
+   /* with a pool the compressed frames are handed out from its own buffers */
+   if (param_threads > 0)
+      pool = encode_pool_new(param_threads, fd_in, &streaminfo, &frameinfo);
+   else
+      jpeg = (uint8_t*)malloc(param_bufsize);
+
    frame = 0;
-   while (y4m_read_frame(fd_in, &streaminfo, &frameinfo, yuv)==Y4M_OK && (!got_sigint)) {
+   for (;;) {
 
-      fprintf (stdout, "frame %d\r", frame);
-      fflush (stdout);
-      jpegsize = encode_jpeg_raw (jpeg, param_bufsize, param_quality,
-                                  param_interlace,
-				  y4m_si_get_chroma(&streaminfo),
-                                  y4m_si_get_width(&streaminfo),
-				  y4m_si_get_height(&streaminfo),
-                                  yuv[0], yuv[1], yuv[2]);
+      if (pool) {
+         if (!encode_pool_next(pool, &jpeg, &jpegsize))
+            break;
+      } else {
+         if (y4m_read_frame(fd_in, &streaminfo, &frameinfo, yuv) != Y4M_OK ||
+             got_sigint)
+            break;
+         fprintf (stdout, "frame %d\r", frame);
+         fflush (stdout);
+         jpegsize = encode_jpeg_raw (jpeg, param_bufsize, param_quality,
+                                     param_interlace,
+                                     y4m_si_get_chroma(&streaminfo),
+                                     y4m_si_get_width(&streaminfo),
+                                     y4m_si_get_height(&streaminfo),
+                                     yuv[0], yuv[1], yuv[2]);
+      }
       if (jpegsize==-1) {
          mjpeg_error( "Couldn't compress YUV to JPEG");
          exit(1);
@@ -462,6 +705,9 @@ int main(int argc, char *argv[])
       }
    }
 
+   if (pool)
+      encode_pool_free(pool);
+
    /* copy remaining audio */
    if (param_inputwav != NULL)
    {
@@ -50,6 +50,7 @@
 #include "mpeg2encoder.hh"
 #include <cassert>
 #include <string.h>
+#include "mjpeg_logging.h"
 
 ElemStrmWriter::ElemStrmWriter() 
 {
@@ -62,6 +63,30 @@ ElemStrmWriter::~ElemStrmWriter()
 
 /* *********************************************************************** */
 
+QueueStrmWriter::QueueStrmWriter( mjpeg_bytequeue_t *_queue ) :
+    queue( _queue )
+{
+}
+
+QueueStrmWriter::~QueueStrmWriter()
+{
+    mjpeg_bytequeue_close( queue );
+}
+
+void QueueStrmWriter::WriteOutBufferUpto( const uint8_t *buffer, 
+                                          const uint32_t flush_upto )
+{
+    size_t written = mjpeg_bytequeue_write( queue, buffer, 
+                                            static_cast<size_t>(flush_upto) );
+    if( written != static_cast<size_t>(flush_upto) )
+    {
+        mjpeg_error_exit1( "Elementary stream consumer stopped reading" );
+    }
+    flushed += flush_upto;
+}
+
+/* *********************************************************************** */
+
 
 OutputFragBuf::OutputFragBuf()
 {
@@ -21,6 +21,7 @@
  */
 
 #include "mjpeg_types.h"
+#include "bytequeue.h"
 
 class EncoderParams;
 
@@ -38,6 +39,29 @@ protected:
 };
 
 
+/**************************
+ *
+ * Elementary stream output into an in-memory byte queue. Lets a
+ * consumer in the same process (e.g. mplex reading through an
+ * IQueueBitStream) multiplex the stream while it is being encoded
+ * without an intermediate file or FIFO. Blocks while the queue is
+ * full. The queue is closed (end of stream) when the writer is
+ * destroyed.
+ *
+ *************************/
+
+class QueueStrmWriter : public ElemStrmWriter
+{
+public:
+    QueueStrmWriter( mjpeg_bytequeue_t *queue );
+    virtual ~QueueStrmWriter();
+    virtual void WriteOutBufferUpto( const uint8_t *buffer, const uint32_t flush_upto );
+    virtual uint64_t BitCount() { return flushed * 8LL; }
+private:
+    mjpeg_bytequeue_t *queue;
+};
+
+
 
 /******************************
  *
@@ -10,7 +10,7 @@ typedef int64_t clockticks;		// This value *must* be signed
 class AUnit
 {
 public:
-	AUnit() : length(0), PTS(0), DTS(0) {}
+	AUnit() : length(0), PTS(0), DTS(0), users(0) {}
 	//
 	// How many payload bytes muxing AU will require.  Eventually will be more
 	// complex for input streams where AU are no contiguous
@@ -29,6 +29,10 @@ public:
     unsigned int type;
 	bool	   seq_header;
 	bool	   end_seq;
+	//
+	// Number of AUStreams (owner plus followers) still holding the record
+	//
+	unsigned int users;
 
 };
 
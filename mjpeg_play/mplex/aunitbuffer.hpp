@@ -1,62 +1,229 @@
 #ifndef __AUNITBUFFER_H__
 #define __AUNITBUFFER_H__
 
-#include <deque>
+#include <vector>
 #include "mjpeg_logging.h"
 #include "aunit.hpp"
 
+//
+// Queue of scanned but not yet muxed Access Units.
+//
+// The queue itself is a ring of AUnit pointers that doubles in size
+// when full so there is no limit on look-ahead.  The AUnit records
+// are allocated from slabs and recycled through a free list: the
+// record handed out by Next() remains valid until it is given back
+// with Release().  Records removed with DropLast() are not recycled
+// (a pointer obtained through Lookahead() may still refer to them)
+// and are only freed with the slabs.
+//
+// Several AUStreams can share one scan: a follower (see Follow())
+// queues the same records as the stream it follows but allocates none
+// of its own.  Every record counts the streams still holding it and
+// goes back on the owner's free list once the last of them has
+// released it.  Callers sharing a scan must serialise all calls on the
+// owner and its followers.
+//
+// While appends are deferred (see DeferAppends()) Append() and
+// DropLast() touch nothing the readers of the queue use: the records
+// are held back until Publish() queues them.  This lets a parser
+// thread scan without holding the lock that serialises the queue.
+//
+
 class AUStream
 {
 public:
-	AUStream()  {}
-	~AUStream() 
+	AUStream() :
+		ring(0),
+		ring_size(0),
+		head(0),
+		count(0),
+		owner(0),
+		deferring(false),
+		dropped(0)
+		{}
+	~AUStream()
 	{
-		for( std::deque<AUnit *>::iterator i = buf.begin(); i != buf.end(); ++i )
-			delete *i;
+		Unfollow();
+		for( std::vector<AUnit *>::iterator i = slabs.begin(); i != slabs.end(); ++i )
+			delete [] *i;
+		delete [] ring;
 	}
-	
+
 	void Append( AUnit &rec )
 	{
-		if( buf.size() >= BUF_SIZE_SANITY )
-			mjpeg_error_exit1( "INTERNAL ERROR: AU buffer overflow" );
-		buf.push_back( new AUnit(rec) );
+		if( deferring )
+		{
+			deferred.push_back( rec );
+			return;
+		}
+		if( free_units.empty() )
+			NewSlab();
+		AUnit *unit = free_units.back();
+		free_units.pop_back();
+		*unit = rec;
+		unit->users = 1 + followers.size();
+		Queue( unit );
+		for( std::vector<AUStream *>::iterator f = followers.begin(); 
+			 f != followers.end(); ++f )
+			(*f)->Queue( unit );
 	}
 
-	inline AUnit *Next( ) 
-	{ 
-		if( buf.size()==0 )
+	inline AUnit *Next( )
+	{
+		if( count==0 )
 		{
 			return 0;
 		}
 	    else
 		{
-			AUnit *res = buf.front();
-			buf.pop_front();
+			AUnit *res = ring[head];
+			head = (head+1) & (ring_size-1);
+			--count;
 			return res;
 		}
 	}
 
+	inline void Release( AUnit *unit )
+	{
+		if( unit == 0 )
+			return;
+		if( owner != 0 )
+			owner->Release( unit );
+		else if( --unit->users == 0 )
+			free_units.push_back( unit );
+	}
+
 	inline void DropLast()
 		{
-			if( buf.empty() )
+			if( deferring )
+			{
+				if( deferred.empty() )
+					++dropped;
+				else
+					deferred.pop_back();
+				return;
+			}
+			if( count == 0 )
 				mjpeg_error_exit1( "INTERNAL ERROR: droplast empty AU buffer" );
-			buf.pop_back();
-			
+			--count;
+			for( std::vector<AUStream *>::iterator f = followers.begin(); 
+				 f != followers.end(); ++f )
+				(*f)->DropLast();
+		}
+
+	//
+	// Queue the records appended to 'scanned' instead of our own: the
+	// AU's we have queued are replaced by those 'scanned' has queued
+	// and from now on we receive everything it appends.
+	//
+	void Follow( AUStream &scanned )
+	{
+		Unfollow();
+		count = 0;
+		for( unsigned int i = 0; i < scanned.count; ++i )
+		{
+			AUnit *unit = scanned.ring[(scanned.head+i) & (scanned.ring_size-1)];
+			++unit->users;
+			Queue( unit );
+		}
+		owner = &scanned;
+		scanned.followers.push_back( this );
+	}
+
+	//
+	// Stop following: the records still queued are released.
+	//
+	void Unfollow()
+	{
+		if( owner == 0 )
+			return;
+		while( count > 0 )
+			Release( Next() );
+		std::vector<AUStream *> &f = owner->followers;
+		for( std::vector<AUStream *>::iterator i = f.begin(); i != f.end(); ++i )
+		{
+			if( *i == this )
+			{
+				f.erase( i );
+				break;
+			}
 		}
+		owner = 0;
+	}
+
+	inline void DeferAppends( bool defer )
+	{
+		Publish();
+		deferring = defer;
+	}
+
+	//
+	// Queue the records appended (and drop those dropped) since appends
+	// were deferred or last published.
+	//
+	void Publish()
+	{
+		bool defer = deferring;
+		deferring = false;
+		for( ; dropped > 0; --dropped )
+			DropLast();
+		for( std::vector<AUnit>::iterator i = deferred.begin(); 
+			 i != deferred.end(); ++i )
+			Append( *i );
+		deferred.clear();
+		deferring = defer;
+	}
 
 	inline AUnit *Lookahead( unsigned int n)
 	{
-		return buf.size() <= n ? 0 : buf[n];
+		return count <= n ? 0 : ring[(head+n) & (ring_size-1)];
     }
 
-	inline unsigned int MaxAULookahead() const { return buf.size(); }
+	inline unsigned int MaxAULookahead() const { return count; }
 
 private:
-	static const unsigned int BUF_SIZE_SANITY = 1000;
+	static const unsigned int INITIAL_RING_SIZE = 64;
+	static const unsigned int SLAB_SIZE = 128;
 
+	void Queue( AUnit *unit )
+	{
+		if( count == ring_size )
+			GrowRing();
+		ring[(head+count) & (ring_size-1)] = unit;
+		++count;
+	}
+
+	void GrowRing()
+	{
+		unsigned int new_size = ring_size == 0 ? INITIAL_RING_SIZE : ring_size*2;
+		AUnit **new_ring = new AUnit *[new_size];
+		for( unsigned int i = 0; i < count; ++i )
+			new_ring[i] = ring[(head+i) & (ring_size-1)];
+		delete [] ring;
+		ring = new_ring;
+		ring_size = new_size;
+		head = 0;
+	}
+
+	void NewSlab()
+	{
+		AUnit *slab = new AUnit[SLAB_SIZE];
+		slabs.push_back( slab );
+		for( unsigned int i = SLAB_SIZE; i > 0; --i )
+			free_units.push_back( &slab[i-1] );
+	}
 
-	
-	std::deque<AUnit *> buf;
+	AUnit **ring;				// Queued AU's (ring_size is a power of 2)
+	unsigned int ring_size;
+	unsigned int head;			// Index of oldest queued AU
+	unsigned int count;			// Number of queued AU's
+	std::vector<AUnit *> slabs;
+	std::vector<AUnit *> free_units;
+	AUStream *owner;			// Stream we follow (if any)
+	std::vector<AUStream *> followers;	// Streams following us
+	bool deferring;				// Hold back appends until Publish()
+	std::vector<AUnit> deferred;	// Records appended meanwhile...
+	unsigned int dropped;		// ... and number of queued ones dropped
 };
 
 
@@ -127,6 +127,8 @@ uint8_t *BitStreamBuffering::StartAppendPoint( unsigned int to_append )
    Refills an IBitStream's input buffer based on the internal
    variables buffered and bfr_size.
    Strategy: we read 1/4 of a buffer, always.
+   N.b. the buffer may be grown but the data is read into it without
+   buffer_lock held: only the bytes beyond those buffered are written.
  */
 bool IBitStream::ReadIntoBuffer(unsigned int to_read)
 {
@@ -135,12 +137,15 @@ bool IBitStream::ReadIntoBuffer(unsigned int to_read)
     while( read_pow2 < to_read ) 
         read_pow2 <<= 1;
 
-
-    i = ReadStreamBytes( StartAppendPoint(read_pow2), 
-                         static_cast<size_t>(read_pow2) );      
+    pthread_mutex_lock( &buffer_lock );
+    uint8_t *append_point = StartAppendPoint(read_pow2);
+    pthread_mutex_unlock( &buffer_lock );
+    i = ReadStreamBytes( append_point, static_cast<size_t>(read_pow2) );      
 	//i = fread(StartAppendPoint(read_pow2), sizeof(uint8_t), 
     //			  static_cast<size_t>(read_pow2), fileh);
+    pthread_mutex_lock( &buffer_lock );
     Appended(static_cast<unsigned int>(i));
+    pthread_mutex_unlock( &buffer_lock );
 
 	if ( i == 0 )
 	{
@@ -150,6 +155,26 @@ bool IBitStream::ReadIntoBuffer(unsigned int to_read)
 	return true;
 }
 
+/**
+   Append up to to_read more bytes from the underlying stream to the
+   buffer without touching the bit-level parsing state.  In particular
+   running out of data does not set eobs: the parsing finds that out
+   for itself when it gets there.
+   @param to_read the number of bytes wanted
+   @returns the number of bytes appended
+*/
+unsigned int IBitStream::ReadAhead( unsigned int to_read )
+{
+    pthread_mutex_lock( &buffer_lock );
+    uint8_t *append_point = StartAppendPoint(to_read);
+    pthread_mutex_unlock( &buffer_lock );
+    size_t i = ReadStreamBytes( append_point, static_cast<size_t>(to_read) );
+    pthread_mutex_lock( &buffer_lock );
+    Appended(static_cast<unsigned int>(i));
+    pthread_mutex_unlock( &buffer_lock );
+    return static_cast<unsigned int>(i);
+}
+
 
 
 
@@ -162,6 +187,12 @@ uint32_t IBitStream::Get1Bit()
 
 	if (eobs)
 		return 0;
+	if (bitidx != 1)
+	{
+		// Stays within the current byte: no refill possible
+		bitreadpos++;
+		return (bfr[byteidx] >> (--bitidx)) & 1;
+	}
 	bit = (bfr[byteidx] >> (--bitidx))& 1;
 	bitreadpos++;
 	
@@ -178,6 +209,20 @@ uint32_t IBitStream::Get1Bit()
 	return bit;
 }
 
+/* Big-endian load of the 64 bits starting at p (compiles to a
+   single load + byte swap) */
+static inline uint64_t Load64BE( const uint8_t *p )
+{
+	return (static_cast<uint64_t>(p[0]) << 56) |
+		(static_cast<uint64_t>(p[1]) << 48) |
+		(static_cast<uint64_t>(p[2]) << 40) |
+		(static_cast<uint64_t>(p[3]) << 32) |
+		(static_cast<uint64_t>(p[4]) << 24) |
+		(static_cast<uint64_t>(p[5]) << 16) |
+		(static_cast<uint64_t>(p[6]) << 8) |
+		static_cast<uint64_t>(p[7]);
+}
+
 /*read N bits from the bit stream 
 @returns the read bits, 0 on EOF */
 uint32_t IBitStream::GetBits(int N)
@@ -186,6 +231,23 @@ uint32_t IBitStream::GetBits(int N)
 	int i = N;
 	unsigned int j;
 
+	// Fast path: whenever at least 8 bytes are buffered ahead of the
+	// read position the (at most 7 + 32 bit) field lies inside a
+	// single 64-bit window so it can be extracted with two shifts and
+	// the read position advanced in one step.  The read position
+	// cannot reach the end of the buffer so no refill (and hence no
+	// change in eobs) is possible, exactly as in the bit-wise loop.
+	if( !eobs && N > 0 && N <= 32 && buffered - byteidx >= 8 )
+	{
+		unsigned int skip = 8 - bitidx;
+		uint64_t window = Load64BE( bfr+byteidx ) << skip;
+		unsigned int bits = skip + N;
+		byteidx += bits >> 3;
+		bitidx = 8 - (bits & 7);
+		bitreadpos += N;
+		return static_cast<uint32_t>(window >> (64 - N));
+	}
+
 	// Optimize: we are on byte boundary and want to read multiple of bytes!
 	if ((bitidx == 8) && ((N & 7) == 0))
 	{
@@ -251,6 +313,9 @@ bool IBitStream::SeekSync(uint32_t sync, int N, int lim)
 		Get1Bit();
 	}
 
+    if( (N & 7) == 0 && N > 0 && N <= 32 && !eobs )
+        return SeekSyncBytes( sync, N>>3, lim );
+
 	val = GetBits(N);
 	if( eobs )
 		return false;
@@ -266,6 +331,89 @@ bool IBitStream::SeekSync(uint32_t sync, int N, int lim)
 	return (!!lim);
 }
 
+/****************
+ *
+ * Byte-aligned SeekSync for whole-byte sync words.  Rather than
+ * shifting the stream through GetBits(8) a byte at a time the buffered
+ * data is scanned with memchr for the last byte of the sync word (for
+ * start codes the rarely occurring 0x01 or the start code value) and
+ * candidates are checked in place.  The read position is then moved in
+ * one step.  Behaviour, including the final read position and eobs on
+ * failure, is identical to the bit-wise loop in SeekSync.
+ *
+ ***************/
+
+bool IBitStream::SeekSyncBytes( uint32_t sync, unsigned int sync_bytes, int lim )
+{
+    assert( bitidx == 8 );
+    uint8_t pattern[4];
+    for( unsigned int i = 0; i < sync_bytes; ++i )
+        pattern[i] = static_cast<uint8_t>(sync >> (8*(sync_bytes-1-i)));
+    const uint8_t last = pattern[sync_bytes-1];
+
+    // Candidate sync positions relative to byteidx are 0..max_cand
+    // (a limit <= 0 never runs out in SeekSync either)
+    const unsigned int max_cand =
+        lim > 0 ? static_cast<unsigned int>(lim-1) : ~0U - sync_bytes;
+    const unsigned int start = byteidx;
+    unsigned int cand = 0;
+    unsigned int consumed;
+    bool found = false;
+
+    for(;;)
+    {
+        // Make sure at least one complete candidate is buffered
+        if( buffered - start < cand + sync_bytes )
+        {
+            if( ReadIntoBuffer() )
+                continue;
+            // EOF before a sync: everything up to the end is consumed
+            consumed = buffered - start;
+            break;
+        }
+
+        unsigned int last_cand = buffered - start - sync_bytes;
+        if( last_cand > max_cand )
+            last_cand = max_cand;
+
+        const uint8_t *base = bfr + start;
+        const uint8_t *p = base + cand + sync_bytes - 1;
+        const uint8_t *end = base + last_cand + sync_bytes;
+        while( p < end )
+        {
+            p = static_cast<const uint8_t *>(memchr( p, last, end - p ));
+            if( p == 0 )
+                break;
+            const uint8_t *c = p - (sync_bytes - 1);
+            if( memcmp( c, pattern, sync_bytes - 1 ) == 0 )
+            {
+                cand = static_cast<unsigned int>(c - base);
+                found = true;
+                break;
+            }
+            ++p;
+        }
+        if( found )
+        {
+            consumed = cand + sync_bytes;
+            break;
+        }
+        if( last_cand == max_cand )
+        {
+            // Search limit reached
+            consumed = max_cand + sync_bytes;
+            break;
+        }
+        cand = last_cand + 1;
+    }
+
+    byteidx = start + consumed;
+    bitreadpos += static_cast<bitcount_t>(consumed) * 8;
+    if( byteidx == buffered && !eobs )
+        ReadIntoBuffer();
+    return found && !eobs;
+}
+
 /****************
  *
  * Move the bit read position forward a specified number of bytes
@@ -293,30 +441,61 @@ void IBitStream::SeekFwdBits( unsigned int bytes_to_seek_fwd)
 
 /**
   Flushes all read input up-to *but not including* byte flush_upto.
+  The buffer space is only reclaimed by Compact.
   @param flush_to the number of bits to flush
 */
 
 void IBitStream::Flush(bitcount_t flush_upto )
 {
+    pthread_mutex_lock( &buffer_lock );
 	if( flush_upto > bfr_start+buffered )
 		mjpeg_error_exit1("INTERNAL ERROR: attempt to flush input beyond buffered amount" );
 
 	if( flush_upto < bfr_start )
 		mjpeg_error_exit1("INTERNAL ERROR: attempt to flush input stream before  first buffered byte %lld last is %lld", flush_upto, bfr_start );
 
-	unsigned int bytes_to_flush = 
-		static_cast<unsigned int>(flush_upto - bfr_start);
+    if( flush_upto > flushed_to )
+        flushed_to = flush_upto;
+    pthread_mutex_unlock( &buffer_lock );
+}
+
+/**
+  Reclaims the buffer space of flushed input.  This moves the buffered
+  data so it may only be called by the thread scanning the stream and
+  not in the middle of a scan (e.g. between PrepareUndo and
+  UndoChanges).
+*/
+
+void IBitStream::Compact()
+{
+    pthread_mutex_lock( &buffer_lock );
+	bitcount_t flush_upto = flushed_to;
+
+	//
+	// Keep what shared readers have still to copy
+	//
+	std::vector<ISharedBitStream *>::iterator s;
+	for( s = sharers.begin(); s != sharers.end(); ++s )
+	{
+		if( (*s)->CopiedTo() < flush_upto )
+			flush_upto = (*s)->CopiedTo();
+	}
+
 	//
 	// Don't bother actually flushing until a good fraction of a buffer
 	// will be cleared.
 	//
 
-	if( bytes_to_flush < bfr_size/2 )
-		return;
-	buffered -= bytes_to_flush;
-	bfr_start = flush_upto;
-	byteidx -= bytes_to_flush;
-	memmove( bfr, bfr+bytes_to_flush, static_cast<size_t>(buffered));
+	if( flush_upto >= bfr_start + bfr_size/2 )
+	{
+		unsigned int bytes_to_flush = 
+			static_cast<unsigned int>(flush_upto - bfr_start);
+		buffered -= bytes_to_flush;
+		bfr_start = flush_upto;
+		byteidx -= bytes_to_flush;
+		memmove( bfr, bfr+bytes_to_flush, static_cast<size_t>(buffered));
+	}
+    pthread_mutex_unlock( &buffer_lock );
 }
 
 
@@ -347,6 +526,7 @@ void IBitStream::UndoChanges( IBitStreamUndo &undo)
 unsigned int IBitStream::GetBytes(uint8_t *dst, unsigned int length)
 {
 	unsigned int to_read = length;
+    pthread_mutex_lock( &buffer_lock );
 	if( bytereadpos < bfr_start)
 		mjpeg_error_exit1("INTERNAL ERROR: access to input stream buffer @ %lld: before first buffered byte (%lld)", bytereadpos, bfr_start );
 
@@ -371,9 +551,27 @@ unsigned int IBitStream::GetBytes(uint8_t *dst, unsigned int length)
 	// read
 	//flush( bytereadpos );
 	bytereadpos += to_read;
+    pthread_mutex_unlock( &buffer_lock );
 	return to_read;
 }
 
+unsigned int IBitStream::BufferedBytes()
+{
+    pthread_mutex_lock( &buffer_lock );
+    unsigned int buffered_bytes = 
+        static_cast<unsigned int>(bfr_start+buffered-bytereadpos);
+    pthread_mutex_unlock( &buffer_lock );
+    return buffered_bytes;
+}
+
+bitcount_t IBitStream::BufferedTo()
+{
+    pthread_mutex_lock( &buffer_lock );
+    bitcount_t buffered_to = bfr_start+buffered;
+    pthread_mutex_unlock( &buffer_lock );
+    return buffered_to;
+}
+
 /*****
  *
  * Bitstream reading is complete...
@@ -384,9 +582,152 @@ unsigned int IBitStream::GetBytes(uint8_t *dst, unsigned int length)
 
 void IBitStream::ScanDone()
 {
+    pthread_mutex_lock( &buffer_lock );
     scandone = true;
+    pthread_mutex_unlock( &buffer_lock );
+}
+
+
+/**
+   Set up a bit stream reading from an in-memory byte queue.  Blocks
+   until the producer has supplied the first buffer-full (or ended the
+   stream).
+   @param queue the byte queue to read from
+   @param name name used for the stream in messages
+   @param buf_size initial size of the scanning buffer
+*/
+IQueueBitStream::IQueueBitStream( mjpeg_bytequeue_t *_queue,
+                                  const char *name,
+                                  unsigned int buf_size ) :
+    IBitStream(),
+    queue( _queue )
+{
+    streamname = name;
+    SetBufSize(buf_size);
+    eobs = false;
+    byteidx = 0;
+    if (!ReadIntoBuffer())
+    {
+        if (buffered==0)
+            mjpeg_error_exit1( "Unable to read from %s.", name);
+    }
 }
 
+/**
+   Destructor: nothing more will be read so a producer still writing
+   must not block forever.
+*/
+IQueueBitStream::~IQueueBitStream()
+{
+    mjpeg_bytequeue_abort( queue );
+    Release();
+}
+
+size_t IQueueBitStream::ReadStreamBytes( uint8_t *buf, size_t number )
+{
+    return mjpeg_bytequeue_read( queue, buf, number );
+}
+
+bool IQueueBitStream::EndOfStream()
+{
+    return mjpeg_bytequeue_eof( queue );
+}
+
+/**
+   Set up a bit stream reading the data of another input bit stream
+   out of its buffer.  The source must not have been flushed yet.
+   @param source the stream whose data is to be read
+   @param buf_size initial size of the scanning buffer
+*/
+ISharedBitStream::ISharedBitStream( IBitStream &_source,
+                                    unsigned int buf_size ) :
+    IBitStream(),
+    source( _source ),
+    copied( 0 )
+{
+    if( source.bfr_start != 0 )
+        mjpeg_error_exit1( "INTERNAL ERROR: shared input stream already flushed" );
+    streamname = source.StreamName();
+    pthread_mutex_lock( &source.buffer_lock );
+    source.sharers.push_back( this );
+    pthread_mutex_unlock( &source.buffer_lock );
+    SetBufSize(buf_size);
+    eobs = false;
+    byteidx = 0;
+    if (!ReadIntoBuffer())
+    {
+        if (buffered==0)
+            mjpeg_error_exit1( "Unable to read from %s.", streamname);
+    }
+}
+
+ISharedBitStream::~ISharedBitStream()
+{
+    std::vector<ISharedBitStream *>::iterator s;
+    pthread_mutex_lock( &source.buffer_lock );
+    for( s = source.sharers.begin(); s != source.sharers.end(); ++s )
+    {
+        if( *s == this )
+        {
+            source.sharers.erase( s );
+            break;
+        }
+    }
+    pthread_mutex_unlock( &source.buffer_lock );
+    Release();
+}
+
+/**
+   Copy everything the source has buffered that we do not yet have.
+   This is how data gets here once the source is being scanned.  Only
+   our reader's thread uses our own buffer so it is appended to without
+   our buffer_lock.
+   @returns the number of bytes copied
+*/
+unsigned int ISharedBitStream::Sync()
+{
+    Compact();
+    pthread_mutex_lock( &source.buffer_lock );
+    unsigned int to_copy = 
+        static_cast<unsigned int>(source.bfr_start+source.buffered - copied);
+    if( to_copy > 0 )
+    {
+        memcpy( StartAppendPoint(to_copy), 
+                source.bfr+(static_cast<unsigned int>(copied-source.bfr_start)),
+                to_copy );
+        Appended(to_copy);
+        copied += to_copy;
+    }
+    pthread_mutex_unlock( &source.buffer_lock );
+    return to_copy;
+}
+
+/**
+   Reads made while our own headers are parsed (before the source is
+   being scanned) fetch data the source has not yet buffered for it.
+*/
+size_t ISharedBitStream::ReadStreamBytes( uint8_t *buf, size_t number )
+{
+    while( source.BufferedTo() - copied < number 
+           && source.ReadAhead( static_cast<unsigned int>(number) ) > 0 )
+        ;
+    pthread_mutex_lock( &source.buffer_lock );
+    size_t to_copy = 
+        static_cast<size_t>(source.bfr_start+source.buffered - copied);
+    if( to_copy > number )
+        to_copy = number;
+    memcpy( buf, 
+            source.bfr+(static_cast<unsigned int>(copied-source.bfr_start)),
+            to_copy );
+    copied += to_copy;
+    pthread_mutex_unlock( &source.buffer_lock );
+    return to_copy;
+}
+
+bool ISharedBitStream::EndOfStream()
+{
+    return copied == source.BufferedTo() && source.EndOfStream();
+}
 
 #ifdef REDUNDANT_CODE
 /**
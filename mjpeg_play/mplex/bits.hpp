@@ -3,9 +3,13 @@
 
 #include <stdio.h>
 #include <assert.h>
+#include <vector>
+#include <pthread.h>
+#include "bytequeue.h"
 
 typedef uint64_t bitcount_t;
 
+class ISharedBitStream;
 
 class BitStreamBuffering
 {
@@ -104,6 +108,12 @@ protected:
  * needs to buffered to be flushed from the buffer (and buffer space
  * reclaimed!).
  *
+ * The buffer may be scanned by one thread while another reads bytes
+ * from it or copies them (see ISharedBitStream).  Only the scanning
+ * thread appends to the buffer, grows it or reclaims flushed space
+ * (Compact) and it does so with buffer_lock held.  The byte-level
+ * entry-points hold buffer_lock while they touch the buffer.
+ *
  *
  * INVARIANT: only data items up to the bit-level file-pointer can be 'read'
  * It is possible to undo bit-level parsing calls back up the last flush.
@@ -126,10 +136,16 @@ class IBitStream : public IBitStreamUndo, public BitStreamBuffering
 public:
  	IBitStream() :
 		IBitStreamUndo(),
-		streamname( "unnamed" )
+		streamname( "unnamed" ),
+		flushed_to( 0 )
 		{
+			pthread_mutex_init( &buffer_lock, NULL );
+		}
+	virtual ~IBitStream() 
+		{ 
+			Release(); 
+			pthread_mutex_destroy( &buffer_lock );
 		}
-	virtual ~IBitStream() { Release(); }
 
 
 	// Bit-level Parsing file-pointer entry-points
@@ -144,16 +160,16 @@ public:
 
 	// Byte-level file-I/O entry-points
 	inline bitcount_t GetBytePos() { return bytereadpos; }
-	inline unsigned int BufferedBytes()
-		{
-			return static_cast<unsigned int>(bfr_start+buffered-bytereadpos);
-		}
+	unsigned int BufferedBytes();
 	unsigned int GetBytes( uint8_t *dst,
 						   unsigned int length_bytes);
+	bitcount_t BufferedTo();
+	unsigned int ReadAhead( unsigned int to_read );
 
 	//
 	// Byte data buffer management
 	void Flush( bitcount_t byte_position );
+	void Compact();
     
     //
     // Reading from stream is done...
@@ -162,10 +178,69 @@ public:
 	inline const char *StreamName() { return streamname; }
 protected:
 	bool ReadIntoBuffer( unsigned int to_read = BUFFER_SIZE );
+	bool SeekSyncBytes( uint32_t sync, unsigned int sync_bytes, int lim );
 	virtual size_t ReadStreamBytes( uint8_t *buf, size_t number ) = 0;
 	virtual bool EndOfStream() = 0;
 	const char *streamname;
+	pthread_mutex_t buffer_lock;
+	bitcount_t flushed_to;		// Data before here is no longer needed
+
+	//
+	// Readers copying our buffered data (see ISharedBitStream).  Data
+	// is not flushed until they have all copied it.
+	//
+	friend class ISharedBitStream;
+	std::vector<ISharedBitStream *> sharers;
+
+};
+
+/***************************************
+ *
+ * ISharedBitStream - Input bit stream that reads another input bit
+ * stream's data out of that stream's buffer, so that one read of the
+ * input can be parsed by several readers.  Sync may be called while
+ * the source is being scanned by another thread: it copies under the
+ * source's buffer_lock.  Sync and the reads of a shared stream must
+ * all come from one thread.
+ *
+ ******************************************/
 
+class ISharedBitStream : public IBitStream
+{
+public:
+	ISharedBitStream( IBitStream &source, 
+					  unsigned int buf_size = BUFFER_SIZE );
+	~ISharedBitStream();
+	inline IBitStream &Source() { return source; }
+	inline bitcount_t CopiedTo() { return copied; }
+	unsigned int Sync();
+private:
+	virtual size_t ReadStreamBytes( uint8_t *buf, size_t number );
+	virtual bool EndOfStream();
+	IBitStream &source;
+	bitcount_t copied;			// Source data up to here has been copied
+};
+
+/***************************************
+ *
+ * IQueueBitStream - Input bit stream read from an in-memory byte queue
+ * filled by a producer thread in the same process (e.g. mpeg2enc's
+ * QueueStrmWriter).  Allows encoding and multiplexing to run
+ * concurrently with no intermediate file or FIFO.
+ *
+ ******************************************/
+
+class IQueueBitStream : public IBitStream
+{
+public:
+	IQueueBitStream( mjpeg_bytequeue_t *queue, 
+					 const char *name = "queue",
+					 unsigned int buf_size = BUFFER_SIZE );
+	~IQueueBitStream();
+private:
+	virtual size_t ReadStreamBytes( uint8_t *buf, size_t number );
+	virtual bool EndOfStream();
+	mjpeg_bytequeue_t *queue;
 };
 
 #ifdef REDUNDANT_CODE
@@ -24,6 +24,8 @@
 #include <config.h>
 #include <assert.h>
 #include <limits.h>
+#include <string.h>
+#include <errno.h>
 
 #include "mjpeg_types.h"
 #include "inputstrm.hpp"
@@ -67,9 +69,21 @@ MuxStream::BufferSizeCode()
 }
 
 
+const unsigned int ElementaryStream::SHARED_PARSE_LAG = 8*1024*1024;
+
 ElementaryStream::ElementaryStream( IBitStream &ibs,
                                     Multiplexor &into, stream_kind _kind) : 
 
+    parse_owner(0),
+    shared_bs(0),
+    parser_running(false),
+    parser_stop(false),
+    parser_idle(false),
+    parser_held_by(0),
+    scan_complete(false),
+    au_demand(0),
+    parse_ahead(0),
+    read_pos(0),
     stream_length(0),
     bs( ibs ),
     eoscan(false),
@@ -82,12 +96,271 @@ ElementaryStream::ElementaryStream( IBitStream &ibs,
     buffer_min(INT_MAX),
     buffer_max(1)
 {
+    pthread_mutex_init( &scan_lock, NULL );
+    pthread_cond_init( &scan_progress, NULL );
+    pthread_cond_init( &scan_demand, NULL );
 }
 
 ElementaryStream::~ElementaryStream ()
 {
-    if( au != 0 )
-        delete au;
+    StopParsing();
+    pthread_cond_destroy( &scan_demand );
+    pthread_cond_destroy( &scan_progress );
+    pthread_mutex_destroy( &scan_lock );
+}
+
+/***********************************
+ *
+ * Start a thread that scans the elementary stream ahead of the muxer
+ * so that parsing of the different input streams proceeds in parallel
+ * with each other and with the packetising itself.  The parser keeps a
+ * bounded number of AU's buffered (more only if the muxer asks for a
+ * longer look-ahead).  The resulting AU sequence is identical to that
+ * produced by scanning on demand.
+ *
+ **********************************/
+
+void ElementaryStream::StartParsing()
+{
+    if( parser_running || parse_owner != 0 )
+        return;
+    pthread_mutex_lock( &scan_lock );
+    scan_complete = eoscan;
+    if( scan_complete )
+    {
+        // Nothing left to scan for any followers either
+        pthread_cond_broadcast( &scan_progress );
+        pthread_mutex_unlock( &scan_lock );
+        return;
+    }
+    parse_ahead = 2*FRAME_CHUNK;
+    au_demand = 0;
+    parser_stop = false;
+    aunits.DeferAppends( true );
+    parser_running = true;
+    pthread_mutex_unlock( &scan_lock );
+    if( pthread_create( &parser_thread, NULL,
+                        &ElementaryStream::ParserThreadWrapper, this ) != 0 )
+    {
+        mjpeg_error_exit1( "parser thread creation failed: %s", 
+                           strerror(errno) );
+    }
+}
+
+void ElementaryStream::StopParsing()
+{
+    if( parse_owner != 0 )
+    {
+        // Stop following: give back the AU's we still hold
+        LockScanning();
+        aunits.Release( au );
+        au = 0;
+        aunits.Unfollow();
+        vector<ElementaryStream *> &followers = parse_owner->parse_followers;
+        vector<ElementaryStream *>::iterator f;
+        for( f = followers.begin(); f != followers.end(); ++f )
+        {
+            if( *f == this )
+            {
+                followers.erase( f );
+                break;
+            }
+        }
+        if( parse_owner->parser_held_by == this )
+            parse_owner->parser_held_by = 0;
+        pthread_cond_signal( &parse_owner->scan_demand );
+        UnlockScanning();
+        parse_owner = 0;
+        return;
+    }
+    if( !parser_running )
+        return;
+    pthread_mutex_lock( &scan_lock );
+    parser_stop = true;
+    pthread_cond_signal( &scan_demand );
+    pthread_mutex_unlock( &scan_lock );
+    pthread_join( parser_thread, NULL );
+    parser_running = false;
+    aunits.DeferAppends( false );
+}
+
+/***********************************
+ *
+ * Follow the scan of owner (the same input, read for another output)
+ * instead of scanning our own copy of it: our AU's are those its
+ * parser thread appends and our data is copied from its buffer.  Must
+ * be called before either stream is muxed.  Returns false if owner
+ * does not scan the input our ISharedBitStream reads.
+ *
+ **********************************/
+
+bool ElementaryStream::ShareParse( ElementaryStream &owner )
+{
+    ISharedBitStream *shared = dynamic_cast<ISharedBitStream *>(&bs);
+    if( shared == 0 || &shared->Source() != &owner.bs )
+        return false;
+    shared_bs = shared;
+    parse_owner = &owner;
+    owner.parse_followers.push_back( this );
+    aunits.Follow( owner.aunits );
+    eoscan = false;
+    return true;
+}
+
+void *ElementaryStream::ParserThreadWrapper( void *stream )
+{
+    static_cast<ElementaryStream *>(stream)->ParseAhead();
+    return 0;
+}
+
+void ElementaryStream::ParseAhead()
+{
+    pthread_mutex_lock( &scan_lock );
+    while( !scan_complete && !(parser_stop && parse_followers.empty()) )
+    {
+        if( !ParseWanted() )
+        {
+            parser_idle = true;
+            pthread_cond_wait( &scan_demand, &scan_lock );
+            parser_idle = false;
+            continue;
+        }
+        // The muxers see nothing of the chunk until it is published
+        // so it is scanned without the lock
+        pthread_mutex_unlock( &scan_lock );
+        bs.Compact();
+        FillAUbuffer(FRAME_CHUNK);
+        if( eoscan )
+            bs.ScanDone();
+        pthread_mutex_lock( &scan_lock );
+        aunits.Publish();
+        scan_complete = eoscan;
+        pthread_cond_broadcast( &scan_progress );
+    }
+    pthread_mutex_unlock( &scan_lock );
+}
+
+/***********************************
+ *
+ * Should the parser thread scan more?  Only if we or one of our
+ * followers is short of AU's or data.  When the scan is shared it is
+ * also held back (parser_held_by is set) while a reader that is not
+ * waiting for any scan lags more than SHARED_PARSE_LAG bytes behind:
+ * otherwise the data buffered for a slow output would grow without
+ * limit.  The reader wakes the parser again once it has caught up
+ * (see MuxProgress) and its multiplexor does so when it starts
+ * waiting for a scan (see WakeParser).
+ *
+ **********************************/
+
+bool ElementaryStream::ParseWanted()
+{
+    ElementaryStream *lagging = 0;
+    bool wanted = ParseWantedBy( *this, lagging );
+    vector<ElementaryStream *>::iterator f;
+    for( f = parse_followers.begin(); f != parse_followers.end(); ++f )
+        wanted |= ParseWantedBy( **f, lagging );
+    parser_held_by = wanted && !parse_followers.empty() ? lagging : 0;
+    return wanted && parser_held_by == 0;
+}
+
+bool ElementaryStream::ParseWantedBy( ElementaryStream &reader, 
+                                      ElementaryStream *&lagging )
+{
+    bitcount_t unread = bs.BufferedTo() - reader.read_pos;
+    if( lagging == 0 && reader.au_demand == 0 && unread > SHARED_PARSE_LAG 
+        && !reader.muxinto.WaitingForScan() )
+        lagging = &reader;
+    unsigned int wanted = reader.au_demand > parse_ahead 
+                          ? reader.au_demand : parse_ahead;
+    return reader.aunits.MaxAULookahead() < wanted 
+        || unread < reader.muxinto.sector_size;
+}
+
+/***********************************
+ *
+ * Wake the parser thread of the scan we share if it is held back: our
+ * multiplexor has started waiting for a scan so none of its streams
+ * may hold a scan back any longer.  Must be called without the scan
+ * lock held.
+ *
+ **********************************/
+
+void ElementaryStream::WakeParser()
+{
+    if( !ScanThreaded() )
+        return;
+    LockScanning();
+    if( ScanOwner().parser_held_by != 0 )
+        pthread_cond_broadcast( &ScanOwner().scan_demand );
+    UnlockScanning();
+}
+
+/***********************************
+ *
+ * Muxer-side access to the scanning state: the scan lock of our
+ * parser thread or of the stream whose scan we follow.
+ *
+ **********************************/
+
+void ElementaryStream::LockScanning()
+{
+    if( ScanThreaded() )
+        pthread_mutex_lock( &ScanOwner().scan_lock );
+}
+
+void ElementaryStream::UnlockScanning()
+{
+    if( ScanThreaded() )
+        pthread_mutex_unlock( &ScanOwner().scan_lock );
+}
+
+/***********************************
+ *
+ * Report how far we have muxed to the parser thread and wake it if it
+ * is idle and our AU's are running low or it is being held back until
+ * we catch up.  Called with the scan lock held.
+ *
+ **********************************/
+
+void ElementaryStream::MuxProgress()
+{
+    ElementaryStream &owner = ScanOwner();
+    read_pos = bs.GetBytePos();
+    if( !owner.parser_idle )
+        return;
+    if( owner.parser_held_by == this 
+        ? owner.bs.BufferedTo() - read_pos <= SHARED_PARSE_LAG
+        : owner.parser_held_by == 0 
+          && aunits.MaxAULookahead() <= owner.parse_ahead/2 )
+        pthread_cond_signal( &owner.scan_demand );
+}
+
+/***********************************
+ *
+ * Has the parser thread published enough AU's and data to permit a
+ * look-ahead of look_ahead AU's and the muxing of at least one
+ * sector?  Called with the scan lock held.
+ *
+ **********************************/
+
+bool ElementaryStream::ScanBuffered( unsigned int look_ahead )
+{
+    bool complete = ScanOwner().scan_complete;
+    if( parse_owner != 0 )
+    {
+        // The data for the AU's published so far is in the owner's
+        // buffer: copy it
+        shared_bs->Sync();
+        if( complete && !eoscan )
+        {
+            eoscan = true;
+            bs.ScanDone();
+        }
+    }
+    return complete ||
+        ( look_ahead < aunits.MaxAULookahead() 
+          && bs.BufferedBytes() >= muxinto.sector_size );
 }
 
 /***********************************
@@ -96,15 +369,41 @@ ElementaryStream::~ElementaryStream ()
  * permit look-ahead of look_ahead/processing AUs forward from the
  * current AU *and* the muxing of at least one sector.
  *
+ * With a parser thread (ours or that of the scan we follow) this
+ * waits for it.  Called with the scan lock held.
+ *
  **********************************/
 
 void 
 ElementaryStream::AUBufferLookaheadFill( unsigned int look_ahead)
 {
+    if( ScanThreaded() )
+    {
+        if( ScanBuffered( look_ahead ) )
+            return;
+        UnlockScanning();
+        muxinto.WaitingForScan( true );
+        LockScanning();
+        ElementaryStream &owner = ScanOwner();
+        while( !ScanBuffered( look_ahead ) )
+        {
+            if( look_ahead+1 > au_demand )
+                au_demand = look_ahead+1;
+            read_pos = bs.GetBytePos();
+            pthread_cond_signal( &owner.scan_demand );
+            pthread_cond_wait( &owner.scan_progress, &owner.scan_lock );
+        }
+        au_demand = 0;
+        UnlockScanning();
+        muxinto.WaitingForScan( false );
+        LockScanning();
+        return;
+    }
     while( !eoscan &&
            ( look_ahead+1 > aunits.MaxAULookahead() 
              || bs.BufferedBytes() < muxinto.sector_size ) )
     {
+        bs.Compact();
         FillAUbuffer(FRAME_CHUNK);
     }
     if( eoscan )
@@ -121,14 +420,17 @@ ElementaryStream::AUBufferLookaheadFill( unsigned int look_ahead)
 bool 
 ElementaryStream::NextAU()
 {
-    // Free up no longer needed AU record
-    if( au != 0 )
-        delete au;
     // Ensure we have enough in the AU buffer!
+    LockScanning();
+    // Recycle no longer needed AU record
+    aunits.Release( au );
     AUBufferLookaheadFill(1);
 
     // Get the details of the next AU to be muxed....
 	AUnit *p_au = aunits.Next();
+    if( ScanThreaded() )
+        MuxProgress();
+    UnlockScanning();
 	if( p_au != NULL )
 	{
 
@@ -146,11 +448,24 @@ ElementaryStream::NextAU()
 }
 
 
+bool
+ElementaryStream::EndOfScan()
+{
+    LockScanning();
+    bool end = ScanThreaded() ? ScanOwner().scan_complete : eoscan;
+    UnlockScanning();
+    return end;
+}
+
+
 AUnit *
 ElementaryStream::Lookahead( unsigned int n)
 {
+    LockScanning();
     AUBufferLookaheadFill(n);
-    return aunits.Lookahead( n );
+    AUnit *p_au = aunits.Lookahead( n );
+    UnlockScanning();
+    return p_au;
 }
 
 unsigned int 
@@ -286,8 +601,19 @@ ElementaryStream::SetSyncOffset( clockticks sync_offset )
 
 void ElementaryStream::BufferAndOutputSector( )
 {
+    LockScanning();
     AUBufferLookaheadFill(1);   // TODO is this really needed here?
+    UnlockScanning();
+    // No lock is needed for the packetising itself: NextAU and
+    // Lookahead take it for themselves and the data we read is safe
+    // from the scanning (see IBitStream and ISharedBitStream).
     OutputSector();
+    if( ScanThreaded() )
+    {
+        LockScanning();
+        MuxProgress();
+        UnlockScanning();
+    }
 }
 
 
@@ -26,6 +26,7 @@
 #include <vector>
 #include <sys/stat.h>
 #include <cassert>
+#include <pthread.h>
 
 #include "mjpeg_types.h"
 #include "mpegconsts.h"
@@ -191,6 +192,13 @@ public:
 
 	void SetSyncOffset( clockticks timestamp_delay );
 
+    void StartParsing();
+    void StopParsing();
+    void WakeParser();
+    bool ShareParse( ElementaryStream &owner );
+    inline bool ParseShared() { return !parse_followers.empty(); }
+    inline bool FollowsParse() { return parse_owner != 0; }
+
 	void BufferAndOutputSector();
  
 	inline bool BuffersInHeader() { return buffers_in_header; }
@@ -232,7 +240,53 @@ public:
     bitcount_t bytes_read;
 private:
     void AUBufferLookaheadFill( unsigned int look_ahead);
+    bool ScanBuffered( unsigned int look_ahead );
+    void MuxProgress();
+    static void *ParserThreadWrapper( void *stream );
+    void ParseAhead();
+    bool ParseWanted();
+    bool ParseWantedBy( ElementaryStream &reader, 
+                        ElementaryStream *&lagging );
+    inline bool ScanThreaded() { return parser_running || parse_owner != 0; }
+    inline ElementaryStream &ScanOwner() 
+        { return parse_owner != 0 ? *parse_owner : *this; }
+
+    //
+    // Parser thread state. When a parser thread is running it has
+    // sole use of the bit-level scanning side of 'bs' and scans
+    // without holding scan_lock: the AU's it appends to 'aunits' are
+    // deferred until the chunk scanned is published (along with
+    // eoscan as scan_complete) under scan_lock.  The muxer only holds
+    // scan_lock to take AU's from 'aunits', to wait for the parser and
+    // to report its progress.  Its byte-level reads and flushes of
+    // 'bs' need no scan_lock (see IBitStream).
+    //
+    // A stream whose scan is shared (see ShareParse) always has a
+    // parser thread.  Its followers do no scanning of their own: they
+    // take their AU's from its aunits under its scan_lock and copy its
+    // data through an ISharedBitStream.
+    //
+    static const unsigned int SHARED_PARSE_LAG;
+    ElementaryStream *parse_owner;  // Stream whose scan we follow
+    vector<ElementaryStream *> parse_followers;
+    ISharedBitStream *shared_bs;    // Our bs when following a scan
+    bool parser_running;
+    bool parser_stop;
+    bool parser_idle;               // Parser waiting for scan_demand...
+    ElementaryStream *parser_held_by; // ... held back for this reader
+    bool scan_complete;             // eoscan as published by the parser
+    pthread_t parser_thread;
+    pthread_mutex_t scan_lock;
+    pthread_cond_t scan_progress;   // Parser -> muxer: more AU's scanned
+    pthread_cond_t scan_demand;     // Muxer(s) -> parser: more AU's wanted
+    unsigned int au_demand;         // AU look-ahead muxer is waiting for
+    unsigned int parse_ahead;       // AU's parser buffers ahead
+    bitcount_t read_pos;            // Muxed to, as reported to the parser
 
+protected:
+    void LockScanning();
+    void UnlockScanning();
+    bool EndOfScan();   // eoscan as published to the muxer
 
 
 protected:
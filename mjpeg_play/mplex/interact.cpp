@@ -75,6 +75,8 @@ MultiplexJob::MultiplexJob()
     outfile_pattern = 0;
     packets_per_pack = 1;
     run_in_frames = 0;      // Select default run-in...
+    parallel_parse = false;
+    live_run_in = 0;        // Not live mode
     audio_tracks = 0;
     video_tracks = 0;
     subtitle_tracks = 0;
@@ -71,6 +71,8 @@ public:
   int max_segment_size;
   int min_pes_header_len;
   int run_in_frames;            // Run-in expressed in Frame intervals
+  bool parallel_parse;          // Scan each input stream in its own thread
+  int live_run_in;              // Live mode: max. run-in frames (0 = off)
   Workarounds workarounds;      // Special work-around flags that
                                 // constrain the syntax to suit
                                 // the foibles of particular MPEG
@@ -39,6 +39,8 @@
 #endif
 #include <ctype.h>
 #include <math.h>
+#include <errno.h>
+#include <pthread.h>
 #include "cpu_accel.h"
 #include "mjpeg_types.h"
 #include "mjpeg_logging.h"
@@ -75,10 +77,21 @@ lround(double x)
 
 
 
+/********************************
+ *
+ * FileOutputStream - output to a sequence of files.  The mux thread
+ * only copies the data it writes into large buffers.  Full buffers are
+ * written out (and segment files opened and closed) by a separate
+ * writer thread so that the muxer is not held up by slow output
+ * devices or network file systems.  The mux thread only waits if all
+ * WRITE_BUFFERS buffers are in flight.
+ *
+ ********************************/
+
 class FileOutputStream : public OutputStream
 {
 public:
-    FileOutputStream( const char *filename_pat );
+    FileOutputStream( const char *filename_pat, bool live = false );
     ~FileOutputStream();
     virtual int  Open( );
     virtual void Close();
@@ -87,45 +100,259 @@ public:
     virtual void Write(uint8_t *data, unsigned int len);
 
 private:
-    FILE *strm;
+    static const unsigned int WRITE_BUFFER_SIZE = 1024*1024;
+    static const unsigned int WRITE_BUFFERS = 8;
+    static const unsigned int WRITE_JOBS = WRITE_BUFFERS+2;
+
+    // A unit of work for the writer thread: write out data, then
+    // optionally close the current file and/or open a new one.
+    struct WriteJob
+    {
+        bool close_file;
+        char *open_filename;
+        uint8_t *data;
+        unsigned int len;
+    };
+
+    void QueueJob( bool close_file, const char *open_filename );
+    void QueueBuffer();
+    static void *WriterThreadWrapper( void *stream );
+    void Writer();
+    static void CloseAtExit();
+
+    FILE *strm;                 // Only touched by the writer thread
+    bool live;                  // Hand over every write immediately
     char *filename_pat;
     char *cur_filename;
     size_t cur_filename_len;
 
+    uint8_t *buffers[WRITE_BUFFERS];
+    uint8_t *free_buffers[WRITE_BUFFERS];
+    unsigned int num_free_buffers;
+    uint8_t *cur_buffer;
+    unsigned int cur_len;
+
+    WriteJob jobs[WRITE_JOBS];
+    unsigned int job_head;
+    unsigned int jobs_queued;
+    bool writer_running;
+    pthread_t writer_thread;
+    pthread_t mux_thread;
+    pthread_mutex_t lock;
+    pthread_cond_t job_queued;
+    pthread_cond_t job_done;
+
+    // Streams with a running writer thread. Error exits from the
+    // mux thread close them so that everything muxed so far is
+    // written, just as exit() would flush stdio buffers.  With
+    // extra outputs several mux threads may open streams at once.
+    static const unsigned int MAX_OPEN_STREAMS = 16;
+    static FileOutputStream *open_streams[MAX_OPEN_STREAMS];
+    static pthread_mutex_t open_streams_lock;
 };
 
+FileOutputStream *
+FileOutputStream::open_streams[FileOutputStream::MAX_OPEN_STREAMS];
+pthread_mutex_t FileOutputStream::open_streams_lock = PTHREAD_MUTEX_INITIALIZER;
 
 
-FileOutputStream::FileOutputStream( const char *name_pat ) 
+
+FileOutputStream::FileOutputStream( const char *name_pat, bool _live ) :
+    strm( 0 ),
+    live( _live ),
+    num_free_buffers( 0 ),
+    cur_buffer( 0 ),
+    cur_len( 0 ),
+    job_head( 0 ),
+    jobs_queued( 0 ),
+    writer_running( false )
 {
     filename_pat = strcpy( new char[strlen(name_pat)+1], name_pat );
     cur_filename_len = strlen(filename_pat)+sizeof(segment_num)*3+1;
     cur_filename = new char[cur_filename_len];
     snprintf( cur_filename, cur_filename_len, filename_pat, segment_num );
+    for( unsigned int i = 0; i < WRITE_BUFFERS; ++i )
+    {
+        buffers[i] = new uint8_t[WRITE_BUFFER_SIZE];
+        free_buffers[num_free_buffers++] = buffers[i];
+    }
+    pthread_mutex_init( &lock, NULL );
+    pthread_cond_init( &job_queued, NULL );
+    pthread_cond_init( &job_done, NULL );
 }
 
 FileOutputStream::~FileOutputStream()
 {
+    if( writer_running )
+        Close();
+    pthread_cond_destroy( &job_done );
+    pthread_cond_destroy( &job_queued );
+    pthread_mutex_destroy( &lock );
+    for( unsigned int i = 0; i < WRITE_BUFFERS; ++i )
+        delete [] buffers[i];
     delete [] filename_pat;
     delete [] cur_filename;
 }
 
+/*
+ * Hand a job to the writer thread, waiting if the job queue is full.
+ * The current buffer (if any) goes with it and a free buffer is
+ * fetched for subsequent writes.
+ */
+
+void FileOutputStream::QueueJob( bool close_file, const char *open_filename )
+{
+    pthread_mutex_lock( &lock );
+    while( jobs_queued == WRITE_JOBS )
+        pthread_cond_wait( &job_done, &lock );
+    WriteJob &job = jobs[(job_head+jobs_queued)%WRITE_JOBS];
+    job.close_file = close_file;
+    job.open_filename = 
+        open_filename != 0 
+        ? strcpy( new char[strlen(open_filename)+1], open_filename )
+        : 0;
+    job.data = cur_len > 0 ? cur_buffer : 0;
+    job.len = cur_len;
+    ++jobs_queued;
+    pthread_cond_signal( &job_queued );
+    if( job.data != 0 )
+    {
+        while( num_free_buffers == 0 )
+            pthread_cond_wait( &job_done, &lock );
+        cur_buffer = free_buffers[--num_free_buffers];
+        cur_len = 0;
+    }
+    pthread_mutex_unlock( &lock );
+}
+
+void FileOutputStream::QueueBuffer()
+{
+    if( cur_len > 0 )
+        QueueJob( false, 0 );
+}
+
+void *FileOutputStream::WriterThreadWrapper( void *stream )
+{
+    static_cast<FileOutputStream *>(stream)->Writer();
+    return 0;
+}
+
+void FileOutputStream::Writer()
+{
+    bool finished = false;
+    pthread_mutex_lock( &lock );
+    while( !finished )
+    {
+        while( jobs_queued == 0 )
+            pthread_cond_wait( &job_queued, &lock );
+        WriteJob job = jobs[job_head];
+        pthread_mutex_unlock( &lock );
+
+        if( job.data != 0 )
+        {
+            if( fwrite( job.data, 1, job.len, strm ) != job.len )
+            {
+                mjpeg_error_exit1( "Failed write: %s", strerror(errno) );
+            }
+            if( live && fflush( strm ) != 0 )
+                mjpeg_error_exit1( "Failed write: %s", strerror(errno) );
+        }
+        finished = job.close_file && job.open_filename == 0;
+        if( job.close_file && strm != 0 )
+        {
+            if( fclose(strm) != 0 )
+                mjpeg_error_exit1( "Failed write: %s", strerror(errno) );
+            strm = 0;
+        }
+        if( job.open_filename != 0 )
+        {
+            strm = fopen( job.open_filename, "wb" );
+            if( strm == NULL )
+            {
+                mjpeg_error_exit1( "Could not open for writing: %s", 
+                                   job.open_filename );
+            }
+            delete [] job.open_filename;
+        }
+
+        pthread_mutex_lock( &lock );
+        if( job.data != 0 )
+            free_buffers[num_free_buffers++] = job.data;
+        job_head = (job_head+1)%WRITE_JOBS;
+        --jobs_queued;
+        pthread_cond_signal( &job_done );
+    }
+    pthread_mutex_unlock( &lock );
+}
+
+      
+void FileOutputStream::CloseAtExit()
+{
+    for( unsigned int i = 0; i < MAX_OPEN_STREAMS; ++i )
+    {
+        pthread_mutex_lock( &open_streams_lock );
+        FileOutputStream *stream = open_streams[i];
+        pthread_mutex_unlock( &open_streams_lock );
+        if( stream != 0 && pthread_equal( stream->mux_thread, pthread_self() ) )
+            stream->Close();
+    }
+}
       
 int FileOutputStream::Open()
 {
+    static bool at_exit_registered = false;
     segment_len = 0;
-	strm = fopen( cur_filename, "wb" );
-	if( strm == NULL )
-	{
-		mjpeg_error_exit1( "Could not open for writing: %s", cur_filename );
-	}
-
+    if( !writer_running )
+    {
+        pthread_mutex_lock( &open_streams_lock );
+        if( !at_exit_registered )
+        {
+            atexit( &FileOutputStream::CloseAtExit );
+            at_exit_registered = true;
+        }
+        for( unsigned int i = 0; i < MAX_OPEN_STREAMS; ++i )
+        {
+            if( open_streams[i] == 0 )
+            {
+                open_streams[i] = this;
+                break;
+            }
+        }
+        pthread_mutex_unlock( &open_streams_lock );
+        mux_thread = pthread_self();
+        pthread_mutex_lock( &lock );
+        cur_buffer = free_buffers[--num_free_buffers];
+        cur_len = 0;
+        pthread_mutex_unlock( &lock );
+        if( pthread_create( &writer_thread, NULL,
+                            &FileOutputStream::WriterThreadWrapper, 
+                            this ) != 0 )
+        {
+            mjpeg_error_exit1( "output thread creation failed: %s", 
+                               strerror(errno) );
+        }
+        writer_running = true;
+    }
+    QueueJob( false, cur_filename );
 	return 0;
 }
 
 void FileOutputStream::Close()
 { 
-    fclose(strm);
+    // Last data goes out with the final close, which also stops the
+    // writer thread
+    QueueJob( true, 0 );
+    pthread_join( writer_thread, NULL );
+    writer_running = false;
+    pthread_mutex_lock( &open_streams_lock );
+    for( unsigned int i = 0; i < MAX_OPEN_STREAMS; ++i )
+    {
+        if( open_streams[i] == this )
+            open_streams[i] = 0;
+    }
+    pthread_mutex_unlock( &open_streams_lock );
+    free_buffers[num_free_buffers++] = cur_buffer;
+    cur_buffer = 0;
 }
 
 
@@ -140,7 +367,6 @@ FileOutputStream::NextSegment( )
 {
     auto_ptr<char> prev_filename_buf( new char[strlen(cur_filename)+1] );
     char *prev_filename = prev_filename_buf.get();
-	fclose(strm);
 	++segment_num;
     strcpy( prev_filename, cur_filename );
 	snprintf( cur_filename, cur_filename_len, filename_pat, segment_num );
@@ -149,22 +375,31 @@ FileOutputStream::NextSegment( )
 		mjpeg_error_exit1( 
 			"Need to split output but there appears to be no %%d in the filename pattern %s", filename_pat );
 	}
-	strm = fopen( cur_filename, "wb" );
-	if( strm == NULL )
-	{
-		mjpeg_error_exit1( "Could not open for writing: %s", cur_filename );
-	}
+    // Buffered data belongs to the previous segment and is written
+    // before the switch-over.
+    QueueBuffer();
+    QueueJob( true, cur_filename );
     segment_len = 0;
 }
 
 void
 FileOutputStream::Write( uint8_t *buf, unsigned int len )
 {
-    if( fwrite( buf, 1, len, strm ) != len )
+    segment_len += static_cast<uint64_t>(len);
+    while( len > 0 )
     {
-        mjpeg_error_exit1( "Failed write: %s", cur_filename );
+        unsigned int to_copy = WRITE_BUFFER_SIZE - cur_len;
+        if( to_copy > len )
+            to_copy = len;
+        memcpy( cur_buffer+cur_len, buf, to_copy );
+        cur_len += to_copy;
+        buf += to_copy;
+        len -= to_copy;
+        if( cur_len == WRITE_BUFFER_SIZE )
+            QueueBuffer();
     }
-    segment_len += static_cast<uint64_t>(len);
+    if( live )
+        QueueBuffer();
 }
 
 
@@ -188,23 +423,35 @@ class IFileBitStream : public IBitStream
 {
 public:
  	IFileBitStream( const char *bs_filename, 
+                    bool live = false,
 					unsigned int buf_size = BUFFER_SIZE);
 	~IFileBitStream();
 
 private:
 	FILE *fileh;
 	char *filename;
+    bool live;                  // Return whatever data is available
+    bool at_eof;                // ... in which case we track EOF ourselves
 	virtual size_t ReadStreamBytes( uint8_t *buf, size_t number ) 
 		{
+            if( live )
+                return ReadAvailable( buf, number );
 			return fread(buf,sizeof(uint8_t), number, fileh ); 
 		}
-	virtual bool EndOfStream() { return feof(fileh) != 0; }
+	virtual bool EndOfStream() 
+        { 
+            return live ? at_eof : feof(fileh) != 0; 
+        }
+    size_t ReadAvailable( uint8_t *buf, size_t number );
 	
 };
 
 IFileBitStream::IFileBitStream( const char *bs_filename,
+                                bool _live,
                                 unsigned int buf_size) :
-    IBitStream()
+    IBitStream(),
+    live( _live ),
+    at_eof( false )
 {
 	if ((fileh = fopen(bs_filename, "rb")) == NULL)
 	   mjpeg_error_exit1( "Unable to open file %s for reading.", bs_filename);
@@ -221,6 +468,30 @@ IFileBitStream::IFileBitStream( const char *bs_filename,
 	   }
 }
 
+/**
+   Live input: rather than waiting (as fread does) for a complete
+   buffer-full from a pipe or capture device return as soon as some
+   data is available.  A zero count still only occurs at EOF.
+*/
+size_t IFileBitStream::ReadAvailable( uint8_t *buf, size_t number )
+{
+    if( at_eof )
+        return 0;
+    for(;;)
+    {
+        ssize_t got = read( fileno(fileh), buf, number );
+        if( got > 0 )
+            return static_cast<size_t>(got);
+        if( got == 0 )
+        {
+            at_eof = true;
+            return 0;
+        }
+        if( errno != EINTR && errno != EAGAIN )
+            mjpeg_error_exit1( "Failed read: %s: %s", filename, strerror(errno) );
+    }
+}
+
 /**
    Destructor: close the device containing the bit stream after a read
    process
@@ -248,15 +519,33 @@ class CmdLineMultiplexJob : public MultiplexJob
 {
 public:
 	CmdLineMultiplexJob( unsigned int argc, char *argv[]);
+    ~CmdLineMultiplexJob();
+
+    // Jobs for the additional outputs (-X).  They share a single
+    // read and scan of the input files with this job.
+    vector<MultiplexJob *> extra_jobs;
 
 private:
+    static const unsigned int MAX_EXTRA_OUTPUTS = 7;
+    struct ExtraOutput
+    {
+        int mux_format;
+        int max_segment_size;
+        const char *outfile_pattern;
+    };
+
 	void InputStreamsFromCmdLine (unsigned int argc, char* argv[] );
+    void ShareInputStreams( vector<IBitStream *> &inputs );
+    MultiplexJob *ExtraOutputJob( const ExtraOutput &extra );
 	void Usage(char *program_name);
 	bool ParseVideoOpt( const char *optarg );
 	bool ParseLpcmOpt( const char *optarg );
 	bool ParseWorkaroundOpt( const char *optarg );
 	bool ParseTimeOffset( const char *optarg );
 	bool ParseSubtitleOptions( const char *optarg  );
+    bool ParseExtraOutput( const char *optarg );
+
+    vector<ExtraOutput> extra_outputs;
 
 	static const char short_options[];
 
@@ -267,7 +556,7 @@ private:
 };
 
 const char CmdLineMultiplexJob::short_options[] =
-        "o:i:b:r:O:v:f:l:s:S:p:W:L:R:VCMhd:";
+        "o:i:b:r:O:v:f:l:s:S:p:W:L:R:P:A:X:VCMhd:";
 #if defined(HAVE_GETOPT_LONG)
 struct option CmdLineMultiplexJob::long_options[] = 
 {
@@ -284,6 +573,9 @@ struct option CmdLineMultiplexJob::long_options[] =
     { "system-headers",    0, 0, 'h' },
     { "ignore-seqend-markers",     0, 0, 'M' },
     { "run-in",            1, 0, 'R' },
+    { "parallel-parse",    1, 0, 'P' },
+    { "live",              1, 0, 'A' },
+    { "extra-output",      1, 0, 'X' },
     { "max-segment-size",  1, 0, 'S' },
     { "mux-limit",          1, 0, 'l' },
     { "packets-per-pack",  1, 0, 'p' },
@@ -365,6 +657,21 @@ CmdLineMultiplexJob::CmdLineMultiplexJob(unsigned int argc, char *argv[]) :
                 Usage(argv[0]);
             break;
 
+        case 'P':
+            parallel_parse = atoi(optarg) != 0;
+            break;
+
+        case 'A':
+            live_run_in = atoi(optarg);
+            if( live_run_in < 1 || live_run_in > 100 )
+                Usage(argv[0]);
+            break;
+
+        case 'X':
+            if( ! ParseExtraOutput( optarg ) )
+                Usage(argv[0]);
+            break;
+
         case 'O':
             if( ! ParseTimeOffset(optarg) )
             {
@@ -429,6 +736,19 @@ CmdLineMultiplexJob::CmdLineMultiplexJob(unsigned int argc, char *argv[]) :
     {
         Usage(argv[0]);
     }
+    if( !extra_outputs.empty() )
+    {
+        // Stills are scanned to suit the output format so their scan
+        // cannot be shared
+        bool stills = MPEG_STILLS_FORMAT(mux_format);
+        for( unsigned int j = 0; j < extra_outputs.size(); ++j )
+            stills |= MPEG_STILLS_FORMAT(extra_outputs[j].mux_format);
+        if( stills )
+        {
+            mjpeg_error( "Extra outputs cannot be used with stills formats" );
+            Usage(argv[0]);
+        }
+    }
     (void)mjpeg_default_handler_verbosity(verbose);
     mjpeg_info( "mplex version %s (%s %s)",VERSION,MPLEX_VER,MPLEX_DATE );
 
@@ -473,6 +793,16 @@ void CmdLineMultiplexJob::Usage(char *str)
     "  Force constant bit-rate video multiplexing\n"
     "--run-in|-R num\n"
     "  Force a 'run-in' of exactly num frame intervals\n"
+    "--parallel-parse|-P 0|1\n"
+    "  Scan each input stream in its own thread (default: 0)\n"
+    "--extra-output|-X fmt[:size]:pattern\n"
+    "  Also multiplex to pattern in format fmt (segment size size MB)\n"
+    "  from the same read and scan of the inputs.  May be repeated.\n"
+    "  Not for stills formats.\n"
+    "--live|-A num\n"
+    "  Low-latency mode for live input: limit the run-in to num\n"
+    "  frame intervals [1..100] (or the shortest that avoids\n"
+    "  under-runs), scan AUs only on demand, flush output\n"
 	"--packets-per-pack|-p num\n"
     "  Number of packets per pack generic formats [1..100]\n"
 	"--system-headers|-h\n"
@@ -644,6 +974,29 @@ bool CmdLineMultiplexJob::ParseVideoOpt( const char *optarg )
     return true;
 }
 
+bool CmdLineMultiplexJob::ParseExtraOutput( const char *optarg )
+{
+    ExtraOutput extra;
+    char *endptr;
+    extra.mux_format = static_cast<int>(strtol( optarg, &endptr, 10 ));
+    if( endptr == optarg || *endptr != ':' 
+        || extra.mux_format < MPEG_FORMAT_MPEG1 
+        || extra.mux_format > MPEG_FORMAT_LAST 
+        || extra_outputs.size() == MAX_EXTRA_OUTPUTS )
+        return false;
+    const char *startptr = endptr+1;
+    extra.max_segment_size = static_cast<int>(strtol( startptr, &endptr, 10 ));
+    if( endptr != startptr && *endptr == ':' )
+        startptr = endptr+1;
+    else
+        extra.max_segment_size = 0;
+    if( *startptr == '\0' )
+        return false;
+    extra.outfile_pattern = startptr;
+    extra_outputs.push_back( extra );
+    return true;
+}
+
 bool CmdLineMultiplexJob::ParseTimeOffset(const char *optarg)
 {
     double f;
@@ -675,21 +1028,148 @@ void CmdLineMultiplexJob::InputStreamsFromCmdLine(unsigned int argc, char* argv[
     unsigned int i;
 	for( i = 1; i < argc; ++i )
     {
-		inputs.push_back( new IFileBitStream( argv[i] ) );
+		inputs.push_back( new IFileBitStream( argv[i], live_run_in != 0 ) );
 	}
+    if( !extra_outputs.empty() )
+        ShareInputStreams( inputs );
 	SetupInputStreams( inputs );
 }
 
+//
+// Several outputs: the jobs for the extra outputs read this job's
+// input files through ISharedBitStreams, so each file is only read
+// once (and, see Multiplexor::ShareParsing, only scanned once).
+//
+
+void CmdLineMultiplexJob::ShareInputStreams( vector<IBitStream *> &inputs )
+{
+    unsigned int i, j;
+    // The extra jobs must copy the user's stream parameters before
+    // SetupInputStreams adjusts them to suit this job's format.
+    for( j = 0; j < extra_outputs.size(); ++j )
+        extra_jobs.push_back( ExtraOutputJob( extra_outputs[j] ) );
+    for( j = 0; j < extra_jobs.size(); ++j )
+    {
+        vector<IBitStream *> shared;
+        for( i = 0; i < inputs.size(); ++i )
+            shared.push_back( new ISharedBitStream( *inputs[i] ) );
+        extra_jobs[j]->SetupInputStreams( shared );
+    }
+}
+
+MultiplexJob *CmdLineMultiplexJob::ExtraOutputJob( const ExtraOutput &extra )
+{
+    MultiplexJob *job = new MultiplexJob;
+    static_cast<MultiplexParams &>(*job) = *this;
+    job->mux_format = extra.mux_format;
+    job->max_segment_size = extra.max_segment_size;
+    job->outfile_pattern = extra.outfile_pattern;
+    job->vdr_index_pathname = 0;
+
+    vector<VideoParams *>::iterator vp;
+    for( vp = video_param.begin(); vp < video_param.end(); ++vp )
+        job->video_param.push_back( 
+            VideoParams::Checked( (*vp)->DecodeBufferSize() ) );
+    vector<LpcmParams *>::iterator lp;
+    for( lp = lpcm_param.begin(); lp < lpcm_param.end(); ++lp )
+        job->lpcm_param.push_back( 
+            LpcmParams::Checked( (*lp)->SamplesPerSec(), 
+                                 (*lp)->Channels(), 
+                                 (*lp)->BitsPerSample() ) );
+    vector<SubtitleStreamParams *>::iterator sp;
+    for( sp = subtitle_params.begin(); sp < subtitle_params.end(); ++sp )
+        job->subtitle_params.push_back(
+            SubtitleStreamParams::Checked( (*sp)->Offset(), (*sp)->StreamId() ) );
+    return job;
+}
+
+CmdLineMultiplexJob::~CmdLineMultiplexJob()
+{
+    for( unsigned int j = 0; j < extra_jobs.size(); ++j )
+        delete extra_jobs[j];
+}
+
+/*******************************
+ *
+ * Multiplexing of an extra output in its own thread.  The multiplexor
+ * is set up beforehand (in the main thread) as it must be linked to
+ * the main output's before either runs.
+ *
+ ******************************/
+
+static void ReleaseInputStreams( MultiplexJob &job )
+{
+    for( unsigned int i = 0; i < job.streams.size(); ++i )
+    {
+        delete job.streams[i]->bs;
+        job.streams[i]->bs = 0;
+    }
+}
+
+class OutputMuxThread
+{
+public:
+    OutputMuxThread( Multiplexor &_mux ) :
+        mux( _mux )
+        {
+            if( pthread_create( &thread, NULL, 
+                                &OutputMuxThread::ThreadWrapper, this ) != 0 )
+                mjpeg_error_exit1( "mux thread creation failed: %s", 
+                                   strerror(errno) );
+        }
+    void Join() { pthread_join( thread, NULL ); }
+private:
+    static void *ThreadWrapper( void *mux_thread )
+        {
+            static_cast<OutputMuxThread *>(mux_thread)->Run();
+            return 0;
+        }
+    void Run()
+        {
+            mux.Multiplex();
+        }
+    Multiplexor &mux;
+    pthread_t thread;
+};
+
 
 int main (int argc, char* argv[])
 {
 	CmdLineMultiplexJob job(argc,argv);
-	FileOutputStream output( job.outfile_pattern );
+	FileOutputStream output( job.outfile_pattern, job.live_run_in != 0 );
     FileOutputStream *index = job.vdr_index_pathname != 0 
                              ? new FileOutputStream( job.vdr_index_pathname ) 
                              : 0;
-	Multiplexor mux(job, output, index );
-	mux.Multiplex();
+    unsigned int i;
+    {
+        Multiplexor mux(job, output, index );
+        // Extra outputs follow the scan of the main output's inputs
+        // which must therefore stay until they are all done
+        vector<FileOutputStream *> extra_outputs;
+        vector<Multiplexor *> extra_muxes;
+        vector<OutputMuxThread *> extra_threads;
+        for( i = 0; i < job.extra_jobs.size(); ++i )
+        {
+            MultiplexJob &extra = *job.extra_jobs[i];
+            extra_outputs.push_back( 
+                new FileOutputStream( extra.outfile_pattern, 
+                                      extra.live_run_in != 0 ) );
+            extra_muxes.push_back( 
+                new Multiplexor( extra, *extra_outputs[i], 0 ) );
+            extra_muxes[i]->ShareParsing( mux );
+        }
+        for( i = 0; i < extra_muxes.size(); ++i )
+            extra_threads.push_back( new OutputMuxThread( *extra_muxes[i] ) );
+        mux.Multiplex();
+        for( i = 0; i < extra_threads.size(); ++i )
+        {
+            extra_threads[i]->Join();
+            delete extra_threads[i];
+            delete extra_muxes[i];
+            delete extra_outputs[i];
+            ReleaseInputStreams( *job.extra_jobs[i] );
+        }
+    }
     if( index != 0 )
         delete index;
     return (0);	
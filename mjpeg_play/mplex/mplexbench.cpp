@@ -0,0 +1,728 @@
+/*
+ *  mplexbench.cpp:  Multiplexor throughput / buffer model benchmark
+ *
+ *  Generates synthetic elementary streams in memory and multiplexes
+ *  them for a selection of format presets into an in-memory output
+ *  stream, reporting throughput, padding overhead and buffer
+ *  under-runs for each.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <vector>
+#include "mjpeg_types.h"
+#include "mjpeg_logging.h"
+#include "mpegconsts.h"
+
+#include "interact.hpp"
+#include "bits.hpp"
+#include "outputstrm.hpp"
+#include "multiplexor.hpp"
+
+using std::vector;
+
+typedef vector<uint8_t> ByteBuf;
+
+/******************************************************************
+ *
+ * Synthetic stream generation
+ *
+ ******************************************************************/
+
+/*
+ * Minimal MSB-first bit writer for assembling headers.
+ */
+
+class BitWriter
+{
+public:
+    BitWriter( ByteBuf &_buf ) : buf(_buf), acc(0), nbits(0) {}
+    void PutBits( uint32_t val, int n )
+        {
+            while( n-- > 0 )
+            {
+                acc = (acc << 1) | ((val >> n) & 1);
+                if( ++nbits == 8 )
+                {
+                    buf.push_back( static_cast<uint8_t>(acc) );
+                    acc = 0;
+                    nbits = 0;
+                }
+            }
+        }
+    void AlignBits()
+        {
+            if( nbits != 0 )
+                PutBits( 0, 8-nbits );
+        }
+    void StartCode( uint8_t code )
+        {
+            AlignBits();
+            PutBits( 0x000001, 24 );
+            PutBits( code, 8 );
+        }
+private:
+    ByteBuf &buf;
+    uint32_t acc;
+    int nbits;
+};
+
+/*
+ * Deterministic filler: never contains two zero bytes in a row so it
+ * cannot fake a start code.
+ */
+
+static uint32_t filler_seed = 12345;
+
+static void AppendFiller( ByteBuf &buf, unsigned int len )
+{
+    for( unsigned int i = 0; i < len; ++i )
+    {
+        filler_seed = filler_seed * 1103515245 + 12345;
+        buf.push_back( static_cast<uint8_t>((filler_seed >> 24) | 0x01) );
+    }
+}
+
+struct VideoSpec
+{
+    int mpeg;
+    unsigned int width, height;
+    unsigned int kbps;
+    unsigned int vbv_size;      // 16kbit units
+};
+
+/*
+ * Closed 12 frame GOPs, M=3, 25 frames/sec, sequence header before
+ * each GOP.  Picture sizes follow a I:P:B = 4:2:1 split of the bit-rate
+ * with up to 20% jitter downwards so the rate given in the sequence
+ * header is a true maximum. The coded picture data is a single slice
+ * of filler.
+ */
+
+static void GenerateVideo( ByteBuf &buf, const VideoSpec &spec,
+                           double duration )
+{
+    static const struct { int type; int tref; } gop[12] =
+        { {1,0}, {2,3}, {3,1}, {3,2}, {2,6}, {3,4},
+          {3,5}, {2,9}, {3,7}, {3,8}, {2,11}, {3,10} };
+    static const double weight[4] = { 0.0, 4.0, 2.0, 1.0 };
+    const unsigned int frame_rate_code = 3;
+    const double fps = 25.0;
+    unsigned int frames = static_cast<unsigned int>(duration * fps);
+    frames -= frames % 12;
+    double gop_bytes = spec.kbps * 1000.0 / 8.0 * 12.0 / fps;
+    double unit = gop_bytes / (4.0 + 3*2.0 + 8*1.0);
+    BitWriter bw( buf );
+    uint32_t jitter = 1;
+
+    for( unsigned int f = 0; f < frames; ++f )
+    {
+        unsigned int g = f % 12;
+        if( g == 0 )
+        {
+            bw.StartCode( 0xb3 );   // Sequence header
+            bw.PutBits( spec.width, 12 );
+            bw.PutBits( spec.height, 12 );
+            bw.PutBits( spec.mpeg == 1 ? 1 : 2, 4 );
+            bw.PutBits( frame_rate_code, 4 );
+            bw.PutBits( (spec.kbps * 1000 + 399) / 400, 18 );
+            bw.PutBits( 1, 1 );
+            bw.PutBits( spec.vbv_size, 10 );
+            bw.PutBits( spec.mpeg == 1 ? 1 : 0, 1 );
+            bw.PutBits( 0, 2 );
+            if( spec.mpeg == 2 )
+            {
+                bw.StartCode( 0xb5 );   // Sequence extension
+                bw.PutBits( 1, 4 );
+                bw.PutBits( 0x48, 8 );  // Main profile @ Main level
+                bw.PutBits( 1, 1 );     // Progressive
+                bw.PutBits( 1, 2 );     // 4:2:0
+                bw.PutBits( 0, 4 );
+                bw.PutBits( 0, 12 );
+                bw.PutBits( 1, 1 );
+                bw.PutBits( 0, 8 );
+                bw.PutBits( 0, 1 );
+                bw.PutBits( 0, 7 );
+            }
+            unsigned int secs = f / 25;
+            bw.StartCode( 0xb8 );   // GOP header
+            bw.PutBits( 0, 1 );
+            bw.PutBits( secs / 3600, 5 );
+            bw.PutBits( (secs / 60) % 60, 6 );
+            bw.PutBits( 1, 1 );
+            bw.PutBits( secs % 60, 6 );
+            bw.PutBits( f % 25, 6 );
+            bw.PutBits( 1, 1 );     // Closed GOP
+            bw.PutBits( 0, 1 );
+        }
+
+        size_t pict_start = buf.size();
+        int type = gop[g].type;
+        bw.StartCode( 0x00 );   // Picture header
+        bw.PutBits( gop[g].tref, 10 );
+        bw.PutBits( type, 3 );
+        bw.PutBits( 0xffff, 16 );
+        if( type != 1 )
+            bw.PutBits( spec.mpeg == 1 ? 1 : 7, 4 );
+        if( type == 3 )
+            bw.PutBits( spec.mpeg == 1 ? 1 : 7, 4 );
+        bw.PutBits( 0, 1 );
+        if( spec.mpeg == 2 )
+        {
+            bw.StartCode( 0xb5 );   // Picture coding extension
+            bw.PutBits( 8, 4 );
+            bw.PutBits( 0xffff, 16 );
+            bw.PutBits( 0, 2 );
+            bw.PutBits( 3, 2 );     // Frame picture
+            bw.PutBits( 0x106, 10 );    // Frame DCT, 4:2:0, progressive
+        }
+        bw.StartCode( 0x01 );   // Slice
+        jitter = jitter * 1103515245 + 12345;
+        double scale = 0.8 + 0.2 * ((jitter >> 16) & 0xff) / 255.0;
+        size_t size = static_cast<size_t>(unit * weight[type] * scale);
+        size_t used = buf.size() - pict_start;
+        AppendFiller( buf, size > used + 16 ? size - used : 16 );
+    }
+    bw.StartCode( 0xb7 );   // Sequence end
+}
+
+/*
+ * MPEG-1 layer II audio. Padding is inserted as an encoder would for
+ * sample rates where the frame size is not a whole number of bytes.
+ */
+
+static void GenerateMPA( ByteBuf &buf, unsigned int kbps,
+                         unsigned int freq, double duration )
+{
+    static const unsigned int kbps_table[] =
+        { 0,32,48,56,64,80,96,112,128,160,192,224,256,320,384 };
+    unsigned int rate_code = 1;
+    while( rate_code < 14 && kbps_table[rate_code] < kbps )
+        ++rate_code;
+    unsigned int freq_code = freq == 44100 ? 0 : freq == 48000 ? 1 : 2;
+    unsigned int frames = static_cast<unsigned int>(duration * freq / 1152);
+    unsigned int slot_rem = 144000 * kbps_table[rate_code] % freq;
+    unsigned int rem = 0;
+    BitWriter bw( buf );
+
+    for( unsigned int f = 0; f < frames; ++f )
+    {
+        rem += slot_rem;
+        unsigned int padding = rem >= freq;
+        if( padding )
+            rem -= freq;
+        unsigned int len = 144000 * kbps_table[rate_code] / freq + padding;
+        size_t start = buf.size();
+        bw.PutBits( 0x7ff, 11 );
+        bw.PutBits( 3, 2 );     // MPEG-1
+        bw.PutBits( 2, 2 );     // Layer II
+        bw.PutBits( 1, 1 );     // No CRC
+        bw.PutBits( rate_code, 4 );
+        bw.PutBits( freq_code, 2 );
+        bw.PutBits( padding, 1 );
+        bw.PutBits( 0, 9 );
+        buf.resize( start + len, 0 );
+    }
+}
+
+/*
+ * AC3 48kHz 192kbit/sec stereo: 768 byte frames of 1536 samples.
+ */
+
+static void GenerateAC3( ByteBuf &buf, double duration )
+{
+    const unsigned int framesize = 768;
+    unsigned int frames = static_cast<unsigned int>(duration * 48000 / 1536);
+    BitWriter bw( buf );
+    for( unsigned int f = 0; f < frames; ++f )
+    {
+        size_t start = buf.size();
+        bw.PutBits( 0x0b77, 16 );
+        bw.PutBits( 0, 16 );        // CRC
+        bw.PutBits( 0, 2 );         // 48kHz
+        bw.PutBits( 20, 6 );        // 192 kbit/sec
+        bw.PutBits( 8, 5 );         // bsid
+        bw.PutBits( 0, 3 );
+        bw.PutBits( 2, 3 );         // Stereo
+        bw.AlignBits();
+        buf.resize( start + framesize, 0 );
+    }
+}
+
+/*
+ * Raw 48kHz 16-bit stereo LPCM (mplex's default LPCM parameters).
+ */
+
+static void GenerateLPCM( ByteBuf &buf, double duration )
+{
+    AppendFiller( buf, static_cast<unsigned int>(duration * 48000) * 4 );
+}
+
+/*
+ * Subtitles in the tcextract/subtitle2vobsub format subpstream.cpp
+ * reads: a header record in host byte order then the subpicture
+ * packet. One 2KB subpicture every 2 seconds.
+ */
+
+struct SubtitleHeader
+{
+    char marker[8];
+    unsigned int header_length;
+    unsigned int header_version;
+    unsigned int payload_length;
+    unsigned int lpts;
+    double rpts;
+    unsigned int discont_ctr;
+};
+
+static void GenerateSubtitles( ByteBuf &buf, double duration )
+{
+    const unsigned int payload = 2048;
+    for( double t = 0.5; t < duration; t += 2.0 )
+    {
+        SubtitleHeader hdr;
+        memset( &hdr, 0, sizeof(hdr) );
+        memcpy( hdr.marker, "SUBTITLE", 8 );
+        hdr.header_length = sizeof(hdr) - sizeof(hdr.marker);
+        hdr.header_version = 0x00030001;
+        hdr.payload_length = payload;
+        hdr.lpts = static_cast<unsigned int>(t * 90000);
+        hdr.rpts = t;
+        const uint8_t *p = reinterpret_cast<const uint8_t *>(&hdr);
+        buf.insert( buf.end(), p, p + sizeof(hdr) );
+        buf.push_back( 0x20 );      // Sub-stream id
+        AppendFiller( buf, payload-1 );
+    }
+}
+
+/******************************************************************
+ *
+ * In-memory input and output streams
+ *
+ ******************************************************************/
+
+class IMemBitStream : public IBitStream
+{
+public:
+    IMemBitStream( const ByteBuf &_data, const char *name ) :
+        IBitStream(),
+        data( _data ),
+        pos( 0 )
+        {
+            streamname = name;
+            SetBufSize( BUFFER_SIZE );
+            eobs = false;
+            byteidx = 0;
+            if( !ReadIntoBuffer() && buffered == 0 )
+                mjpeg_error_exit1( "Empty synthetic stream %s", name );
+        }
+    ~IMemBitStream() { Release(); }
+private:
+    virtual size_t ReadStreamBytes( uint8_t *buf, size_t number )
+        {
+            size_t left = data.size() - pos;
+            if( number > left )
+                number = left;
+            memcpy( buf, &data[pos], number );
+            pos += number;
+            return number;
+        }
+    virtual bool EndOfStream() { return pos == data.size(); }
+
+    const ByteBuf &data;
+    size_t pos;
+};
+
+/*
+ * Discards the multiplexed output but walks the start codes of each
+ * sector written to tally up what went into it.  Bytes in padding
+ * packets and any bytes outside of packs/packets (e.g. VCD zero
+ * stuffing) count as padding.
+ */
+
+class MemOutputStream : public OutputStream
+{
+public:
+    MemOutputStream() : bytes(0), sectors(0), padding(0), segments(1) {}
+    virtual int Open() { return 0; }
+    virtual void Close() {}
+    virtual uint64_t SegmentSize() { return segment_len; }
+    virtual void NextSegment()
+        {
+            segment_len = 0;
+            ++segment_num;
+            ++segments;
+        }
+    virtual void Write( uint8_t *data, unsigned int len );
+
+    uint64_t bytes;
+    uint64_t sectors;
+    uint64_t padding;
+    unsigned int segments;
+};
+
+void MemOutputStream::Write( uint8_t *data, unsigned int len )
+{
+    unsigned int i = 0;
+    while( i + 4 <= len )
+    {
+        if( data[i] != 0 || data[i+1] != 0 || data[i+2] != 1 )
+            break;
+        uint8_t id = data[i+3];
+        unsigned int hdr_len;
+        if( id == 0xba )        // Pack header
+        {
+            if( i + 5 > len )
+                break;
+            if( (data[i+4] & 0xc0) == 0x40 )
+            {
+                if( i + 14 > len )
+                    break;
+                hdr_len = 14 + (data[i+13] & 0x07);
+            }
+            else
+                hdr_len = 12;
+        }
+        else if( id == 0xb9 )   // Program end
+            hdr_len = 4;
+        else
+        {
+            if( i + 6 > len )
+                break;
+            hdr_len = 6 + ((data[i+4] << 8) | data[i+5]);
+            if( id == 0xbe )
+                padding += hdr_len;
+        }
+        i += hdr_len;
+    }
+    if( i < len )
+        padding += len - i;
+    bytes += len;
+    segment_len += len;
+    ++sectors;
+}
+
+/******************************************************************
+ *
+ * Benchmark driver
+ *
+ * Each preset is multiplexed in a child process: the multiplexor
+ * treats persistent under-runs (and broken input) as fatal and
+ * exits.  The child reports back through a pipe from an atexit
+ * handler so the figures up to that point are still available.
+ *
+ ******************************************************************/
+
+struct BenchResult
+{
+    uint64_t bytes;
+    uint64_t sectors;
+    uint64_t padding;
+    unsigned int segments;
+    unsigned int underruns;
+    double secs;
+};
+
+static BenchResult result;
+static MemOutputStream *bench_output = 0;
+static Multiplexor *bench_mux = 0;
+static struct timeval bench_start;
+static int result_fd = -1;
+
+static double Elapsed( const struct timeval &start )
+{
+    struct timeval now;
+    gettimeofday( &now, 0 );
+    return (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) * 1e-6;
+}
+
+//
+// Take the figures from the run in progress.  Done when the run
+// completes (before its output and multiplexor go out of scope) or,
+// for a run that exits part way, from the atexit handler.
+//
+
+static void CollectResult()
+{
+    result.secs = Elapsed( bench_start );
+    if( bench_output != 0 )
+    {
+        result.bytes = bench_output->bytes;
+        result.sectors = bench_output->sectors;
+        result.padding = bench_output->padding;
+        result.segments = bench_output->segments;
+    }
+    if( bench_mux != 0 )
+        result.underruns = bench_mux->Underruns();
+    bench_output = 0;
+    bench_mux = 0;
+}
+
+static void ReportResult()
+{
+    if( result_fd < 0 )
+        return;
+    if( bench_output != 0 )
+        CollectResult();
+    if( write( result_fd, &result, sizeof(result) ) != sizeof(result) )
+        mjpeg_warn( "Failed to report benchmark result" );
+    close( result_fd );
+    result_fd = -1;
+}
+
+struct Preset
+{
+    int mux_format;
+    const char *name;
+    VideoSpec video;
+    unsigned int mpa_kbps;      // 0 = none
+    unsigned int mpa_freq;
+    bool ac3;
+    bool lpcm;
+    bool subtitles;
+};
+
+static const Preset presets[] =
+{
+    { MPEG_FORMAT_MPEG1, "MPEG-1", { 1, 352, 288, 1150, 20 },
+      224, 44100, false, false, false },
+    { MPEG_FORMAT_VCD, "VCD", { 1, 352, 288, 1150, 20 },
+      224, 44100, false, false, false },
+    { MPEG_FORMAT_VCD_NSR, "VCD (nsr)", { 1, 352, 288, 1150, 20 },
+      224, 44100, false, false, false },
+    { MPEG_FORMAT_MPEG2, "MPEG-2", { 2, 720, 576, 4000, 112 },
+      192, 48000, false, false, false },
+    { MPEG_FORMAT_SVCD, "SVCD", { 2, 480, 576, 2500, 112 },
+      224, 44100, false, false, false },
+    { MPEG_FORMAT_SVCD_NSR, "SVCD (nsr)", { 2, 480, 576, 2500, 112 },
+      224, 44100, false, false, false },
+    { MPEG_FORMAT_DVD, "DVD", { 2, 720, 576, 6000, 112 },
+      0, 0, true, true, true },
+    { MPEG_FORMAT_DVD_NAV, "DVD (nav)", { 2, 720, 576, 6000, 112 },
+      0, 0, true, true, true },
+};
+
+static const Preset *FindPreset( int mux_format )
+{
+    for( unsigned int i = 0; i < sizeof(presets)/sizeof(presets[0]); ++i )
+        if( presets[i].mux_format == mux_format )
+            return &presets[i];
+    return 0;
+}
+
+static void RunPreset( const Preset &preset, double duration,
+                       unsigned int video_kbps, bool parallel_parse,
+                       int segment_mb )
+{
+    VideoSpec video = preset.video;
+    if( video_kbps != 0 )
+        video.kbps = video_kbps;
+
+    ByteBuf vbuf, abuf, ac3buf, lpcmbuf, subbuf;
+    GenerateVideo( vbuf, video, duration );
+    if( preset.mpa_kbps != 0 )
+        GenerateMPA( abuf, preset.mpa_kbps, preset.mpa_freq, duration );
+    if( preset.ac3 )
+        GenerateAC3( ac3buf, duration );
+    if( preset.lpcm )
+        GenerateLPCM( lpcmbuf, duration );
+    if( preset.subtitles )
+        GenerateSubtitles( subbuf, duration );
+
+    MultiplexJob job;
+    job.mux_format = preset.mux_format;
+    job.parallel_parse = parallel_parse;
+    job.max_segment_size = segment_mb;
+    vector<IBitStream *> inputs;
+    inputs.push_back( new IMemBitStream( vbuf, "synthetic.m2v" ) );
+    if( !abuf.empty() )
+        inputs.push_back( new IMemBitStream( abuf, "synthetic.mp2" ) );
+    if( !ac3buf.empty() )
+        inputs.push_back( new IMemBitStream( ac3buf, "synthetic.ac3" ) );
+    if( !lpcmbuf.empty() )
+        inputs.push_back( new IMemBitStream( lpcmbuf, "synthetic.lpcm" ) );
+    if( !subbuf.empty() )
+        inputs.push_back( new IMemBitStream( subbuf, "synthetic.sub" ) );
+    job.SetupInputStreams( inputs );
+
+    MemOutputStream output;
+    bench_output = &output;
+    gettimeofday( &bench_start, 0 );
+    Multiplexor mux( job, output, 0 );
+    bench_mux = &mux;
+    mux.Multiplex();
+    CollectResult();
+}
+
+static void Usage( const char *progname )
+{
+    fprintf( stderr,
+             "Usage: %s [options]\n"
+             "  -f fmt[,fmt...]  Format presets to run (default 0,3,4,9)\n"
+             "                   %s\n"
+             "  -t secs          Duration of the synthetic streams (default 60)\n"
+             "  -b kbps          Override the video bit-rate of the presets\n"
+             "  -n num           Repeat each run num times, report fastest (default 1)\n"
+             "  -P 0|1           Parse inputs in parallel threads (default 0)\n"
+             "  -S MB            Split output into segments of MB\n"
+             "  -v num           Verbosity of mplex messages [0..2] (default 0)\n",
+             progname,
+             "0=MPEG-1 1=VCD 2=VCD(nsr) 3=MPEG-2 4=SVCD 5=SVCD(nsr) 8=DVD(nav) 9=DVD" );
+    exit(1);
+}
+
+int main( int argc, char *argv[] )
+{
+    vector<int> formats;
+    double duration = 60.0;
+    unsigned int video_kbps = 0;
+    unsigned int repeats = 1;
+    bool parallel_parse = false;
+    int segment_mb = 0;
+    int verbose = 0;
+    int c;
+
+    while( (c = getopt( argc, argv, "f:t:b:n:P:S:v:" )) != -1 )
+    {
+        switch( c )
+        {
+        case 'f' :
+        {
+            char *p = optarg;
+            do
+            {
+                char *end;
+                int fmt = strtol( p, &end, 10 );
+                if( end == p || FindPreset(fmt) == 0 )
+                    Usage(argv[0]);
+                formats.push_back( fmt );
+                p = *end == ',' ? end + 1 : end;
+            }
+            while( *p != '\0' );
+            break;
+        }
+        case 't' :
+            duration = atof( optarg );
+            if( duration < 1.0 )
+                Usage(argv[0]);
+            break;
+        case 'b' :
+            video_kbps = atoi( optarg );
+            break;
+        case 'n' :
+            repeats = atoi( optarg );
+            if( repeats < 1 )
+                Usage(argv[0]);
+            break;
+        case 'P' :
+            parallel_parse = atoi( optarg ) != 0;
+            break;
+        case 'S' :
+            segment_mb = atoi( optarg );
+            break;
+        case 'v' :
+            verbose = atoi( optarg );
+            if( verbose < 0 || verbose > 2 )
+                Usage(argv[0]);
+            break;
+        default :
+            Usage(argv[0]);
+        }
+    }
+    if( optind != argc )
+        Usage(argv[0]);
+    if( formats.empty() )
+    {
+        formats.push_back( MPEG_FORMAT_MPEG1 );
+        formats.push_back( MPEG_FORMAT_MPEG2 );
+        formats.push_back( MPEG_FORMAT_SVCD );
+        formats.push_back( MPEG_FORMAT_DVD );
+    }
+
+    (void)mjpeg_default_handler_verbosity( verbose );
+    fflush( stdout );
+
+    printf( "%-11s %9s %8s %8s %10s %8s %5s %9s\n",
+            "format", "MB", "secs", "MB/s", "sectors/s", "padding", "segs",
+            "underruns" );
+    bool failures = false;
+    for( vector<int>::iterator f = formats.begin(); f != formats.end(); ++f )
+    {
+        const Preset &preset = *FindPreset( *f );
+        BenchResult best;
+        bool failed = false;
+        for( unsigned int r = 0; r < repeats && !failed; ++r )
+        {
+            int fds[2];
+            if( pipe( fds ) != 0 )
+                mjpeg_error_exit1( "Could not create result pipe" );
+            fflush( stdout );
+            pid_t pid = fork();
+            if( pid < 0 )
+                mjpeg_error_exit1( "Could not fork benchmark process" );
+            if( pid == 0 )
+            {
+                close( fds[0] );
+                result_fd = fds[1];
+                memset( &result, 0, sizeof(result) );
+                atexit( ReportResult );
+                RunPreset( preset, duration, video_kbps,
+                           parallel_parse, segment_mb );
+                exit(0);
+            }
+            close( fds[1] );
+            BenchResult res;
+            memset( &res, 0, sizeof(res) );
+            bool got = read( fds[0], &res, sizeof(res) ) == sizeof(res);
+            close( fds[0] );
+            int status;
+            waitpid( pid, &status, 0 );
+            failed = !got || !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+            if( r == 0 || failed || res.secs < best.secs )
+                best = res;
+        }
+
+        double secs = best.secs > 0.0 ? best.secs : 1e-9;
+        printf( "%-11s %9.1f %8.3f %8.1f %10.0f %7.2f%% %5u %9u%s\n",
+                preset.name,
+                best.bytes / (1024.0*1024.0),
+                best.secs,
+                best.bytes / (1024.0*1024.0) / secs,
+                best.sectors / secs,
+                best.bytes == 0 ? 0.0 : 100.0 * best.padding / best.bytes,
+                best.segments,
+                best.underruns,
+                failed ? "  FAILED" : "" );
+        fflush( stdout );
+        failures |= failed;
+    }
+    return failures ? 1 : 0;
+}
+
+
+/*
+ * Local variables:
+ *  c-file-style: "stroustrup"
+ *  tab-width: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,262 @@
+/*
+ *  mplexqueue.cpp:  Check of multiplexing from in-memory byte queues
+ *
+ *  Feeds each input file through an mpeg2enc QueueStrmWriter and a
+ *  byte queue into an IQueueBitStream, as an encoder running in the
+ *  same process as the multiplexor would, and multiplexes the result.
+ *  The output must be identical to that of multiplexing the files
+ *  directly.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <vector>
+#include "mjpeg_types.h"
+#include "mjpeg_logging.h"
+#include "mpegconsts.h"
+#include "bytequeue.h"
+
+#include "interact.hpp"
+#include "bits.hpp"
+#include "outputstrm.hpp"
+#include "multiplexor.hpp"
+#include "elemstrmwriter.hh"
+
+using std::vector;
+
+typedef vector<uint8_t> ByteBuf;
+
+/*
+ * Input read straight from a file: the reference.
+ */
+
+class IStdioBitStream : public IBitStream
+{
+public:
+    IStdioBitStream( const char *filename ) :
+        IBitStream()
+        {
+            if( (fileh = fopen( filename, "rb" )) == NULL )
+                mjpeg_error_exit1( "Unable to open file %s for reading.",
+                                   filename );
+            streamname = filename;
+            SetBufSize( BUFFER_SIZE );
+            eobs = false;
+            byteidx = 0;
+            if( !ReadIntoBuffer() && buffered == 0 )
+                mjpeg_error_exit1( "Unable to read from %s.", filename );
+        }
+    ~IStdioBitStream() { fclose( fileh ); Release(); }
+private:
+    virtual size_t ReadStreamBytes( uint8_t *buf, size_t number )
+        { return fread( buf, sizeof(uint8_t), number, fileh ); }
+    virtual bool EndOfStream() { return feof( fileh ) != 0; }
+
+    FILE *fileh;
+};
+
+/*
+ * Producer: copies a file into a byte queue through a QueueStrmWriter
+ * in its own thread, in pieces of varying size much as an encoder
+ * flushes its output a frame at a time.
+ */
+
+class QueueFeeder
+{
+public:
+    QueueFeeder( const char *_filename, mjpeg_bytequeue_t *queue ) :
+        filename( _filename ),
+        writer( new QueueStrmWriter( queue ) )
+        {
+            if( (fileh = fopen( filename, "rb" )) == NULL )
+                mjpeg_error_exit1( "Unable to open file %s for reading.",
+                                   filename );
+            if( pthread_create( &thread, NULL,
+                                &QueueFeeder::ThreadWrapper, this ) != 0 )
+                mjpeg_error_exit1( "feeder thread creation failed: %s",
+                                   strerror(errno) );
+        }
+    ~QueueFeeder()
+        {
+            pthread_join( thread, NULL );
+            fclose( fileh );
+        }
+private:
+    static void *ThreadWrapper( void *feeder )
+        {
+            static_cast<QueueFeeder *>(feeder)->Feed();
+            return 0;
+        }
+    void Feed()
+        {
+            static const unsigned int piece_sizes[] =
+                { 4096, 37, 65536, 1, 12000, 2324 };
+            ByteBuf buf( 65536 );
+            unsigned int piece = 0;
+            size_t got;
+            do
+            {
+                got = fread( &buf[0], 1, piece_sizes[piece], fileh );
+                if( got > 0 )
+                    writer->WriteOutBufferUpto( &buf[0], got );
+                piece = (piece + 1) % (sizeof(piece_sizes)/sizeof(piece_sizes[0]));
+            } while( got > 0 );
+            // Ends the stream
+            delete writer;
+        }
+
+    const char *filename;
+    FILE *fileh;
+    QueueStrmWriter *writer;
+    pthread_t thread;
+};
+
+/*
+ * Collects the multiplexed output (all segments) in memory.
+ */
+
+class MemOutputStream : public OutputStream
+{
+public:
+    virtual int Open() { return 0; }
+    virtual void Close() {}
+    virtual uint64_t SegmentSize() { return segment_len; }
+    virtual void NextSegment()
+        {
+            segment_len = 0;
+            ++segment_num;
+        }
+    virtual void Write( uint8_t *buf, unsigned int len )
+        {
+            data.insert( data.end(), buf, buf + len );
+            segment_len += len;
+        }
+
+    ByteBuf data;
+};
+
+static void Mux( MultiplexJob &job, vector<IBitStream *> &inputs,
+                 ByteBuf &result )
+{
+    job.SetupInputStreams( inputs );
+    MemOutputStream output;
+    {
+        Multiplexor mux( job, output, 0 );
+        mux.Multiplex();
+    }
+    for( unsigned int i = 0; i < inputs.size(); ++i )
+        delete inputs[i];
+    result.swap( output.data );
+}
+
+static void Usage( const char *progname )
+{
+    fprintf( stderr,
+             "Usage: %s [options] input_file...\n"
+             "  -f fmt   Multiplex format (default 3)\n"
+             "  -q KB    Size of the byte queues (default 64)\n"
+             "  -P 0|1   Parse inputs in parallel threads (default 0)\n"
+             "  -v num   Verbosity of mplex messages [0..2] (default 0)\n",
+             progname );
+    exit(1);
+}
+
+int main( int argc, char *argv[] )
+{
+    int mux_format = MPEG_FORMAT_MPEG2;
+    unsigned int queue_kb = 64;
+    bool parallel_parse = false;
+    int verbose = 0;
+    int c;
+    while( (c = getopt( argc, argv, "f:q:P:v:" )) != -1 )
+    {
+        switch( c )
+        {
+        case 'f' :
+            mux_format = atoi( optarg );
+            break;
+        case 'q' :
+            queue_kb = atoi( optarg );
+            if( queue_kb == 0 )
+                Usage( argv[0] );
+            break;
+        case 'P' :
+            parallel_parse = atoi( optarg ) != 0;
+            break;
+        case 'v' :
+            verbose = atoi( optarg );
+            break;
+        default :
+            Usage( argv[0] );
+        }
+    }
+    if( optind == argc )
+        Usage( argv[0] );
+    (void)mjpeg_default_handler_verbosity( verbose );
+
+    ByteBuf direct, queued;
+    int i;
+    {
+        MultiplexJob job;
+        job.mux_format = mux_format;
+        job.parallel_parse = parallel_parse;
+        vector<IBitStream *> inputs;
+        for( i = optind; i < argc; ++i )
+            inputs.push_back( new IStdioBitStream( argv[i] ) );
+        Mux( job, inputs, direct );
+    }
+    {
+        MultiplexJob job;
+        job.mux_format = mux_format;
+        job.parallel_parse = parallel_parse;
+        vector<mjpeg_bytequeue_t *> queues;
+        vector<QueueFeeder *> feeders;
+        vector<IBitStream *> inputs;
+        for( i = optind; i < argc; ++i )
+        {
+            queues.push_back( mjpeg_bytequeue_new( queue_kb * 1024 ) );
+            feeders.push_back( new QueueFeeder( argv[i], queues.back() ) );
+            inputs.push_back( new IQueueBitStream( queues.back(), argv[i] ) );
+        }
+        Mux( job, inputs, queued );
+        for( unsigned int j = 0; j < feeders.size(); ++j )
+        {
+            delete feeders[j];
+            mjpeg_bytequeue_free( queues[j] );
+        }
+    }
+
+    if( queued != direct )
+    {
+        size_t diff = 0;
+        while( diff < queued.size() && diff < direct.size() &&
+               queued[diff] == direct[diff] )
+            ++diff;
+        printf( "FAILED: queued output (%lu bytes) differs from direct "
+                "output (%lu bytes) at byte %lu\n",
+                (unsigned long)queued.size(), (unsigned long)direct.size(),
+                (unsigned long)diff );
+        return 1;
+    }
+    printf( "OK: queued and direct output identical (%lu bytes)\n",
+            (unsigned long)direct.size() );
+    return 0;
+}
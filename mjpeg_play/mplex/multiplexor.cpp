@@ -23,6 +23,7 @@
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
 
 #include <mjpeg_types.h>
 #include <mjpeg_logging.h>
@@ -48,6 +49,8 @@ Multiplexor::Multiplexor(MultiplexJob &job, OutputStream &output, OutputStream *
     underrun_ignore = 0;
     underruns = 0;
 	start_of_new_pack = false;
+    scan_waits = 0;
+    pthread_mutex_init( &scan_wait_lock, NULL );
     InitSyntaxParameters(job);
     InitInputStreams(job);
 
@@ -64,6 +67,70 @@ Multiplexor::~Multiplexor()
     }
     vstreams.clear();
     astreams.clear();
+    pthread_mutex_destroy( &scan_wait_lock );
+}
+
+/****************
+ *
+ * Share the scanning of the input streams of primary, which reads the
+ * same inputs for another output: each of our input streams follows
+ * the scan of the primary stream reading the same input rather than
+ * scanning its own copy.  Must be called before either multiplexor is
+ * run and primary must outlive us.
+ *
+ ***************/
+
+void Multiplexor::ShareParsing( Multiplexor &primary )
+{
+	std::vector<ElementaryStream *>::iterator str, owner;
+	for( str = estreams.begin(); str < estreams.end(); ++str )
+	{
+		for( owner = primary.estreams.begin(); 
+			 owner < primary.estreams.end(); ++owner )
+		{
+			if( (*str)->ShareParse( **owner ) )
+				break;
+		}
+		if( owner == primary.estreams.end() )
+			mjpeg_error_exit1( "INTERNAL ERROR: no shared scan for stream %02x",
+							   (*str)->stream_id );
+	}
+}
+
+/****************
+ *
+ * Track whether we are waiting for (shared) input stream scanning.  A
+ * shared scan is not held back for a slow output that is itself held
+ * up waiting for the scan of another of its streams: that scan may in
+ * turn be being held back for the output we are ahead of.  So when we
+ * start waiting the scans our streams share are woken to look again.
+ * Must be called without any scan lock held.
+ *
+ ***************/
+
+void Multiplexor::WaitingForScan( bool waiting )
+{
+    pthread_mutex_lock( &scan_wait_lock );
+    if( waiting )
+        ++scan_waits;
+    else
+        --scan_waits;
+    bool started = waiting && scan_waits == 1;
+    pthread_mutex_unlock( &scan_wait_lock );
+    if( started )
+    {
+        std::vector<ElementaryStream *>::iterator str;
+        for( str = estreams.begin(); str < estreams.end(); ++str )
+            (*str)->WakeParser();
+    }
+}
+
+bool Multiplexor::WaitingForScan()
+{
+    pthread_mutex_lock( &scan_wait_lock );
+    bool waiting = scan_waits > 0;
+    pthread_mutex_unlock( &scan_wait_lock );
+    return waiting;
 }
 
 /******************************************************************
@@ -90,6 +157,10 @@ void Multiplexor::InitSyntaxParameters(MultiplexJob &job)
 	split_at_seq_end = !job.multifile_segment;
     workarounds = job.workarounds;
     run_in_frames = job.run_in_frames;
+    live_run_in = job.live_run_in;
+    // In live mode reads block waiting for the source so there is
+    // nothing to be gained from scanning in separate threads
+    parallel_parse = job.parallel_parse && live_run_in == 0;
     max_segment_size = static_cast<uint64_t>(job.max_segment_size)
                        * static_cast<uint64_t>(1024 * 1024);
     max_PTS = static_cast<clockticks>(job.max_PTS) * CLOCKS;
@@ -145,6 +216,7 @@ void Multiplexor::InitSyntaxParameters(MultiplexJob &job)
 		vcd_zero_stuffing = 0;
 		vbr = true;
         dtspts_for_all_vau = 0;
+		sector_align_iframeAUs = false;
         timestamp_iframe_only = false;
         video_buffers_iframe_only = false;
 		break;
@@ -625,6 +697,33 @@ clockticks Multiplexor::RunInDelay()
             data_delay += 3*(*str)->BufferSize()/4;
         }
         ByteposTimecode( data_delay, delay );
+
+        // Live: don't hold back output for longer than the run-in
+        // asked for unless the data of the first frames could then
+        // not reach the decoder buffers in time
+        if( live_run_in != 0 )
+        {
+            double live_interval = 
+                frame_interval != 0.0 ? frame_interval : CLOCKS / 25.0;
+            clockticks live_delay = 
+                static_cast<clockticks>(live_run_in * live_interval);
+            clockticks min_delay = LiveMinRunIn( live_delay );
+            // Round up so the rounding below can't undercut it
+            min_delay = static_cast<clockticks>(
+                ceil( min_delay / live_interval ) * live_interval );
+            if( delay > live_delay )
+            {
+                mjpeg_info( "Live mode: run-in limited to %d frame intervals",
+                            live_run_in );
+                delay = live_delay;
+            }
+            if( delay < min_delay )
+            {
+                mjpeg_warn( "Live mode: run-in raised to %.0f frame intervals to avoid buffer under-run",
+                            min_delay / live_interval );
+                delay = min_delay;
+            }
+        }
     }
     
     // Round delay a multiple of frame interval if its known...
@@ -639,6 +738,92 @@ clockticks Multiplexor::RunInDelay()
 
 }
 
+/**********************************************************************
+ *
+ * Live mode: the shortest run-in with which every AU due in the first
+ * window clockticks of playback reaches its decoder buffer by its DTS
+ * when the streams are muxed at the full data rate.  Only AUs due in
+ * the window are scanned so the look-ahead is bounded by the run-in
+ * asked for.
+ *
+ **********************************************************************/
+
+struct RunInDeadline
+{
+    clockticks due;             // DTS less the run-in
+    unsigned int stream;
+    unsigned int bytes;
+};
+
+static bool EarlierDeadline( const RunInDeadline &a, const RunInDeadline &b )
+{
+    return a.due < b.due;
+}
+
+clockticks Multiplexor::LiveMinRunIn( clockticks window )
+{
+    std::vector<ElementaryStream *> streams;
+    std::vector<clockticks> offsets;
+    std::vector<RunInDeadline> deadlines;
+    std::vector<ElementaryStream *>::iterator str;
+    unsigned int i;
+
+    // The decoding delays Init will set relative to the run-in
+    clockticks av_offset = vstreams.size() != 0 
+        ? vstreams[0]->BasePTS()-vstreams[0]->BaseDTS() : 0;
+    for( str = vstreams.begin(); str < vstreams.end(); ++str )
+    {
+        streams.push_back( *str );
+        offsets.push_back( video_delay );
+    }
+    for( str = astreams.begin(); str < astreams.end(); ++str )
+    {
+        streams.push_back( *str );
+        offsets.push_back( audio_delay + av_offset );
+    }
+
+    for( i = 0; i < streams.size(); ++i )
+    {
+        ElementaryStream &strm = *streams[i];
+        if( strm.au == 0 )
+            continue;
+        clockticks base = strm.BaseDTS();
+        AUnit *unit = strm.au;
+        for( unsigned int ahead = 0; 
+             unit != 0 && unit->DTS - base <= window; 
+             unit = strm.Lookahead( ahead++ ) )
+        {
+            RunInDeadline deadline;
+            deadline.due = offsets[i] + unit->DTS - base;
+            deadline.stream = i;
+            deadline.bytes = unit->PayloadSize();
+            deadlines.push_back( deadline );
+        }
+    }
+    std::stable_sort( deadlines.begin(), deadlines.end(), EarlierDeadline );
+
+    // Each stream's data is muxed in whole sectors carrying (at
+    // least) its minimum packet payload
+    std::vector<bitcount_t> stream_bytes( streams.size(), 0 );
+    std::vector<bitcount_t> stream_sectors( streams.size(), 0 );
+    bitcount_t sectors = 0;
+    clockticks min_delay = 0;
+    for( i = 0; i < deadlines.size(); ++i )
+    {
+        unsigned int s = deadlines[i].stream;
+        unsigned int payload = streams[s]->MinPacketData();
+        stream_bytes[s] += deadlines[i].bytes;
+        sectors -= stream_sectors[s];
+        stream_sectors[s] = (stream_bytes[s] + payload - 1) / payload;
+        sectors += stream_sectors[s];
+        clockticks sent;
+        ByteposTimecode( (sectors+1) * sector_transport_size, sent );
+        if( sent - deadlines[i].due > min_delay )
+            min_delay = sent - deadlines[i].due;
+    }
+    return min_delay;
+}
+
 /**********************************************************************
  *
  *  Initializes the output stream proper. Traverses the input files
@@ -754,9 +939,17 @@ void Multiplexor::Init()
 	// Now that all mux parameters are set we can trigger parsing
 	// of actual input stream data and calculation of associated 
 	// PTS/DTS by causing the read of the first AU's...
+	// If requested each stream is scanned ahead by its own parser thread.
+	// A stream whose scan other outputs share always is.
+	// For live input scan no further ahead than muxing actually asks
+	// for (one AU at a time rather than in chunks).
 	//
 	for( str = estreams.begin(); str < estreams.end(); ++str )
 	{
+		if( live_run_in != 0 )
+			(*str)->FRAME_CHUNK = 1;
+		if( parallel_parse || (*str)->ParseShared() )
+			(*str)->StartParsing();
 		(*str)->NextAU();
 	}
 
@@ -1390,7 +1583,11 @@ void Multiplexor::Multiplex()
 	MuxStatus( mjpeg_loglev_t("info") );
 	for( str = estreams.begin(); str < estreams.end(); ++str )
 	{
-		(*str)->Close();
+		// The statistics of a shared scan are its owner's to report
+		bool follower = (*str)->FollowsParse();
+		(*str)->StopParsing();
+		if( !follower )
+			(*str)->Close();
         if( (*str)->nsec <= 50 )
             mjpeg_info( "BUFFERING stream too short for useful statistics");
         else
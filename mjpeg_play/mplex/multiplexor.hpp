@@ -15,8 +15,13 @@ class Multiplexor
 public:
 	Multiplexor(MultiplexJob &job, OutputStream &output, OutputStream *index);
         ~Multiplexor ();
+	void ShareParsing( Multiplexor &primary );
 	void Multiplex ();
 
+	void WaitingForScan( bool waiting );
+	bool WaitingForScan();
+	inline unsigned int Underruns() const { return underruns; }
+
 
 	void ByteposTimecode( bitcount_t bytepos, clockticks &ts );
 	
@@ -58,6 +63,7 @@ public:
 	bool seg_starts_with_video;
 	bool timestamp_iframe_only;
 	bool video_buffers_iframe_only;
+	bool parallel_parse;
 	unsigned int audio_buffer_size;
 	unsigned int packets_per_pack;
 	unsigned int min_pes_header_len;
@@ -66,6 +72,7 @@ public:
 	int mpeg;
 	int data_rate;
     unsigned int    run_in_frames;
+    unsigned int    live_run_in;        // Live mode: max. run-in frames
     int mux_format;
 	uint64_t max_segment_size;
 
@@ -111,6 +118,11 @@ private:
 	bitcount_t bytes_output;
     clockticks ticks_per_sector;
     OutputStream *vdr_index;
+
+	/* Number of our input streams (with shared scans) we are waiting to
+	   see scanned further */
+	pthread_mutex_t scan_wait_lock;
+	unsigned int scan_waits;
 public:
 	clockticks current_SCR;
 private:
@@ -135,6 +147,7 @@ private:
 	void InitInputStreamsForStills(MultiplexJob & job );
 	void InitInputStreamsForVideo(MultiplexJob & job );
 	clockticks RunInDelay();
+	clockticks LiveMinRunIn( clockticks window );
 	void Init();
 	
 
@@ -200,7 +200,7 @@ unsigned int VideoStream::ExcludeNextIFramePayload()
         payload += au_ahead->PayloadSize();
         ++ahead;
     }
-    assert( eoscan || au_ahead != 0 );
+    assert( au_ahead != 0 || EndOfScan() );
     return payload;
 }
 
@@ -0,0 +1,145 @@
+/*
+ *  bytequeue.c:  Bounded in-memory byte stream connecting a producer
+ *                thread to a consumer thread.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "mjpeg_logging.h"
+#include "bytequeue.h"
+
+struct mjpeg_bytequeue
+{
+  uint8_t *buf;
+  size_t capacity;
+  size_t head;			/* Offset of oldest unread byte */
+  size_t fill;			/* Bytes queued */
+  int closed;			/* Writer has finished */
+  int aborted;			/* Reader has finished */
+  pthread_mutex_t lock;
+  pthread_cond_t readable;
+  pthread_cond_t writable;
+};
+
+mjpeg_bytequeue_t *mjpeg_bytequeue_new(size_t capacity)
+{
+  mjpeg_bytequeue_t *q = malloc(sizeof(*q));
+  if (q == NULL || capacity == 0 || (q->buf = malloc(capacity)) == NULL)
+    mjpeg_error_exit1("Could not allocate %lu byte stream queue",
+		      (unsigned long)capacity);
+  q->capacity = capacity;
+  q->head = 0;
+  q->fill = 0;
+  q->closed = 0;
+  q->aborted = 0;
+  pthread_mutex_init(&q->lock, NULL);
+  pthread_cond_init(&q->readable, NULL);
+  pthread_cond_init(&q->writable, NULL);
+  return q;
+}
+
+void mjpeg_bytequeue_free(mjpeg_bytequeue_t *q)
+{
+  if (q == NULL)
+    return;
+  pthread_cond_destroy(&q->writable);
+  pthread_cond_destroy(&q->readable);
+  pthread_mutex_destroy(&q->lock);
+  free(q->buf);
+  free(q);
+}
+
+size_t mjpeg_bytequeue_write(mjpeg_bytequeue_t *q,
+			     const uint8_t *buf, size_t len)
+{
+  size_t done = 0;
+
+  pthread_mutex_lock(&q->lock);
+  while (done < len && !q->aborted) {
+    size_t tail, chunk;
+    while (q->fill == q->capacity && !q->aborted)
+      pthread_cond_wait(&q->writable, &q->lock);
+    if (q->aborted)
+      break;
+    /* Copy into the free space up to the physical end of the ring */
+    tail = (q->head + q->fill) % q->capacity;
+    chunk = q->capacity - q->fill;
+    if (chunk > q->capacity - tail)
+      chunk = q->capacity - tail;
+    if (chunk > len - done)
+      chunk = len - done;
+    memcpy(q->buf + tail, buf + done, chunk);
+    q->fill += chunk;
+    done += chunk;
+    pthread_cond_signal(&q->readable);
+  }
+  pthread_mutex_unlock(&q->lock);
+  return done;
+}
+
+size_t mjpeg_bytequeue_read(mjpeg_bytequeue_t *q, uint8_t *buf, size_t len)
+{
+  size_t done = 0;
+
+  pthread_mutex_lock(&q->lock);
+  while (done < len) {
+    size_t chunk;
+    while (q->fill == 0 && !q->closed)
+      pthread_cond_wait(&q->readable, &q->lock);
+    if (q->fill == 0)
+      break;			/* Closed and drained */
+    chunk = q->fill;
+    if (chunk > q->capacity - q->head)
+      chunk = q->capacity - q->head;
+    if (chunk > len - done)
+      chunk = len - done;
+    memcpy(buf + done, q->buf + q->head, chunk);
+    q->head = (q->head + chunk) % q->capacity;
+    q->fill -= chunk;
+    done += chunk;
+    pthread_cond_signal(&q->writable);
+  }
+  pthread_mutex_unlock(&q->lock);
+  return done;
+}
+
+void mjpeg_bytequeue_close(mjpeg_bytequeue_t *q)
+{
+  pthread_mutex_lock(&q->lock);
+  q->closed = 1;
+  pthread_cond_broadcast(&q->readable);
+  pthread_mutex_unlock(&q->lock);
+}
+
+void mjpeg_bytequeue_abort(mjpeg_bytequeue_t *q)
+{
+  pthread_mutex_lock(&q->lock);
+  q->aborted = 1;
+  pthread_cond_broadcast(&q->writable);
+  pthread_mutex_unlock(&q->lock);
+}
+
+int mjpeg_bytequeue_eof(mjpeg_bytequeue_t *q)
+{
+  int eof;
+  pthread_mutex_lock(&q->lock);
+  eof = q->closed && q->fill == 0;
+  pthread_mutex_unlock(&q->lock);
+  return eof;
+}
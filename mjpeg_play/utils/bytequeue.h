@@ -0,0 +1,61 @@
+/*
+ *  bytequeue.h:  Bounded in-memory byte stream connecting a producer
+ *                thread to a consumer thread (e.g. an encoder writing an
+ *                elementary stream and a multiplexer reading it).
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef __BYTEQUEUE_H__
+#define __BYTEQUEUE_H__
+
+#include <stddef.h>
+#include "mjpeg_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct mjpeg_bytequeue mjpeg_bytequeue_t;
+
+/* Create a queue buffering at most 'capacity' bytes. */
+mjpeg_bytequeue_t *mjpeg_bytequeue_new(size_t capacity);
+void mjpeg_bytequeue_free(mjpeg_bytequeue_t *q);
+
+/* Append len bytes, blocking while the queue is full.  Returns the
+   number of bytes queued: short only if the reading side has been
+   shut down with mjpeg_bytequeue_abort(). */
+size_t mjpeg_bytequeue_write(mjpeg_bytequeue_t *q,
+			     const uint8_t *buf, size_t len);
+
+/* Read up to len bytes, blocking until len bytes are available or the
+   writer has closed the queue.  Like fread() the count is short only
+   at end of stream. */
+size_t mjpeg_bytequeue_read(mjpeg_bytequeue_t *q, uint8_t *buf, size_t len);
+
+/* Writer side: no more data will be written (end of stream). */
+void mjpeg_bytequeue_close(mjpeg_bytequeue_t *q);
+
+/* Reader side: no more data will be read; unblocks and fails writers. */
+void mjpeg_bytequeue_abort(mjpeg_bytequeue_t *q);
+
+/* True once the queue is closed and every byte has been read. */
+int mjpeg_bytequeue_eof(mjpeg_bytequeue_t *q);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
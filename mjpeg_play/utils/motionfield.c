@@ -0,0 +1,213 @@
+/*
+ *  motionfield.c:  Per-frame block motion vectors carried alongside a
+ *                  YUV4MPEG stream.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mjpeg_logging.h"
+#include "motionfield.h"
+
+#define MF_LINE_MAX 80
+
+void mjpeg_motionfield_init(mjpeg_motionfield_t *mf,
+			    int luma_width, int luma_height, int blocksize)
+{
+  int i, n;
+
+  mf->blocksize = blocksize;
+  mf->width = (luma_width + blocksize - 1) / blocksize;
+  mf->height = (luma_height + blocksize - 1) / blocksize;
+  mf->frame = -1;
+  mf->next_frame = -1;
+  n = mf->width * mf->height;
+  mf->mv = calloc(n, sizeof(mf->mv[0]));
+  mf->sad = malloc(n * sizeof(mf->sad[0]));
+  if (mf->mv == NULL || mf->sad == NULL)
+    mjpeg_error_exit1("Could not allocate motion field of %dx%d blocks",
+		      mf->width, mf->height);
+  for (i = 0; i < n; i++)
+    mf->sad[i] = MJPEG_MOTIONFIELD_NOSAD;
+}
+
+void mjpeg_motionfield_fini(mjpeg_motionfield_t *mf)
+{
+  free(mf->mv);
+  free(mf->sad);
+  mf->mv = NULL;
+  mf->sad = NULL;
+}
+
+const int16_t *mjpeg_motionfield_get(const mjpeg_motionfield_t *mf,
+				     int frame, int x, int y)
+{
+  int i = x / mf->blocksize;
+  int j = y / mf->blocksize;
+
+  if (frame < 0 || mf->frame != frame)
+    return NULL;
+  if (i >= mf->width)
+    i = mf->width - 1;
+  if (j >= mf->height)
+    j = mf->height - 1;
+  return mf->mv[i + j * mf->width];
+}
+
+/* Read a line of at most MF_LINE_MAX characters, without its newline. */
+static int read_line(int fd, char *line)
+{
+  int n;
+
+  for (n = 0; n < MF_LINE_MAX; n++) {
+    ssize_t r = y4m_read(fd, line + n, 1);
+    if (r > 0)
+      return (n == 0) ? Y4M_ERR_EOF : Y4M_ERR_BADEOF;
+    if (r < 0)
+      return Y4M_ERR_SYSTEM;
+    if (line[n] == '\n') {
+      line[n] = '\0';
+      return Y4M_OK;
+    }
+  }
+  return Y4M_ERR_HEADER;
+}
+
+int mjpeg_motionfield_write_header(int fd, const mjpeg_motionfield_t *mf)
+{
+  char line[MF_LINE_MAX + 1];
+  int n;
+
+  n = snprintf(line, sizeof(line), "%s W%d H%d B%d\n",
+	       MJPEG_MOTIONFIELD_MAGIC, mf->width, mf->height, mf->blocksize);
+  return (y4m_write(fd, line, n) == 0) ? Y4M_OK : Y4M_ERR_SYSTEM;
+}
+
+int mjpeg_motionfield_read_header(int fd, mjpeg_motionfield_t *mf)
+{
+  char line[MF_LINE_MAX + 1];
+  int w, h, b, err;
+
+  if ((err = read_line(fd, line)) != Y4M_OK)
+    return err;
+  if (sscanf(line, MJPEG_MOTIONFIELD_MAGIC " W%d H%d B%d", &w, &h, &b) != 3
+      || w <= 0 || h <= 0 || b <= 0)
+    return Y4M_ERR_MAGIC;
+  mjpeg_motionfield_init(mf, w * b, h * b, b);
+  return Y4M_OK;
+}
+
+int mjpeg_motionfield_write_frame(int fd, const mjpeg_motionfield_t *mf)
+{
+  char line[MF_LINE_MAX + 1];
+  int i, n = mf->width * mf->height;
+  uint8_t *buf, *p;
+  int err = Y4M_OK;
+
+  i = snprintf(line, sizeof(line), "%s %d\n",
+	       MJPEG_MOTIONFIELD_FRAME_MAGIC, mf->frame);
+  if (y4m_write(fd, line, i) != 0)
+    return Y4M_ERR_SYSTEM;
+
+  if ((buf = malloc(n * 6)) == NULL)
+    return Y4M_ERR_SYSTEM;
+  for (i = 0, p = buf; i < n; i++, p += 6) {
+    p[0] = mf->mv[i][0] & 0xff;
+    p[1] = (mf->mv[i][0] >> 8) & 0xff;
+    p[2] = mf->mv[i][1] & 0xff;
+    p[3] = (mf->mv[i][1] >> 8) & 0xff;
+    p[4] = mf->sad[i] & 0xff;
+    p[5] = mf->sad[i] >> 8;
+  }
+  if (y4m_write(fd, buf, n * 6) != 0)
+    err = Y4M_ERR_SYSTEM;
+  free(buf);
+  return err;
+}
+
+int mjpeg_motionfield_read_frame(int fd, mjpeg_motionfield_t *mf, int frame)
+{
+  char line[MF_LINE_MAX + 1];
+  int i, n = mf->width * mf->height;
+  uint8_t *buf, *p;
+  int err;
+
+  mf->frame = -1;
+  for (;;) {
+    if (mf->next_frame < 0) {
+      if ((err = read_line(fd, line)) != Y4M_OK)
+	return err;
+      if (sscanf(line, MJPEG_MOTIONFIELD_FRAME_MAGIC " %d",
+		 &mf->next_frame) != 1 || mf->next_frame < 0) {
+	mf->next_frame = -1;
+	return Y4M_ERR_MAGIC;
+      }
+    }
+    if (mf->next_frame > frame)
+      return Y4M_OK;
+
+    if ((buf = malloc(n * 6)) == NULL)
+      return Y4M_ERR_SYSTEM;
+    err = (y4m_read(fd, buf, n * 6) == 0) ? Y4M_OK : Y4M_ERR_BADEOF;
+    for (i = 0, p = buf; err == Y4M_OK && i < n; i++, p += 6) {
+      mf->mv[i][0] = (int16_t)(p[0] | (p[1] << 8));
+      mf->mv[i][1] = (int16_t)(p[2] | (p[3] << 8));
+      mf->sad[i] = p[4] | (p[5] << 8);
+    }
+    free(buf);
+    if (err != Y4M_OK)
+      return err;
+
+    if (mf->next_frame == frame)
+      mf->frame = frame;
+    mf->next_frame = -1;
+    if (mf->frame == frame)
+      return Y4M_OK;
+  }
+}
+
+void mjpeg_motionfield_tag_frame(y4m_frame_info_t *fi, int frame)
+{
+  y4m_xtag_list_t *xtags = y4m_fi_xtags(fi);
+  char tag[Y4M_MAX_XTAG_SIZE];
+  int i;
+
+  for (i = y4m_xtag_count(xtags) - 1; i >= 0; i--)
+    if (!strncmp(y4m_xtag_get(xtags, i), MJPEG_MOTIONFIELD_XTAG,
+		 strlen(MJPEG_MOTIONFIELD_XTAG)))
+      y4m_xtag_remove(xtags, i);
+  snprintf(tag, sizeof(tag), "%s%d", MJPEG_MOTIONFIELD_XTAG, frame);
+  if (y4m_xtag_add(xtags, tag) != Y4M_OK)
+    mjpeg_warn("Could not tag frame %d with its motion field", frame);
+}
+
+int mjpeg_motionfield_frame_tag(y4m_frame_info_t *fi, int dflt)
+{
+  y4m_xtag_list_t *xtags = y4m_fi_xtags(fi);
+  const char *tag;
+  int i, frame;
+
+  for (i = 0; i < y4m_xtag_count(xtags); i++) {
+    tag = y4m_xtag_get(xtags, i);
+    if (!strncmp(tag, MJPEG_MOTIONFIELD_XTAG, strlen(MJPEG_MOTIONFIELD_XTAG))
+	&& sscanf(tag + strlen(MJPEG_MOTIONFIELD_XTAG), "%d", &frame) == 1
+	&& frame >= 0)
+      return frame;
+  }
+  return dflt;
+}
@@ -0,0 +1,108 @@
+/*
+ *  motionfield.h:  Per-frame block motion vectors carried alongside a
+ *                  YUV4MPEG stream, so that one stage of a pipeline can
+ *                  hand its motion search results to the next.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef __MOTIONFIELD_H__
+#define __MOTIONFIELD_H__
+
+#include "mjpeg_types.h"
+#include "yuv4mpeg.h"
+
+/*
+ * The vectors travel in a sidecar stream (a file, or a named pipe when
+ * the stages run concurrently).  It starts with the line
+ *
+ *    MOTIONFIELD W<blocks across> H<blocks down> B<block size>
+ *
+ * and holds one record per frame that has vectors:
+ *
+ *    MFRAME <frame number>
+ *
+ * followed by W*H little-endian 16 bit triplets (dx, dy, sad), in
+ * raster order.  Block (i,j) covers the luma pixels starting at
+ * (i*B, j*B) of the frame; the vector is in whole luma pixels and
+ * points to where that block is found in the previous frame.  Records
+ * are in increasing frame order but frames may be missing, e.g. the
+ * first one, which has no previous frame.
+ *
+ * The producer tags each frame of its YUV4MPEG output with an
+ * "XMVF=<frame number>" x-tag.  A consumer matches a frame to its
+ * record by that tag, or by counting frames if a stage in between has
+ * dropped the tags.  Vectors are only ever used as search seeds, so a
+ * mismatch costs speed, not correctness.
+ */
+
+#define MJPEG_MOTIONFIELD_MAGIC "MOTIONFIELD"
+#define MJPEG_MOTIONFIELD_FRAME_MAGIC "MFRAME"
+#define MJPEG_MOTIONFIELD_XTAG "XMVF="
+#define MJPEG_MOTIONFIELD_NOSAD 0xffff	/* sad of a vector that's unknown */
+
+typedef struct _mjpeg_motionfield
+{
+  int width;			/* blocks per row */
+  int height;			/* block rows */
+  int blocksize;		/* luma pixels per block side */
+  int frame;			/* frame the vectors belong to, -1 if none */
+  int16_t (*mv)[2];		/* dx,dy for each block */
+  uint16_t *sad;		/* matching error for each block */
+  /* private */
+  int next_frame;		/* record whose header has been read already */
+} mjpeg_motionfield_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Allocate a field for a frame of the given luma size.  The vectors
+   are zero, their sads unknown. */
+void mjpeg_motionfield_init(mjpeg_motionfield_t *mf,
+			    int luma_width, int luma_height, int blocksize);
+void mjpeg_motionfield_fini(mjpeg_motionfield_t *mf);
+
+/* Return the vector of the block covering luma pixel x,y, or NULL if
+   the field holds no vectors for 'frame'. */
+const int16_t *mjpeg_motionfield_get(const mjpeg_motionfield_t *mf,
+				     int frame, int x, int y);
+
+/* Write the sidecar's header, or one frame record (numbered mf->frame).
+   Return Y4M_OK or a Y4M_ERR_* code. */
+int mjpeg_motionfield_write_header(int fd, const mjpeg_motionfield_t *mf);
+int mjpeg_motionfield_write_frame(int fd, const mjpeg_motionfield_t *mf);
+
+/* Read the sidecar's header and allocate the field to match. */
+int mjpeg_motionfield_read_header(int fd, mjpeg_motionfield_t *mf);
+
+/* Read forward to the record of the given frame, skipping earlier
+   ones.  If there is none, mf->frame is set to -1 and the following
+   record is kept for a later call.  At the end of the stream
+   Y4M_ERR_EOF is returned (with mf->frame == -1). */
+int mjpeg_motionfield_read_frame(int fd, mjpeg_motionfield_t *mf, int frame);
+
+/* Replace a frame's XMVF x-tag with one for the given frame number. */
+void mjpeg_motionfield_tag_frame(y4m_frame_info_t *fi, int frame);
+
+/* Return the frame number in a frame's XMVF x-tag, or 'dflt' if it
+   hasn't got one. */
+int mjpeg_motionfield_frame_tag(y4m_frame_info_t *fi, int dflt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MOTIONFIELD_H__ */
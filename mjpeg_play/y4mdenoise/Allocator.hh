@@ -10,9 +10,72 @@
 #include "Limits.hh"
 
 
+// Allocation statistics, as kept by Allocator<> and
+// VariableSizeAllocator.
+class AllocatorStats
+{
+public:
+	size_t m_nBytes;
+		// The number of bytes currently held in chunks.
+
+	size_t m_nPeakBytes;
+		// The largest number of bytes ever held in chunks.
+
+	uint32_t m_ulPeakAllocated;
+		// The largest number of live allocations ever.
+
+	uint32_t m_ulChunks;
+		// The number of chunks ever gotten from the standard memory
+		// allocator.
+
+	AllocatorStats() : m_nBytes (0), m_nPeakBytes (0),
+			m_ulPeakAllocated (0), m_ulChunks (0) {}
+		// Default constructor.
+
+	void NewChunk (size_t a_nBytes)
+	{
+		++m_ulChunks;
+		m_nBytes += a_nBytes;
+		if (m_nPeakBytes < m_nBytes)
+			m_nPeakBytes = m_nBytes;
+	}
+		// Note that a chunk was gotten from the standard memory
+		// allocator.
+
+	void FreeChunk (size_t a_nBytes) { m_nBytes -= a_nBytes; }
+		// Note that a chunk was given back to the standard memory
+		// allocator.
+
+	void Allocated (uint32_t a_ulAllocated)
+	{
+		if (m_ulPeakAllocated < a_ulAllocated)
+			m_ulPeakAllocated = a_ulAllocated;
+	}
+		// Note the number of live allocations.
+
+	void Add (const AllocatorStats &a_rOther)
+	{
+		m_nBytes += a_rOther.m_nBytes;
+		m_nPeakBytes += a_rOther.m_nPeakBytes;
+		m_ulPeakAllocated += a_rOther.m_ulPeakAllocated;
+		m_ulChunks += a_rOther.m_ulChunks;
+	}
+		// Accumulate another allocator's statistics into these.
+		// (The peaks are summed, so they're an upper bound.)
+};
+
+
+
 // An allocator for small classes.  It gets large chunks from the
 // standard memory allocator & divides it up.  It's able to handle
 // several different object sizes at once.
+//
+// An allocator isn't thread-safe; each thread must use its own.
+// When the last allocation is deallocated, the allocator resets itself,
+// i.e. it keeps its chunks for reuse instead of freeing them.  So an
+// allocator whose objects all get freed at the end of each frame turns
+// into a per-frame arena that stops allocating memory once it has
+// grown to the largest frame's needs.
 template <size_t SIZES>
 class Allocator
 {
@@ -36,6 +99,17 @@ public:
 	uint32_t GetNumAllocated (void) const { return m_ulAllocated; }
 		// Get the number of allocated blocks.
 
+	const AllocatorStats &GetStats (void) const { return m_oStats; }
+		// Get allocation statistics.
+
+	void Reset (void);
+		// Forget all allocations, but keep our chunks for reuse.
+		// Only safe if there are no live allocations.
+
+	void Purge (void);
+		// Free up all chunks.
+		// Only safe if there are no live allocations.
+
 private:
 	// One chunk of memory.
 	class Chunk
@@ -43,7 +117,7 @@ private:
 	public:
 		Chunk *m_pNext;
 			// The next allocated chunk.
-		char *m_aSpace;
+		char m_aSpace[];
 			// The memory to divide up.
 	};
 
@@ -53,6 +127,10 @@ private:
 	Chunk *m_pChunks;
 		// A linked-list of all the allocated chunks.
 
+	Chunk *m_pSpareChunks;
+		// A linked-list of chunks left over from before the last reset,
+		// ready to be reused.
+
 	char *m_pFreeChunk;
 		// The next piece of unallocated memory in the
 		// most-recently-allocated chunk.
@@ -72,9 +150,8 @@ private:
 		// Used to make sure they always ask for the same memory size
 		// in each bucket.
 
-	void Purge (void);
-		// Free up all chunks.
-		// Only safe if there are no live allocations.
+	AllocatorStats m_oStats;
+		// Allocation statistics.
 };
 
 
@@ -83,7 +160,7 @@ private:
 // time from the standard memory allocator.
 template <size_t SIZES>
 Allocator<SIZES>::Allocator (size_t a_nChunkSize)
-	: m_pChunks (NULL), m_pFreeChunk (NULL)
+	: m_pChunks (NULL), m_pSpareChunks (NULL), m_pFreeChunk (NULL)
 {
 	// Round our chunk size up to the nearest pointer size.
 	m_nChunkSize = ((a_nChunkSize + sizeof (Chunk *) - 1)
@@ -166,6 +243,7 @@ Allocator<SIZES>::Allocate (size_t a_nSize, size_t a_nBytes)
 
 		// That's one more allocation.
 		++m_ulAllocated;
+		m_oStats.Allocated (m_ulAllocated);
 
 		// Return the allocated memory.
 		return pAlloc;
@@ -185,6 +263,7 @@ Allocator<SIZES>::Allocate (size_t a_nSize, size_t a_nBytes)
 
 		// That's one more allocation.
 		++m_ulAllocated;
+		m_oStats.Allocated (m_ulAllocated);
 
 		// Return the allocated memory.
 		return pAlloc;
@@ -200,10 +279,22 @@ Allocator<SIZES>::Allocate (size_t a_nSize, size_t a_nBytes)
 
 	// Add a new chunk to our list.
 	{
-		// Allocate a new chunk.
-		Chunk *pNewChunk = (Chunk *) malloc (m_nChunkSize);
-		if (pNewChunk == NULL)
-			return NULL;
+		Chunk *pNewChunk;
+
+		// Reuse a chunk from before the last reset, if there is one.
+		// Otherwise, allocate a new chunk.
+		if (m_pSpareChunks != NULL)
+		{
+			pNewChunk = m_pSpareChunks;
+			m_pSpareChunks = m_pSpareChunks->m_pNext;
+		}
+		else
+		{
+			pNewChunk = (Chunk *) malloc (m_nChunkSize);
+			if (pNewChunk == NULL)
+				return NULL;
+			m_oStats.NewChunk (m_nChunkSize);
+		}
 
 		// Hook it into our list.
 		pNewChunk->m_pNext = m_pChunks;
@@ -215,6 +306,7 @@ Allocator<SIZES>::Allocate (size_t a_nSize, size_t a_nBytes)
 
 	// That's one more allocation.
 	++m_ulAllocated;
+	m_oStats.Allocated (m_ulAllocated);
 
 	// Return the allocated memory.
 	return (void *) (&(m_pChunks->m_aSpace));
@@ -238,17 +330,17 @@ Allocator<SIZES>::Deallocate (size_t a_nSize, size_t /* a_nBytes */,
 	// That's one less allocation.
 	--m_ulAllocated;
 
-	// If all memory is unallocated, free up our chunks & start over.
+	// If all memory is unallocated, start over, but keep our chunks.
 	if (m_ulAllocated == 0UL)
-		Purge();
+		Reset();
 }
 
 
 
-// Free up all chunks.
+// Forget all allocations, but keep our chunks for reuse.
 template <size_t SIZES>
 void
-Allocator<SIZES>::Purge (void)
+Allocator<SIZES>::Reset (void)
 {
 	// Make sure there are no live allocations
 	assert (m_ulAllocated == 0UL);
@@ -258,14 +350,15 @@ Allocator<SIZES>::Purge (void)
 		m_apFree[i] = NULL;
 	m_pFreeChunk = NULL;
 
-	// Free all allocated chunks.
+	// Move all allocated chunks to the spare list.
 	while (m_pChunks != NULL)
 	{
 		// Remember the next chunk.
 		Chunk *pNextChunk = m_pChunks->m_pNext;
 
-		// Free this chunk.
-		free (m_pChunks);
+		// Put this chunk on the spare list.
+		m_pChunks->m_pNext = m_pSpareChunks;
+		m_pSpareChunks = m_pChunks;
 
 		// Move to the next chunk.
 		m_pChunks = pNextChunk;
@@ -274,4 +367,29 @@ Allocator<SIZES>::Purge (void)
 
 
 
+// Free up all chunks.
+template <size_t SIZES>
+void
+Allocator<SIZES>::Purge (void)
+{
+	// Empty the free-space list, and move all chunks to the spare list.
+	Reset();
+
+	// Free all spare chunks.
+	while (m_pSpareChunks != NULL)
+	{
+		// Remember the next chunk.
+		Chunk *pNextChunk = m_pSpareChunks->m_pNext;
+
+		// Free this chunk.
+		free (m_pSpareChunks);
+		m_oStats.FreeChunk (m_nChunkSize);
+
+		// Move to the next chunk.
+		m_pSpareChunks = pNextChunk;
+	}
+}
+
+
+
 #endif // __ALLOCATOR_H__
@@ -15,6 +15,7 @@
 #include "SetRegion2D.hh"
 #include "BitmapRegion2D.hh"
 #include "Vector.hh"
+#include "RegionPolicy.hh"
 
 // HACK: for development error messages.
 #include <stdio.h>
@@ -47,9 +48,9 @@
 
 
 
-// Define this to implement set-regions with vectors.
-// Don't define this to implement set-regions with skip-lists.
-#define SET_REGION_IMPLEMENTED_WITH_VECTOR
+// How set-regions are implemented, and which regions & flood-fills
+// are implemented with bitmap regions instead, is selected by the
+// REGIONS template parameter; see RegionPolicy.hh.
 
 
 
@@ -65,32 +66,7 @@
 
 
 
-// Define this to use bitmap regions to implement zero-motion
-// flood-fill.
-#define ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
-
-
-
-// Define this to use bitmap regions to implement match-throttle
-// flood-fill.
-#define MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
-
-
-
-// Define this to use bitmap regions to implement pruning flood-fill.
-//#define PRUNING_FLOOD_FILL_WITH_BITMAP_REGIONS
-
-
-
-// Define this to use a bitmap region to implement the
-// used-reference-pixel region.  Don't define it to use a set-based
-// region to implement the used-reference-pixel region.
-#define USED_REFERENCE_PIXELS_REGION_IS_BITMAP
-
-
-
 // We'll be using this variant of the search-border.
-// (SearchBorder uses SET_REGION_IMPLEMENTED_WITH_VECTOR to configure.)
 #include "SearchBorder.hh"
 
 // We'll be using this variant of the search-window.
@@ -106,6 +82,102 @@
 
 
 
+// Statistics on the result of one frame's analysis -- the number of
+// pixels that didn't move, the number that moved, the number found by
+// flood-filling, and the number of new pixels.
+class PixelStats
+{
+public:
+	unsigned long m_nNotMovedZeroMotion, m_nNotMovedThrottled,
+			m_nNotMoved, m_nMovedThrottled, m_nMoved, m_nNoMatchNew,
+			m_nNew;
+		// The pixel counts, by the analysis' verdict.
+
+	PixelStats() : m_nNotMovedZeroMotion (0), m_nNotMovedThrottled (0),
+			m_nNotMoved (0), m_nMovedThrottled (0), m_nMoved (0),
+			m_nNoMatchNew (0), m_nNew (0) {}
+		// Default constructor.
+
+	void Add (const PixelStats &a_rOther)
+	{
+		m_nNotMovedZeroMotion += a_rOther.m_nNotMovedZeroMotion;
+		m_nNotMovedThrottled += a_rOther.m_nNotMovedThrottled;
+		m_nNotMoved += a_rOther.m_nNotMoved;
+		m_nMovedThrottled += a_rOther.m_nMovedThrottled;
+		m_nMoved += a_rOther.m_nMoved;
+		m_nNoMatchNew += a_rOther.m_nNoMatchNew;
+		m_nNew += a_rOther.m_nNew;
+	}
+		// Accumulate another analysis' statistics into these.
+
+	void Print (int a_nFrame) const
+	{
+		unsigned long nPixels = m_nNotMovedZeroMotion
+			+ m_nNotMovedThrottled + m_nNotMoved + m_nMovedThrottled
+			+ m_nMoved + m_nNoMatchNew + m_nNew;
+		float fInversePixelsPercent
+			= (nPixels == 0) ? 0.0f : 100.0f / float (nPixels);
+
+		fprintf (stderr, "Frame %d: %.1f%%+%.1f%%+%.1f%% not-moved, "
+				"%.1f%%+%.1f%% moved, %.1f%%+%.1f%% new\n",
+			a_nFrame,
+			(float (m_nNotMovedZeroMotion) * fInversePixelsPercent),
+			(float (m_nNotMovedThrottled) * fInversePixelsPercent),
+			(float (m_nNotMoved) * fInversePixelsPercent),
+			(float (m_nMovedThrottled) * fInversePixelsPercent),
+			(float (m_nMoved) * fInversePixelsPercent),
+			(float (m_nNoMatchNew) * fInversePixelsPercent),
+			(float (m_nNew) * fInversePixelsPercent));
+	}
+		// Print the statistics as percentages of all the pixels.
+};
+
+
+
+// The interface to a motion-searcher, i.e. everything its clients use.
+// It doesn't depend on how the motion-searcher implements its regions,
+// so that motion-searchers with different region policies can be
+// chosen between at run time.  Parameterized by the size of elements
+// in the pixels, the numeric type to use for pixel indices, a numeric
+// type big enough to hold the product of the largest expected frame
+// width/height, and the types of pixels and reference frames.
+template <class PIXEL_NUM, class PIXELINDEX, class FRAMESIZE,
+	class PIXEL, class REFERENCEFRAME>
+class MotionSearcherBase
+{
+public:
+	typedef PIXEL Pixel_t;
+		// Our pixel type.
+
+	typedef REFERENCEFRAME ReferenceFrame_t;
+		// Our reference frame type.
+
+	typedef PIXEL_NUM PixelValue_t;
+		// The numeric type to use in pixel values, in each dimension
+		// of our pixels.
+
+	virtual ~MotionSearcherBase() {}
+		// Destructor.
+
+	virtual void Init (Status_t &a_reStatus, int a_nFrames,
+			PIXELINDEX a_tnWidth, PIXELINDEX a_tnHeight,
+			PIXELINDEX a_tnSearchRadiusX, PIXELINDEX a_tnSearchRadiusY,
+			PixelValue_t a_nZeroTolerance, PixelValue_t a_nTolerance,
+			FRAMESIZE a_nMatchCountThrottle,
+			FRAMESIZE a_nMatchSizeThrottle) = 0;
+	virtual const ReferenceFrame_t *GetFrameReadyForOutput (void) = 0;
+	virtual void AddFrame (Status_t &a_reStatus,
+			const Pixel_t *a_pPixels) = 0;
+	virtual const ReferenceFrame_t *GetRemainingFrames (void) = 0;
+	virtual void Purge (void) = 0;
+	virtual void AddAllocatorStats (AllocatorStats &a_rStats) const = 0;
+	virtual void AddPixelStats (PixelStats &a_rStats) const = 0;
+	virtual void SetPrintPixelStats (bool a_bPrint) = 0;
+		// See MotionSearcher<>.
+};
+
+
+
 // The generic motion-searcher class.  It's parameterized by the size of
 // elements in the pixels, the dimension of the pixels, the numeric type
 // to use in tolerance calculations, the numeric type to use for pixel
@@ -113,8 +185,9 @@
 // expected frame width/height, the width/height of pixel groups to
 // operate on, a numeric type big enough to hold pixel-dimension *
 // pixel-group-width * pixel-group-height bits and serve as an array
-// index, and the types of pixels, reference pixels, and reference
-// frames to operate on.  When constructed, it's configured with the
+// index, the types of pixels, reference pixels, and reference frames
+// to operate on, and the region-implementation policy (see
+// RegionPolicy.hh).  When constructed, it's configured with the
 // number of frames over which to accumulate pixel values, the search
 // radius (in separate x and y directions), the error tolerances, and
 // throttle values for the number of matches and the size of matches.
@@ -167,8 +240,11 @@ template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class REFERENCEPIXEL
 		= ReferencePixel<PIXEL_TOL,PIXEL_NUM,DIM,PIXEL>,
 	class REFERENCEFRAME
-		= ReferenceFrame<REFERENCEPIXEL,PIXELINDEX,FRAMESIZE> >
+		= ReferenceFrame<REFERENCEPIXEL,PIXELINDEX,FRAMESIZE>,
+	class REGIONS = DefaultRegionPolicy>
 class MotionSearcher
+	: public MotionSearcherBase<PIXEL_NUM,PIXELINDEX,FRAMESIZE,PIXEL,
+		REFERENCEFRAME>
 {
 public:
 	typedef PIXEL Pixel_t;
@@ -193,7 +269,7 @@ public:
 	virtual ~MotionSearcher();
 		// Destructor.
 
-	void Init (Status_t &a_reStatus, int a_nFrames,
+	virtual void Init (Status_t &a_reStatus, int a_nFrames,
 			PIXELINDEX a_tnWidth, PIXELINDEX a_tnHeight,
 			PIXELINDEX a_tnSearchRadiusX, PIXELINDEX a_tnSearchRadiusY,
 			PixelValue_t a_nZeroTolerance, PixelValue_t a_nTolerance,
@@ -203,7 +279,7 @@ public:
 		// accumulate pixel data, the dimensions of the frames, the
 		// search radius, the error tolerances, and the match throttles.
 
-	const ReferenceFrame_t *GetFrameReadyForOutput (void);
+	virtual const ReferenceFrame_t *GetFrameReadyForOutput (void);
 		// If a frame is ready to be output, return it, otherwise return
 		// NULL.
 		// Call this once before each call to AddFrame(), to ensure that
@@ -211,21 +287,44 @@ public:
 		// this implies the data in the returned frame will be
 		// invalidated by AddFrame().
 
-	void AddFrame (Status_t &a_reStatus, const Pixel_t *a_pPixels);
+	virtual void AddFrame (Status_t &a_reStatus,
+			const Pixel_t *a_pPixels);
 		// Add another frame to be analyzed into the system.
 		// The digested version will eventually be returned by either
 		// GetFrameReadyForOutput() or GetRemainingFrames().
 
-	const ReferenceFrame_t *GetRemainingFrames (void);
+	virtual const ReferenceFrame_t *GetRemainingFrames (void);
 		// Once there is no more input, call this repeatedly to get the
 		// details of the remaining frames, until it returns NULL.
 
-	void Purge (void);
+	virtual void Purge (void);
 		// Purge ourselves of temporary structures that aren't normally
 		// freed at the end of a frame.  (Most are.)
 		// Should be called every once in a while (e.g. every 10 frames).
 
+	virtual void AddAllocatorStats (AllocatorStats &a_rStats) const;
+		// Accumulate the statistics of all our allocators into the
+		// given statistics.
+
+	virtual void AddPixelStats (PixelStats &a_rStats) const
+		{ a_rStats.Add (m_oPixelStats); }
+		// Accumulate the pixel statistics of the last frame added into
+		// the given statistics.
+
+	virtual void SetPrintPixelStats (bool a_bPrint)
+		{ m_bPrintPixelStats = a_bPrint; }
+		// Set whether AddFrame() prints its pixel statistics (at
+		// verbosity 1 and up).  On by default; a client that runs
+		// several motion-searchers on parts of a frame turns it off and
+		// prints their sum instead.
+
 private:
+	PixelStats m_oPixelStats;
+		// The pixel statistics of the last frame added.
+
+	bool m_bPrintPixelStats;
+		// Whether AddFrame() prints them.
+
 	int m_nFrames;
 		// The number of reference frames we use.
 
@@ -296,21 +395,8 @@ private:
 	typedef Region2D<PIXELINDEX,FRAMESIZE> BaseRegion_t;
 		// The base class for all our region types.
 
-	#ifdef SET_REGION_IMPLEMENTED_WITH_VECTOR
-	typedef Vector<typename BaseRegion_t::Extent,
-				typename BaseRegion_t::Extent,
-				Ident<typename BaseRegion_t::Extent,
-					typename BaseRegion_t::Extent>,
-				Less<typename BaseRegion_t::Extent> >
-			RegionImp_t;
-	#else // SET_REGION_IMPLEMENTED_WITH_VECTOR
-	typedef SkipList<typename BaseRegion_t::Extent,
-				typename BaseRegion_t::Extent,
-				Ident<typename BaseRegion_t::Extent,
-					typename BaseRegion_t::Extent>,
-				Less<typename BaseRegion_t::Extent> >
-			RegionImp_t;
-	#endif // SET_REGION_IMPLEMENTED_WITH_VECTOR
+	typedef typename SetRegionImp<PIXELINDEX,FRAMESIZE,
+			REGIONS::m_kbSetRegionsAreVectors>::Imp_t RegionImp_t;
 		// The container class that implements our set-based region.
 
 	typedef SetRegion2D<PIXELINDEX,FRAMESIZE,RegionImp_t> Region_t;
@@ -320,7 +406,8 @@ private:
 	typedef BitmapRegion2D<PIXELINDEX,FRAMESIZE> BitmapRegion_t;
 		// How we use BitmapRegion2D<>.
 
-	typedef SearchBorder<PIXELINDEX,FRAMESIZE> BaseSearchBorder_t;
+	typedef SearchBorder<PIXELINDEX,FRAMESIZE,RegionImp_t>
+		BaseSearchBorder_t;
 		// The base class for the type of search-border we'll be using.
 
 	typedef typename BaseSearchBorder_t::MovedRegion MovedRegion;
@@ -340,19 +427,15 @@ private:
 		// length, i.e. the order in which they should be applied to
 		// the reference-frame version of the new frame.
 
-	#ifdef USED_REFERENCE_PIXELS_REGION_IS_BITMAP
-	BitmapRegion_t m_oUsedReferencePixels;
-	#else // USED_REFERENCE_PIXELS_REGION_IS_BITMAP
-	Region_t m_oUsedReferencePixels;
-	#endif // USED_REFERENCE_PIXELS_REGION_IS_BITMAP
+	typedef typename TypeSelect<REGIONS::m_kbUsedPixelsAreBitmaps,
+			BitmapRegion_t,Region_t>::Type UsedPixelsRegion_t;
+		// The type of region that keeps track of used/tested pixels.
+
+	RegionAdapter<UsedPixelsRegion_t> m_oUsedReferencePixels;
 		// The region describing all parts of the reference frame that
 		// have been found in the new frame.
 
-	#ifdef USED_REFERENCE_PIXELS_REGION_IS_BITMAP
-	BitmapRegion_t m_oTestedZeroMotionPixels;
-	#else // USED_REFERENCE_PIXELS_REGION_IS_BITMAP
-	Region_t m_oTestedZeroMotionPixels;
-	#endif // USED_REFERENCE_PIXELS_REGION_IS_BITMAP
+	RegionAdapter<UsedPixelsRegion_t> m_oTestedZeroMotionPixels;
 		// The region describing all parts of the reference frame that
 		// have been tested in the zero-motion pass.
 
@@ -361,11 +444,38 @@ private:
 		// detection is finished.  Allocated here to avoid lots of
 		// creation & destruction.
 
-	#ifdef MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
 	BitmapRegion_t m_oFloodFillRegion;
-	#endif // MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
 		// The region that does the flood-filling for the
-		// match-throttle-region.
+		// match-throttle-region, if the zero-motion or match-throttle
+		// flood-fills are implemented with bitmap regions.
+
+	typedef typename TypeSelect<REGIONS::m_kbZeroMotionFloodFillIsBitmap,
+			BitmapRegion_t,Region_t>::Type ZeroMotionRegion_t;
+	typedef typename TypeSelect
+			<REGIONS::m_kbMatchThrottleFloodFillIsBitmap,
+			BitmapRegion_t,Region_t>::Type MatchThrottleRegion_t;
+	typedef typename TypeSelect<REGIONS::m_kbPruningFloodFillIsBitmap,
+			BitmapRegion_t,Region_t>::Type PruningRegion_t;
+		// The types of region that implement our flood-fills.
+
+	void ZeroMotionFloodFill (Status_t &a_reStatus,
+			const BitmapRegion_t *);
+	void ZeroMotionFloodFill (Status_t &a_reStatus, const Region_t *);
+		// Flood-fill the current pixel-group, which has been found to
+		// have no motion, and leave the result in the match-throttle
+		// region.  The second argument selects the implementation;
+		// pass a null ZeroMotionRegion_t pointer.
+
+	void MatchThrottleFloodFill (Status_t &a_reStatus,
+			PIXELINDEX a_tnMotionX, PIXELINDEX a_tnMotionY,
+			const BitmapRegion_t *);
+	void MatchThrottleFloodFill (Status_t &a_reStatus,
+			PIXELINDEX a_tnMotionX, PIXELINDEX a_tnMotionY,
+			const Region_t *);
+		// Flood-fill the current pixel-group, with the given motion
+		// vector, and leave the result in the match-throttle region.
+		// The last argument selects the implementation; pass a null
+		// MatchThrottleRegion_t pointer.
 
 	void ApplyRegionToNewFrame (Status_t &a_reStatus,
 			const MovedRegion &a_rRegion);
@@ -483,32 +593,17 @@ private:
 
 	// A class that helps implement the zero-motion flood-fill.
 	class ZeroMotionFloodFillControl
-		#ifdef ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
-		: public BitmapRegion_t::FloodFillControl
-		#else // ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
-		: public Region_t::FloodFillControl
-		#endif // ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
+		: public FloodFillControlAdapter<ZeroMotionRegion_t>
 	{
 	private:
-		#ifdef ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
-		typedef typename BitmapRegion_t::FloodFillControl BaseClass;
-			// Keep track of who our base class is.
-		#else // ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
-		typedef typename Region_t::FloodFillControl BaseClass;
+		typedef FloodFillControlAdapter<ZeroMotionRegion_t> BaseClass;
 			// Keep track of who our base class is.
-		#endif // ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
 
 		MotionSearcher *m_pMotionSearcher;
 			// The motion-searcher we're working for.
 
 	public:
-		#ifdef ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
-		ZeroMotionFloodFillControl();
-		#else // ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
-		ZeroMotionFloodFillControl
-				(typename BaseClass::Allocator &a_rAllocator
-					= Region_t::Extents::Imp::sm_oNodeAllocator);
-		#endif // ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
+		ZeroMotionFloodFillControl (RegionAllocator_t &a_rAllocator);
 			// Default constructor.  Must be followed by Init().
 
 		void Init (Status_t &a_reStatus,
@@ -536,28 +631,13 @@ private:
 
 	// A class that helps implement the match-throttle flood-fill.
 	class MatchThrottleFloodFillControl
-		#ifdef MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
-		: public BitmapRegion_t::FloodFillControl
-		#else // MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
-		: public Region_t::FloodFillControl
-		#endif // MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
+		: public FloodFillControlAdapter<MatchThrottleRegion_t>
 	{
 	private:
-		#ifdef MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
-		typedef typename BitmapRegion_t::FloodFillControl BaseClass;
-			// Keep track of who our base class is.
-		#else // MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
-		typedef typename Region_t::FloodFillControl BaseClass;
+		typedef FloodFillControlAdapter<MatchThrottleRegion_t> BaseClass;
 			// Keep track of who our base class is.
-		#endif // MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
 	public:
-		#ifdef MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
-		MatchThrottleFloodFillControl();
-		#else // MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
-		MatchThrottleFloodFillControl
-				(typename BaseClass::Allocator &a_rAllocator
-					= Region_t::Extents::Imp::sm_oNodeAllocator);
-		#endif // MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
+		MatchThrottleFloodFillControl (RegionAllocator_t &a_rAllocator);
 			// Default constructor.  Must be followed by Init().
 
 		void Init (Status_t &a_reStatus,
@@ -598,28 +678,13 @@ private:
 	// A class that helps implement the pruning flood-fill, i.e. the one
 	// that removes resolved pixels from a candidate moved-region.
 	class PruningFloodFillControl
-		#ifdef PRUNING_FLOOD_FILL_WITH_BITMAP_REGIONS
-		: public BitmapRegion_t::FloodFillControl
-		#else // PRUNING_FLOOD_FILL_WITH_BITMAP_REGIONS
-		: public Region_t::FloodFillControl
-		#endif // PRUNING_FLOOD_FILL_WITH_BITMAP_REGIONS
+		: public FloodFillControlAdapter<PruningRegion_t>
 	{
 	private:
-		#ifdef PRUNING_FLOOD_FILL_WITH_BITMAP_REGIONS
-		typedef typename BitmapRegion_t::FloodFillControl BaseClass;
+		typedef FloodFillControlAdapter<PruningRegion_t> BaseClass;
 			// Keep track of who our base class is.
-		#else // PRUNING_FLOOD_FILL_WITH_BITMAP_REGIONS
-		typedef typename Region_t::FloodFillControl BaseClass;
-			// Keep track of who our base class is.
-		#endif // PRUNING_FLOOD_FILL_WITH_BITMAP_REGIONS
 	public:
-		#ifdef PRUNING_FLOOD_FILL_WITH_BITMAP_REGIONS
-		PruningFloodFillControl();
-		#else // MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
-		PruningFloodFillControl
-				(typename BaseClass::Allocator &a_rAllocator
-					= Region_t::Extents::Imp::sm_oNodeAllocator);
-		#endif // PRUNING_FLOOD_FILL_WITH_BITMAP_REGIONS
+		PruningFloodFillControl (RegionAllocator_t &a_rAllocator);
 			// Default constructor.  Must be followed by Init().
 
 		void Init (Status_t &a_reStatus,
@@ -664,30 +729,26 @@ private:
 template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
 	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
-	class REFERENCEFRAME>
+	class REFERENCEFRAME, class REGIONS>
 MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 		PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
-		REFERENCEFRAME>::MotionSearcher()
+		REFERENCEFRAME,REGIONS>::MotionSearcher()
 	: m_oRegionAllocator (1048576),
 	m_oMovedRegionSetAllocator (262144),
 	m_setRegions (typename MovedRegion::SortBySizeThenMotionVectorLength(),
 		m_oMovedRegionSetAllocator),
+	m_oUsedReferencePixels (m_oRegionAllocator),
+	m_oTestedZeroMotionPixels (m_oRegionAllocator),
 	m_oMatchThrottleRegion (m_oRegionAllocator),
 	#ifdef THROTTLE_PIXELSORTER_WITH_SAD
 	m_oMatchAllocator (65536),
 	m_setMatches (typename MatchedPixelGroup::SortBySAD(),
 		m_oMatchAllocator),
 	#endif // THROTTLE_PIXELSORTER_WITH_SAD
-	m_oSearchBorder (m_setRegions, m_oRegionAllocator)
-	#ifndef ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
-	, m_oZeroMotionFloodFillControl (m_oRegionAllocator)
-	#endif // ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
-	#ifndef MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
-	, m_oMatchThrottleFloodFillControl (m_oRegionAllocator)
-	#endif // MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
-	#ifndef PRUNING_FLOOD_FILL_WITH_BITMAP_REGIONS
-	, m_oPruningFloodFillControl (m_oRegionAllocator)
-	#endif // PRUNING_FLOOD_FILL_WITH_BITMAP_REGIONS
+	m_oSearchBorder (m_setRegions, m_oRegionAllocator),
+	m_oZeroMotionFloodFillControl (m_oRegionAllocator),
+	m_oMatchThrottleFloodFillControl (m_oRegionAllocator),
+	m_oPruningFloodFillControl (m_oRegionAllocator)
 {
 	// No frames yet.
 	m_nFrames = 0;
@@ -696,6 +757,9 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	m_tnWidth = m_tnHeight = PIXELINDEX (0);
 	m_tnPixels = FRAMESIZE (0);
 
+	// Print statistics by default.
+	m_bPrintPixelStats = true;
+
 	// No information on the sort of search to do yet.
 	m_tnSearchRadiusX = m_tnSearchRadiusY = PIXELINDEX (0);
 	m_tnZeroTolerance = m_tnTolerance = m_tnTwiceTolerance
@@ -716,10 +780,10 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
 	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
-	class REFERENCEFRAME>
+	class REFERENCEFRAME, class REGIONS>
 MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
-	REFERENCEFRAME>::~MotionSearcher()
+	REFERENCEFRAME,REGIONS>::~MotionSearcher()
 {
 	// Free up any remaining moved regions.  (Testing for a non-zero
 	// size is defined to be safe even if the set hasn't been
@@ -761,10 +825,10 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
 	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
-	class REFERENCEFRAME>
+	class REFERENCEFRAME, class REGIONS>
 void
 MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
-	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,REFERENCEFRAME>::Init
+	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,REFERENCEFRAME,REGIONS>::Init
 	(Status_t &a_reStatus, int a_nFrames, PIXELINDEX a_tnWidth,
 	PIXELINDEX a_tnHeight, PIXELINDEX a_tnSearchRadiusX,
 	PIXELINDEX a_tnSearchRadiusY, PixelValue_t a_tnZeroTolerance,
@@ -829,7 +893,7 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	{
 		// Allocate the next reference frame.
 		m_ppFrames[i] = new ReferenceFrame_t (a_reStatus, a_tnWidth,
-			a_tnHeight);
+			a_tnHeight, m_oPixelPool);
 		if (m_ppFrames[i] == NULL)
 		{
 			a_reStatus = g_kOutOfMemory;
@@ -862,41 +926,19 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 		return;
 
 	// Initialize the moved-region extents allocator.
-	#ifdef SET_REGION_IMPLEMENTED_WITH_VECTOR
-	m_oRegionAllocator.Init (a_reStatus);
+	InitRegionAllocator (a_reStatus, m_oRegionAllocator);
 	if (a_reStatus != g_kNoError)
 		return;
-	#endif // SET_REGION_IMPLEMENTED_WITH_VECTOR
 
 	// Initialize our used reference-pixels container.
-	#ifdef USED_REFERENCE_PIXELS_REGION_IS_BITMAP
 	m_oUsedReferencePixels.Init (a_reStatus, a_tnWidth, a_tnHeight);
-	#else // USED_REFERENCE_PIXELS_REGION_IS_BITMAP
-	m_oUsedReferencePixels.Init (a_reStatus, m_oRegionAllocator);
-	#endif // USED_REFERENCE_PIXELS_REGION_IS_BITMAP
 	if (a_reStatus != g_kNoError)
 		return;
-	#if defined (USED_REFERENCE_PIXELS_REGION_IS_BITMAP)
-	#if defined (DEBUG_REGION2D)
-	// HACK: too expensive, test region class elsewhere.
-	m_oUsedReferencePixels.SetDebug (false);
-	#endif // DEBUG_REGION2D
-	#endif // USED_REFERENCE_PIXELS_REGION_IS_BITMAP
 
 	// Initialize our tested zero-motion-pixels container.
-	#ifdef USED_REFERENCE_PIXELS_REGION_IS_BITMAP
 	m_oTestedZeroMotionPixels.Init (a_reStatus, a_tnWidth, a_tnHeight);
-	#else // USED_REFERENCE_PIXELS_REGION_IS_BITMAP
-	m_oTestedZeroMotionPixels.Init (a_reStatus, m_oRegionAllocator);
-	#endif // USED_REFERENCE_PIXELS_REGION_IS_BITMAP
 	if (a_reStatus != g_kNoError)
 		return;
-	#if defined (USED_REFERENCE_PIXELS_REGION_IS_BITMAP)
-	#if defined (DEBUG_REGION2D)
-	// HACK: too expensive, test region class elsewhere.
-	m_oTestedZeroMotionPixels.SetDebug (false);
-	#endif // DEBUG_REGION2D
-	#endif // USED_REFERENCE_PIXELS_REGION_IS_BITMAP
 
 	// Initialize our match-throttle region.
 	m_oMatchThrottleRegion.Init (a_reStatus);
@@ -905,15 +947,13 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 
 	// Initialize the region that does the flood-filling for the
 	// match-throttle-region.
-	#ifdef MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
-	m_oFloodFillRegion.Init (a_reStatus, a_tnWidth, a_tnHeight);
-	if (a_reStatus != g_kNoError)
-		return;
-	#if defined (DEBUG_REGION2D)
-	// HACK: too expensive, test region class elsewhere.
-	m_oFloodFillRegion.SetDebug (false);
-	#endif // DEBUG_REGION2D
-	#endif // MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
+	if (REGIONS::m_kbZeroMotionFloodFillIsBitmap
+		|| REGIONS::m_kbMatchThrottleFloodFillIsBitmap)
+	{
+		m_oFloodFillRegion.Init (a_reStatus, a_tnWidth, a_tnHeight);
+		if (a_reStatus != g_kNoError)
+			return;
+	}
 
 	// Initialize the search-border.
 	// Note that the search-border is not given the value of
@@ -965,13 +1005,13 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
 	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
-	class REFERENCEFRAME>
+	class REFERENCEFRAME, class REGIONS>
 const typename MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,
 	FRAMESIZE, PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
-	REFERENCEFRAME>::ReferenceFrame_t *
+	REFERENCEFRAME,REGIONS>::ReferenceFrame_t *
 MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
-	REFERENCEFRAME>::GetFrameReadyForOutput (void)
+	REFERENCEFRAME,REGIONS>::GetFrameReadyForOutput (void)
 {
 	ReferenceFrame_t *pFrame;
 		// The frame to return to the caller.
@@ -1011,10 +1051,10 @@ extern "C" { extern int frame, verbose; };
 template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
 	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
-	class REFERENCEFRAME>
+	class REFERENCEFRAME, class REGIONS>
 void
 MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
-	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,REFERENCEFRAME>::AddFrame
+	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,REFERENCEFRAME,REGIONS>::AddFrame
 	(Status_t &a_reStatus, const Pixel_t *a_pPixels)
 {
 	FRAMESIZE i;
@@ -1085,12 +1125,6 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 				m_tnX = 0;
 				for (;;)
 				{
-					ReferencePixel_t *pPrevPixel;
-						// The pixel from the previous frame.
-					#ifdef ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
-					typename BitmapRegion_t::ConstIterator itExtent;
-					#endif // ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
-						// Used to convert between region types.
 
 					// Loop through the pixels to compare, see if they all
 					// match within the tolerance.
@@ -1109,11 +1143,9 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 								goto noMatch;
 
 							// Get the two pixels to compare.
-							pPrevPixel = m_pReferenceFrame->GetPixel
-								(tnPixelX, tnPixelY);
-							assert (pPrevPixel != NULL);
 							const Pixel_t &rPrevPixel
-								= pPrevPixel->GetValue();
+								= m_pReferenceFrame->GetValue
+									(tnPixelX, tnPixelY);
 							const Pixel_t &rNewPixel
 								= a_pPixels[tnPixelY * m_tnWidth
 									+ tnPixelX];
@@ -1129,73 +1161,13 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 					}
 
 					// These pixels are within the zero-motion tolerance.
-					// Set up a region describing the current pixel-group.
-					#ifdef ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
-					m_oFloodFillRegion.Clear();
-					for (tnPixelY = m_tnY;
-						 tnPixelY < m_tnY + PGH;
-						 ++tnPixelY)
-					{
-						m_oFloodFillRegion.Merge (a_reStatus, tnPixelY,
-							m_tnX, m_tnX + PGW);
-						if (a_reStatus != g_kNoError)
-							return;
-					}
-					#else // ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
-					m_oMatchThrottleRegion.Clear();
-					for (tnPixelY = m_tnY;
-						 tnPixelY < m_tnY + PGH;
-						 ++tnPixelY)
-					{
-						m_oMatchThrottleRegion.Merge (a_reStatus, tnPixelY,
-							m_tnX, m_tnX + PGW);
-						if (a_reStatus != g_kNoError)
-							return;
-					}
-					#endif // ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
-
-					// Set its motion vector.
-					m_oMatchThrottleRegion.SetMotionVector (0, 0);
-
-					// Set its location.  (Needed only for debugging
-					// purposes.)
-					#ifndef NDEBUG
-					m_oMatchThrottleRegion.m_tnX = m_tnX;
-					m_oMatchThrottleRegion.m_tnY = m_tnY;
-					#endif // !NDEBUG
-
-					// Flood-fill this match, so as to get its full extent.
-					#ifdef ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
-					m_oFloodFillRegion.FloodFill (a_reStatus,
-						m_oZeroMotionFloodFillControl, false, true);
-					#else // ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
-					m_oMatchThrottleRegion.FloodFill (a_reStatus,
-						m_oZeroMotionFloodFillControl, false, true);
-					#endif // ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
+					// Flood-fill this match, so as to get its full extent,
+					// and leave it in the match-throttle region.
+					ZeroMotionFloodFill (a_reStatus,
+						(const ZeroMotionRegion_t *) NULL);
 					if (a_reStatus != g_kNoError)
 						return;
 
-					// Now copy the results of the flood-fill to the
-					// match-throttle region.
-					#ifdef ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
-					m_oMatchThrottleRegion.Clear();
-					for (itExtent = m_oFloodFillRegion.Begin();
-						 itExtent != m_oFloodFillRegion.End();
-						 ++itExtent)
-					{
-						// Get the current extent.
-						const typename BitmapRegion_t::Extent &rExtent
-							= *itExtent;
-
-						// Copy it to the match-throttle region.
-						m_oMatchThrottleRegion.Union
-							(a_reStatus, rExtent.m_tnY,
-								rExtent.m_tnXStart, rExtent.m_tnXEnd);
-						if (a_reStatus != g_kNoError)
-							return;
-					}
-					#endif // ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
-
 					// All of these reference pixels have been tested.
 					// There's no need to test them again.
 					{
@@ -1327,8 +1299,8 @@ noMatch:
 
 							// If this pixel has been resolved already,
 							// skip this pixel-group.
-							if (m_pNewFrame->GetPixel (tnPixelX,
-									tnPixelY) != NULL)
+							if (m_pNewFrame->HasPixel (tnPixelX,
+									tnPixelY))
 								goto nextGroup;
 
 							// Set the pixel value in the pixel-group.
@@ -1623,15 +1595,14 @@ noMatch:
 						for (tnX = m_tnX; tnX < m_tnX + PGW; ++tnX)
 						{
 							// Allocate a new reference pixel.
-							ReferencePixel_t *pNewPixel
-								= m_oPixelPool.Allocate();
+							FRAMESIZE tnNewPixel = m_oPixelPool.Allocate();
 
 							// Store the new pixel in the reference frame.
-							m_pNewFrame->SetPixel (tnX, tnY, pNewPixel);
+							m_pNewFrame->SetPixel (tnX, tnY, tnNewPixel);
 
 							// Give it the value from the new frame.
-							pNewPixel->AddSample (a_pPixels[tnY
-								* m_tnWidth + tnX]);
+							m_oPixelPool.AddSample (tnNewPixel,
+								a_pPixels[tnY * m_tnWidth + tnX]);
 						}
 					}
 				}
@@ -1832,27 +1803,23 @@ nextGroup:
 	// them, using the data in the new frame.
 	for (i = 0; i < m_tnPixels; ++i)
 	{
-		ReferencePixel_t *pNewPixel;
-
 		// If this pixel is still unresolved, give it the value of
 		// the corresponding pixel in the new frame.
-		pNewPixel = m_pNewFrame->GetPixel (i);
-		if (pNewPixel == NULL)
+		if (!m_pNewFrame->HasPixel (i))
 		{
 			// Allocate a new reference pixel.
-			ReferencePixel_t *pNewPixel = m_oPixelPool.Allocate();
+			FRAMESIZE tnNewPixel = m_oPixelPool.Allocate();
 
 			// Store the new pixel in the reference frame.
-			m_pNewFrame->SetPixel (i, pNewPixel);
+			m_pNewFrame->SetPixel (i, tnNewPixel);
 
 			// Give it the value from the new frame.
-			pNewPixel->AddSample (a_pPixels[i]);
+			m_oPixelPool.AddSample (tnNewPixel, a_pPixels[i]);
 
 			// That's one more new pixel.
 			++tnNewPixels;
 		}
-		else if (pNewPixel != NULL
-			&& pNewPixel->GetFrameReferences() == 1)
+		else if (m_pNewFrame->GetFrameReferences (i) == 1)
 		{
 			// Count up the earlier-found new pixel.  (It wasn't safe to
 			// count them until flood-filling had a chance to override
@@ -1876,7 +1843,7 @@ nextGroup:
 	#ifdef USE_REFERENCEFRAMEPIXELS_ONCE
 	for (i = 0; i < m_tnPixels; ++i)
 	{
-		int16_t nRefs = m_pNewFrame->GetPixel (i)->GetFrameReferences();
+		int16_t nRefs = m_pNewFrame->GetFrameReferences (i);
 		assert (nRefs > 0);
 		assert (nRefs <= m_nFrames);
 	}
@@ -1887,21 +1854,30 @@ nextGroup:
 	m_pReferenceFrame = m_pNewFrame = NULL;
 	m_pNewFramePixels = NULL;
 
+	// Remember the pixel statistics.
+	m_oPixelStats.m_nNotMovedZeroMotion = tnNotMovedZeroMotionPixels;
+	m_oPixelStats.m_nNotMovedThrottled = tnNotMovedThrottledPixels;
+	m_oPixelStats.m_nNotMoved = tnNotMovedPixels;
+	m_oPixelStats.m_nMovedThrottled = tnMovedThrottledPixels;
+	m_oPixelStats.m_nMoved = tnMovedPixels;
+	m_oPixelStats.m_nNoMatchNew = tnNoMatchNewPixels;
+	m_oPixelStats.m_nNew = tnNewPixels;
+
 	// HACK: print the pixel statistics.
-	if (verbose >= 1)
-	{
-		float fInversePixelsPercent = 100.0f / float (m_tnPixels);
+	if (verbose >= 1 && m_bPrintPixelStats)
+		m_oPixelStats.Print (frame);
 
-		fprintf (stderr, "Frame %d: %.1f%%+%.1f%%+%.1f%% not-moved, "
-				"%.1f%%+%.1f%% moved, %.1f%%+%.1f%% new\n",
-			frame,
-			(float (tnNotMovedZeroMotionPixels) * fInversePixelsPercent),
-			(float (tnNotMovedThrottledPixels) * fInversePixelsPercent),
-			(float (tnNotMovedPixels) * fInversePixelsPercent),
-			(float (tnMovedThrottledPixels) * fInversePixelsPercent),
-			(float (tnMovedPixels) * fInversePixelsPercent),
-			(float (tnNoMatchNewPixels) * fInversePixelsPercent),
-			(float (tnNewPixels) * fInversePixelsPercent));
+	// Print the memory used by the temporary allocations.
+	if (verbose >= 2)
+	{
+		AllocatorStats oStats;
+		AddAllocatorStats (oStats);
+		fprintf (stderr, "Frame %d: %luK in %lu chunks (%luK peak), "
+				"%lu allocations peak\n",
+			frame, (unsigned long) (oStats.m_nBytes / 1024),
+			(unsigned long) oStats.m_ulChunks,
+			(unsigned long) (oStats.m_nPeakBytes / 1024),
+			(unsigned long) oStats.m_ulPeakAllocated);
 	}
 
 	// Print the allocation totals.
@@ -1913,15 +1889,9 @@ nextGroup:
 
 	// Purge all remaining temporary memory allocations.
 	m_oMatchThrottleRegion.Purge();
-	#ifndef ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
 	m_oZeroMotionFloodFillControl.Purge();
-	#endif // ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
-	#ifndef MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
 	m_oMatchThrottleFloodFillControl.Purge();
-	#endif // MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
-	#ifndef PRUNING_FLOOD_FILL_WITH_BITMAP_REGIONS
 	m_oPruningFloodFillControl.Purge();
-	#endif // PRUNING_FLOOD_FILL_WITH_BITMAP_REGIONS
 
 	// Make sure our temporary memory allocations have been purged.
 	assert (m_oRegionAllocator.GetNumAllocated() == 0);
@@ -1935,13 +1905,13 @@ nextGroup:
 template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
 	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
-	class REFERENCEFRAME>
+	class REFERENCEFRAME, class REGIONS>
 const typename MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,
 	FRAMESIZE,PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
-	REFERENCEFRAME>::ReferenceFrame_t *
+	REFERENCEFRAME,REGIONS>::ReferenceFrame_t *
 MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
-	REFERENCEFRAME>::GetRemainingFrames (void)
+	REFERENCEFRAME,REGIONS>::GetRemainingFrames (void)
 {
 	ReferenceFrame_t *pFrame;
 		// The frame to return to the caller.
@@ -1966,11 +1936,11 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
 	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
-	class REFERENCEFRAME>
+	class REFERENCEFRAME, class REGIONS>
 void
 MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
-	REFERENCEFRAME>::Purge (void)
+	REFERENCEFRAME,REGIONS>::Purge (void)
 {
 	// Clear out the pixel-sorter.
 	m_oSearchWindow.PurgePixelSorter();
@@ -1978,16 +1948,37 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 
 
 
+// Accumulate the statistics of all our allocators.
+template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
+	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
+	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
+	class REFERENCEFRAME, class REGIONS>
+void
+MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
+	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
+	REFERENCEFRAME,REGIONS>::AddAllocatorStats (AllocatorStats &a_rStats) const
+{
+	a_rStats.Add (m_oRegionAllocator.GetStats());
+	a_rStats.Add (m_oMovedRegionSetAllocator.GetStats());
+	#ifdef THROTTLE_PIXELSORTER_WITH_SAD
+	a_rStats.Add (m_oMatchAllocator.GetStats());
+	#endif // THROTTLE_PIXELSORTER_WITH_SAD
+	m_oSearchBorder.AddAllocatorStats (a_rStats);
+	a_rStats.Add (m_oSearchWindow.GetPixelSorterStats());
+}
+
+
+
 #ifdef THROTTLE_PIXELSORTER_WITH_SAD
 
 // Default constructor.
 template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
 	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
-	class REFERENCEFRAME>
+	class REFERENCEFRAME, class REGIONS>
 MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
-	REFERENCEFRAME>::MatchedPixelGroup::MatchedPixelGroup()
+	REFERENCEFRAME,REGIONS>::MatchedPixelGroup::MatchedPixelGroup()
 {
 	// No match yet.
 	m_tnSAD = 0;
@@ -2000,10 +1991,10 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
 	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
-	class REFERENCEFRAME>
+	class REFERENCEFRAME, class REGIONS>
 MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
-	REFERENCEFRAME>::MatchedPixelGroup::MatchedPixelGroup
+	REFERENCEFRAME,REGIONS>::MatchedPixelGroup::MatchedPixelGroup
 	(Tolerance_t a_tnSAD,
 	const typename SearchWindow_t::PixelGroup *a_pGroup)
 : m_tnSAD (a_tnSAD), m_pGroup (a_pGroup)
@@ -2017,10 +2008,10 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
 	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
-	class REFERENCEFRAME>
+	class REFERENCEFRAME, class REGIONS>
 MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
-	REFERENCEFRAME>::MatchedPixelGroup::~MatchedPixelGroup()
+	REFERENCEFRAME,REGIONS>::MatchedPixelGroup::~MatchedPixelGroup()
 {
 	// Nothing to do.
 }
@@ -2031,11 +2022,11 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
 	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
-	class REFERENCEFRAME>
+	class REFERENCEFRAME, class REGIONS>
 inline bool
 MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
-	REFERENCEFRAME>::MatchedPixelGroup::SortBySAD::operator()
+	REFERENCEFRAME,REGIONS>::MatchedPixelGroup::SortBySAD::operator()
 	(const MatchedPixelGroup &a_rLeft,
 	const MatchedPixelGroup &a_rRight) const
 {
@@ -2051,10 +2042,10 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
 	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
-	class REFERENCEFRAME>
+	class REFERENCEFRAME, class REGIONS>
 void
 MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
-	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,REFERENCEFRAME>
+	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,REFERENCEFRAME,REGIONS>
 	::ApplyRegionToNewFrame (Status_t &a_reStatus,
 	const MovedRegion &a_rRegion)
 {
@@ -2088,9 +2079,9 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 		for (x = rExtent.m_tnXStart; x < rExtent.m_tnXEnd; ++x)
 		{
 			#ifdef PRINT_SEARCHBORDER
-			if (m_pNewFrame->GetPixel (x, rExtent.m_tnY) != NULL
-				&& m_pNewFrame->GetPixel (x, rExtent.m_tnY)
-					->GetFrameReferences() != 1)
+			if (m_pNewFrame->HasPixel (x, rExtent.m_tnY)
+				&& m_pNewFrame->GetFrameReferences (x, rExtent.m_tnY)
+					!= 1)
 			{
 				fprintf (stderr, "Pixel (%d,%d) already resolved\n",
 					int (x), int (rExtent.m_tnY));
@@ -2099,24 +2090,21 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 
 			// Make sure this new-frame pixel hasn't been
 			// resolved yet.
-			assert (m_pNewFrame->GetPixel (x, rExtent.m_tnY)
-				== NULL
-			|| m_pNewFrame->GetPixel (x, rExtent.m_tnY)
-				->GetFrameReferences() == 1);
+			assert (m_pNewFrame->GetFrameReferences (x, rExtent.m_tnY)
+				<= 1);
 
 			// Get the corresponding reference-frame pixel.
-			ReferencePixel_t *pReferencePixel
+			FRAMESIZE tnReferencePixel
 				= m_pReferenceFrame->GetPixel (x + tnMotionX,
 					rExtent.m_tnY + tnMotionY);
-			assert (pReferencePixel != NULL);
 
 			// Set the new-frame pixel to this reference pixel.
 			m_pNewFrame->SetPixel (x, rExtent.m_tnY,
-				pReferencePixel);
+				tnReferencePixel);
 
 			// Accumulate the new-frame value of this pixel.
-			pReferencePixel->AddSample
-				(m_pNewFramePixels[FRAMESIZE (rExtent.m_tnY)
+			m_oPixelPool.AddSample (tnReferencePixel,
+				m_pNewFramePixels[FRAMESIZE (rExtent.m_tnY)
 				 * FRAMESIZE (m_tnWidth) + FRAMESIZE (x)]);
 		}
 	}
@@ -2160,10 +2148,10 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
 	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
-	class REFERENCEFRAME>
+	class REFERENCEFRAME, class REGIONS>
 MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 		PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
-		REFERENCEFRAME>::SearchBorder_t::SearchBorder_t
+		REFERENCEFRAME,REGIONS>::SearchBorder_t::SearchBorder_t
 		(MovedRegionSet &a_rsetRegions,
 			typename MovedRegion::Allocator &a_rAlloc)
 	: BaseClass (a_rAlloc), m_rsetRegions (a_rsetRegions)
@@ -2177,11 +2165,11 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
 	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
-	class REFERENCEFRAME>
+	class REFERENCEFRAME, class REGIONS>
 void
 MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
-	REFERENCEFRAME>::SearchBorder_t::OnCompletedRegion
+	REFERENCEFRAME,REGIONS>::SearchBorder_t::OnCompletedRegion
 	(Status_t &a_reStatus,
 	typename SearchBorder_t::MovedRegion *a_pRegion)
 {
@@ -2212,41 +2200,136 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 
 
 
-// Add a new region, with the given motion vector, to the
-// search border.  Flood-fills its area before adding.
+// Flood-fill the current pixel-group, which has been found to have
+// no motion, using a bitmap region, and leave the result in the
+// match-throttle region.
 template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
 	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
-	class REFERENCEFRAME>
-FRAMESIZE
+	class REFERENCEFRAME, class REGIONS>
+void
 MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
-	REFERENCEFRAME>::SearchBorder_AddNewRegion (Status_t &a_reStatus,
-	PIXELINDEX a_tnMotionX, PIXELINDEX a_tnMotionY)
+	REFERENCEFRAME,REGIONS>::ZeroMotionFloodFill (Status_t &a_reStatus,
+	const BitmapRegion_t *)
 {
 	PIXELINDEX tnY;
 		// Used to loop through the pixel-group's lines.
+	typename BitmapRegion_t::ConstIterator itExtent;
+		// Used to convert between region types.
 
 	// Set up a region describing the current pixel-group.
-	#ifdef MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
 	m_oFloodFillRegion.Clear();
 	for (tnY = m_tnY; tnY < m_tnY + PGH; ++tnY)
 	{
-		m_oFloodFillRegion.Merge (a_reStatus, tnY, m_tnX,
-			m_tnX + PGW);
+		m_oFloodFillRegion.Merge (a_reStatus, tnY, m_tnX, m_tnX + PGW);
 		if (a_reStatus != g_kNoError)
-			return 0;
+			return;
 	}
-	#else // MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
+
+	// Set its motion vector.
+	m_oMatchThrottleRegion.SetMotionVector (0, 0);
+
+	// Set its location.  (Needed only for debugging purposes.)
+	#ifndef NDEBUG
+	m_oMatchThrottleRegion.m_tnX = m_tnX;
+	m_oMatchThrottleRegion.m_tnY = m_tnY;
+	#endif // !NDEBUG
+
+	// Flood-fill this match, so as to get its full extent.
+	m_oFloodFillRegion.FloodFill (a_reStatus,
+		m_oZeroMotionFloodFillControl, false, true);
+	if (a_reStatus != g_kNoError)
+		return;
+
+	// Now copy the results of the flood-fill to the match-throttle
+	// region.
+	m_oMatchThrottleRegion.Clear();
+	for (itExtent = m_oFloodFillRegion.Begin();
+		 itExtent != m_oFloodFillRegion.End();
+		 ++itExtent)
+	{
+		// Get the current extent.
+		const typename BitmapRegion_t::Extent &rExtent = *itExtent;
+
+		// Copy it to the match-throttle region.
+		m_oMatchThrottleRegion.Union (a_reStatus, rExtent.m_tnY,
+			rExtent.m_tnXStart, rExtent.m_tnXEnd);
+		if (a_reStatus != g_kNoError)
+			return;
+	}
+}
+
+
+
+// Flood-fill the current pixel-group, which has been found to have
+// no motion, directly in the match-throttle region.
+template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
+	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
+	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
+	class REFERENCEFRAME, class REGIONS>
+void
+MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
+	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
+	REFERENCEFRAME,REGIONS>::ZeroMotionFloodFill (Status_t &a_reStatus,
+	const Region_t *)
+{
+	PIXELINDEX tnY;
+		// Used to loop through the pixel-group's lines.
+
+	// Set up a region describing the current pixel-group.
 	m_oMatchThrottleRegion.Clear();
 	for (tnY = m_tnY; tnY < m_tnY + PGH; ++tnY)
 	{
 		m_oMatchThrottleRegion.Merge (a_reStatus, tnY, m_tnX,
 			m_tnX + PGW);
 		if (a_reStatus != g_kNoError)
-			return 0;
+			return;
+	}
+
+	// Set its motion vector.
+	m_oMatchThrottleRegion.SetMotionVector (0, 0);
+
+	// Set its location.  (Needed only for debugging purposes.)
+	#ifndef NDEBUG
+	m_oMatchThrottleRegion.m_tnX = m_tnX;
+	m_oMatchThrottleRegion.m_tnY = m_tnY;
+	#endif // !NDEBUG
+
+	// Flood-fill this match, so as to get its full extent.
+	m_oMatchThrottleRegion.FloodFill (a_reStatus,
+		m_oZeroMotionFloodFillControl, false, true);
+}
+
+
+
+// Flood-fill the current pixel-group, with the given motion vector,
+// using a bitmap region, and leave the result in the match-throttle
+// region.
+template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
+	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
+	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
+	class REFERENCEFRAME, class REGIONS>
+void
+MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
+	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
+	REFERENCEFRAME,REGIONS>::MatchThrottleFloodFill (Status_t &a_reStatus,
+	PIXELINDEX a_tnMotionX, PIXELINDEX a_tnMotionY,
+	const BitmapRegion_t *)
+{
+	PIXELINDEX tnY;
+		// Used to loop through the pixel-group's lines.
+	typename BitmapRegion_t::ConstIterator itExtent;
+		// Used to convert between region types.
+
+	// Set up a region describing the current pixel-group.
+	m_oFloodFillRegion.Clear();
+	for (tnY = m_tnY; tnY < m_tnY + PGH; ++tnY)
+	{
+		m_oFloodFillRegion.Merge (a_reStatus, tnY, m_tnX, m_tnX + PGW);
+		if (a_reStatus != g_kNoError)
+			return;
 	}
-	#endif // MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
 
 	// Set its motion vector.
 	m_oMatchThrottleRegion.SetMotionVector (a_tnMotionX, a_tnMotionY);
@@ -2260,21 +2343,14 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	// Flood-fill this match, so as to get its full extent.
 	m_oMatchThrottleFloodFillControl.SetupForFloodFill (a_tnMotionX,
 		a_tnMotionY);
-	#ifdef MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
 	m_oFloodFillRegion.FloodFill (a_reStatus,
 		m_oMatchThrottleFloodFillControl, false, true);
-	#else // MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
-	m_oMatchThrottleRegion.FloodFill (a_reStatus,
-		m_oMatchThrottleFloodFillControl, false, true);
-	#endif // MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
 	if (a_reStatus != g_kNoError)
-		return 0;
+		return;
 
 	// Now copy the results of the flood-fill to the match-throttle
-	// region, so that it can be added to the search-border.
-	#ifdef MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
+	// region.
 	m_oMatchThrottleRegion.Clear();
-	typename BitmapRegion_t::ConstIterator itExtent;
 	for (itExtent = m_oFloodFillRegion.Begin();
 		 itExtent != m_oFloodFillRegion.End();
 		 ++itExtent)
@@ -2283,13 +2359,77 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 		const typename BitmapRegion_t::Extent &rExtent = *itExtent;
 
 		// Copy it to the match-throttle region.
-		m_oMatchThrottleRegion.Merge
-			(a_reStatus, rExtent.m_tnY,
-				rExtent.m_tnXStart, rExtent.m_tnXEnd);
+		m_oMatchThrottleRegion.Merge (a_reStatus, rExtent.m_tnY,
+			rExtent.m_tnXStart, rExtent.m_tnXEnd);
 		if (a_reStatus != g_kNoError)
-			return 0;
+			return;
+	}
+}
+
+
+
+// Flood-fill the current pixel-group, with the given motion vector,
+// directly in the match-throttle region.
+template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
+	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
+	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
+	class REFERENCEFRAME, class REGIONS>
+void
+MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
+	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
+	REFERENCEFRAME,REGIONS>::MatchThrottleFloodFill (Status_t &a_reStatus,
+	PIXELINDEX a_tnMotionX, PIXELINDEX a_tnMotionY,
+	const Region_t *)
+{
+	PIXELINDEX tnY;
+		// Used to loop through the pixel-group's lines.
+
+	// Set up a region describing the current pixel-group.
+	m_oMatchThrottleRegion.Clear();
+	for (tnY = m_tnY; tnY < m_tnY + PGH; ++tnY)
+	{
+		m_oMatchThrottleRegion.Merge (a_reStatus, tnY, m_tnX,
+			m_tnX + PGW);
+		if (a_reStatus != g_kNoError)
+			return;
 	}
-	#endif // MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
+
+	// Set its motion vector.
+	m_oMatchThrottleRegion.SetMotionVector (a_tnMotionX, a_tnMotionY);
+
+	// Set its location.  (Needed only for debugging purposes.)
+	#ifndef NDEBUG
+	m_oMatchThrottleRegion.m_tnX = m_tnX;
+	m_oMatchThrottleRegion.m_tnY = m_tnY;
+	#endif // !NDEBUG
+
+	// Flood-fill this match, so as to get its full extent.
+	m_oMatchThrottleFloodFillControl.SetupForFloodFill (a_tnMotionX,
+		a_tnMotionY);
+	m_oMatchThrottleRegion.FloodFill (a_reStatus,
+		m_oMatchThrottleFloodFillControl, false, true);
+}
+
+
+
+// Add a new region, with the given motion vector, to the
+// search border.  Flood-fills its area before adding.
+template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
+	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
+	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
+	class REFERENCEFRAME, class REGIONS>
+FRAMESIZE
+MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
+	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
+	REFERENCEFRAME,REGIONS>::SearchBorder_AddNewRegion (Status_t &a_reStatus,
+	PIXELINDEX a_tnMotionX, PIXELINDEX a_tnMotionY)
+{
+	// Flood-fill the current pixel-group, so as to get its full
+	// extent, and leave it in the match-throttle region.
+	MatchThrottleFloodFill (a_reStatus, a_tnMotionX, a_tnMotionY,
+		(const MatchThrottleRegion_t *) NULL);
+	if (a_reStatus != g_kNoError)
+		return 0;
 
 	// Get the size of the flood-filled region.
 	FRAMESIZE tnThisMatch = m_oMatchThrottleRegion.NumberOfPoints();
@@ -2330,11 +2470,11 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
 	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
-	class REFERENCEFRAME>
+	class REFERENCEFRAME, class REGIONS>
 FRAMESIZE
 MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
-	REFERENCEFRAME>::SearchBorder_MatchThrottle (Status_t &a_reStatus,
+	REFERENCEFRAME,REGIONS>::SearchBorder_MatchThrottle (Status_t &a_reStatus,
 	FRAMESIZE a_nMatchCount,
 	PIXELINDEX &a_rtnMotionX, PIXELINDEX &a_rtnMotionY)
 {
@@ -2435,17 +2575,12 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
 	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
-	class REFERENCEFRAME>
+	class REFERENCEFRAME, class REGIONS>
 MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
-	REFERENCEFRAME>::ZeroMotionFloodFillControl
-	#ifdef ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
-	::ZeroMotionFloodFillControl()
-	#else // ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
-	::ZeroMotionFloodFillControl
-		(typename BaseClass::Allocator &a_rAllocator)
+	REFERENCEFRAME,REGIONS>::ZeroMotionFloodFillControl
+	::ZeroMotionFloodFillControl (RegionAllocator_t &a_rAllocator)
 	: BaseClass (a_rAllocator)
-	#endif // ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
 {
 	// We don't know who we're working for yet.
 	m_pMotionSearcher = NULL;
@@ -2457,11 +2592,11 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
 	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
-	class REFERENCEFRAME>
+	class REFERENCEFRAME, class REGIONS>
 void
 MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
-	REFERENCEFRAME>::ZeroMotionFloodFillControl::Init
+	REFERENCEFRAME,REGIONS>::ZeroMotionFloodFillControl::Init
 	(Status_t &a_reStatus, MotionSearcher *a_pMotionSearcher)
 {
 	// Make sure they didn't start us off with an error.
@@ -2471,12 +2606,8 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	assert (a_pMotionSearcher != NULL);
 
 	// Initialize our base class.
-	BaseClass::Init (a_reStatus
-		#ifdef ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
-		, a_pMotionSearcher->m_tnWidth,
-		a_pMotionSearcher->m_tnHeight
-		#endif // ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
-		);
+	BaseClass::Init (a_reStatus, a_pMotionSearcher->m_tnWidth,
+		a_pMotionSearcher->m_tnHeight);
 	if (a_reStatus != g_kNoError)
 		return;
 
@@ -2491,39 +2622,38 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
 	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
-	class REFERENCEFRAME>
+	class REFERENCEFRAME, class REGIONS>
 bool
 MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
-	REFERENCEFRAME>::ZeroMotionFloodFillControl::ShouldUseExtent
+	REFERENCEFRAME,REGIONS>::ZeroMotionFloodFillControl::ShouldUseExtent
 	(typename ZeroMotionFloodFillControl::BaseClass::Extent &a_rExtent)
 {
-#ifdef ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
-
-	// Make sure the extent doesn't need to be clipped.
-	assert (a_rExtent.m_tnY >= 0
-		&& a_rExtent.m_tnY < m_pMotionSearcher->m_tnHeight
-		&& a_rExtent.m_tnXStart >= 0
-		&& a_rExtent.m_tnXStart < m_pMotionSearcher->m_tnWidth
-		&& a_rExtent.m_tnXEnd > 0
-		&& a_rExtent.m_tnXEnd <= m_pMotionSearcher->m_tnWidth);
-
-#else // ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
-
-	// If this extent is completely off the screen, skip it.
-	if (a_rExtent.m_tnY < 0
-	|| a_rExtent.m_tnY >= m_pMotionSearcher->m_tnHeight
-	|| a_rExtent.m_tnXStart >= m_pMotionSearcher->m_tnWidth
-	|| a_rExtent.m_tnXEnd <= 0)
-		return false;
-
-	// If this extent is partially off the screen, clip it.
-	if (a_rExtent.m_tnXStart < 0)
-		a_rExtent.m_tnXStart = 0;
-	if (a_rExtent.m_tnXEnd > m_pMotionSearcher->m_tnWidth)
-		a_rExtent.m_tnXEnd = m_pMotionSearcher->m_tnWidth;
-
-#endif // ZERO_MOTION_FLOOD_FILL_WITH_BITMAP_REGIONS
+	if (BaseClass::m_kbBitmap)
+	{
+		// Make sure the extent doesn't need to be clipped.
+		assert (a_rExtent.m_tnY >= 0
+			&& a_rExtent.m_tnY < m_pMotionSearcher->m_tnHeight
+			&& a_rExtent.m_tnXStart >= 0
+			&& a_rExtent.m_tnXStart < m_pMotionSearcher->m_tnWidth
+			&& a_rExtent.m_tnXEnd > 0
+			&& a_rExtent.m_tnXEnd <= m_pMotionSearcher->m_tnWidth);
+	}
+	else
+	{
+		// If this extent is completely off the screen, skip it.
+		if (a_rExtent.m_tnY < 0
+		|| a_rExtent.m_tnY >= m_pMotionSearcher->m_tnHeight
+		|| a_rExtent.m_tnXStart >= m_pMotionSearcher->m_tnWidth
+		|| a_rExtent.m_tnXEnd <= 0)
+			return false;
+
+		// If this extent is partially off the screen, clip it.
+		if (a_rExtent.m_tnXStart < 0)
+			a_rExtent.m_tnXStart = 0;
+		if (a_rExtent.m_tnXEnd > m_pMotionSearcher->m_tnWidth)
+			a_rExtent.m_tnXEnd = m_pMotionSearcher->m_tnWidth;
+	}
 
 	// Let our caller know to use this extent.
 	return true;
@@ -2536,27 +2666,27 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
 	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
-	class REFERENCEFRAME>
+	class REFERENCEFRAME, class REGIONS>
 bool
 MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
-	REFERENCEFRAME>::ZeroMotionFloodFillControl::IsPointInRegion
+	REFERENCEFRAME,REGIONS>::ZeroMotionFloodFillControl::IsPointInRegion
 	(PIXELINDEX a_tnX, PIXELINDEX a_tnY)
 {
 	// If this pixel has been resolved, skip it.
-	if (m_pMotionSearcher->m_pNewFrame->GetPixel (a_tnX, a_tnY) != NULL)
+	if (m_pMotionSearcher->m_pNewFrame->HasPixel (a_tnX, a_tnY))
 		return false;
 
 	// Get the pixels of interest.
 	const Pixel_t &rNewPixel = m_pMotionSearcher->m_pNewFramePixels
 		[a_tnY * m_pMotionSearcher->m_tnWidth + a_tnX];
-	ReferencePixel_t *pRefPixel
-		= m_pMotionSearcher->m_pReferenceFrame->GetPixel (a_tnX, a_tnY);
+	const Pixel_t &rRefPixel
+		= m_pMotionSearcher->m_pReferenceFrame->GetValue (a_tnX, a_tnY);
 
 	// If the new pixel is close enough to the reference pixel, the
 	// point is in the region.
 	if (rNewPixel.IsWithinTolerance
-		(pRefPixel->GetValue(), m_pMotionSearcher->m_tnZeroTolerance))
+		(rRefPixel, m_pMotionSearcher->m_tnZeroTolerance))
 	{
 		// The point is in the region.
 		return true;
@@ -2572,17 +2702,12 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
 	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
-	class REFERENCEFRAME>
+	class REFERENCEFRAME, class REGIONS>
 MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
-	REFERENCEFRAME>::MatchThrottleFloodFillControl
-	#ifdef MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
-	::MatchThrottleFloodFillControl()
-	#else // MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
-	::MatchThrottleFloodFillControl
-		(typename BaseClass::Allocator &a_rAllocator)
+	REFERENCEFRAME,REGIONS>::MatchThrottleFloodFillControl
+	::MatchThrottleFloodFillControl (RegionAllocator_t &a_rAllocator)
 	: BaseClass (a_rAllocator)
-	#endif // MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
 {
 	// We don't know who we're working for yet.
 	m_pMotionSearcher = NULL;
@@ -2594,11 +2719,11 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
 	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
-	class REFERENCEFRAME>
+	class REFERENCEFRAME, class REGIONS>
 void
 MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
-	REFERENCEFRAME>::MatchThrottleFloodFillControl::Init
+	REFERENCEFRAME,REGIONS>::MatchThrottleFloodFillControl::Init
 	(Status_t &a_reStatus, MotionSearcher *a_pMotionSearcher)
 {
 	// Make sure they didn't start us off with an error.
@@ -2608,12 +2733,8 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	assert (a_pMotionSearcher != NULL);
 
 	// Initialize our base class.
-	BaseClass::Init (a_reStatus
-		#ifdef MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
-		, a_pMotionSearcher->m_tnWidth,
-		a_pMotionSearcher->m_tnHeight
-		#endif // MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
-		);
+	BaseClass::Init (a_reStatus, a_pMotionSearcher->m_tnWidth,
+		a_pMotionSearcher->m_tnHeight);
 	if (a_reStatus != g_kNoError)
 		return;
 
@@ -2627,11 +2748,11 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
 	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
-	class REFERENCEFRAME>
+	class REFERENCEFRAME, class REGIONS>
 void
 MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
-	REFERENCEFRAME>::MatchThrottleFloodFillControl::SetupForFloodFill
+	REFERENCEFRAME,REGIONS>::MatchThrottleFloodFillControl::SetupForFloodFill
 	(PIXELINDEX a_tnMotionX, PIXELINDEX a_tnMotionY)
 {
 	// Save the motion vector.
@@ -2646,62 +2767,61 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
 	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
-	class REFERENCEFRAME>
+	class REFERENCEFRAME, class REGIONS>
 bool
 MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
-	REFERENCEFRAME>::MatchThrottleFloodFillControl::ShouldUseExtent
+	REFERENCEFRAME,REGIONS>::MatchThrottleFloodFillControl::ShouldUseExtent
 	(typename Region_t::Extent &a_rExtent)
 {
-#ifdef MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
-
-	// Make sure the extent doesn't need to be clipped.
-	assert (a_rExtent.m_tnY >= 0
-		&& a_rExtent.m_tnY < m_pMotionSearcher->m_tnHeight
-		&& a_rExtent.m_tnXStart >= 0
-		&& a_rExtent.m_tnXStart < m_pMotionSearcher->m_tnWidth
-		&& a_rExtent.m_tnXEnd > 0
-		&& a_rExtent.m_tnXEnd <= m_pMotionSearcher->m_tnWidth);
-
-	// If this extent (with its motion vector) is completely off the
-	// screen, skip it.
-	if (a_rExtent.m_tnY + m_tnMotionY < 0
-	|| a_rExtent.m_tnY + m_tnMotionY >= m_pMotionSearcher->m_tnHeight
-	|| a_rExtent.m_tnXStart + m_tnMotionX >= m_pMotionSearcher->m_tnWidth
-	|| a_rExtent.m_tnXEnd + m_tnMotionX <= 0)
-		return false;
-
-	// If this extent (with its motion vector) is partially off the
-	// screen, clip it.
-	if (a_rExtent.m_tnXStart + m_tnMotionX < 0)
-		a_rExtent.m_tnXStart = -m_tnMotionX;
-	if (a_rExtent.m_tnXEnd + m_tnMotionX > m_pMotionSearcher->m_tnWidth)
-		a_rExtent.m_tnXEnd = m_pMotionSearcher->m_tnWidth - m_tnMotionX;
-
-#else // MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
-
-	// If this extent is completely off the screen, skip it.
-	if (a_rExtent.m_tnY < 0
-	|| a_rExtent.m_tnY >= m_pMotionSearcher->m_tnHeight
-	|| a_rExtent.m_tnXStart >= m_pMotionSearcher->m_tnWidth
-	|| a_rExtent.m_tnXEnd <= 0
-	|| a_rExtent.m_tnY + m_tnMotionY < 0
-	|| a_rExtent.m_tnY + m_tnMotionY >= m_pMotionSearcher->m_tnHeight
-	|| a_rExtent.m_tnXStart + m_tnMotionX >= m_pMotionSearcher->m_tnWidth
-	|| a_rExtent.m_tnXEnd + m_tnMotionX <= 0)
-		return false;
-
-	// If this extent is partially off the screen, clip it.
-	if (a_rExtent.m_tnXStart + m_tnMotionX < 0)
-		a_rExtent.m_tnXStart = -m_tnMotionX;
-	if (a_rExtent.m_tnXEnd + m_tnMotionX > m_pMotionSearcher->m_tnWidth)
-		a_rExtent.m_tnXEnd = m_pMotionSearcher->m_tnWidth - m_tnMotionX;
-	if (a_rExtent.m_tnXStart < 0)
-		a_rExtent.m_tnXStart = 0;
-	if (a_rExtent.m_tnXEnd > m_pMotionSearcher->m_tnWidth)
-		a_rExtent.m_tnXEnd = m_pMotionSearcher->m_tnWidth;
-
-#endif // MATCH_THROTTLE_FLOOD_FILL_WITH_BITMAP_REGIONS
+	if (BaseClass::m_kbBitmap)
+	{
+		// Make sure the extent doesn't need to be clipped.
+		assert (a_rExtent.m_tnY >= 0
+			&& a_rExtent.m_tnY < m_pMotionSearcher->m_tnHeight
+			&& a_rExtent.m_tnXStart >= 0
+			&& a_rExtent.m_tnXStart < m_pMotionSearcher->m_tnWidth
+			&& a_rExtent.m_tnXEnd > 0
+			&& a_rExtent.m_tnXEnd <= m_pMotionSearcher->m_tnWidth);
+
+		// If this extent (with its motion vector) is completely off the
+		// screen, skip it.
+		if (a_rExtent.m_tnY + m_tnMotionY < 0
+		|| a_rExtent.m_tnY + m_tnMotionY >= m_pMotionSearcher->m_tnHeight
+		|| a_rExtent.m_tnXStart + m_tnMotionX >= m_pMotionSearcher->m_tnWidth
+		|| a_rExtent.m_tnXEnd + m_tnMotionX <= 0)
+			return false;
+
+		// If this extent (with its motion vector) is partially off the
+		// screen, clip it.
+		if (a_rExtent.m_tnXStart + m_tnMotionX < 0)
+			a_rExtent.m_tnXStart = -m_tnMotionX;
+		if (a_rExtent.m_tnXEnd + m_tnMotionX > m_pMotionSearcher->m_tnWidth)
+			a_rExtent.m_tnXEnd = m_pMotionSearcher->m_tnWidth - m_tnMotionX;
+	}
+	else
+	{
+		// If this extent is completely off the screen, skip it.
+		if (a_rExtent.m_tnY < 0
+		|| a_rExtent.m_tnY >= m_pMotionSearcher->m_tnHeight
+		|| a_rExtent.m_tnXStart >= m_pMotionSearcher->m_tnWidth
+		|| a_rExtent.m_tnXEnd <= 0
+		|| a_rExtent.m_tnY + m_tnMotionY < 0
+		|| a_rExtent.m_tnY + m_tnMotionY >= m_pMotionSearcher->m_tnHeight
+		|| a_rExtent.m_tnXStart + m_tnMotionX >= m_pMotionSearcher->m_tnWidth
+		|| a_rExtent.m_tnXEnd + m_tnMotionX <= 0)
+			return false;
+
+		// If this extent is partially off the screen, clip it.
+		if (a_rExtent.m_tnXStart + m_tnMotionX < 0)
+			a_rExtent.m_tnXStart = -m_tnMotionX;
+		if (a_rExtent.m_tnXEnd + m_tnMotionX > m_pMotionSearcher->m_tnWidth)
+			a_rExtent.m_tnXEnd = m_pMotionSearcher->m_tnWidth - m_tnMotionX;
+		if (a_rExtent.m_tnXStart < 0)
+			a_rExtent.m_tnXStart = 0;
+		if (a_rExtent.m_tnXEnd > m_pMotionSearcher->m_tnWidth)
+			a_rExtent.m_tnXEnd = m_pMotionSearcher->m_tnWidth;
+	}
 
 	// Let our caller know to use this extent.
 	return true;
@@ -2714,20 +2834,17 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
 	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
-	class REFERENCEFRAME>
+	class REFERENCEFRAME, class REGIONS>
 bool
 MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
-	REFERENCEFRAME>::MatchThrottleFloodFillControl::IsPointInRegion
+	REFERENCEFRAME,REGIONS>::MatchThrottleFloodFillControl::IsPointInRegion
 	(PIXELINDEX a_tnX, PIXELINDEX a_tnY)
 {
-	// Get the new pixel, if any.
-	ReferencePixel_t *pNewPixel = m_pMotionSearcher->m_pNewFrame
-		->GetPixel (a_tnX, a_tnY);
-
 	// We can potentially flood-fill this pixel if it's unresolved or
 	// if it thinks it's new data.
-	if (pNewPixel == NULL || pNewPixel->GetFrameReferences() == 1)
+	if (m_pMotionSearcher->m_pNewFrame->GetFrameReferences (a_tnX, a_tnY)
+		<= 1)
 	{
 		// Get the reference pixel's coordinates.
 		PIXELINDEX tnRefX = a_tnX + m_tnMotionX;
@@ -2742,13 +2859,13 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 		{
 			// If the new pixel is close enough to it, the point is in
 			// the region.
-			ReferencePixel_t *pRefPixel
-				= m_pMotionSearcher->m_pReferenceFrame->GetPixel
+			const Pixel_t &rRefPixel
+				= m_pMotionSearcher->m_pReferenceFrame->GetValue
 					(tnRefX, tnRefY);
 			const Pixel_t &rNewPixel = m_pMotionSearcher
 				->m_pNewFramePixels[a_tnY
 					* m_pMotionSearcher->m_tnWidth + a_tnX];
-			if (rNewPixel.IsWithinTolerance (pRefPixel->GetValue(),
+			if (rNewPixel.IsWithinTolerance (rRefPixel,
 				 m_pMotionSearcher->m_tnTolerance))
 			{
 				// Let our caller know the point is in the region.
@@ -2767,17 +2884,12 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
 	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
-	class REFERENCEFRAME>
+	class REFERENCEFRAME, class REGIONS>
 MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
-	REFERENCEFRAME>::PruningFloodFillControl
-	#ifdef PRUNING_FLOOD_FILL_WITH_BITMAP_REGIONS
-	::PruningFloodFillControl()
-	#else // PRUNING_FLOOD_FILL_WITH_BITMAP_REGIONS
-	::PruningFloodFillControl
-		(typename BaseClass::Allocator &a_rAllocator)
+	REFERENCEFRAME,REGIONS>::PruningFloodFillControl
+	::PruningFloodFillControl (RegionAllocator_t &a_rAllocator)
 	: BaseClass (a_rAllocator)
-	#endif // PRUNING_FLOOD_FILL_WITH_BITMAP_REGIONS
 {
 	// We don't know who we're working for yet.
 	m_pMotionSearcher = NULL;
@@ -2789,11 +2901,11 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
 	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
-	class REFERENCEFRAME>
+	class REFERENCEFRAME, class REGIONS>
 void
 MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
-	REFERENCEFRAME>::PruningFloodFillControl::Init
+	REFERENCEFRAME,REGIONS>::PruningFloodFillControl::Init
 	(Status_t &a_reStatus, MotionSearcher *a_pMotionSearcher)
 {
 	// Make sure they didn't start us off with an error.
@@ -2803,12 +2915,8 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	assert (a_pMotionSearcher != NULL);
 
 	// Initialize our base class.
-	BaseClass::Init (a_reStatus
-		#ifdef PRUNING_FLOOD_FILL_WITH_BITMAP_REGIONS
-		, a_pMotionSearcher->m_tnWidth,
-		a_pMotionSearcher->m_tnHeight
-		#endif // PRUNING_FLOOD_FILL_WITH_BITMAP_REGIONS
-		);
+	BaseClass::Init (a_reStatus, a_pMotionSearcher->m_tnWidth,
+		a_pMotionSearcher->m_tnHeight);
 	if (a_reStatus != g_kNoError)
 		return;
 
@@ -2822,11 +2930,11 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
 	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
-	class REFERENCEFRAME>
+	class REFERENCEFRAME, class REGIONS>
 void
 MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
-	REFERENCEFRAME>::PruningFloodFillControl::SetupForFloodFill
+	REFERENCEFRAME,REGIONS>::PruningFloodFillControl::SetupForFloodFill
 	(PIXELINDEX a_tnMotionX, PIXELINDEX a_tnMotionY)
 {
 	// Save the motion vector.
@@ -2841,11 +2949,11 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
 	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
-	class REFERENCEFRAME>
+	class REFERENCEFRAME, class REGIONS>
 bool
 MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
-	REFERENCEFRAME>::PruningFloodFillControl::ShouldUseExtent
+	REFERENCEFRAME,REGIONS>::PruningFloodFillControl::ShouldUseExtent
 	(typename Region_t::Extent &a_rExtent)
 {
 	// Make sure the extent doesn't need to be clipped.
@@ -2869,20 +2977,17 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
 	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
 	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
-	class REFERENCEFRAME>
+	class REFERENCEFRAME, class REGIONS>
 bool
 MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
-	REFERENCEFRAME>::PruningFloodFillControl::IsPointInRegion
+	REFERENCEFRAME,REGIONS>::PruningFloodFillControl::IsPointInRegion
 	(PIXELINDEX a_tnX, PIXELINDEX a_tnY)
 {
-	// Get the new pixel, if any.
-	ReferencePixel_t *pNewPixel = m_pMotionSearcher->m_pNewFrame
-		->GetPixel (a_tnX, a_tnY);
-
 	// We can potentially flood-fill this pixel if it's unresolved or
 	// if it thinks it's new data.
-	if (pNewPixel == NULL || pNewPixel->GetFrameReferences() == 1)
+	if (m_pMotionSearcher->m_pNewFrame->GetFrameReferences (a_tnX, a_tnY)
+		<= 1)
 	{
 		// Get the reference pixel's coordinates.
 		PIXELINDEX tnRefX = a_tnX + m_tnMotionX;
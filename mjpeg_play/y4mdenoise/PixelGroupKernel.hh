@@ -0,0 +1,504 @@
+#ifndef __PIXEL_GROUP_KERNEL_H__
+#define __PIXEL_GROUP_KERNEL_H__
+
+// Released to the public under the GNU General Public License v2.
+// See the file COPYING for more information.
+
+#include "config.h"
+#include "mjpeg_types.h"
+#include "ReferenceFrame.hh"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif // __SSE2__
+
+
+
+// The pixel-group comparisons used by the search-window and its
+// pixel-sorter.  Parameterized like the search-window, i.e. by the
+// size of elements in the pixels, the dimension of the pixels, the
+// numeric type to use in tolerance calculations, the width/height of
+// pixel groups, the type of the pixel-sorter's child-branch bitmask,
+// and the type of pixels.
+//
+// The general version loops through the pixels and uses the pixel
+// class' own tolerance test.  The pixel-group shapes that y4mdenoise
+// actually uses (4x2 one-byte intensity pixels, 2x2 two-byte color
+// pixels) are specialized below; both of those groups are exactly
+// 8 bytes, and are compared all at once.
+template <class PIXEL_NUM, int DIM, class PIXEL_TOL, int PGW, int PGH,
+	class SORTERBITMASK, class PIXEL>
+class PixelGroupKernel
+{
+public:
+	typedef PIXEL Pixel_t;
+		// Our pixel type.
+
+	typedef PIXEL_TOL Tolerance_t;
+		// Our tolerance value type.
+
+	static bool IsWithinTolerance (const Pixel_t a_atThis[PGH][PGW],
+			const Pixel_t a_atOther[PGH][PGW],
+			Tolerance_t a_tnTolerance);
+		// Returns true if all the pixels in the two groups are within
+		// the given tolerance of each other.
+
+	static bool IsWithinTolerance (const Pixel_t a_atThis[PGH][PGW],
+			const Pixel_t a_atOther[PGH][PGW],
+			Tolerance_t a_tnTolerance, Tolerance_t &a_rtnSAD);
+		// Returns true if all the pixels in the two groups are within
+		// the given tolerance of each other, and backpatches the
+		// sum-of-absolute-differences in a_rtnSAD.
+
+	static bool IsAnyAxisWithinTolerance
+			(const Pixel_t a_atThis[PGH][PGW],
+			const Pixel_t a_atOther[PGH][PGW],
+			Tolerance_t a_tnTolerance);
+		// Returns true if any single dimension of any pixel, taken
+		// by itself, is within the given tolerance of the
+		// corresponding pixel in the other group.
+
+	static bool IsAnyAxisEqual (const Pixel_t a_atThis[PGH][PGW],
+			const Pixel_t a_atOther[PGH][PGW]);
+		// Returns true if any single dimension of any pixel equals
+		// the corresponding pixel in the other group.
+
+	static SORTERBITMASK GetGreaterMask
+			(const Pixel_t a_atThis[PGH][PGW],
+			const Pixel_t a_atOther[PGH][PGW]);
+		// Returns a bitmask with one bit per pixel dimension, set if
+		// the dimension is greater than the corresponding one in the
+		// other group.  Bits are numbered in memory order, i.e. the
+		// same way as SearchWindow::PixelSorterBranchNode::GetBitMask().
+
+	static void NarrowRange (const Pixel_t a_atThis[PGH][PGW],
+			const Pixel_t a_atSplit[PGH][PGW],
+			Pixel_t a_atMin[PGH][PGW], Pixel_t a_atMax[PGH][PGW]);
+		// For every pixel dimension greater than the split value,
+		// raise the minimum to the split value; for all the others,
+		// lower the maximum to the split value.
+};
+
+
+
+// Returns true if all the pixels in the two groups are within
+// the given tolerance of each other.
+template <class PIXEL_NUM, int DIM, class PIXEL_TOL, int PGW, int PGH,
+	class SORTERBITMASK, class PIXEL>
+bool
+PixelGroupKernel<PIXEL_NUM,DIM,PIXEL_TOL,PGW,PGH,SORTERBITMASK,PIXEL>
+	::IsWithinTolerance (const Pixel_t a_atThis[PGH][PGW],
+	const Pixel_t a_atOther[PGH][PGW], Tolerance_t a_tnTolerance)
+{
+	int nX, nY;
+		// Used to loop through pixels.
+
+	// Compare the two pixel groups, pixel by pixel.
+	for (nY = 0; nY < PGH; ++nY)
+		for (nX = 0; nX < PGW; ++nX)
+			if (!a_atThis[nY][nX].IsWithinTolerance (a_atOther[nY][nX],
+				a_tnTolerance))
+			{
+				return false;
+			}
+
+	// The pixel groups are equal, within the given tolerance.
+	return true;
+}
+
+
+
+// Returns true if all the pixels in the two groups are within
+// the given tolerance of each other, and backpatches the
+// sum-of-absolute-differences in a_rtnSAD.
+template <class PIXEL_NUM, int DIM, class PIXEL_TOL, int PGW, int PGH,
+	class SORTERBITMASK, class PIXEL>
+bool
+PixelGroupKernel<PIXEL_NUM,DIM,PIXEL_TOL,PGW,PGH,SORTERBITMASK,PIXEL>
+	::IsWithinTolerance (const Pixel_t a_atThis[PGH][PGW],
+	const Pixel_t a_atOther[PGH][PGW], Tolerance_t a_tnTolerance,
+	Tolerance_t &a_rtnSAD)
+{
+	int nX, nY;
+		// Used to loop through pixels.
+	Tolerance_t tnSAD;
+		// The sum-of-absolute-differences between two pixels.
+
+	// Compare the two pixel groups, pixel by pixel, and sum up the
+	// sum-of-absolute-differences.
+	a_rtnSAD = 0;
+	for (nY = 0; nY < PGH; ++nY)
+	{
+		for (nX = 0; nX < PGW; ++nX)
+		{
+			if (!a_atThis[nY][nX].IsWithinTolerance (a_atOther[nY][nX],
+				a_tnTolerance, tnSAD))
+			{
+				return false;
+			}
+			a_rtnSAD += tnSAD;
+		}
+	}
+
+	// The pixel groups are equal, within the given tolerance.
+	return true;
+}
+
+
+
+// Returns true if any single dimension of any pixel, taken by itself,
+// is within the given tolerance of the corresponding pixel in the
+// other group.
+template <class PIXEL_NUM, int DIM, class PIXEL_TOL, int PGW, int PGH,
+	class SORTERBITMASK, class PIXEL>
+bool
+PixelGroupKernel<PIXEL_NUM,DIM,PIXEL_TOL,PGW,PGH,SORTERBITMASK,PIXEL>
+	::IsAnyAxisWithinTolerance (const Pixel_t a_atThis[PGH][PGW],
+	const Pixel_t a_atOther[PGH][PGW], Tolerance_t a_tnTolerance)
+{
+	int nX, nY, i, j;
+		// Used to loop through pixels & pixel dimensions.
+
+	for (nY = 0; nY < PGH; ++nY)
+	{
+		for (nX = 0; nX < PGW; ++nX)
+		{
+			for (i = 0; i < DIM; ++i)
+			{
+				// Make copies of the two pixels.
+				Pixel_t oThisPixel = a_atThis[nY][nX];
+				const Pixel_t &rOtherPixel = a_atOther[nY][nX];
+
+				// Collapse all dimensions but the current one.
+				for (j = 0; j < DIM; ++j)
+					if (j != i)
+						oThisPixel[j] = rOtherPixel[j];
+
+				// If this axis, all by itself, is within the
+				// tolerance, stop here.
+				if (oThisPixel.IsWithinTolerance (rOtherPixel,
+					a_tnTolerance))
+				{
+					return true;
+				}
+			}
+		}
+	}
+
+	// No axis was within the tolerance.
+	return false;
+}
+
+
+
+// Returns true if any single dimension of any pixel equals the
+// corresponding pixel in the other group.
+template <class PIXEL_NUM, int DIM, class PIXEL_TOL, int PGW, int PGH,
+	class SORTERBITMASK, class PIXEL>
+bool
+PixelGroupKernel<PIXEL_NUM,DIM,PIXEL_TOL,PGW,PGH,SORTERBITMASK,PIXEL>
+	::IsAnyAxisEqual (const Pixel_t a_atThis[PGH][PGW],
+	const Pixel_t a_atOther[PGH][PGW])
+{
+	int nX, nY, i;
+		// Used to loop through pixels & pixel dimensions.
+
+	for (nY = 0; nY < PGH; ++nY)
+		for (nX = 0; nX < PGW; ++nX)
+			for (i = 0; i < DIM; ++i)
+				if (a_atThis[nY][nX][i] == a_atOther[nY][nX][i])
+					return true;
+	return false;
+}
+
+
+
+// Returns a bitmask with one bit per pixel dimension, set if the
+// dimension is greater than the corresponding one in the other group.
+template <class PIXEL_NUM, int DIM, class PIXEL_TOL, int PGW, int PGH,
+	class SORTERBITMASK, class PIXEL>
+SORTERBITMASK
+PixelGroupKernel<PIXEL_NUM,DIM,PIXEL_TOL,PGW,PGH,SORTERBITMASK,PIXEL>
+	::GetGreaterMask (const Pixel_t a_atThis[PGH][PGW],
+	const Pixel_t a_atOther[PGH][PGW])
+{
+	int nX, nY, i;
+		// Used to loop through pixels & pixel dimensions.
+	SORTERBITMASK tnMask;
+		// The mask being built.
+
+	tnMask = 0;
+	for (nY = 0; nY < PGH; ++nY)
+		for (nX = 0; nX < PGW; ++nX)
+			for (i = 0; i < DIM; ++i)
+				if (a_atThis[nY][nX][i] > a_atOther[nY][nX][i])
+					tnMask |= SORTERBITMASK (1)
+						<< (nY * (PGW * DIM) + nX * DIM + i);
+	return tnMask;
+}
+
+
+
+// For every pixel dimension greater than the split value, raise the
+// minimum to the split value; for all the others, lower the maximum
+// to the split value.
+template <class PIXEL_NUM, int DIM, class PIXEL_TOL, int PGW, int PGH,
+	class SORTERBITMASK, class PIXEL>
+void
+PixelGroupKernel<PIXEL_NUM,DIM,PIXEL_TOL,PGW,PGH,SORTERBITMASK,PIXEL>
+	::NarrowRange (const Pixel_t a_atThis[PGH][PGW],
+	const Pixel_t a_atSplit[PGH][PGW], Pixel_t a_atMin[PGH][PGW],
+	Pixel_t a_atMax[PGH][PGW])
+{
+	int nX, nY, i;
+		// Used to loop through pixels & pixel dimensions.
+
+	for (nY = 0; nY < PGH; ++nY)
+		for (nX = 0; nX < PGW; ++nX)
+			for (i = 0; i < DIM; ++i)
+				if (a_atThis[nY][nX][i] > a_atSplit[nY][nX][i])
+					a_atMin[nY][nX][i] = a_atSplit[nY][nX][i];
+				else
+					a_atMax[nY][nX][i] = a_atSplit[nY][nX][i];
+}
+
+
+
+#if defined(__SSE2__)
+
+// Helpers for the 8-byte pixel-group specializations.
+class PixelGroupKernel8
+{
+public:
+	static __m128i Load (const void *a_pPixels)
+		{ return _mm_loadl_epi64 ((const __m128i *) a_pPixels); }
+		// Load a pixel-group into the low half of a register.
+
+	static void Store (void *a_pPixels, __m128i a_vPixels)
+		{ _mm_storel_epi64 ((__m128i *) a_pPixels, a_vPixels); }
+		// Store the low half of a register into a pixel-group.
+
+	static __m128i AbsoluteDifference (__m128i a_vThis, __m128i a_vOther)
+		{ return _mm_or_si128 (_mm_subs_epu8 (a_vThis, a_vOther),
+			_mm_subs_epu8 (a_vOther, a_vThis)); }
+		// Return the per-byte absolute difference.
+
+	static int GetGreaterMask (__m128i a_vThis, __m128i a_vOther)
+	{
+		// Unsigned bytes are greater where the saturated difference
+		// isn't zero.
+		__m128i vSame = _mm_cmpeq_epi8 (_mm_subs_epu8 (a_vThis,
+			a_vOther), _mm_setzero_si128());
+		return ~_mm_movemask_epi8 (vSame) & 0xFF;
+	}
+		// Return a bitmask of the bytes greater than the other's.
+
+	static bool IsAnyEqual (__m128i a_vThis, __m128i a_vOther)
+		{ return (_mm_movemask_epi8 (_mm_cmpeq_epi8 (a_vThis, a_vOther))
+			& 0xFF) != 0; }
+		// Return true if any byte equals the other's.
+
+	static void NarrowRange (__m128i a_vThis, __m128i a_vSplit,
+		void *a_pMin, void *a_pMax)
+	{
+		__m128i vGreater = _mm_xor_si128 (_mm_cmpeq_epi8
+			(_mm_subs_epu8 (a_vThis, a_vSplit), _mm_setzero_si128()),
+			_mm_set1_epi8 (-1));
+		__m128i vSplit = _mm_and_si128 (vGreater, a_vSplit);
+		Store (a_pMin, _mm_or_si128 (vSplit,
+			_mm_andnot_si128 (vGreater, Load (a_pMin))));
+		vSplit = _mm_andnot_si128 (vGreater, a_vSplit);
+		Store (a_pMax, _mm_or_si128 (vSplit,
+			_mm_and_si128 (vGreater, Load (a_pMax))));
+	}
+		// Raise the minimum/lower the maximum to the split value.
+};
+
+
+
+// 4x2 groups of intensity pixels.  Pixels are within tolerance when
+// their absolute difference is.
+template <class SORTERBITMASK>
+class PixelGroupKernel<uint8_t,1,int32_t,4,2,SORTERBITMASK,
+	Pixel<uint8_t,1,int32_t> >
+{
+public:
+	typedef Pixel<uint8_t,1,int32_t> Pixel_t;
+	typedef int32_t Tolerance_t;
+
+	static bool IsWithinTolerance (const Pixel_t a_atThis[2][4],
+		const Pixel_t a_atOther[2][4], Tolerance_t a_tnTolerance)
+	{
+		__m128i vDiff = PixelGroupKernel8::AbsoluteDifference
+			(PixelGroupKernel8::Load (a_atThis),
+			PixelGroupKernel8::Load (a_atOther));
+		return (_mm_movemask_epi8 (_mm_cmpeq_epi8 (_mm_subs_epu8 (vDiff,
+			Tolerance (a_tnTolerance)), _mm_setzero_si128())) & 0xFF)
+			== 0xFF;
+	}
+
+	static bool IsWithinTolerance (const Pixel_t a_atThis[2][4],
+		const Pixel_t a_atOther[2][4], Tolerance_t a_tnTolerance,
+		Tolerance_t &a_rtnSAD)
+	{
+		__m128i vThis = PixelGroupKernel8::Load (a_atThis);
+		__m128i vOther = PixelGroupKernel8::Load (a_atOther);
+		__m128i vDiff = PixelGroupKernel8::AbsoluteDifference (vThis,
+			vOther);
+		if ((_mm_movemask_epi8 (_mm_cmpeq_epi8 (_mm_subs_epu8 (vDiff,
+			Tolerance (a_tnTolerance)), _mm_setzero_si128())) & 0xFF)
+			!= 0xFF)
+		{
+			return false;
+		}
+		a_rtnSAD = _mm_cvtsi128_si32 (_mm_sad_epu8 (vThis, vOther));
+		return true;
+	}
+
+	static bool IsAnyAxisWithinTolerance (const Pixel_t a_atThis[2][4],
+		const Pixel_t a_atOther[2][4], Tolerance_t a_tnTolerance)
+	{
+		__m128i vDiff = PixelGroupKernel8::AbsoluteDifference
+			(PixelGroupKernel8::Load (a_atThis),
+			PixelGroupKernel8::Load (a_atOther));
+		return (_mm_movemask_epi8 (_mm_cmpeq_epi8 (_mm_subs_epu8 (vDiff,
+			Tolerance (a_tnTolerance)), _mm_setzero_si128())) & 0xFF)
+			!= 0;
+	}
+
+	static bool IsAnyAxisEqual (const Pixel_t a_atThis[2][4],
+		const Pixel_t a_atOther[2][4])
+	{
+		return PixelGroupKernel8::IsAnyEqual
+			(PixelGroupKernel8::Load (a_atThis),
+			PixelGroupKernel8::Load (a_atOther));
+	}
+
+	static SORTERBITMASK GetGreaterMask (const Pixel_t a_atThis[2][4],
+		const Pixel_t a_atOther[2][4])
+	{
+		return SORTERBITMASK (PixelGroupKernel8::GetGreaterMask
+			(PixelGroupKernel8::Load (a_atThis),
+			PixelGroupKernel8::Load (a_atOther)));
+	}
+
+	static void NarrowRange (const Pixel_t a_atThis[2][4],
+		const Pixel_t a_atSplit[2][4], Pixel_t a_atMin[2][4],
+		Pixel_t a_atMax[2][4])
+	{
+		PixelGroupKernel8::NarrowRange (PixelGroupKernel8::Load
+			(a_atThis), PixelGroupKernel8::Load (a_atSplit), a_atMin,
+			a_atMax);
+	}
+
+private:
+	static __m128i Tolerance (Tolerance_t a_tnTolerance)
+		{ return _mm_set1_epi8 ((char) ((a_tnTolerance > 255)
+			? 255 : a_tnTolerance)); }
+		// Return the tolerance in every byte.  (Differences can't
+		// exceed 255, so larger tolerances are all the same.)
+};
+
+
+
+// 2x2 groups of color pixels.  Pixels are within tolerance when the
+// square of the length of their vector difference is; single axes are
+// within tolerance when the square of their difference is.
+template <class SORTERBITMASK>
+class PixelGroupKernel<uint8_t,2,int32_t,2,2,SORTERBITMASK,
+	Pixel<uint8_t,2,int32_t> >
+{
+public:
+	typedef Pixel<uint8_t,2,int32_t> Pixel_t;
+	typedef int32_t Tolerance_t;
+
+	static bool IsWithinTolerance (const Pixel_t a_atThis[2][2],
+		const Pixel_t a_atOther[2][2], Tolerance_t a_tnTolerance)
+	{
+		__m128i vDistance = Distance (a_atThis, a_atOther);
+		return _mm_movemask_epi8 (_mm_cmpgt_epi32 (vDistance,
+			_mm_set1_epi32 (a_tnTolerance))) == 0;
+	}
+
+	static bool IsWithinTolerance (const Pixel_t a_atThis[2][2],
+		const Pixel_t a_atOther[2][2], Tolerance_t a_tnTolerance,
+		Tolerance_t &a_rtnSAD)
+	{
+		__m128i vDistance = Distance (a_atThis, a_atOther);
+		if (_mm_movemask_epi8 (_mm_cmpgt_epi32 (vDistance,
+			_mm_set1_epi32 (a_tnTolerance))) != 0)
+		{
+			return false;
+		}
+		vDistance = _mm_add_epi32 (vDistance,
+			_mm_srli_si128 (vDistance, 8));
+		vDistance = _mm_add_epi32 (vDistance,
+			_mm_srli_si128 (vDistance, 4));
+		a_rtnSAD = _mm_cvtsi128_si32 (vDistance);
+		return true;
+	}
+
+	static bool IsAnyAxisWithinTolerance (const Pixel_t a_atThis[2][2],
+		const Pixel_t a_atOther[2][2], Tolerance_t a_tnTolerance)
+	{
+		// Square the per-axis differences.  (255 squared still fits
+		// in an unsigned 16-bit number.)
+		__m128i vDiff = _mm_unpacklo_epi8
+			(PixelGroupKernel8::AbsoluteDifference
+				(PixelGroupKernel8::Load (a_atThis),
+				PixelGroupKernel8::Load (a_atOther)),
+			_mm_setzero_si128());
+		vDiff = _mm_mullo_epi16 (vDiff, vDiff);
+
+		// Compare them to the tolerance.
+		__m128i vTolerance = _mm_set1_epi16 ((short) ((a_tnTolerance
+			> 65535) ? 65535 : a_tnTolerance));
+		return _mm_movemask_epi8 (_mm_cmpeq_epi16 (_mm_subs_epu16
+			(vDiff, vTolerance), _mm_setzero_si128())) != 0;
+	}
+
+	static bool IsAnyAxisEqual (const Pixel_t a_atThis[2][2],
+		const Pixel_t a_atOther[2][2])
+	{
+		return PixelGroupKernel8::IsAnyEqual
+			(PixelGroupKernel8::Load (a_atThis),
+			PixelGroupKernel8::Load (a_atOther));
+	}
+
+	static SORTERBITMASK GetGreaterMask (const Pixel_t a_atThis[2][2],
+		const Pixel_t a_atOther[2][2])
+	{
+		return SORTERBITMASK (PixelGroupKernel8::GetGreaterMask
+			(PixelGroupKernel8::Load (a_atThis),
+			PixelGroupKernel8::Load (a_atOther)));
+	}
+
+	static void NarrowRange (const Pixel_t a_atThis[2][2],
+		const Pixel_t a_atSplit[2][2], Pixel_t a_atMin[2][2],
+		Pixel_t a_atMax[2][2])
+	{
+		PixelGroupKernel8::NarrowRange (PixelGroupKernel8::Load
+			(a_atThis), PixelGroupKernel8::Load (a_atSplit), a_atMin,
+			a_atMax);
+	}
+
+private:
+	static __m128i Distance (const Pixel_t a_atThis[2][2],
+		const Pixel_t a_atOther[2][2])
+	{
+		__m128i vThis = _mm_unpacklo_epi8 (PixelGroupKernel8::Load
+			(a_atThis), _mm_setzero_si128());
+		__m128i vOther = _mm_unpacklo_epi8 (PixelGroupKernel8::Load
+			(a_atOther), _mm_setzero_si128());
+		__m128i vDiff = _mm_sub_epi16 (vThis, vOther);
+		return _mm_madd_epi16 (vDiff, vDiff);
+	}
+		// Return the square of the length of each pixel's vector
+		// difference, as four 32-bit numbers.
+};
+
+#endif // __SSE2__
+
+
+
+#endif // __PIXEL_GROUP_KERNEL_H__
@@ -8,6 +8,7 @@
 #include "config.h"
 #include <assert.h>
 #include "mjpeg_types.h"
+#include "mjpeg_logging.h"
 #include "Status_t.h"
 #include "TemplateLib.hh"
 
@@ -71,6 +72,10 @@ private:
 // Provide the numeric type for accumulated pixels (and tolerance
 // calculations), the numeric type for pixels, the dimension of the
 // pixel, and the class used to implement pixels.
+// Reference pixels are stored by PixelAllocator<>, which keeps each of
+// their fields in its own array (i.e. a structure of arrays), so that
+// the frequently-read pixel values are packed together.  This class
+// describes reference pixels, and knows how to accumulate samples.
 template <class ACCUM_NUM, class PIXEL_NUM, int DIM,
 	class PIXEL = Pixel<PIXEL_NUM,DIM,ACCUM_NUM> >
 class ReferencePixel
@@ -82,48 +87,20 @@ public:
 	typedef ACCUM_NUM Tolerance_t;
 		// Our tolerance value type.
 
-	ReferencePixel();
-		// Default constructor.
-
-	~ReferencePixel();
-		// Destructor.
-
-	void Reset (void);
-		// Reset ourselves, so that we may refer to a new pixel.
-
-	void AddSample (const PIXEL &a_rPixel);
-		// Incorporate another sample.
+	typedef ACCUM_NUM Accum_t;
+		// The numeric type for accumulated pixels.
 
-	const PIXEL &GetValue (void);
-		// Return this pixel's value.
+	enum { m_knDim = DIM };
+		// The dimension of our pixels.
 
-	void AddFrameReference (void) { ++m_nFrameReferences; }
-		// Add another reference from a frame.
-
-	void RemoveFrameReference (void) { --m_nFrameReferences; }
-		// Remove an existing reference from a frame.
-		// (Once all references are removed, the pixel is implicitly
-		// unallocated.)
+	static void Reset (ACCUM_NUM a_atSum[DIM], ACCUM_NUM &a_rtCount,
+			PIXEL &a_rValue);
+		// Reset a pixel, so that it may refer to a new pixel.
 
-	int16_t GetFrameReferences (void) const
-			{ return m_nFrameReferences; }
-		// Return the number of frames that refer to this pixel.
-
-private:
-	ACCUM_NUM m_atSum[DIM];
-		// The sum of the values of all pixels we've incorporated.
-
-	ACCUM_NUM m_tCount;
-		// The number of pixels we've incorporated.
-
-	int16_t m_nFrameReferences;
-		// The number of reference-frames that make use of this pixel.
-		// A value of 0 means the pixel is not in use & therefore can
-		// be allocated.
-
-	PIXEL m_oPixel;
-		// The value of this pixel, i.e. m_nSumY / m_nYCount.
-		// Calculated on demand.
+	static void AddSample (ACCUM_NUM a_atSum[DIM], ACCUM_NUM &a_rtCount,
+			PIXEL &a_rValue, const PIXEL &a_rPixel);
+		// Incorporate another sample into a pixel's accumulated
+		// sum & count, and recalculate its value.
 };
 
 
@@ -132,10 +109,18 @@ private:
 // Parameterized by the type of reference pixel, and a numeric type that
 // can hold the largest number of reference pixels to be allocated (i.e.
 // big enough to hold the product of the frame's width & height).
+// Reference pixels are referred to by their index in the pool.  Each
+// of their fields is stored in its own contiguous array.
 template <class REFERENCEPIXEL, class FRAMESIZE>
 class PixelAllocator
 {
 public:
+	typedef typename REFERENCEPIXEL::Pixel_t Pixel_t;
+		// Our pixel type.
+
+	typedef typename REFERENCEPIXEL::Accum_t Accum_t;
+		// The numeric type for accumulated pixels.
+
 	PixelAllocator();
 		// Default constructor.
 
@@ -147,12 +132,33 @@ public:
 		// This must be greater than or equal to the number of pixels
 		// that can ever be in use at one time.
 
-	REFERENCEPIXEL *Allocate (void);
-		// Allocate another pixel.
+	FRAMESIZE Allocate (void);
+		// Allocate another pixel, and return its index.
 		// (Note that not having a free pixel to allocate indicates
 		// that the a_nCount parameter to Initialize() needed to be
 		// bigger.)
 
+	void AddSample (FRAMESIZE a_tnPixel, const Pixel_t &a_rPixel);
+		// Incorporate another sample into the given pixel.
+
+	const Pixel_t &GetValue (FRAMESIZE a_tnPixel) const
+			{ return m_pValues[a_tnPixel]; }
+		// Return the given pixel's value.
+
+	void AddFrameReference (FRAMESIZE a_tnPixel)
+			{ ++m_pnFrameReferences[a_tnPixel]; }
+		// Add another reference from a frame.
+
+	void RemoveFrameReference (FRAMESIZE a_tnPixel)
+			{ --m_pnFrameReferences[a_tnPixel]; }
+		// Remove an existing reference from a frame.
+		// (Once all references are removed, the pixel is implicitly
+		// unallocated.)
+
+	int16_t GetFrameReferences (FRAMESIZE a_tnPixel) const
+			{ return m_pnFrameReferences[a_tnPixel]; }
+		// Return the number of frames that refer to the given pixel.
+
 private:
 	FRAMESIZE m_tnCount;
 		// The number of reference pixels in our pool.
@@ -162,50 +168,93 @@ private:
 		// A pixel is considered unallocated if it has a zero
 		// reference count.
 
-	REFERENCEPIXEL *m_pPixels;
-		// The pool of pixels.
+	Pixel_t *m_pValues;
+		// The value of each pixel, i.e. its accumulated sum divided
+		// by its count.  Calculated whenever a sample is added.
+
+	Accum_t (*m_patSums)[REFERENCEPIXEL::m_knDim];
+		// The sum of the values of all samples incorporated into
+		// each pixel.
+
+	Accum_t *m_ptCounts;
+		// The number of samples incorporated into each pixel.
+
+	int16_t *m_pnFrameReferences;
+		// The number of reference-frames that make use of each pixel.
+		// A value of 0 means the pixel is not in use & therefore can
+		// be allocated.
 };
 
 
 
-// A reference frame.  Points to reference pixels, which may be shared
+// A reference frame.  Refers to reference pixels, which may be shared
 // across several reference frames, depending on what motion-detection
 // determines about the pixel's lifetime.  Parameterized by the type of
 // reference pixels to use, the numeric type to use for pixel indices,
 // and a numeric type big enough to hold the product of the largest
 // expected width & height.
+// Reference pixels are referred to by their index in the pixel pool,
+// which is usually smaller than a pointer.
 template <class REFERENCEPIXEL, class PIXELINDEX, class FRAMESIZE>
 class ReferenceFrame
 {
 public:
+	typedef PixelAllocator<REFERENCEPIXEL,FRAMESIZE> PixelAllocator_t;
+		// The pool our reference pixels come from.
+
+	typedef typename REFERENCEPIXEL::Pixel_t Pixel_t;
+		// Our pixel type.
+
 	ReferenceFrame (Status_t &a_reStatus, PIXELINDEX a_tnWidth,
-			PIXELINDEX a_tnHeight);
+			PIXELINDEX a_tnHeight, PixelAllocator_t &a_rPixelPool);
 		// Initializing constructor.
 
-	REFERENCEPIXEL *GetPixel (PIXELINDEX a_tnX, PIXELINDEX a_tnY) const;
-		// Get the pixel at this index (which may be NULL).
+	~ReferenceFrame();
+		// Destructor.
 
-	REFERENCEPIXEL *GetPixel (FRAMESIZE a_tnI) const;
-		// Get the pixel at this offset (which may be NULL).
+	bool HasPixel (PIXELINDEX a_tnX, PIXELINDEX a_tnY) const;
+	bool HasPixel (FRAMESIZE a_tnI) const;
+		// Return true if the pixel at this index/offset has been
+		// resolved, i.e. refers to a reference pixel.
 
-	void SetPixel (PIXELINDEX a_tnX, PIXELINDEX a_tnY,
-			REFERENCEPIXEL *a_pPixel);
-		// Set the pixel at this index.  a_pPixel may be NULL.
+	FRAMESIZE GetPixel (PIXELINDEX a_tnX, PIXELINDEX a_tnY) const;
+	FRAMESIZE GetPixel (FRAMESIZE a_tnI) const;
+		// Get the reference pixel at this index/offset.
+		// The pixel must have been resolved.
+
+	const Pixel_t &GetValue (PIXELINDEX a_tnX, PIXELINDEX a_tnY) const;
+	const Pixel_t &GetValue (FRAMESIZE a_tnI) const;
+		// Get the value of the pixel at this index/offset.
+		// The pixel must have been resolved.
 
-	void SetPixel (FRAMESIZE a_tnI, REFERENCEPIXEL *a_pPixel);
-		// Set the pixel at this offset.  a_pPixel may be NULL.
+	int16_t GetFrameReferences (PIXELINDEX a_tnX, PIXELINDEX a_tnY)
+			const;
+	int16_t GetFrameReferences (FRAMESIZE a_tnI) const;
+		// Return the number of frames that refer to the pixel at this
+		// index/offset, or 0 if it hasn't been resolved.
+
+	void SetPixel (PIXELINDEX a_tnX, PIXELINDEX a_tnY,
+			FRAMESIZE a_tnPixel);
+	void SetPixel (FRAMESIZE a_tnI, FRAMESIZE a_tnPixel);
+		// Set the pixel at this index/offset to the given reference
+		// pixel.
 
 	void Reset (void);
-		// Reset the frame, i.e. set all the pixels to NULL.
+		// Reset the frame, i.e. mark all the pixels as unresolved.
 
 private:
+	enum { m_ktnNoPixel = -1 };
+		// The reference pixel of an unresolved pixel.
+
 	PIXELINDEX m_tnWidth, m_tnHeight;
 		// The dimensions of the frame.
 
-	REFERENCEPIXEL **m_ppPixels;
+	PixelAllocator_t &m_rPixelPool;
+		// The pool our reference pixels come from.
+
+	FRAMESIZE *m_ptnPixels;
 		// The reference pixels that make up this frame.
-		// The contained pointers may be NULL, to mark pixels that still
-		// need to be resolved.
+		// Pixels that still need to be resolved contain m_ktnNoPixel.
 };
 
 
@@ -325,69 +374,46 @@ Pixel<NUM,2,TOL>::IsWithinTolerance
 
 
 
-// Default constructor.
-template <class ACCUM_NUM, class PIXEL_NUM, int DIM, class PIXEL>
-ReferencePixel<ACCUM_NUM,PIXEL_NUM,DIM,PIXEL>::ReferencePixel()
-{
-	// Reset the pixel value.
-	Reset();
-
-	// No references from frames yet.
-	m_nFrameReferences = 0;
-}
-
-
-
-// Destructor.
-template <class ACCUM_NUM, class PIXEL_NUM, int DIM, class PIXEL>
-ReferencePixel<ACCUM_NUM,PIXEL_NUM,DIM,PIXEL>::~ReferencePixel()
-{
-	// Make sure no frames refer to us.
-	assert (m_nFrameReferences == 0);
-}
-
-
-
-// Reset ourselves, so that we may refer to a new pixel.
+// Reset a pixel, so that it may refer to a new pixel.
 template <class ACCUM_NUM, class PIXEL_NUM, int DIM, class PIXEL>
 void
-ReferencePixel<ACCUM_NUM,PIXEL_NUM,DIM,PIXEL>::Reset (void)
+ReferencePixel<ACCUM_NUM,PIXEL_NUM,DIM,PIXEL>::Reset
+	(ACCUM_NUM a_atSum[DIM], ACCUM_NUM &a_rtCount, PIXEL &a_rValue)
 {
 	// Reset the accumulated sum, and get rid of any existing pixel value.
 	for (int i = 0; i < DIM; i++)
 	{
-		m_atSum[i] = ACCUM_NUM (0);
-		m_oPixel[i] = PIXEL_NUM (0);
+		a_atSum[i] = ACCUM_NUM (0);
+		a_rValue[i] = PIXEL_NUM (0);
 	}
-	m_tCount = ACCUM_NUM (0);
+	a_rtCount = ACCUM_NUM (0);
 }
 
 
 
-// Incorporate another sample.
+// Incorporate another sample into a pixel's accumulated sum & count,
+// and recalculate its value.
 template <class ACCUM_NUM, class PIXEL_NUM, int DIM, class PIXEL>
 void
 ReferencePixel<ACCUM_NUM,PIXEL_NUM,DIM,PIXEL>::AddSample
-	(const PIXEL &a_rPixel)
+	(ACCUM_NUM a_atSum[DIM], ACCUM_NUM &a_rtCount, PIXEL &a_rValue,
+	const PIXEL &a_rPixel)
 {
-	// Make sure this pixel is in use.
-	assert (m_nFrameReferences > 0);
-
 	// If the number of samples is getting close to causing overflow
 	// problems, deal with it by losing a little resolution.
 	// (These divides should turn into bit-shifts with integer types,
 	// and therefore not be a performance issue.)
-	if (m_tCount >= 10 /* HACK (Limits<ACCUM_NUM>::Max / ACCUM_NUM (2)) */)
+	if (a_rtCount >= 10 /* HACK (Limits<ACCUM_NUM>::Max / ACCUM_NUM (2)) */)
 	{
 		for (int i = 0; i < DIM; i++)
-			m_atSum[i] /= ACCUM_NUM (2);
-		m_tCount /= ACCUM_NUM (2);
+			a_atSum[i] /= ACCUM_NUM (2);
+		a_rtCount /= ACCUM_NUM (2);
 	}
 
 	// Add the value to our accumulated sum.
 	for (int i = 0; i < DIM; i++)
-		m_atSum[i] += a_rPixel[i];
-	++m_tCount;
+		a_atSum[i] += a_rPixel[i];
+	++a_rtCount;
 
 	// Recalculate the pixel value.
 	{
@@ -397,41 +423,33 @@ ReferencePixel<ACCUM_NUM,PIXEL_NUM,DIM,PIXEL>::AddSample
 			// HACK: try to speed this up.
 
 		// Calculate the pixel's value.
-		if (m_tCount <= 10)
+		if (a_rtCount <= 10)
 		{
 			for (int i = 0; i < DIM; i++)
-				m_oPixel[i] = PIXEL_NUM ((float (m_atSum[i])
-					* afDivisors[m_tCount]) + 0.5f);
+				a_rValue[i] = PIXEL_NUM ((float (a_atSum[i])
+					* afDivisors[a_rtCount]) + 0.5f);
 		}
 		else
 		{
 			for (int i = 0; i < DIM; i++)
-				m_oPixel[i] = PIXEL_NUM ((float (m_atSum[i])
-					/ float (m_tCount)) + 0.5f);
+				a_rValue[i] = PIXEL_NUM ((float (a_atSum[i])
+					/ float (a_rtCount)) + 0.5f);
 		}
 	}
 }
 
 
 
-// Return the pixel's value.
-template <class ACCUM_NUM, class PIXEL_NUM, int DIM, class PIXEL>
-const PIXEL &
-ReferencePixel<ACCUM_NUM,PIXEL_NUM,DIM,PIXEL>::GetValue (void)
-{
-	// Easy enough.
-	return m_oPixel;
-}
-
-
-
 // Default constructor.
 template <class REFERENCEPIXEL, class FRAMESIZE>
 PixelAllocator<REFERENCEPIXEL,FRAMESIZE>::PixelAllocator()
 {
 	// No pixels yet.
 	m_tnCount = m_tnNext = 0;
-	m_pPixels = NULL;
+	m_pValues = NULL;
+	m_patSums = NULL;
+	m_ptCounts = NULL;
+	m_pnFrameReferences = NULL;
 }
 
 
@@ -440,9 +458,17 @@ PixelAllocator<REFERENCEPIXEL,FRAMESIZE>::PixelAllocator()
 template <class REFERENCEPIXEL, class FRAMESIZE>
 PixelAllocator<REFERENCEPIXEL,FRAMESIZE>::~PixelAllocator()
 {
-	// Free up the pixel pool.  (The pixels themselves will verify that
-	// there are no more references to them.)
-	delete[] m_pPixels;
+	// Make sure no frames refer to our pixels.
+	#ifndef NDEBUG
+	for (FRAMESIZE i = 0; i < m_tnCount; ++i)
+		assert (m_pnFrameReferences[i] == 0);
+	#endif // !NDEBUG
+
+	// Free up the pixel pool.
+	delete[] m_pValues;
+	delete[] m_patSums;
+	delete[] m_ptCounts;
+	delete[] m_pnFrameReferences;
 }
 
 
@@ -453,15 +479,22 @@ void
 PixelAllocator<REFERENCEPIXEL,FRAMESIZE>::Initialize
 	(Status_t &a_reStatus, FRAMESIZE a_tnCount)
 {
+	FRAMESIZE i;
+		// Used to loop through pixels.
+
 	// Make sure they didn't start us off with an error.
 	assert (a_reStatus == g_kNoError);
 
 	// Make sure we haven't been initialized already.
-	assert (m_pPixels == NULL);
+	assert (m_pValues == NULL);
 
 	// Try to allocate a pool of the given number of pixels.
-	m_pPixels = new REFERENCEPIXEL[a_tnCount];
-	if (m_pPixels == NULL)
+	m_pValues = new Pixel_t[a_tnCount];
+	m_patSums = new Accum_t[a_tnCount][REFERENCEPIXEL::m_knDim];
+	m_ptCounts = new Accum_t[a_tnCount];
+	m_pnFrameReferences = new int16_t[a_tnCount];
+	if (m_pValues == NULL || m_patSums == NULL || m_ptCounts == NULL
+		|| m_pnFrameReferences == NULL)
 	{
 		a_reStatus = g_kOutOfMemory;
 		return;
@@ -470,6 +503,13 @@ PixelAllocator<REFERENCEPIXEL,FRAMESIZE>::Initialize
 	// Remember that we allocated this many pixels.
 	m_tnCount = a_tnCount;
 
+	// No pixels are in use yet.
+	for (i = 0; i < a_tnCount; ++i)
+	{
+		REFERENCEPIXEL::Reset (m_patSums[i], m_ptCounts[i], m_pValues[i]);
+		m_pnFrameReferences[i] = 0;
+	}
+
 	// Allocate the first pixel first.
 	m_tnNext = 0;
 }
@@ -478,14 +518,14 @@ PixelAllocator<REFERENCEPIXEL,FRAMESIZE>::Initialize
 
 // Allocate another pixel.
 template <class REFERENCEPIXEL, class FRAMESIZE>
-REFERENCEPIXEL *
+FRAMESIZE
 PixelAllocator<REFERENCEPIXEL,FRAMESIZE>::Allocate (void)
 {
 	FRAMESIZE tnOrigNext;
 		// The original value of the index of the next pixel to
 		// allocate.  Used to detect when we've run through all of
 		// them.
-	REFERENCEPIXEL *pPixel;
+	FRAMESIZE tnPixel;
 		// The pixel we allocate.
 
 	// Loop through the pixel pool, find an unallocated one, return it
@@ -494,7 +534,7 @@ PixelAllocator<REFERENCEPIXEL,FRAMESIZE>::Allocate (void)
 	for (;;)
 	{
 		// Get the next pixel.
-		pPixel = m_pPixels + m_tnNext;
+		tnPixel = m_tnNext;
 		//m_tnNext = (m_tnNext + 1) % m_tnCount;
 		++m_tnNext;		// (faster...no divide)
 		assert (m_tnNext <= m_tnCount);
@@ -502,29 +542,46 @@ PixelAllocator<REFERENCEPIXEL,FRAMESIZE>::Allocate (void)
 			m_tnNext = 0;
 
 		// If this pixel is unallocated, reset it & return it.
-		if (pPixel->GetFrameReferences() == 0)
+		if (m_pnFrameReferences[tnPixel] == 0)
 		{
-			pPixel->Reset();
-			return pPixel;
+			REFERENCEPIXEL::Reset (m_patSums[tnPixel],
+				m_ptCounts[tnPixel], m_pValues[tnPixel]);
+			return tnPixel;
 		}
 
-		// Make sure we haven't run out of pixels.  (Returning NULL
-		// may cause a segmentation fault in our client, but that's
-		// slightly better than an infinite loop.)
+		// Make sure we haven't run out of pixels.  (Returning an
+		// in-use pixel would silently corrupt the output.)
 		if (m_tnNext == tnOrigNext)
-		{
-			assert (false);
-			return NULL;
-		}
+			mjpeg_error_exit1 ("Reference pixel pool exhausted "
+				"(%lu pixels)", (unsigned long) m_tnCount);
 	}
 }
 
 
 
+// Incorporate another sample into the given pixel.
+template <class REFERENCEPIXEL, class FRAMESIZE>
+void
+PixelAllocator<REFERENCEPIXEL,FRAMESIZE>::AddSample
+	(FRAMESIZE a_tnPixel, const Pixel_t &a_rPixel)
+{
+	// Make sure this pixel is in use.
+	assert (a_tnPixel >= 0 && a_tnPixel < m_tnCount);
+	assert (m_pnFrameReferences[a_tnPixel] > 0);
+
+	// Easy enough.
+	REFERENCEPIXEL::AddSample (m_patSums[a_tnPixel],
+		m_ptCounts[a_tnPixel], m_pValues[a_tnPixel], a_rPixel);
+}
+
+
+
 // Initializing constructor.
 template <class REFERENCEPIXEL, class PIXELINDEX, class FRAMESIZE>
 ReferenceFrame<REFERENCEPIXEL,PIXELINDEX,FRAMESIZE>::ReferenceFrame
-	(Status_t &a_reStatus, PIXELINDEX a_tnWidth, PIXELINDEX a_tnHeight)
+	(Status_t &a_reStatus, PIXELINDEX a_tnWidth, PIXELINDEX a_tnHeight,
+	PixelAllocator_t &a_rPixelPool)
+	: m_rPixelPool (a_rPixelPool)
 {
 	FRAMESIZE tnPixels;
 		// The total number of pixels referred to by this frame.
@@ -540,8 +597,8 @@ ReferenceFrame<REFERENCEPIXEL,PIXELINDEX,FRAMESIZE>::ReferenceFrame
 
 	// Allocate space for the frame's pixels.
 	tnPixels = FRAMESIZE (a_tnWidth) * FRAMESIZE (a_tnHeight);
-	m_ppPixels = new REFERENCEPIXEL * [tnPixels];
-	if (m_ppPixels == NULL)
+	m_ptnPixels = new FRAMESIZE[tnPixels];
+	if (m_ptnPixels == NULL)
 	{
 		a_reStatus = g_kOutOfMemory;
 		return;
@@ -553,15 +610,26 @@ ReferenceFrame<REFERENCEPIXEL,PIXELINDEX,FRAMESIZE>::ReferenceFrame
 
 	// Initially, no pixels are referred to by the frame.
 	for (i = 0; i < tnPixels; i++)
-		m_ppPixels[i] = NULL;
+		m_ptnPixels[i] = FRAMESIZE (m_ktnNoPixel);
 }
 
 
 
-// Get the pixel at this index (which may be NULL).
+// Destructor.
 template <class REFERENCEPIXEL, class PIXELINDEX, class FRAMESIZE>
-REFERENCEPIXEL *
-ReferenceFrame<REFERENCEPIXEL,PIXELINDEX,FRAMESIZE>::GetPixel
+ReferenceFrame<REFERENCEPIXEL,PIXELINDEX,FRAMESIZE>::~ReferenceFrame()
+{
+	// Free up the frame's pixels.  (Our client should have reset us
+	// first, so that the pixel pool doesn't think they're in use.)
+	delete[] m_ptnPixels;
+}
+
+
+
+// Return true if the pixel at this index has been resolved.
+template <class REFERENCEPIXEL, class PIXELINDEX, class FRAMESIZE>
+inline bool
+ReferenceFrame<REFERENCEPIXEL,PIXELINDEX,FRAMESIZE>::HasPixel
 	(PIXELINDEX a_tnX, PIXELINDEX a_tnY) const
 {
 	// Make sure the indices are within limits.
@@ -569,16 +637,16 @@ ReferenceFrame<REFERENCEPIXEL,PIXELINDEX,FRAMESIZE>::GetPixel
 	assert (a_tnY >= PIXELINDEX (0) && a_tnY < m_tnHeight);
 
 	// Easy enough.
-	return m_ppPixels[FRAMESIZE (a_tnY) * FRAMESIZE (m_tnWidth)
-		+ FRAMESIZE (a_tnX)];
+	return m_ptnPixels[FRAMESIZE (a_tnY) * FRAMESIZE (m_tnWidth)
+		+ FRAMESIZE (a_tnX)] != FRAMESIZE (m_ktnNoPixel);
 }
 
 
 
-// Get the pixel at this offset (which may be NULL).
+// Return true if the pixel at this offset has been resolved.
 template <class REFERENCEPIXEL, class PIXELINDEX, class FRAMESIZE>
-REFERENCEPIXEL *
-ReferenceFrame<REFERENCEPIXEL,PIXELINDEX,FRAMESIZE>::GetPixel
+inline bool
+ReferenceFrame<REFERENCEPIXEL,PIXELINDEX,FRAMESIZE>::HasPixel
 	(FRAMESIZE a_tnI) const
 {
 	// Make sure the offset is within limits.
@@ -586,67 +654,148 @@ ReferenceFrame<REFERENCEPIXEL,PIXELINDEX,FRAMESIZE>::GetPixel
 		&& a_tnI < FRAMESIZE (m_tnWidth) * FRAMESIZE (m_tnHeight));
 
 	// Easy enough.
-	return m_ppPixels[a_tnI];
+	return m_ptnPixels[a_tnI] != FRAMESIZE (m_ktnNoPixel);
 }
 
 
 
-// Set the pixel at this index.  a_pPixel may be NULL.
+// Get the reference pixel at this index.
 template <class REFERENCEPIXEL, class PIXELINDEX, class FRAMESIZE>
-void
-ReferenceFrame<REFERENCEPIXEL,PIXELINDEX,FRAMESIZE>::SetPixel
-	(PIXELINDEX a_tnX, PIXELINDEX a_tnY, REFERENCEPIXEL *a_pPixel)
+inline FRAMESIZE
+ReferenceFrame<REFERENCEPIXEL,PIXELINDEX,FRAMESIZE>::GetPixel
+	(PIXELINDEX a_tnX, PIXELINDEX a_tnY) const
 {
 	// Make sure the indices are within limits.
 	assert (a_tnX >= PIXELINDEX (0) && a_tnX < m_tnWidth);
 	assert (a_tnY >= PIXELINDEX (0) && a_tnY < m_tnHeight);
 
 	// Get the pixel of interest.
-	REFERENCEPIXEL *&rpPixel = m_ppPixels[FRAMESIZE (a_tnY)
+	FRAMESIZE tnPixel = m_ptnPixels[FRAMESIZE (a_tnY)
 		* FRAMESIZE (m_tnWidth) + FRAMESIZE (a_tnX)];
 
-	// If there's a pixel here already, remove our reference to it.
-	if (rpPixel != NULL)
-		rpPixel->RemoveFrameReference();
+	// Make sure it's been resolved.
+	assert (tnPixel != FRAMESIZE (m_ktnNoPixel));
 
-	// Store the new pixel here.
-	rpPixel = a_pPixel;
+	// Easy enough.
+	return tnPixel;
+}
+
+
+
+// Get the reference pixel at this offset.
+template <class REFERENCEPIXEL, class PIXELINDEX, class FRAMESIZE>
+inline FRAMESIZE
+ReferenceFrame<REFERENCEPIXEL,PIXELINDEX,FRAMESIZE>::GetPixel
+	(FRAMESIZE a_tnI) const
+{
+	// Make sure the offset is within limits.
+	assert (a_tnI >= FRAMESIZE (0)
+		&& a_tnI < FRAMESIZE (m_tnWidth) * FRAMESIZE (m_tnHeight));
+
+	// Make sure it's been resolved.
+	assert (m_ptnPixels[a_tnI] != FRAMESIZE (m_ktnNoPixel));
 
-	// If they stored a valid pixel, add our reference to it.
-	if (rpPixel != NULL)
-		rpPixel->AddFrameReference();
+	// Easy enough.
+	return m_ptnPixels[a_tnI];
 }
 
 
 
-// Set the pixel at this offset.  a_pPixel may be NULL.
+// Get the value of the pixel at this index.
 template <class REFERENCEPIXEL, class PIXELINDEX, class FRAMESIZE>
-void
+inline const typename REFERENCEPIXEL::Pixel_t &
+ReferenceFrame<REFERENCEPIXEL,PIXELINDEX,FRAMESIZE>::GetValue
+	(PIXELINDEX a_tnX, PIXELINDEX a_tnY) const
+{
+	// Easy enough.
+	return m_rPixelPool.GetValue (GetPixel (a_tnX, a_tnY));
+}
+
+
+
+// Get the value of the pixel at this offset.
+template <class REFERENCEPIXEL, class PIXELINDEX, class FRAMESIZE>
+inline const typename REFERENCEPIXEL::Pixel_t &
+ReferenceFrame<REFERENCEPIXEL,PIXELINDEX,FRAMESIZE>::GetValue
+	(FRAMESIZE a_tnI) const
+{
+	// Easy enough.
+	return m_rPixelPool.GetValue (GetPixel (a_tnI));
+}
+
+
+
+// Return the number of frames that refer to the pixel at this index.
+template <class REFERENCEPIXEL, class PIXELINDEX, class FRAMESIZE>
+int16_t
+ReferenceFrame<REFERENCEPIXEL,PIXELINDEX,FRAMESIZE>::GetFrameReferences
+	(PIXELINDEX a_tnX, PIXELINDEX a_tnY) const
+{
+	// Easy enough.
+	return GetFrameReferences (FRAMESIZE (a_tnY) * FRAMESIZE (m_tnWidth)
+		+ FRAMESIZE (a_tnX));
+}
+
+
+
+// Return the number of frames that refer to the pixel at this offset.
+template <class REFERENCEPIXEL, class PIXELINDEX, class FRAMESIZE>
+int16_t
+ReferenceFrame<REFERENCEPIXEL,PIXELINDEX,FRAMESIZE>::GetFrameReferences
+	(FRAMESIZE a_tnI) const
+{
+	// Unresolved pixels have no references.
+	if (!HasPixel (a_tnI))
+		return 0;
+
+	// Easy enough.
+	return m_rPixelPool.GetFrameReferences (m_ptnPixels[a_tnI]);
+}
+
+
+
+// Set the pixel at this index to the given reference pixel.
+template <class REFERENCEPIXEL, class PIXELINDEX, class FRAMESIZE>
+inline void
+ReferenceFrame<REFERENCEPIXEL,PIXELINDEX,FRAMESIZE>::SetPixel
+	(PIXELINDEX a_tnX, PIXELINDEX a_tnY, FRAMESIZE a_tnPixel)
+{
+	// Make sure the indices are within limits.
+	assert (a_tnX >= PIXELINDEX (0) && a_tnX < m_tnWidth);
+	assert (a_tnY >= PIXELINDEX (0) && a_tnY < m_tnHeight);
+
+	// Easy enough.
+	SetPixel (FRAMESIZE (a_tnY) * FRAMESIZE (m_tnWidth)
+		+ FRAMESIZE (a_tnX), a_tnPixel);
+}
+
+
+
+// Set the pixel at this offset to the given reference pixel.
+template <class REFERENCEPIXEL, class PIXELINDEX, class FRAMESIZE>
+inline void
 ReferenceFrame<REFERENCEPIXEL,PIXELINDEX,FRAMESIZE>::SetPixel
-	(FRAMESIZE a_tnI, REFERENCEPIXEL *a_pPixel)
+	(FRAMESIZE a_tnI, FRAMESIZE a_tnPixel)
 {
 	// Make sure the offset is within limits.
 	assert (a_tnI >= FRAMESIZE (0)
 		&& a_tnI < FRAMESIZE (m_tnWidth) * FRAMESIZE (m_tnHeight));
 
 	// Get the pixel of interest.
-	REFERENCEPIXEL *&rpPixel = m_ppPixels[a_tnI];
+	FRAMESIZE &rtnPixel = m_ptnPixels[a_tnI];
 
 	// If there's a pixel here already, remove our reference to it.
-	if (rpPixel != NULL)
-		rpPixel->RemoveFrameReference();
-
-	// Store the new pixel here.
-	rpPixel = a_pPixel;
+	if (rtnPixel != FRAMESIZE (m_ktnNoPixel))
+		m_rPixelPool.RemoveFrameReference (rtnPixel);
 
-	// If they stored a valid pixel, add our reference to it.
-	if (rpPixel != NULL)
-		rpPixel->AddFrameReference();
+	// Store the new pixel here, and add our reference to it.
+	rtnPixel = a_tnPixel;
+	m_rPixelPool.AddFrameReference (rtnPixel);
 }
 
 
 
-// Reset the frame (i.e. set all the pixels to NULL).
+// Reset the frame (i.e. mark all the pixels as unresolved).
 template <class REFERENCEPIXEL, class PIXELINDEX, class FRAMESIZE>
 void
 ReferenceFrame<REFERENCEPIXEL,PIXELINDEX,FRAMESIZE>::Reset (void)
@@ -656,16 +805,16 @@ ReferenceFrame<REFERENCEPIXEL,PIXELINDEX,FRAMESIZE>::Reset (void)
 	FRAMESIZE i;
 		// Used to loop through pixels.
 
-	// Loop through all pixels, set them to NULL.
+	// Loop through all pixels, mark them as unresolved.
 	tnPixels = FRAMESIZE (m_tnWidth) * FRAMESIZE (m_tnHeight);
 	for (i = 0; i < tnPixels; ++i)
 	{
 		// If there's a pixel here already, remove our reference to it,
 		// then remove the pixel.
-		if (m_ppPixels[i] != NULL)
+		if (m_ptnPixels[i] != FRAMESIZE (m_ktnNoPixel))
 		{
-			m_ppPixels[i]->RemoveFrameReference();
-			m_ppPixels[i] = NULL;
+			m_rPixelPool.RemoveFrameReference (m_ptnPixels[i]);
+			m_ptnPixels[i] = FRAMESIZE (m_ktnNoPixel);
 		}
 	}
 }
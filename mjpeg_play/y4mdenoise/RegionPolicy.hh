@@ -0,0 +1,184 @@
+#ifndef __REGION_POLICY_H__
+#define __REGION_POLICY_H__
+
+// Released to the public under the GNU General Public License v2.
+// See the file COPYING for more information.
+
+// Region-implementation policies for the motion-searcher, and the
+// adapters that let it treat every region implementation the same way.
+
+#include "config.h"
+#include "mjpeg_types.h"
+#include "Status_t.h"
+#include "TemplateLib.hh"
+#include "SetRegion2D.hh"
+#include "BitmapRegion2D.hh"
+#include "Vector.hh"
+#include "SkipList.hh"
+
+
+
+// How the motion-searcher implements its regions.
+//
+// Each of these choices is independent of the others, and none of
+// them affect the results, only the speed & memory usage.  (Which
+// combination is fastest depends on the frame size & search radius.)
+// Since they're template parameters, several combinations can be
+// instantiated side by side and chosen at run time.
+template <bool SETVECTOR, bool USEDBITMAP, bool ZEROMOTIONBITMAP,
+	bool MATCHTHROTTLEBITMAP, bool PRUNINGBITMAP>
+class RegionPolicy
+{
+public:
+	enum { m_kbSetRegionsAreVectors = SETVECTOR };
+		// True to implement set-regions with vectors, false to
+		// implement them with skip-lists.
+
+	enum { m_kbUsedPixelsAreBitmaps = USEDBITMAP };
+		// True to use bitmap regions for the used-reference-pixel and
+		// tested-zero-motion-pixel regions, false to use set-regions.
+
+	enum { m_kbZeroMotionFloodFillIsBitmap = ZEROMOTIONBITMAP };
+		// True to use bitmap regions to implement zero-motion
+		// flood-fill.
+
+	enum { m_kbMatchThrottleFloodFillIsBitmap = MATCHTHROTTLEBITMAP };
+		// True to use bitmap regions to implement match-throttle
+		// flood-fill.
+
+	enum { m_kbPruningFloodFillIsBitmap = PRUNINGBITMAP };
+		// True to use bitmap regions to implement pruning flood-fill.
+};
+
+typedef RegionPolicy<true,true,true,true,false> DefaultRegionPolicy;
+	// The combination that was hardwired before region policies.
+
+
+
+// The container class that implements a set-based region, i.e. a
+// vector or a skip-list of extents.
+template <class INDEX, class SIZE, bool VECTOR>
+class SetRegionImp
+{
+private:
+	typedef typename Region2D<INDEX,SIZE>::Extent Extent;
+public:
+	typedef Vector<Extent,Extent,Ident<Extent,Extent>,Less<Extent> >
+		Imp_t;
+};
+
+template <class INDEX, class SIZE>
+class SetRegionImp<INDEX,SIZE,false>
+{
+private:
+	typedef typename Region2D<INDEX,SIZE>::Extent Extent;
+public:
+	typedef SkipList<Extent,Extent,Ident<Extent,Extent>,Less<Extent> >
+		Imp_t;
+};
+
+
+
+// Initialize a set-region extent allocator.  Only the vector-based
+// one needs it; skip-list node allocators are ready when constructed.
+inline void
+InitRegionAllocator (Status_t &a_reStatus,
+	VariableSizeAllocator &a_rAllocator)
+{
+	a_rAllocator.Init (a_reStatus);
+}
+
+template <class ALLOCATOR>
+inline void
+InitRegionAllocator (Status_t &a_reStatus, ALLOCATOR &a_rAllocator)
+{
+	// Nothing to do.
+}
+
+
+
+// A region that can be constructed with a set-region extent
+// allocator and initialized with the frame dimensions, no matter how
+// it's implemented.  Set-regions ignore the dimensions; bitmap regions
+// ignore the allocator.
+template <class REGION>
+class RegionAdapter;
+
+template <class INDEX, class SIZE, class SETIMP>
+class RegionAdapter<SetRegion2D<INDEX,SIZE,SETIMP> >
+	: public SetRegion2D<INDEX,SIZE,SETIMP>
+{
+private:
+	typedef SetRegion2D<INDEX,SIZE,SETIMP> BaseClass;
+		// Keep track of who our base class is.
+public:
+	explicit RegionAdapter (typename BaseClass::Allocator &a_rAllocator)
+		: BaseClass (a_rAllocator) {}
+		// Default constructor.  Must be followed by Init().
+
+	void Init (Status_t &a_reStatus, INDEX a_tnWidth, INDEX a_tnHeight)
+		{ BaseClass::Init (a_reStatus); }
+		// Initializer.
+};
+
+template <class INDEX, class SIZE>
+class RegionAdapter<BitmapRegion2D<INDEX,SIZE> >
+	: public BitmapRegion2D<INDEX,SIZE>
+{
+public:
+	template <class ALLOCATOR>
+	explicit RegionAdapter (ALLOCATOR &a_rAllocator) {}
+		// Default constructor.  Must be followed by Init().
+};
+
+
+
+// A flood-fill control that can be constructed with a set-region
+// extent allocator and initialized with the frame dimensions, no
+// matter which region implementation it works with.  Clients derive
+// from this, the same way they'd derive from the region's own
+// FloodFillControl.
+template <class REGION>
+class FloodFillControlAdapter;
+
+template <class INDEX, class SIZE, class SETIMP>
+class FloodFillControlAdapter<SetRegion2D<INDEX,SIZE,SETIMP> >
+	: public SetRegion2D<INDEX,SIZE,SETIMP>::FloodFillControl
+{
+private:
+	typedef typename SetRegion2D<INDEX,SIZE,SETIMP>::FloodFillControl
+		BaseClass;
+		// Keep track of who our base class is.
+public:
+	enum { m_kbBitmap = false };
+		// Whether the flood-fill works with bitmap regions.
+
+	explicit FloodFillControlAdapter
+			(typename BaseClass::Allocator &a_rAllocator)
+		: BaseClass (a_rAllocator) {}
+		// Default constructor.  Must be followed by Init().
+
+	void Init (Status_t &a_reStatus, INDEX a_tnWidth, INDEX a_tnHeight)
+		{ BaseClass::Init (a_reStatus); }
+		// Initializer.
+};
+
+template <class INDEX, class SIZE>
+class FloodFillControlAdapter<BitmapRegion2D<INDEX,SIZE> >
+	: public BitmapRegion2D<INDEX,SIZE>::FloodFillControl
+{
+public:
+	enum { m_kbBitmap = true };
+		// Whether the flood-fill works with bitmap regions.
+
+	template <class ALLOCATOR>
+	explicit FloodFillControlAdapter (ALLOCATOR &a_rAllocator) {}
+		// Default constructor.  Must be followed by Init().
+
+	void Purge (void) {}
+		// Bitmap regions don't keep any temporary allocations.
+};
+
+
+
+#endif // __REGION_POLICY_H__
@@ -14,6 +14,7 @@
 #include "DoublyLinkedList.hh"
 #include "Allocator.hh"
 #include "SetRegion2D.hh"
+#include "RegionPolicy.hh"
 #ifdef	sun
 #include <alloca.h>
 #endif
@@ -46,8 +47,9 @@
 
 
 // The generic search-border class.  It's parameterized by the numeric
-// type to use for pixel indices and a numeric type big enough to hold
-// the product of the largest expected frame width/height.
+// type to use for pixel indices, a numeric type big enough to hold
+// the product of the largest expected frame width/height, and the
+// container class that implements its set-regions.
 // When constructed, it's configured with the size of the frame in which
 // it operates, and the width/height of pixel groups to operate on.
 //
@@ -69,28 +71,16 @@
 // way, when it comes time to add a new match, all regions that
 // intersect the current pixel-group are already known, and duplicate
 // matches can be skipped.
-template <class PIXELINDEX, class FRAMESIZE>
+template <class PIXELINDEX, class FRAMESIZE,
+	class REGIONIMP
+		= typename SetRegionImp<PIXELINDEX,FRAMESIZE,true>::Imp_t>
 class SearchBorder
 {
 public:
 	typedef Region2D<PIXELINDEX,FRAMESIZE> BaseRegion_t;
 		// The base class for all our region types.
 
-	#ifdef SET_REGION_IMPLEMENTED_WITH_VECTOR
-	typedef Vector<typename BaseRegion_t::Extent,
-				typename BaseRegion_t::Extent,
-				Ident<typename BaseRegion_t::Extent,
-					typename BaseRegion_t::Extent>,
-				Less<typename BaseRegion_t::Extent> >
-			RegionImp_t;
-	#else // SET_REGION_IMPLEMENTED_WITH_VECTOR
-	typedef SkipList<typename BaseRegion_t::Extent,
-				typename BaseRegion_t::Extent,
-				Ident<typename BaseRegion_t::Extent,
-					typename BaseRegion_t::Extent>,
-				Less<typename BaseRegion_t::Extent> >
-			RegionImp_t;
-	#endif // SET_REGION_IMPLEMENTED_WITH_VECTOR
+	typedef REGIONIMP RegionImp_t;
 		// The container class that implements our set-based region.
 
 	typedef SetRegion2D<PIXELINDEX,FRAMESIZE,RegionImp_t> Region_t;
@@ -175,6 +165,11 @@ public:
 		// Delete a region that was returned by ChooseBestActiveRegion()
 		// or OnCompletedRegion().
 
+	void AddAllocatorStats (AllocatorStats &a_rStats) const;
+		// Accumulate the statistics of the allocators we own into the
+		// given statistics.  (The set-region extent allocator belongs
+		// to our client.)
+
 	// A moved region of pixels that has been detected.
 	// All extents are in the coordinate system of the new frame; that
 	// makes it easy to unify/subtract regions without regard to their
@@ -416,9 +411,22 @@ public:
 
 
 
+// Accumulate the statistics of the allocators we own.
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
+void
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::AddAllocatorStats
+	(AllocatorStats &a_rStats) const
+{
+	a_rStats.Add (m_oBorderExtentsAllocator.GetStats());
+	a_rStats.Add (m_oMovedRegionSetAllocator.GetStats());
+	a_rStats.Add (m_oMovedRegionAllocator.GetStats());
+}
+
+
+
 // Default constructor.
-template <class PIXELINDEX, class FRAMESIZE>
-SearchBorder<PIXELINDEX,FRAMESIZE>::SearchBorder
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::SearchBorder
 		(typename Region_t::Allocator &a_rAlloc)
 	: m_rSetRegionExtentAllocator (a_rAlloc),
 	m_oBorderExtentsAllocator (1048576),
@@ -450,8 +458,8 @@ SearchBorder<PIXELINDEX,FRAMESIZE>::SearchBorder
 
 
 // Destructor.
-template <class PIXELINDEX, class FRAMESIZE>
-SearchBorder<PIXELINDEX,FRAMESIZE>::~SearchBorder()
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::~SearchBorder()
 {
 	// Make sure our client didn't stop in the middle of a frame.
 	FRAMESIZE tnPixels = FRAMESIZE (m_tnWidth) * FRAMESIZE (m_tnHeight);
@@ -490,9 +498,9 @@ SearchBorder<PIXELINDEX,FRAMESIZE>::~SearchBorder()
 
 
 // Initializer.
-template <class PIXELINDEX, class FRAMESIZE>
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
 void
-SearchBorder<PIXELINDEX,FRAMESIZE>::Init (Status_t &a_reStatus,
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::Init (Status_t &a_reStatus,
 	PIXELINDEX a_tnWidth, PIXELINDEX a_tnHeight,
 	PIXELINDEX a_tnSearchRadiusX, PIXELINDEX a_tnSearchRadiusY,
 	PIXELINDEX a_tnPGW, PIXELINDEX a_tnPGH,
@@ -603,8 +611,8 @@ cleanup0:
 
 
 // Default constructor.  Must be followed by Init().
-template <class PIXELINDEX, class FRAMESIZE>
-SearchBorder<PIXELINDEX,FRAMESIZE>::MovedRegion::MovedRegion
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::MovedRegion::MovedRegion
 		(typename BaseClass::Allocator &a_rAlloc)
 	: BaseClass (a_rAlloc)
 {
@@ -630,8 +638,8 @@ SearchBorder<PIXELINDEX,FRAMESIZE>::MovedRegion::MovedRegion
 
 
 // Initializing constructor.  Creates an empty region.
-template <class PIXELINDEX, class FRAMESIZE>
-SearchBorder<PIXELINDEX,FRAMESIZE>::MovedRegion::MovedRegion
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::MovedRegion::MovedRegion
 		(Status_t &a_reStatus, typename BaseClass::Allocator &a_rAlloc)
 	: BaseClass (a_rAlloc)
 {
@@ -665,8 +673,8 @@ SearchBorder<PIXELINDEX,FRAMESIZE>::MovedRegion::MovedRegion
 
 
 // Copy constructor.
-template <class PIXELINDEX, class FRAMESIZE>
-SearchBorder<PIXELINDEX,FRAMESIZE>::MovedRegion::MovedRegion
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::MovedRegion::MovedRegion
 		(Status_t &a_reStatus, const MovedRegion &a_rOther)
 	: BaseClass (a_reStatus, a_rOther)
 {
@@ -707,9 +715,9 @@ SearchBorder<PIXELINDEX,FRAMESIZE>::MovedRegion::MovedRegion
 
 
 // Initializer.  Must be called on default-constructed regions.
-template <class PIXELINDEX, class FRAMESIZE>
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
 void
-SearchBorder<PIXELINDEX,FRAMESIZE>::MovedRegion::Init
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::MovedRegion::Init
 	(Status_t &a_reStatus)
 {
 	// Make sure they didn't start us off with an error.
@@ -724,9 +732,9 @@ SearchBorder<PIXELINDEX,FRAMESIZE>::MovedRegion::Init
 
 
 // Make the current region a copy of the other region.
-template <class PIXELINDEX, class FRAMESIZE>
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
 void
-SearchBorder<PIXELINDEX,FRAMESIZE>::MovedRegion::Assign
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::MovedRegion::Assign
 	(Status_t &a_reStatus, const MovedRegion &a_rOther)
 {
 	// Make sure they didn't start us off with an error.
@@ -753,9 +761,9 @@ SearchBorder<PIXELINDEX,FRAMESIZE>::MovedRegion::Assign
 
 // Move the contents of the other region into the current region.
 // The current region must be empty.
-template <class PIXELINDEX, class FRAMESIZE>
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
 void
-SearchBorder<PIXELINDEX,FRAMESIZE>::MovedRegion::Move
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::MovedRegion::Move
 	(MovedRegion &a_rOther)
 {
 	// Make sure neither region is already in the search-border, i.e.
@@ -783,8 +791,8 @@ SearchBorder<PIXELINDEX,FRAMESIZE>::MovedRegion::Move
 
 
 // Destructor.
-template <class PIXELINDEX, class FRAMESIZE>
-SearchBorder<PIXELINDEX,FRAMESIZE>::MovedRegion::~MovedRegion()
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::MovedRegion::~MovedRegion()
 {
 	// Make sure there are no references left.
 	assert (m_tnReferences == 0);
@@ -801,9 +809,9 @@ SearchBorder<PIXELINDEX,FRAMESIZE>::MovedRegion::~MovedRegion()
 
 
 // Set the motion vector.
-template <class PIXELINDEX, class FRAMESIZE>
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
 inline void
-SearchBorder<PIXELINDEX,FRAMESIZE>::MovedRegion::SetMotionVector
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::MovedRegion::SetMotionVector
 	(PIXELINDEX a_tnX, PIXELINDEX a_tnY)
 {
 	// Set the motion vector.
@@ -819,9 +827,9 @@ SearchBorder<PIXELINDEX,FRAMESIZE>::MovedRegion::SetMotionVector
 
 
 // Get the motion vector.
-template <class PIXELINDEX, class FRAMESIZE>
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
 inline void
-SearchBorder<PIXELINDEX,FRAMESIZE>::MovedRegion::GetMotionVector
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::MovedRegion::GetMotionVector
 	(PIXELINDEX &a_rtnX, PIXELINDEX &a_rtnY) const
 {
 	// Easy enough.
@@ -832,9 +840,9 @@ SearchBorder<PIXELINDEX,FRAMESIZE>::MovedRegion::GetMotionVector
 
 
 // Comparison operator.
-template <class PIXELINDEX, class FRAMESIZE>
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
 inline bool
-SearchBorder<PIXELINDEX,FRAMESIZE>::MovedRegion
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::MovedRegion
 	::SortBySizeThenMotionVectorLength::operator()
 	(const MovedRegion *a_pLeft, const MovedRegion *a_pRight) const
 {
@@ -869,9 +877,9 @@ SearchBorder<PIXELINDEX,FRAMESIZE>::MovedRegion
 
 
 // Comparison operator.
-template <class PIXELINDEX, class FRAMESIZE>
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
 inline bool
-SearchBorder<PIXELINDEX,FRAMESIZE>::MovedRegion
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::MovedRegion
 	::SortBySizeThenMotionVectorLengthThenRegionAddress::operator()
 	(const MovedRegion *a_pLeft, const MovedRegion *a_pRight) const
 {
@@ -912,9 +920,9 @@ SearchBorder<PIXELINDEX,FRAMESIZE>::MovedRegion
 
 
 // Get the squared length of the motion vector.
-template <class PIXELINDEX, class FRAMESIZE>
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
 inline FRAMESIZE
-SearchBorder<PIXELINDEX,FRAMESIZE>::MovedRegion
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::MovedRegion
 	::GetSquaredMotionVectorLength (void) const
 {
 	// Easy enough.
@@ -926,17 +934,17 @@ SearchBorder<PIXELINDEX,FRAMESIZE>::MovedRegion
 #ifndef NDEBUG
 
 // The number of region objects in existence.
-template <class PIXELINDEX, class FRAMESIZE>
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
 uint32_t
-SearchBorder<PIXELINDEX,FRAMESIZE>::MovedRegion::sm_ulInstances;
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::MovedRegion::sm_ulInstances;
 
 #endif // !NDEBUG
 
 
 
 // Default constructor.
-template <class PIXELINDEX, class FRAMESIZE>
-SearchBorder<PIXELINDEX,FRAMESIZE>::BorderExtentBoundary
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::BorderExtentBoundary
 	::BorderExtentBoundary()
 {
 	// Fill in the blanks.
@@ -947,8 +955,8 @@ SearchBorder<PIXELINDEX,FRAMESIZE>::BorderExtentBoundary
 
 
 // Initializing constructor.
-template <class PIXELINDEX, class FRAMESIZE>
-SearchBorder<PIXELINDEX,FRAMESIZE>::BorderExtentBoundary
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::BorderExtentBoundary
 	::BorderExtentBoundary (MovedRegion *a_pRegion)
 {
 	// Make sure they gave us a region.
@@ -962,8 +970,8 @@ SearchBorder<PIXELINDEX,FRAMESIZE>::BorderExtentBoundary
 
 
 // Destructor.
-template <class PIXELINDEX, class FRAMESIZE>
-SearchBorder<PIXELINDEX,FRAMESIZE>::BorderExtentBoundary
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::BorderExtentBoundary
 	::~BorderExtentBoundary()
 {
 	// Nothing to do.
@@ -974,9 +982,9 @@ SearchBorder<PIXELINDEX,FRAMESIZE>::BorderExtentBoundary
 #ifndef NDEBUG
 
 // Equality operator.
-template <class PIXELINDEX, class FRAMESIZE>
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
 bool
-SearchBorder<PIXELINDEX,FRAMESIZE>::BorderExtentBoundary
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::BorderExtentBoundary
 	::operator == (const BorderExtentBoundary &a_rOther) const
 {
 	// Compare ourselves, field by field.
@@ -989,9 +997,9 @@ SearchBorder<PIXELINDEX,FRAMESIZE>::BorderExtentBoundary
 
 
 // Initialize the search-border, i.e. start in the upper-left corner.
-template <class PIXELINDEX, class FRAMESIZE>
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
 void
-SearchBorder<PIXELINDEX,FRAMESIZE>::StartFrame (Status_t &a_reStatus)
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::StartFrame (Status_t &a_reStatus)
 {
 	// Make sure they didn't start us off with an error.
 	assert (a_reStatus == g_kNoError);
@@ -1033,9 +1041,9 @@ SearchBorder<PIXELINDEX,FRAMESIZE>::StartFrame (Status_t &a_reStatus)
 
 
 // Get the motion-vector-match cell for this motion-vector.
-template <class PIXELINDEX, class FRAMESIZE>
-typename SearchBorder<PIXELINDEX,FRAMESIZE>::MotionVectorMatch &
-SearchBorder<PIXELINDEX,FRAMESIZE>::GetMotionVectorMatch
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
+typename SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::MotionVectorMatch &
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::GetMotionVectorMatch
 	(PIXELINDEX a_tnMotionX, PIXELINDEX a_tnMotionY) const
 {
 	// Make sure the motion-vector is in range.
@@ -1060,9 +1068,9 @@ SearchBorder<PIXELINDEX,FRAMESIZE>::GetMotionVectorMatch
 
 
 // Add the given region to the motion-vector-match array.
-template <class PIXELINDEX, class FRAMESIZE>
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
 void
-SearchBorder<PIXELINDEX,FRAMESIZE>::AddMotionVectorMatch
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::AddMotionVectorMatch
 	(MovedRegion *a_pRegion)
 {
 	// Make sure they gave us a region.
@@ -1084,9 +1092,9 @@ SearchBorder<PIXELINDEX,FRAMESIZE>::AddMotionVectorMatch
 
 
 // Remove the given region from the motion-vector-match array.
-template <class PIXELINDEX, class FRAMESIZE>
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
 void
-SearchBorder<PIXELINDEX,FRAMESIZE>::RemoveMotionVectorMatch
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::RemoveMotionVectorMatch
 	(MovedRegion *a_pRegion)
 {
 	// Make sure they gave us a region.
@@ -1111,9 +1119,9 @@ SearchBorder<PIXELINDEX,FRAMESIZE>::RemoveMotionVectorMatch
 
 // Move one pixel to the right, adding and removing regions from
 // the potentially-intersecting list.
-template <class PIXELINDEX, class FRAMESIZE>
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
 void
-SearchBorder<PIXELINDEX,FRAMESIZE>::MoveRight (Status_t &a_reStatus)
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::MoveRight (Status_t &a_reStatus)
 {
 	PIXELINDEX tnI;
 		// Used to loop through iterators.
@@ -1210,9 +1218,9 @@ SearchBorder<PIXELINDEX,FRAMESIZE>::MoveRight (Status_t &a_reStatus)
 
 // Move one pixel to the left, adding and removing regions from
 // the potentially-intersecting list.
-template <class PIXELINDEX, class FRAMESIZE>
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
 void
-SearchBorder<PIXELINDEX,FRAMESIZE>::MoveLeft (Status_t &a_reStatus)
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::MoveLeft (Status_t &a_reStatus)
 {
 	int tnI;
 		// Used to loop through iterators.
@@ -1310,9 +1318,9 @@ SearchBorder<PIXELINDEX,FRAMESIZE>::MoveLeft (Status_t &a_reStatus)
 
 // Move down a line, finding all regions that can no longer be
 // contiguous with new matches, and handing them back to the client.
-template <class PIXELINDEX, class FRAMESIZE>
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
 void
-SearchBorder<PIXELINDEX,FRAMESIZE>::MoveDown (Status_t &a_reStatus)
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::MoveDown (Status_t &a_reStatus)
 {
 	FRAMESIZE tnI;
 	typename BorderExtentBoundarySet::Iterator itBorder;
@@ -1621,9 +1629,9 @@ SearchBorder<PIXELINDEX,FRAMESIZE>::MoveDown (Status_t &a_reStatus)
 
 // Return the size of the largest active-region.
 // Returns zero if there are no active-regions.
-template <class PIXELINDEX, class FRAMESIZE>
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
 FRAMESIZE
-SearchBorder<PIXELINDEX,FRAMESIZE>::GetSizeOfLargestActiveRegion
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::GetSizeOfLargestActiveRegion
 	(void) const
 {
 	// Get the largest active-region, if any.
@@ -1641,9 +1649,9 @@ SearchBorder<PIXELINDEX,FRAMESIZE>::GetSizeOfLargestActiveRegion
 // need to be flood-filled and added again).
 // If so, return true.
 // If not, return false.
-template <class PIXELINDEX, class FRAMESIZE>
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
 bool
-SearchBorder<PIXELINDEX,FRAMESIZE>::HasExistingMatch
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::HasExistingMatch
 	(PIXELINDEX a_tnMotionX, PIXELINDEX a_tnMotionY) const
 {
 	// Make sure the motion-vector is in range.
@@ -1665,9 +1673,9 @@ SearchBorder<PIXELINDEX,FRAMESIZE>::HasExistingMatch
 
 // Add the given region, with the given motion-vector.
 // Causes a_rRegion to be emptied.
-template <class PIXELINDEX, class FRAMESIZE>
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
 void
-SearchBorder<PIXELINDEX,FRAMESIZE>::AddNewRegion (Status_t &a_reStatus,
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::AddNewRegion (Status_t &a_reStatus,
 	MovedRegion &a_rRegion)
 {
 	MovedRegion *pRegion;
@@ -1846,9 +1854,9 @@ cleanup0:
 
 
 // Removes the given region from the search-border.
-template <class PIXELINDEX, class FRAMESIZE>
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
 void
-SearchBorder<PIXELINDEX,FRAMESIZE>::RemoveRegion (MovedRegion *a_pRegion)
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::RemoveRegion (MovedRegion *a_pRegion)
 {
 	// Make sure they gave us a region to remove.
 	assert (a_pRegion != NULL);
@@ -1985,9 +1993,9 @@ SearchBorder<PIXELINDEX,FRAMESIZE>::RemoveRegion (MovedRegion *a_pRegion)
 // Loop through all regions that matched the current pixel-group,
 // find the single best one, and return it.
 // Backpatch the size of the second-best active-region.
-template <class PIXELINDEX, class FRAMESIZE>
-typename SearchBorder<PIXELINDEX,FRAMESIZE>::MovedRegion *
-SearchBorder<PIXELINDEX,FRAMESIZE>::ChooseBestActiveRegion
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
+typename SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::MovedRegion *
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::ChooseBestActiveRegion
 	(Status_t &a_reStatus, FRAMESIZE &a_rtnSecondBestActiveRegionSize)
 {
 	MovedRegion *pSurvivor;
@@ -2019,9 +2027,9 @@ SearchBorder<PIXELINDEX,FRAMESIZE>::ChooseBestActiveRegion
 
 // Clean up the search border at the end of a frame, e.g. hand all
 // remaining regions back to the client.
-template <class PIXELINDEX, class FRAMESIZE>
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
 void
-SearchBorder<PIXELINDEX,FRAMESIZE>::FinishFrame (Status_t &a_reStatus)
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::FinishFrame (Status_t &a_reStatus)
 {
 	// Make sure they didn't start us off with an error.
 	assert (a_reStatus == g_kNoError);
@@ -2076,9 +2084,9 @@ SearchBorder<PIXELINDEX,FRAMESIZE>::FinishFrame (Status_t &a_reStatus)
 
 // Delete a region that was returned by ChooseBestActiveRegion()
 // or OnCompletedRegion().
-template <class PIXELINDEX, class FRAMESIZE>
+template <class PIXELINDEX, class FRAMESIZE, class REGIONIMP>
 void
-SearchBorder<PIXELINDEX,FRAMESIZE>::DeleteRegion (MovedRegion *a_pRegion)
+SearchBorder<PIXELINDEX,FRAMESIZE,REGIONIMP>::DeleteRegion (MovedRegion *a_pRegion)
 {
 	// Make sure they gave us a region to delete.
 	assert (a_pRegion != NULL);
@@ -13,6 +13,7 @@
 #include "Limits.hh"
 #include "Allocator.hh"
 #include "ReferenceFrame.hh"
+#include "PixelGroupKernel.hh"
 
 
 
@@ -71,6 +72,11 @@ public:
 	typedef PIXEL_TOL Tolerance_t;
 		// The numeric type to use in tolerance calculations.
 
+	typedef PixelGroupKernel<PIXEL_NUM,DIM,PIXEL_TOL,PGW,PGH,
+			SORTERBITMASK,PIXEL> PixelGroupKernel_t;
+		// The pixel-group comparisons, possibly vectorized for our
+		// pixel-group size & pixel type.
+
 	SearchWindow();
 		// Default constructor.
 
@@ -89,6 +95,10 @@ public:
 		// frames).  Otherwise, it may use way too much memory and
 		// starts hitting virtual memory & otherwise performs badly.
 
+	const AllocatorStats &GetPixelSorterStats (void) const
+			{ return m_oPSBNAllocator.GetStats(); }
+		// Get the statistics of the pixel-sorter's allocator.
+
 	// A pixel group.
 	class PixelGroup
 	{
@@ -720,47 +730,13 @@ SearchWindow<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	#endif // CALCULATE_SAD
 	) const
 {
-	PIXELINDEX tnX, tnY;
-		// Used to loop through pixels.
-
-	// Compare the two pixel groups, pixel by pixel.
-	#ifdef CALCULATE_SAD
-	a_rtnSAD = 0;
-	#endif // CALCULATE_SAD
-	for (tnY = 0; tnY < PGH; ++tnY)
-	{
-		for (tnX = 0; tnX < PGW; ++tnX)
-		{
-			#ifdef CALCULATE_SAD
-			Tolerance_t tnSAD;
-			#endif // CALCULATE_SAD
-				// The sum-of-absolute-differences between these two
-				// pixels.
-
-			// Get the two pixels of interest.
-			const Pixel_t &rThisPixel = m_atPixels[tnY][tnX];
-			const Pixel_t &rOtherPixel = a_rOther.m_atPixels[tnY][tnX];
-
-			// If this pixel value is not within the tolerance of
-			// the corresponding pixel in the other group, exit now.
-			if (!rThisPixel.IsWithinTolerance (rOtherPixel, a_tnTolerance
-				#ifdef CALCULATE_SAD
-				, tnSAD
-				#endif // CALCULATE_SAD
-				))
-			{
-				return false;
-			}
-
-			// Sum up the sum-of-absolute-differences.
-			#ifdef CALCULATE_SAD
-			a_rtnSAD += tnSAD;
-			#endif // CALCULATE_SAD
-		}
-	}
-
-	// The pixel groups are equal, within the given tolerance.
-	return true;
+	// Compare the two pixel groups.
+	return PixelGroupKernel_t::IsWithinTolerance (m_atPixels,
+		a_rOther.m_atPixels, a_tnTolerance
+		#ifdef CALCULATE_SAD
+		, a_rtnSAD
+		#endif // CALCULATE_SAD
+		);
 }
 
 
@@ -951,17 +927,11 @@ SearchWindow<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 			{
 				for (tnPixelX = 0; tnPixelX < PGW; ++tnPixelX)
 				{
-					ReferencePixel_t *pPixel;
-						// The current reference pixel.
-
-					// Get the current reference pixel.
-					pPixel = m_pReferenceFrame->GetPixel
-						(tnX + tnPixelX, tnY + tnPixelY);
-
 					// Set up the corresponding pixel in the current
 					// search-window cell.
 					pCell->m_atPixels[tnPixelY][tnPixelX]
-						= pPixel->GetValue();
+						= m_pReferenceFrame->GetValue
+							(tnX + tnPixelX, tnY + tnPixelY);
 				}
 			}
 
@@ -1605,75 +1575,22 @@ SearchWindow<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	SORTERBITMASK &a_rtnChildIndex, PixelGroup &a_rMin,
 	PixelGroup &a_rMax) const
 {
-	PIXELINDEX tnX, tnY;
-	int i;
-		// Used to loop through pixels & pixel dimensions.
-
-	// Compare the cell's pixel values to our split values, and
-	// determine which child branch it should be moved to, or if it
-	// should stay at this level.
-	a_rtnChildIndex = 0;
-	for (tnY = 0; tnY < PGH; ++tnY)
+	// If any of the cell's pixel values, one dimension at a time, is
+	// within the tolerance of the split-point's corresponding pixel,
+	// then this cell has to stay at this level of the tree.
+	if (PixelGroupKernel_t::IsAnyAxisWithinTolerance (a_rCell.m_atPixels,
+		m_oSplitValue.m_atPixels, a_tnTolerance))
 	{
-		for (tnX = 0; tnX < PGW; ++tnX)
-		{
-			// Get the two pixels of interest.
-			const Pixel_t &rCellPixel = a_rCell.m_atPixels[tnY][tnX];
-			const Pixel_t &rSplitPixel
-				= m_oSplitValue.m_atPixels[tnY][tnX];
-
-			// If this pixel value is within the tolerance of
-			// the split-point's corresponding pixel, then this
-			// cell has to stay at this level of the tree.
-			if (DIM == 1
-			&& rCellPixel.IsWithinTolerance (rSplitPixel,
-				a_tnTolerance))
-			{
-				return true;
-			}
-
-			// Determine the effect each dimension has on the
-			// bitmask that we use to determine the index of the
-			// child branch that this cell should descend into.
-			// Also calculate the min/max for this branch.
-			for (i = 0; i < DIM; ++i)
-			{
-				// If this is a multi-dimensional pixel, we have to
-				// make sure that none of its axes are within the
-				// tolerance either.
-				if (DIM > 1)
-				{
-					// Make copies of the two pixels.
-					Pixel_t oCellPixel = rCellPixel;
-					Pixel_t oSplitPixel = rSplitPixel;
-
-					// Collapse all dimensions but the current one.
-					for (int j = 0; j < DIM; ++j)
-						if (j != i)
-							oCellPixel[j] = oSplitPixel[j];
-
-					// If this axis, all by itself, is within the
-					// tolerance, stop here.
-					if (oCellPixel.IsWithinTolerance (oSplitPixel,
-						a_tnTolerance))
-					{
-						return true;
-					}
-				}
-
-				if (rCellPixel[i] > rSplitPixel[i])
-				{
-					a_rtnChildIndex |= GetBitMask (tnY, tnX, i);
-					a_rMin.m_atPixels[tnY][tnX][i] = rSplitPixel[i];
-				}
-				else
-				{
-					a_rMax.m_atPixels[tnY][tnX][i] = rSplitPixel[i];
-				}
-			}
-		}
+		return true;
 	}
 
+	// Determine the index of the child branch that this cell should
+	// descend into, and calculate the min/max for that branch.
+	a_rtnChildIndex = PixelGroupKernel_t::GetGreaterMask
+		(a_rCell.m_atPixels, m_oSplitValue.m_atPixels);
+	PixelGroupKernel_t::NarrowRange (a_rCell.m_atPixels,
+		m_oSplitValue.m_atPixels, a_rMin.m_atPixels, a_rMax.m_atPixels);
+
 	// The cell can move into a child branch.
 	return false;
 }
@@ -1699,77 +1616,26 @@ SearchWindow<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	(const PixelGroup *a_pPixelGroup, Tolerance_t a_tnTwiceTolerance,
 	SORTERBITMASK &a_rtnChildIndex, bool &a_rbMatchAtThisLevel) const
 {
-	PIXELINDEX tnX, tnY;
-	int i;
-		// Used to loop through pixels & pixel dimensions.
-	bool bPixelGroupStopsHere;
-		// True if one of the pixel-group's pixels exactly matches
-		// its corresponding split-point.
-
 	// Make sure they gave us a pixel-group.
 	assert (a_pPixelGroup != NULL);
 
-	// Compare the group's pixel values to our split values, and
-	// determine which child branch it should descend, or if it
-	// should stop at this level.
-	a_rtnChildIndex = 0;
-	bPixelGroupStopsHere = false;
-	a_rbMatchAtThisLevel = false;
-	for (tnY = 0; tnY < PGH; ++tnY)
-	{
-		for (tnX = 0; tnX < PGW; ++tnX)
-		{
-			// Get the two pixels of interest.
-			const Pixel_t &rGroupPixel
-				= a_pPixelGroup->m_atPixels[tnY][tnX];
-			const Pixel_t &rSplitPixel
-				= m_oSplitValue.m_atPixels[tnY][tnX];
-
-			// Determine the effect each dimension has on the
-			// bitmask that we use to determine the index of the
-			// child branch that this cell should descend into.
-			// (If the pixel value is right on a branch's split value,
-			// then all pixels that would match it have been found at
-			// this level.)
-			for (i = 0; i < DIM; i++)
-			{
-				if (rGroupPixel[i] == rSplitPixel[i])
-					bPixelGroupStopsHere = true;
-				if (rGroupPixel[i] > rSplitPixel[i])
-					a_rtnChildIndex |= GetBitMask (tnY, tnX, i);
-
-				// If the current pixel is within twice the tolerance
-				// of the split-point, then some of the search-window
-				// cells that had to stop at this point in the tree may
-				// match the current pixel-group.  (And once we figure
-				// that out, we don't have to check any other pixels for
-				// this property.)
-				if (!a_rbMatchAtThisLevel)
-				{
-					// Make copies of the two pixels.
-					Pixel_t oGroupPixel = rGroupPixel;
-					Pixel_t oSplitPixel = rSplitPixel;
-
-					// Collapse all dimensions but the current one.
-					for (int j = 0; j < DIM; ++j)
-						if (j != i)
-							oGroupPixel[j] = oSplitPixel[j];
-
-					// If this axis, all by itself, is within twice the
-					// tolerance, then we can no longer rule out matches
-					// at this level.
-					if (oGroupPixel.IsWithinTolerance (oSplitPixel,
-						a_tnTwiceTolerance))
-					{
-						a_rbMatchAtThisLevel = true;
-					}
-				}
-			}
-		}
-	}
-
-	// Return whether the pixel group can descend into a child branch.
-	return bPixelGroupStopsHere;
+	// If any of the group's pixel values, one dimension at a time, is
+	// within twice the tolerance of the split-point, then some of the
+	// search-window cells that had to stop at this level of the tree
+	// may match the current pixel-group.
+	a_rbMatchAtThisLevel = PixelGroupKernel_t::IsAnyAxisWithinTolerance
+		(a_pPixelGroup->m_atPixels, m_oSplitValue.m_atPixels,
+		a_tnTwiceTolerance);
+
+	// Determine the index of the child branch that this pixel-group
+	// should descend into.
+	a_rtnChildIndex = PixelGroupKernel_t::GetGreaterMask
+		(a_pPixelGroup->m_atPixels, m_oSplitValue.m_atPixels);
+
+	// If any pixel value is right on a branch's split value, then all
+	// pixels that would match it have been found at this level.
+	return PixelGroupKernel_t::IsAnyAxisEqual (a_pPixelGroup->m_atPixels,
+		m_oSplitValue.m_atPixels);
 }
 
 
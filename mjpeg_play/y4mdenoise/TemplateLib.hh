@@ -72,6 +72,24 @@ public:
 
 
 
+// A template that selects one of two types, based on a compile-time
+// condition.
+template <bool CONDITION, class IFTRUE, class IFFALSE>
+class TypeSelect
+{
+public:
+	typedef IFTRUE Type;
+};
+
+template <class IFTRUE, class IFFALSE>
+class TypeSelect<false,IFTRUE,IFFALSE>
+{
+public:
+	typedef IFFALSE Type;
+};
+
+
+
 // A general absolute-value function.
 template <class TYPE>
 TYPE
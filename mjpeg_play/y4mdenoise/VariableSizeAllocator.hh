@@ -9,6 +9,7 @@
 #include "mjpeg_types.h"
 #include <stdlib.h>
 #include "Limits.hh"
+#include "Allocator.hh"
 #include "PlacementAllocator.hh"
 #include "Set.hh"
 
@@ -29,6 +30,10 @@
 // It maintains its own free-space set, using a SkipList<> with a
 // PlacementAllocator.  This allows the free blocks themselves to be used
 // by the skip-list nodes, allowing for an in-place free-space set.
+//
+// Like Allocator<>, it isn't thread-safe, and when the last allocation
+// is deallocated, it keeps its chunks for reuse.  (Only chunks of the
+// configured size are kept; larger ones are freed.)
 class VariableSizeAllocator
 {
 private:
@@ -86,6 +91,17 @@ public:
 	uint32_t GetNumAllocated (void) const { return m_ulAllocated; }
 		// Get the number of allocated blocks.
 
+	const AllocatorStats &GetStats (void) const { return m_oStats; }
+		// Get allocation statistics.
+
+	void Reset (void);
+		// Forget all allocations, but keep our chunks for reuse.
+		// Only safe if there are no live allocations.
+
+	void Purge (void);
+		// Free up all chunks.
+		// Only safe if there are no live allocations.
+
 private:
 	// One chunk of memory.
 	class Chunk
@@ -93,6 +109,8 @@ private:
 	public:
 		Chunk *m_pNext;
 			// The next allocated chunk.
+		size_t m_nBytes;
+			// The size of this chunk, including this header.
 		char m_aSpace[];
 			// The memory to divide up.
 	};
@@ -104,6 +122,10 @@ private:
 	Chunk *m_pChunks;
 		// A linked-list of all the allocated chunks.
 
+	Chunk *m_pSpareChunks;
+		// A linked-list of chunks left over from before the last reset,
+		// ready to be reused.  All are of the configured chunk size.
+
 	char *m_pFreeChunk;
 	size_t m_nFreeChunk;
 		// The next piece of unallocated memory in the
@@ -128,9 +150,8 @@ private:
 		// The number of live allocations, i.e. those that haven't been
 		// deleted yet.
 
-	void Purge (void);
-		// Free up all chunks.
-		// Only safe if there are no live allocations.
+	AllocatorStats m_oStats;
+		// Allocation statistics.
 };
 
 
@@ -138,7 +159,8 @@ private:
 // Constructor.  Specify the number of bytes to allocate at a
 // time from the standard memory allocator.
 VariableSizeAllocator::VariableSizeAllocator (size_t a_nChunkSize)
-	: m_nChunkSize (a_nChunkSize), m_pChunks (NULL), m_pFreeChunk (NULL),
+	: m_nChunkSize (a_nChunkSize), m_pChunks (NULL), m_pSpareChunks (NULL),
+	m_pFreeChunk (NULL),
 	m_nFreeChunk (0), m_oPlacementAllocator (a_nChunkSize),
 	m_setFreeSpace (Block::SortBySize(), m_oPlacementAllocator),
 	m_nSmallestBlockSize (m_setFreeSpace.GetSizeOfLargestNode()),
@@ -173,7 +195,8 @@ VariableSizeAllocator::~VariableSizeAllocator()
 	// doesn't guarantee order of destruction for global objects, we
 	// have no guarantee our clients have been destroyed, and so it
 	// isn't safe to delete our memory.)
-	if (m_ulAllocated == 0UL && m_pChunks != NULL)
+	if (m_ulAllocated == 0UL
+			&& (m_pChunks != NULL || m_pSpareChunks != NULL))
 		Purge();
 }
 
@@ -347,16 +370,29 @@ VariableSizeAllocator::Allocate (size_t a_nSize, size_t a_nBytes)
 		// Calculate the size of the new chunk.
 		// Make sure it's big enough to handle this allocation, i.e. in case
 		// it's bigger than the configured chunk size.
-		size_t nChunkSize = ((a_nBytes + 2 * sizeof (Chunk *) - 1)
-			/ sizeof (Chunk *)) * sizeof (Chunk *);
+		size_t nChunkSize = ((a_nBytes + sizeof (Chunk)
+			+ sizeof (Chunk *) - 1) / sizeof (Chunk *)) * sizeof (Chunk *);
 		nChunkSize = Max (nChunkSize, m_nChunkSize);
 
 		// Add a new chunk to our list.
 		{
-			// Allocate a new chunk.
-			Chunk *pNewChunk = (Chunk *) malloc (nChunkSize);
-			if (pNewChunk == NULL)
-				return NULL;
+			Chunk *pNewChunk;
+
+			// Reuse a chunk from before the last reset, if there's one
+			// big enough.  Otherwise, allocate a new chunk.
+			if (m_pSpareChunks != NULL && nChunkSize == m_nChunkSize)
+			{
+				pNewChunk = m_pSpareChunks;
+				m_pSpareChunks = m_pSpareChunks->m_pNext;
+			}
+			else
+			{
+				pNewChunk = (Chunk *) malloc (nChunkSize);
+				if (pNewChunk == NULL)
+					return NULL;
+				pNewChunk->m_nBytes = nChunkSize;
+				m_oStats.NewChunk (nChunkSize);
+			}
 
 			// Hook it into our list.
 			pNewChunk->m_pNext = m_pChunks;
@@ -385,6 +421,7 @@ allocated:;
 
 	// That's one more allocation.
 	++m_ulAllocated;
+	m_oStats.Allocated (m_ulAllocated);
 
 	// Guard against writing out of bounds.
 	#if VSA_GUARD_SIZE > 0
@@ -492,16 +529,16 @@ VariableSizeAllocator::Deallocate (size_t a_nSize, size_t a_nBytes,
 	// That's one less allocation.
 	--m_ulAllocated;
 
-	// If all memory is unallocated, free up our chunks & start over.
+	// If all memory is unallocated, start over, but keep our chunks.
 	if (m_ulAllocated == 0UL)
-		Purge();
+		Reset();
 }
 
 
 
-// Free up all chunks.
+// Forget all allocations, but keep our chunks for reuse.
 void
-VariableSizeAllocator::Purge (void)
+VariableSizeAllocator::Reset (void)
 {
 	// Make sure there are no live allocations
 	assert (m_ulAllocated == 0UL);
@@ -521,14 +558,24 @@ VariableSizeAllocator::Purge (void)
 	m_pFreeChunk = NULL;
 	m_nFreeChunk = 0;
 
-	// Free all allocated chunks.
+	// Move all allocated chunks to the spare list, except for any
+	// that are larger than usual.
 	while (m_pChunks != NULL)
 	{
 		// Remember the next chunk.
 		Chunk *pNextChunk = m_pChunks->m_pNext;
 
-		// Free this chunk.
-		free (m_pChunks);
+		// Keep or free this chunk.
+		if (m_pChunks->m_nBytes == m_nChunkSize)
+		{
+			m_pChunks->m_pNext = m_pSpareChunks;
+			m_pSpareChunks = m_pChunks;
+		}
+		else
+		{
+			m_oStats.FreeChunk (m_pChunks->m_nBytes);
+			free (m_pChunks);
+		}
 
 		// Move to the next chunk.
 		m_pChunks = pNextChunk;
@@ -537,4 +584,28 @@ VariableSizeAllocator::Purge (void)
 
 
 
+// Free up all chunks.
+void
+VariableSizeAllocator::Purge (void)
+{
+	// Empty the free-space set, and move all chunks to the spare list.
+	Reset();
+
+	// Free all spare chunks.
+	while (m_pSpareChunks != NULL)
+	{
+		// Remember the next chunk.
+		Chunk *pNextChunk = m_pSpareChunks->m_pNext;
+
+		// Free this chunk.
+		m_oStats.FreeChunk (m_pSpareChunks->m_nBytes);
+		free (m_pSpareChunks);
+
+		// Move to the next chunk.
+		m_pSpareChunks = pNextChunk;
+	}
+}
+
+
+
 #endif // __VARIABLESIZEALLOCATOR_H__
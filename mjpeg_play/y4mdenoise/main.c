@@ -71,6 +71,8 @@ int main(int argc, char *argv[])
   denoiser.matchCountThrottle = 16;
   denoiser.matchSizeThrottle  = 256;
   denoiser.threads            = 1;
+  denoiser.bands              = 1;
+  denoiser.regions            = 0;
   
   /* process commandline */
   process_commandline(argc, argv);
@@ -276,7 +278,7 @@ process_commandline(int argc, char *argv[])
 {
   char c;
 
-  while ((c = getopt (argc, argv, "h?z:Z:t:T:r:R:m:M:f:BI:p:v:")) != -1)
+  while ((c = getopt (argc, argv, "h?z:Z:t:T:r:R:m:M:f:BI:p:b:g:v:")) != -1)
   {
     switch (c)
     {
@@ -372,6 +374,27 @@ process_commandline(int argc, char *argv[])
         denoiser.threads = threads;
         break;
       }
+      case 'b':
+      {
+	 	int bands = atoi (optarg);
+		if (bands < 1 || bands > 16)
+		{
+      		mjpeg_error_exit1 ("-b must be between 1 and 16");
+		}
+        denoiser.bands = bands;
+        break;
+      }
+      case 'g':
+      {
+	 	int regions = newdenoise_region_policy (optarg);
+		if (regions < 0)
+		{
+      		mjpeg_error_exit1 ("-g must be auto, default, sparse, dense, "
+				"set, or skiplist");
+		}
+        denoiser.regions = regions;
+        break;
+      }
       case 'v':
         verbose = atoi (optarg);
         if (verbose < 0 || verbose > 2)
@@ -422,6 +445,10 @@ display_help (void)
 	"------------------\n"
 	"-p    parallelism: 0=no threads, 1=r/w thread only, 2=do color in\n"
 	"      separate thread (default: 1)\n"
+	"-b    Split intensity into this many horizontal bands, each denoised\n"
+	"      in its own thread (default: 1)\n"
+	"-g    Region implementation: auto, default, sparse, dense, set, or\n"
+	"      skiplist.  Affects only speed & memory usage (default: auto)\n"
 	"-r    Radius for motion-search (default: 16)\n"
 	"-R    Radius for color motion-search (default: -r setting)\n"
 	"-t    Error tolerance (default: 3)\n"
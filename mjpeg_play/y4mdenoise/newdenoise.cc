@@ -32,25 +32,58 @@ typedef ReferenceFrame<ReferencePixelY, int16_t, int32_t>
 typedef ReferenceFrame<ReferencePixelCbCr, int16_t, int32_t>
 	ReferenceFrameCbCr;
 
-// The denoisers.  (We have to make these classes, in order to keep gdb
-// from crashing.  I didn't even know one could crash gdb. ;-)
-#if 0
-typedef MotionSearcher<uint8_t, 1, int32_t, int16_t, int32_t, 4, 2,
-		uint16_t, PixelY, ReferencePixelY, ReferenceFrameY>
+// The denoisers' interfaces.  The denoisers themselves are created by
+// new_motion_searcher_y() and new_motion_searcher_cbcr(), according to
+// the chosen region implementation.
+typedef MotionSearcherBase<uint8_t, int16_t, int32_t, PixelY,
+		ReferenceFrameY>
 	MotionSearcherY;
-typedef MotionSearcher<uint8_t, 2, int32_t, int16_t, int32_t, 2, 2,
-		uint16_t, PixelCbCr, ReferencePixelCbCr, ReferenceFrameCbCr>
+typedef MotionSearcherBase<uint8_t, int16_t, int32_t, PixelCbCr,
+		ReferenceFrameCbCr>
 	MotionSearcherCbCr;
-#else
-class MotionSearcherY
+MotionSearcherY *g_pMotionSearcherY;
+MotionSearcherCbCr *g_pMotionSearcherCbCr;
+
+// The denoisers.  (We have to make these classes, in order to keep gdb
+// from crashing.  I didn't even know one could crash gdb. ;-)
+template <class REGIONS>
+class MotionSearcherYImp
 	: public MotionSearcher<uint8_t, 1, int32_t, int16_t, int32_t, 4, 2,
-		uint16_t, PixelY, ReferencePixelY, ReferenceFrameY> {};
-class MotionSearcherCbCr
+		uint16_t, PixelY, ReferencePixelY, ReferenceFrameY, REGIONS> {};
+template <class REGIONS>
+class MotionSearcherCbCrImp
 	: public MotionSearcher<uint8_t, 2, int32_t, int16_t, int32_t, 2, 2,
-		uint16_t, PixelCbCr, ReferencePixelCbCr, ReferenceFrameCbCr> {};
-#endif
-MotionSearcherY g_oMotionSearcherY;
-MotionSearcherCbCr g_oMotionSearcherCbCr;
+		uint16_t, PixelCbCr, ReferencePixelCbCr, ReferenceFrameCbCr,
+		REGIONS> {};
+
+// The region implementations that can be chosen at run time.  Each one
+// is another instantiation of the motion-searchers, so this list is
+// kept short.  They all produce the same output; they differ only in
+// speed & memory usage.
+enum RegionChoice
+{
+	kRegionsAuto,		// choose from the frame size & search radius
+	kRegionsDefault,	// bitmaps for used pixels & most flood-fills
+	kRegionsSparse,		// set-regions for zero-motion flood-fills
+	kRegionsDense,		// bitmaps for everything possible
+	kRegionsSet,		// set-regions for everything
+	kRegionsSkipList,	// set-regions, implemented with skip-lists
+	kRegionsCount
+};
+static const char *g_apszRegionNames[kRegionsCount] =
+{
+	"auto", "default", "sparse", "dense", "set", "skiplist"
+};
+typedef RegionPolicy<true,true,false,true,false> SparseRegionPolicy;
+typedef RegionPolicy<true,true,true,true,true> DenseRegionPolicy;
+typedef RegionPolicy<true,false,false,false,false> SetRegionPolicy;
+typedef RegionPolicy<false,false,false,false,false> SkipListRegionPolicy;
+
+// Internal methods to choose a region implementation and create the
+// matching denoisers.
+static int choose_regions (int a_nWidth, int a_nHeight, int a_nRadius);
+static MotionSearcherY *new_motion_searcher_y (int a_nRegions);
+static MotionSearcherCbCr *new_motion_searcher_cbcr (int a_nRegions);
 
 // Whether the denoisers should be used.
 bool g_bMotionSearcherY;
@@ -72,6 +105,12 @@ static void output_field
 	(int a_nMask, const MotionSearcherY::ReferenceFrame_t *a_pFrameY,
 	const MotionSearcherCbCr::ReferenceFrame_t *a_pFrameCbCr,
 	uint8_t *a_pOutputY, uint8_t *a_pOutputCb, uint8_t *a_pOutputCr);
+static void output_bands (uint8_t *a_pOutputY);
+
+// Internal methods to denoise intensity in several bands.
+static int init_bands_y (int a_nFrames, int a_nHeightY);
+static int newdenoise_bands_intensity (const uint8_t *a_pInputY,
+	uint8_t *a_pOutputY);
 
 
 
@@ -347,6 +386,100 @@ private:
 		// Input/output buffers.
 };
 
+// One horizontal band of the intensity plane, with its own denoiser.
+// Bands overlap their neighbors by about a search-radius, so that
+// motion across a band boundary can still be found; the overlapping
+// rows get blended together when the bands are reassembled.
+class DenoiserBandY
+{
+public:
+	DenoiserBandY();
+		// Default constructor.  Must be followed by Init().
+	
+	~DenoiserBandY();
+		// Destructor.
+
+	void Init (Status_t &a_reStatus, int a_nFrames, int a_nTop,
+			int a_nRows);
+		// Initializer.  The band covers a_nRows rows of each field,
+		// starting at row a_nTop.  (A non-interlaced frame is one
+		// field.)  a_nFrames is the number of reference frames.
+
+	int DenoiseFrame (const uint8_t *a_pInputY);
+		// Denoise this band of the given frame.  A null input frame
+		// means that the end of input has been reached.
+		// Returns 0 if GetOutput() contains the next denoised band,
+		// 1 if there was no output, -1 if there was an error.
+
+	const uint8_t *GetOutput (void) const { return m_pOutputY; }
+		// Get the last denoised band.  It's stored as whole frame
+		// rows, i.e. field-row GetTop() of the first field is at the
+		// beginning.
+
+	int GetTop (void) const { return m_nTop; }
+		// Get the first field-row covered by this band.
+
+	const PixelStats &GetPixelStats (void) const { return m_oPixelStats; }
+		// Get the pixel statistics of the last frame denoised (summed
+		// over its fields).
+
+private:
+	MotionSearcherY *m_pMotionSearcher;
+		// The band's denoiser.
+
+	int m_nTop, m_nRows;
+		// The field-rows covered by this band.
+
+	int m_nPixels;
+		// The number of pixels in one field of the band.
+
+	MotionSearcherY::Pixel_t *m_pPixels;
+		// Used to translate input into the form the denoiser needs.
+
+	uint8_t *m_pOutputY;
+		// The last denoised band.
+
+	PixelStats m_oPixelStats;
+		// The pixel statistics of the last frame denoised.
+};
+
+// A class to denoise a band of intensity in a separate thread.
+class DenoiserThreadBandY : public DenoiserThread
+{
+private:
+	typedef DenoiserThread BaseClass;
+		// Keep track of who our base class is.
+
+public:
+	DenoiserThreadBandY();
+		// Default constructor.
+	
+	virtual ~DenoiserThreadBandY();
+		// Destructor.
+
+	void Initialize (DenoiserBandY *a_pBand);
+		// Initialize.  Set up all private thread data and start the
+		// worker thread.
+	
+	void AddFrame (const uint8_t *a_pInputY);
+		// Add a frame to the denoiser.
+	
+	int WaitForAddFrame (void);
+		// Get the next denoised band, if any.
+		// Returns the result of Work().
+
+protected:
+	virtual int Work (void);
+		// Denoise the current frame.
+
+private:
+	DenoiserBandY *m_pBand;
+		// The band we denoise.
+
+	const uint8_t *m_pInputY;
+		// Input buffer.
+};
+
 // A class to read/write raw-video in a separate thread.
 class ReadWriteThread : public BasicThread
 {
@@ -479,6 +612,17 @@ DenoiserThreadCbCr g_oDenoiserThreadCbCr;
 DenoiserThreadRead g_oDenoiserThreadRead;
 DenoiserThreadWrite g_oDenoiserThreadWrite;
 
+// Intensity bands, if intensity is denoised in several bands.  The
+// first band is denoised in the current thread, the rest in their own
+// threads.  g_pnBandSplitsY[] holds the field-row where each band's
+// exclusive area begins; around each split, g_nBandBlendY rows above
+// and below are blended between the two bands.
+int g_nBandsY;
+DenoiserBandY *g_pBandsY;
+DenoiserThreadBandY *g_pBandThreadsY;
+int *g_pnBandSplitsY;
+int g_nBandBlendY;
+
 
 
 // Initialize the denoising system.
@@ -518,15 +662,37 @@ int newdenoise_init (int a_nFrames, int a_nWidthY, int a_nHeightY,
 			a_nWidthCbCr, a_nHeightCbCr);
 	}
 
+	// Log the region implementation, if one was chosen explicitly.
+	if (denoiser.regions != kRegionsAuto)
+		mjpeg_info ("Using %s regions",
+			g_apszRegionNames[denoiser.regions]);
+
+	// If intensity should be denoised in several bands, set that up.
+	g_nBandsY = 0;
+	if (a_nWidthY != 0 && a_nHeightY != 0 && denoiser.bands > 1)
+	{
+		g_bMotionSearcherY = true;
+		if (init_bands_y (nInterlace * a_nFrames,
+				a_nHeightY / nInterlace) != 0)
+			return -1;
+	}
+
 	// If intensity should be denoised, set it up.
-	if (a_nWidthY != 0 && a_nHeightY != 0)
+	else if (a_nWidthY != 0 && a_nHeightY != 0)
 	{
 		g_bMotionSearcherY = true;
 		g_nPixelsY = (a_nWidthY * a_nHeightY) / nInterlace;
 		g_pPixelsY = new MotionSearcherY::Pixel_t [g_nPixelsY];
 		if (g_pPixelsY == NULL)
 			return -1;
-		g_oMotionSearcherY.Init (eStatus, nInterlace * a_nFrames,
+		g_pMotionSearcherY = new_motion_searcher_y (choose_regions
+			(a_nWidthY, a_nHeightY / nInterlace, denoiser.radiusY));
+		if (g_pMotionSearcherY == NULL)
+		{
+			delete[] g_pPixelsY;
+			return -1;
+		}
+		g_pMotionSearcherY->Init (eStatus, nInterlace * a_nFrames,
 			a_nWidthY, a_nHeightY / nInterlace,
 			denoiser.radiusY, denoiser.radiusY,
 			denoiser.zThresholdY, denoiser.thresholdY,
@@ -551,7 +717,16 @@ int newdenoise_init (int a_nFrames, int a_nWidthY, int a_nHeightY,
 			delete[] g_pPixelsY;
 			return -1;
 		}
-		g_oMotionSearcherCbCr.Init (eStatus, nInterlace * a_nFrames,
+		g_pMotionSearcherCbCr = new_motion_searcher_cbcr (choose_regions
+			(a_nWidthCbCr, a_nHeightCbCr / nInterlace,
+				denoiser.radiusCbCr / denoiser.frame.ss_h));
+		if (g_pMotionSearcherCbCr == NULL)
+		{
+			delete[] g_pPixelsCbCr;
+			delete[] g_pPixelsY;
+			return -1;
+		}
+		g_pMotionSearcherCbCr->Init (eStatus, nInterlace * a_nFrames,
 			a_nWidthCbCr, a_nHeightCbCr / nInterlace,
 			denoiser.radiusCbCr / denoiser.frame.ss_h,
 			denoiser.radiusCbCr / denoiser.frame.ss_v,
@@ -576,6 +751,148 @@ int newdenoise_init (int a_nFrames, int a_nWidthY, int a_nHeightY,
 	return 0;
 }
 
+// Set up to denoise intensity in several bands.
+// Returns 0 if successful, -1 if there was some problem.
+static int
+init_bands_y (int a_nFrames, int a_nHeightY)
+{
+	Status_t eStatus;
+		// An error that may occur.
+	int nMargin;
+		// How far each band extends past its exclusive area.
+	int nRows;
+		// The height of each band's exclusive area.
+	int i;
+		// Used to loop through bands.
+
+	// No errors yet.
+	eStatus = g_kNoError;
+
+	// Bands overlap by the search radius, rounded up to a whole
+	// number of pixel-groups, and the middle half of the overlap gets
+	// blended.
+	nMargin = (denoiser.radiusY + 1) & ~1;
+	g_nBandBlendY = nMargin / 2;
+
+	// Each band's exclusive area has to be at least as tall as the
+	// overlap, so that neighboring blend areas don't meet.
+	g_nBandsY = denoiser.bands;
+	while (g_nBandsY > 1 && ((a_nHeightY / g_nBandsY) & ~1) < nMargin)
+		--g_nBandsY;
+	if (g_nBandsY != denoiser.bands)
+		mjpeg_warn ("Frame is too short for %d bands, using %d",
+			denoiser.bands, g_nBandsY);
+
+	// Split the field into bands, at pixel-group boundaries.
+	nRows = (a_nHeightY / g_nBandsY) & ~1;
+	g_pnBandSplitsY = new int[g_nBandsY + 1];
+	g_pBandsY = new DenoiserBandY[g_nBandsY];
+	if (g_pnBandSplitsY == NULL || g_pBandsY == NULL)
+		return -1;
+	for (i = 0; i < g_nBandsY; ++i)
+		g_pnBandSplitsY[i] = i * nRows;
+	g_pnBandSplitsY[g_nBandsY] = a_nHeightY;
+
+	// Set up each band's denoiser.
+	for (i = 0; i < g_nBandsY; ++i)
+	{
+		int nTop = Max (0, g_pnBandSplitsY[i] - nMargin);
+		int nBottom = Min (a_nHeightY, g_pnBandSplitsY[i + 1] + nMargin);
+		g_pBandsY[i].Init (eStatus, a_nFrames, nTop, nBottom - nTop);
+		if (eStatus != g_kNoError)
+			return -1;
+	}
+
+	// Start a thread for every band but the first.
+	if (g_nBandsY > 1)
+	{
+		g_pBandThreadsY = new DenoiserThreadBandY[g_nBandsY - 1];
+		if (g_pBandThreadsY == NULL)
+			return -1;
+		for (i = 1; i < g_nBandsY; ++i)
+			g_pBandThreadsY[i - 1].Initialize (&g_pBandsY[i]);
+	}
+
+	// Initialization was successful.
+	return 0;
+}
+
+// Look up a region implementation by name.
+int
+newdenoise_region_policy (const char *a_pszName)
+{
+	int i;
+		// Used to loop through region implementations.
+
+	for (i = 0; i < kRegionsCount; ++i)
+		if (strcmp (a_pszName, g_apszRegionNames[i]) == 0)
+			return i;
+	return -1;
+}
+
+// Choose the region implementation for a denoiser, given the size of
+// the frames it sees & its search radius.
+// Returns a RegionChoice other than kRegionsAuto.
+static int
+choose_regions (int a_nWidth, int a_nHeight, int a_nRadius)
+{
+	// If they chose one, use it.
+	if (denoiser.regions != kRegionsAuto)
+		return denoiser.regions;
+
+	// Bitmap regions have to be cleared before every flood-fill, which
+	// costs in proportion to the frame size, while set-regions cost in
+	// proportion to the size of the match.  So once frames get big
+	// enough (e.g. HD) compared to the area being searched, flood-fill
+	// the zero-motion matches (the most numerous) with set-regions.
+	if (a_nWidth * a_nHeight >= 1280 * 720 / 2 && a_nRadius <= 16)
+		return kRegionsSparse;
+
+	// Otherwise, use the implementation that has been the default all
+	// along.
+	return kRegionsDefault;
+}
+
+// Create an intensity denoiser with the given region implementation.
+// Returns NULL if there was some problem.
+static MotionSearcherY *
+new_motion_searcher_y (int a_nRegions)
+{
+	switch (a_nRegions)
+	{
+	case kRegionsSparse:
+		return new MotionSearcherYImp<SparseRegionPolicy>;
+	case kRegionsDense:
+		return new MotionSearcherYImp<DenseRegionPolicy>;
+	case kRegionsSet:
+		return new MotionSearcherYImp<SetRegionPolicy>;
+	case kRegionsSkipList:
+		return new MotionSearcherYImp<SkipListRegionPolicy>;
+	default:
+		return new MotionSearcherYImp<DefaultRegionPolicy>;
+	}
+}
+
+// Create a color denoiser with the given region implementation.
+// Returns NULL if there was some problem.
+static MotionSearcherCbCr *
+new_motion_searcher_cbcr (int a_nRegions)
+{
+	switch (a_nRegions)
+	{
+	case kRegionsSparse:
+		return new MotionSearcherCbCrImp<SparseRegionPolicy>;
+	case kRegionsDense:
+		return new MotionSearcherCbCrImp<DenseRegionPolicy>;
+	case kRegionsSet:
+		return new MotionSearcherCbCrImp<SetRegionPolicy>;
+	case kRegionsSkipList:
+		return new MotionSearcherCbCrImp<SkipListRegionPolicy>;
+	default:
+		return new MotionSearcherCbCrImp<DefaultRegionPolicy>;
+	}
+}
+
 // Shut down the denoising system.
 int
 newdenoise_shutdown (void)
@@ -584,6 +901,10 @@ newdenoise_shutdown (void)
 	if (g_bMotionSearcherCbCr && (denoiser.threads & 2))
 		g_oDenoiserThreadCbCr.ForceShutdown();
 	
+	// If intensity was denoised in bands, shut those threads down.
+	for (int i = 1; i < g_nBandsY; ++i)
+		g_pBandThreadsY[i - 1].ForceShutdown();
+
 	// If reading/writing is being done in separate threads, shut
 	// them down.
 	if (denoiser.threads & 1)
@@ -591,6 +912,12 @@ newdenoise_shutdown (void)
 		g_oDenoiserThreadRead.ForceShutdown();
 		g_oDenoiserThreadWrite.ForceShutdown();
 	}
+
+	// Free up the denoisers.
+	delete g_pMotionSearcherY;
+	g_pMotionSearcherY = NULL;
+	delete g_pMotionSearcherCbCr;
+	g_pMotionSearcherCbCr = NULL;
 	
 	// No errors.
 	return 0;
@@ -658,8 +985,8 @@ newdenoise_frame0 (const uint8_t *a_pInputY, const uint8_t *a_pInputCb,
 		extern int frame;
 		if (frame % denoiser.frames == 0)
 		{
-			g_oMotionSearcherY.Purge();
-			g_oMotionSearcherCbCr.Purge();
+			g_pMotionSearcherY->Purge();
+			g_pMotionSearcherCbCr->Purge();
 		}
 	}
 
@@ -670,9 +997,9 @@ newdenoise_frame0 (const uint8_t *a_pInputY, const uint8_t *a_pInputCb,
 	{
 		// Get any remaining frame.
 		if (g_bMotionSearcherY)
-			pFrameY = g_oMotionSearcherY.GetRemainingFrames();
+			pFrameY = g_pMotionSearcherY->GetRemainingFrames();
 		if (g_bMotionSearcherCbCr)
-			pFrameCbCr = g_oMotionSearcherCbCr.GetRemainingFrames();
+			pFrameCbCr = g_pMotionSearcherCbCr->GetRemainingFrames();
 	
 		// Output it.
 		output_frame (pFrameY, pFrameCbCr, a_pOutputY, a_pOutputCb,
@@ -685,9 +1012,9 @@ newdenoise_frame0 (const uint8_t *a_pInputY, const uint8_t *a_pInputCb,
 	{
 		// Get any frame that's ready for output.
 		if (g_bMotionSearcherY)
-			pFrameY = g_oMotionSearcherY.GetFrameReadyForOutput();
+			pFrameY = g_pMotionSearcherY->GetFrameReadyForOutput();
 		if (g_bMotionSearcherCbCr)
-			pFrameCbCr = g_oMotionSearcherCbCr.GetFrameReadyForOutput();
+			pFrameCbCr = g_pMotionSearcherCbCr->GetFrameReadyForOutput();
 	
 		// Output it.
 		output_frame (pFrameY, pFrameCbCr, a_pOutputY, a_pOutputCb,
@@ -703,7 +1030,7 @@ newdenoise_frame0 (const uint8_t *a_pInputY, const uint8_t *a_pInputCb,
 				g_pPixelsY[i] = PixelY (a_pInputY + i);
 
 			// Pass the frame to the denoiser.
-			g_oMotionSearcherY.AddFrame (eStatus, g_pPixelsY);
+			g_pMotionSearcherY->AddFrame (eStatus, g_pPixelsY);
 			if (eStatus != g_kNoError)
 				return -1;
 		}
@@ -722,7 +1049,7 @@ newdenoise_frame0 (const uint8_t *a_pInputY, const uint8_t *a_pInputCb,
 			}
 
 			// Pass the frame to the denoiser.
-			g_oMotionSearcherCbCr.AddFrame (eStatus, g_pPixelsCbCr);
+			g_pMotionSearcherCbCr->AddFrame (eStatus, g_pPixelsCbCr);
 			if (eStatus != g_kNoError)
 				return -1;
 		}
@@ -763,7 +1090,7 @@ newdenoise_frame_intensity (const uint8_t *a_pInputY,
 	{
 		extern int frame;
 		if (frame % denoiser.frames == 0)
-			g_oMotionSearcherY.Purge();
+			g_pMotionSearcherY->Purge();
 	}
 
 	// If the end of input has been reached, then return the next
@@ -771,7 +1098,7 @@ newdenoise_frame_intensity (const uint8_t *a_pInputY,
 	if (a_pInputY == NULL)
 	{
 		// Get any remaining frame.
-		pFrameY = g_oMotionSearcherY.GetRemainingFrames();
+		pFrameY = g_pMotionSearcherY->GetRemainingFrames();
 	
 		// Output it.
 		output_frame (pFrameY, NULL, a_pOutputY, NULL, NULL);
@@ -782,7 +1109,7 @@ newdenoise_frame_intensity (const uint8_t *a_pInputY,
 	else
 	{
 		// Get any frame that's ready for output.
-		pFrameY = g_oMotionSearcherY.GetFrameReadyForOutput();
+		pFrameY = g_pMotionSearcherY->GetFrameReadyForOutput();
 	
 		// Output it.
 		output_frame (pFrameY, NULL, a_pOutputY, NULL, NULL);
@@ -794,7 +1121,7 @@ newdenoise_frame_intensity (const uint8_t *a_pInputY,
 			g_pPixelsY[i] = PixelY (a_pInputY + i);
 
 		// Pass the frame to the denoiser.
-		g_oMotionSearcherY.AddFrame (eStatus, g_pPixelsY);
+		g_pMotionSearcherY->AddFrame (eStatus, g_pPixelsY);
 		if (eStatus != g_kNoError)
 			return -1;
 	}
@@ -828,7 +1155,7 @@ newdenoise_frame_color (const uint8_t *a_pInputCb,
 	{
 		extern int frame;
 		if (frame % denoiser.frames == 0)
-			g_oMotionSearcherCbCr.Purge();
+			g_pMotionSearcherCbCr->Purge();
 	}
 
 	// If the end of input has been reached, then return the next
@@ -836,7 +1163,7 @@ newdenoise_frame_color (const uint8_t *a_pInputCb,
 	if (a_pInputCr == NULL)
 	{
 		// Get any remaining frame.
-		pFrameCbCr = g_oMotionSearcherCbCr.GetRemainingFrames();
+		pFrameCbCr = g_pMotionSearcherCbCr->GetRemainingFrames();
 	
 		// Output it.
 		output_frame (NULL, pFrameCbCr, NULL, a_pOutputCb, a_pOutputCr);
@@ -847,7 +1174,7 @@ newdenoise_frame_color (const uint8_t *a_pInputCb,
 	else
 	{
 		// Get any frame that's ready for output.
-		pFrameCbCr = g_oMotionSearcherCbCr.GetFrameReadyForOutput();
+		pFrameCbCr = g_pMotionSearcherCbCr->GetFrameReadyForOutput();
 	
 		// Output it.
 		output_frame (NULL, pFrameCbCr, NULL, a_pOutputCb, a_pOutputCr);
@@ -867,7 +1194,7 @@ newdenoise_frame_color (const uint8_t *a_pInputCb,
 			}
 
 			// Pass the frame to the denoiser.
-			g_oMotionSearcherCbCr.AddFrame (eStatus, g_pPixelsCbCr);
+			g_pMotionSearcherCbCr->AddFrame (eStatus, g_pPixelsCbCr);
 			if (eStatus != g_kNoError)
 				return -1;
 		}
@@ -877,6 +1204,49 @@ newdenoise_frame_color (const uint8_t *a_pInputCb,
 	return (pFrameCbCr != NULL) ? 0 : 1;
 }
 
+// Denoise intensity in several bands, one per thread, then reassemble
+// the bands.  Handles both interlaced and non-interlaced frames.
+static int
+newdenoise_bands_intensity (const uint8_t *a_pInputY,
+	uint8_t *a_pOutputY)
+{
+	int i, bY, bBand;
+
+	// Denoise the first band in the current thread, and the rest in
+	// their own threads.
+	for (i = 1; i < g_nBandsY; ++i)
+		g_pBandThreadsY[i - 1].AddFrame (a_pInputY);
+	bY = g_pBandsY[0].DenoiseFrame (a_pInputY);
+	for (i = 1; i < g_nBandsY; ++i)
+	{
+		bBand = g_pBandThreadsY[i - 1].WaitForAddFrame();
+		if (bBand == -1)
+			bY = -1;
+
+		// All bands see the same frames, so they should all produce
+		// output at the same time.
+		assert (bY == -1 || bBand == bY);
+	}
+
+	// Print the statistics of all the bands together.
+	{
+		extern int frame, verbose;
+		if (a_pInputY != NULL && verbose >= 1)
+		{
+			PixelStats oStats;
+			for (i = 0; i < g_nBandsY; ++i)
+				oStats.Add (g_pBandsY[i].GetPixelStats());
+			oStats.Print (frame);
+		}
+	}
+
+	// If there was output, put the bands back together.
+	if (bY == 0)
+		output_bands (a_pOutputY);
+	
+	return bY;
+}
+
 int
 newdenoise_frame (const uint8_t *a_pInputY, const uint8_t *a_pInputCb,
 	const uint8_t *a_pInputCr, uint8_t *a_pOutputY,
@@ -892,7 +1262,9 @@ newdenoise_frame (const uint8_t *a_pInputY, const uint8_t *a_pInputCb,
 	if (g_bMotionSearcherCbCr && (denoiser.threads & 2))
 		g_oDenoiserThreadCbCr.AddFrame (a_pInputCb, a_pInputCr,
 			a_pOutputCb, a_pOutputCr);
-	if (g_bMotionSearcherY)
+	if (g_bMotionSearcherY && g_nBandsY > 0)
+		bY = newdenoise_bands_intensity (a_pInputY, a_pOutputY);
+	else if (g_bMotionSearcherY)
 		bY = newdenoise_frame_intensity (a_pInputY, a_pOutputY);
 	if (g_bMotionSearcherCbCr && !(denoiser.threads & 2))
 		bCbCr = newdenoise_frame_color (a_pInputCb, a_pInputCr,
@@ -924,9 +1296,6 @@ static void output_frame
 	// by our caller.
 	if (a_pFrameY != NULL)
 	{
-		ReferencePixelY *pY;
-			// The pixel, as it's being converted to the output format.
-
 		// Make sure our caller gave us somewhere to write output.
 		assert (a_pOutputY != NULL);
 
@@ -934,17 +1303,12 @@ static void output_frame
 		// format.
 		for (i = 0; i < g_nPixelsY; ++i)
 		{
-			pY = a_pFrameY->GetPixel (i);
-			assert (pY != NULL);
-			const PixelY &rY = pY->GetValue();
+			const PixelY &rY = a_pFrameY->GetValue (i);
 			a_pOutputY[i] = rY[0];
 		}
 	}
 	if (a_pFrameCbCr != NULL)
 	{
-		ReferencePixelCbCr *pCbCr;
-			// The pixel, as it's being converted to the output format.
-
 		// Make sure our caller gave us somewhere to write output.
 		assert (a_pOutputCb != NULL && a_pOutputCr != NULL);
 
@@ -952,9 +1316,7 @@ static void output_frame
 		// format.
 		for (i = 0; i < g_nPixelsCbCr; ++i)
 		{
-			pCbCr = a_pFrameCbCr->GetPixel (i);
-			assert (pCbCr != NULL);
-			const PixelCbCr &rCbCr = pCbCr->GetValue();
+			const PixelCbCr &rCbCr = a_pFrameCbCr->GetValue (i);
 			a_pOutputCb[i] = rCbCr[0];
 			a_pOutputCr[i] = rCbCr[1];
 		}
@@ -991,8 +1353,8 @@ newdenoise_interlaced_frame0 (const uint8_t *a_pInputY,
 		extern int frame;
 		if (frame % denoiser.frames == 0)
 		{
-			g_oMotionSearcherY.Purge();
-			g_oMotionSearcherCbCr.Purge();
+			g_pMotionSearcherY->Purge();
+			g_pMotionSearcherCbCr->Purge();
 		}
 	}
 
@@ -1006,9 +1368,9 @@ newdenoise_interlaced_frame0 (const uint8_t *a_pInputY,
 	{
 		// Get 1/2 any remaining frame.
 		if (g_bMotionSearcherY)
-			pFrameY = g_oMotionSearcherY.GetRemainingFrames();
+			pFrameY = g_pMotionSearcherY->GetRemainingFrames();
 		if (g_bMotionSearcherCbCr)
-			pFrameCbCr = g_oMotionSearcherCbCr.GetRemainingFrames();
+			pFrameCbCr = g_pMotionSearcherCbCr->GetRemainingFrames();
 	
 		// Output it.
 		output_field (nMask ^ 0, pFrameY, pFrameCbCr, a_pOutputY,
@@ -1016,9 +1378,9 @@ newdenoise_interlaced_frame0 (const uint8_t *a_pInputY,
 
 		// Get 1/2 any remaining frame.
 		if (g_bMotionSearcherY)
-			pFrameY = g_oMotionSearcherY.GetRemainingFrames();
+			pFrameY = g_pMotionSearcherY->GetRemainingFrames();
 		if (g_bMotionSearcherCbCr)
-			pFrameCbCr = g_oMotionSearcherCbCr.GetRemainingFrames();
+			pFrameCbCr = g_pMotionSearcherCbCr->GetRemainingFrames();
 	
 		// Output it.
 		output_field (nMask ^ 1, pFrameY, pFrameCbCr, a_pOutputY,
@@ -1031,9 +1393,9 @@ newdenoise_interlaced_frame0 (const uint8_t *a_pInputY,
 	{
 		// Get 1/2 any frame that's ready for output.
 		if (g_bMotionSearcherY)
-			pFrameY = g_oMotionSearcherY.GetFrameReadyForOutput();
+			pFrameY = g_pMotionSearcherY->GetFrameReadyForOutput();
 		if (g_bMotionSearcherCbCr)
-			pFrameCbCr = g_oMotionSearcherCbCr.GetFrameReadyForOutput();
+			pFrameCbCr = g_pMotionSearcherCbCr->GetFrameReadyForOutput();
 	
 		// Output it.
 		output_field (nMask ^ 0, pFrameY, pFrameCbCr, a_pOutputY,
@@ -1051,7 +1413,7 @@ newdenoise_interlaced_frame0 (const uint8_t *a_pInputY,
 			assert (i == g_nPixelsY);
 
 			// Pass the frame to the denoiser.
-			g_oMotionSearcherY.AddFrame (eStatus, g_pPixelsY);
+			g_pMotionSearcherY->AddFrame (eStatus, g_pPixelsY);
 			if (eStatus != g_kNoError)
 				return -1;
 		}
@@ -1073,16 +1435,16 @@ newdenoise_interlaced_frame0 (const uint8_t *a_pInputY,
 			assert (i == g_nPixelsCbCr);
 
 			// Pass the frame to the denoiser.
-			g_oMotionSearcherCbCr.AddFrame (eStatus, g_pPixelsCbCr);
+			g_pMotionSearcherCbCr->AddFrame (eStatus, g_pPixelsCbCr);
 			if (eStatus != g_kNoError)
 				return -1;
 		}
 	
 		// Get 1/2 any frame that's ready for output.
 		if (g_bMotionSearcherY)
-			pFrameY = g_oMotionSearcherY.GetFrameReadyForOutput();
+			pFrameY = g_pMotionSearcherY->GetFrameReadyForOutput();
 		if (g_bMotionSearcherCbCr)
-			pFrameCbCr = g_oMotionSearcherCbCr.GetFrameReadyForOutput();
+			pFrameCbCr = g_pMotionSearcherCbCr->GetFrameReadyForOutput();
 	
 		// Output it.
 		output_field (nMask ^ 1, pFrameY, pFrameCbCr, a_pOutputY,
@@ -1100,7 +1462,7 @@ newdenoise_interlaced_frame0 (const uint8_t *a_pInputY,
 			assert (i == g_nPixelsY);
 
 			// Pass the frame to the denoiser.
-			g_oMotionSearcherY.AddFrame (eStatus, g_pPixelsY);
+			g_pMotionSearcherY->AddFrame (eStatus, g_pPixelsY);
 			if (eStatus != g_kNoError)
 				return -1;
 		}
@@ -1122,7 +1484,7 @@ newdenoise_interlaced_frame0 (const uint8_t *a_pInputY,
 			assert (i == g_nPixelsCbCr);
 
 			// Pass the frame to the denoiser.
-			g_oMotionSearcherCbCr.AddFrame (eStatus, g_pPixelsCbCr);
+			g_pMotionSearcherCbCr->AddFrame (eStatus, g_pPixelsCbCr);
 			if (eStatus != g_kNoError)
 				return -1;
 		}
@@ -1166,7 +1528,7 @@ newdenoise_interlaced_frame_intensity (const uint8_t *a_pInputY,
 	{
 		extern int frame;
 		if (frame % denoiser.frames == 0)
-			g_oMotionSearcherY.Purge();
+			g_pMotionSearcherY->Purge();
 	}
 
 	// Set up for the type of interlacing.
@@ -1177,13 +1539,13 @@ newdenoise_interlaced_frame_intensity (const uint8_t *a_pInputY,
 	if (a_pInputY == NULL)
 	{
 		// Get 1/2 any remaining frame.
-		pFrameY = g_oMotionSearcherY.GetRemainingFrames();
+		pFrameY = g_pMotionSearcherY->GetRemainingFrames();
 	
 		// Output it.
 		output_field (nMask ^ 0, pFrameY, NULL, a_pOutputY, NULL, NULL);
 
 		// Get 1/2 any remaining frame.
-		pFrameY = g_oMotionSearcherY.GetRemainingFrames();
+		pFrameY = g_pMotionSearcherY->GetRemainingFrames();
 	
 		// Output it.
 		output_field (nMask ^ 1, pFrameY, NULL, a_pOutputY, NULL, NULL);
@@ -1194,7 +1556,7 @@ newdenoise_interlaced_frame_intensity (const uint8_t *a_pInputY,
 	else
 	{
 		// Get 1/2 any frame that's ready for output.
-		pFrameY = g_oMotionSearcherY.GetFrameReadyForOutput();
+		pFrameY = g_pMotionSearcherY->GetFrameReadyForOutput();
 	
 		// Output it.
 		output_field (nMask ^ 0, pFrameY, NULL, a_pOutputY, NULL, NULL);
@@ -1208,12 +1570,12 @@ newdenoise_interlaced_frame_intensity (const uint8_t *a_pInputY,
 		assert (i == g_nPixelsY);
 
 		// Pass the frame to the denoiser.
-		g_oMotionSearcherY.AddFrame (eStatus, g_pPixelsY);
+		g_pMotionSearcherY->AddFrame (eStatus, g_pPixelsY);
 		if (eStatus != g_kNoError)
 			return -1;
 	
 		// Get 1/2 any frame that's ready for output.
-		pFrameY = g_oMotionSearcherY.GetFrameReadyForOutput();
+		pFrameY = g_pMotionSearcherY->GetFrameReadyForOutput();
 	
 		// Output it.
 		output_field (nMask ^ 1, pFrameY, NULL, a_pOutputY, NULL, NULL);
@@ -1227,7 +1589,7 @@ newdenoise_interlaced_frame_intensity (const uint8_t *a_pInputY,
 		assert (i == g_nPixelsY);
 
 		// Pass the frame to the denoiser.
-		g_oMotionSearcherY.AddFrame (eStatus, g_pPixelsY);
+		g_pMotionSearcherY->AddFrame (eStatus, g_pPixelsY);
 		if (eStatus != g_kNoError)
 			return -1;
 	}
@@ -1264,7 +1626,7 @@ newdenoise_interlaced_frame_color (const uint8_t *a_pInputCb,
 	{
 		extern int frame;
 		if (frame % denoiser.frames == 0)
-			g_oMotionSearcherCbCr.Purge();
+			g_pMotionSearcherCbCr->Purge();
 	}
 
 	// Set up for the type of interlacing.
@@ -1275,14 +1637,14 @@ newdenoise_interlaced_frame_color (const uint8_t *a_pInputCb,
 	if (a_pInputCr == NULL)
 	{
 		// Get 1/2 any remaining frame.
-		pFrameCbCr = g_oMotionSearcherCbCr.GetRemainingFrames();
+		pFrameCbCr = g_pMotionSearcherCbCr->GetRemainingFrames();
 	
 		// Output it.
 		output_field (nMask ^ 0, NULL, pFrameCbCr, NULL, a_pOutputCb,
 			a_pOutputCr);
 
 		// Get 1/2 any remaining frame.
-		pFrameCbCr = g_oMotionSearcherCbCr.GetRemainingFrames();
+		pFrameCbCr = g_pMotionSearcherCbCr->GetRemainingFrames();
 	
 		// Output it.
 		output_field (nMask ^ 1, NULL, pFrameCbCr, NULL, a_pOutputCb,
@@ -1294,7 +1656,7 @@ newdenoise_interlaced_frame_color (const uint8_t *a_pInputCb,
 	else
 	{
 		// Get 1/2 any frame that's ready for output.
-		pFrameCbCr = g_oMotionSearcherCbCr.GetFrameReadyForOutput();
+		pFrameCbCr = g_pMotionSearcherCbCr->GetFrameReadyForOutput();
 	
 		// Output it.
 		output_field (nMask ^ 0, NULL, pFrameCbCr, NULL, a_pOutputCb,
@@ -1318,13 +1680,13 @@ newdenoise_interlaced_frame_color (const uint8_t *a_pInputCb,
 			assert (i == g_nPixelsCbCr);
 
 			// Pass the frame to the denoiser.
-			g_oMotionSearcherCbCr.AddFrame (eStatus, g_pPixelsCbCr);
+			g_pMotionSearcherCbCr->AddFrame (eStatus, g_pPixelsCbCr);
 			if (eStatus != g_kNoError)
 				return -1;
 		}
 	
 		// Get 1/2 any frame that's ready for output.
-		pFrameCbCr = g_oMotionSearcherCbCr.GetFrameReadyForOutput();
+		pFrameCbCr = g_pMotionSearcherCbCr->GetFrameReadyForOutput();
 	
 		// Output it.
 		output_field (nMask ^ 1, NULL, pFrameCbCr, NULL, a_pOutputCb,
@@ -1348,7 +1710,7 @@ newdenoise_interlaced_frame_color (const uint8_t *a_pInputCb,
 			assert (i == g_nPixelsCbCr);
 
 			// Pass the frame to the denoiser.
-			g_oMotionSearcherCbCr.AddFrame (eStatus, g_pPixelsCbCr);
+			g_pMotionSearcherCbCr->AddFrame (eStatus, g_pPixelsCbCr);
 			if (eStatus != g_kNoError)
 				return -1;
 		}
@@ -1373,7 +1735,9 @@ newdenoise_interlaced_frame (const uint8_t *a_pInputY,
 	if (g_bMotionSearcherCbCr && (denoiser.threads & 2))
 		g_oDenoiserThreadCbCr.AddFrame (a_pInputCb, a_pInputCr,
 			a_pOutputCb, a_pOutputCr);
-	if (g_bMotionSearcherY)
+	if (g_bMotionSearcherY && g_nBandsY > 0)
+		bY = newdenoise_bands_intensity (a_pInputY, a_pOutputY);
+	else if (g_bMotionSearcherY)
 		bY = newdenoise_interlaced_frame_intensity (a_pInputY,
 			a_pOutputY);
 	if (g_bMotionSearcherCbCr && !(denoiser.threads & 2))
@@ -1404,9 +1768,6 @@ static void output_field
 	// by our caller.
 	if (a_pFrameY != NULL)
 	{
-		ReferencePixelY *pY;
-			// The pixel, as it's being converted to the output format.
-
 		// Make sure our caller gave us somewhere to write output.
 		assert (a_pOutputY != NULL);
 
@@ -1416,18 +1777,13 @@ static void output_field
 		{
 			for (x = 0; x < g_nWidthY; ++x, ++i)
 			{
-				pY = a_pFrameY->GetPixel (i);
-				assert (pY != NULL);
-				const PixelY &rY = pY->GetValue();
+				const PixelY &rY = a_pFrameY->GetValue (i);
 				a_pOutputY[y * g_nWidthY + x] = rY[0];
 			}
 		}
 	}
 	if (a_pFrameCbCr != NULL)
 	{
-		ReferencePixelCbCr *pCbCr;
-			// The pixel, as it's being converted to the output format.
-
 		// Make sure our caller gave us somewhere to write output.
 		assert (a_pOutputCb != NULL && a_pOutputCr != NULL);
 
@@ -1437,9 +1793,7 @@ static void output_field
 		{
 			for (x = 0; x < g_nWidthCbCr; ++x, ++i)
 			{
-				pCbCr = a_pFrameCbCr->GetPixel (i);
-				assert (pCbCr != NULL);
-				const PixelCbCr &rCbCr = pCbCr->GetValue();
+				const PixelCbCr &rCbCr = a_pFrameCbCr->GetValue (i);
 				a_pOutputCb[y * g_nWidthCbCr + x] = rCbCr[0];
 				a_pOutputCr[y * g_nWidthCbCr + x] = rCbCr[1];
 			}
@@ -1448,6 +1802,65 @@ static void output_field
 }
 
 
+static void output_bands (uint8_t *a_pOutputY)
+{
+	int nInterlace;
+		// The number of fields in a frame.
+	int nBlendRows;
+		// The number of frame rows blended on each side of a split.
+	int i, x, y;
+		// Used to loop through bands/pixels.
+
+	// Make sure our caller gave us somewhere to write output.
+	assert (a_pOutputY != NULL);
+
+	// Band rows are counted in field-rows, but the bands store whole
+	// frame rows.
+	nInterlace = (denoiser.interlaced != 0) ? 2 : 1;
+	nBlendRows = g_nBandBlendY * nInterlace;
+
+	// Copy the part of each band that no other band overlaps.
+	for (i = 0; i < g_nBandsY; ++i)
+	{
+		int nBandTop = g_pBandsY[i].GetTop() * nInterlace;
+		int nFrom = g_pnBandSplitsY[i] * nInterlace;
+		int nTo = g_pnBandSplitsY[i + 1] * nInterlace;
+		if (i > 0)
+			nFrom += nBlendRows;
+		if (i < g_nBandsY - 1)
+			nTo -= nBlendRows;
+		memcpy (a_pOutputY + nFrom * g_nWidthY,
+			g_pBandsY[i].GetOutput() + (nFrom - nBandTop) * g_nWidthY,
+			(nTo - nFrom) * g_nWidthY);
+	}
+
+	// Blend across each split.  The lower band's weight ramps up
+	// linearly from the top of the blend area to the bottom.
+	for (i = 1; i < g_nBandsY; ++i)
+	{
+		int nStart = g_pnBandSplitsY[i] * nInterlace - nBlendRows;
+		int nDivisor = 4 * nBlendRows;
+		const uint8_t *pAbove = g_pBandsY[i - 1].GetOutput()
+			+ (nStart - g_pBandsY[i - 1].GetTop() * nInterlace)
+				* g_nWidthY;
+		const uint8_t *pBelow = g_pBandsY[i].GetOutput()
+			+ (nStart - g_pBandsY[i].GetTop() * nInterlace) * g_nWidthY;
+		uint8_t *pOut = a_pOutputY + nStart * g_nWidthY;
+
+		for (y = 0; y < 2 * nBlendRows; ++y)
+		{
+			int nWeight = 2 * y + 1;
+			for (x = 0; x < g_nWidthY; ++x)
+				pOut[x] = (int (pAbove[x]) * (nDivisor - nWeight)
+					+ int (pBelow[x]) * nWeight + nDivisor / 2) / nDivisor;
+			pAbove += g_nWidthY;
+			pBelow += g_nWidthY;
+			pOut += g_nWidthY;
+		}
+	}
+}
+
+
 
 // Pixel methods.
 
@@ -2391,6 +2804,256 @@ DenoiserThreadCbCr::Work (void)
 
 
 
+// The DenoiserBandY class.
+
+
+
+// Default constructor.
+DenoiserBandY::DenoiserBandY()
+{
+	// No band yet.
+	m_pMotionSearcher = NULL;
+	m_nTop = m_nRows = m_nPixels = 0;
+	m_pPixels = NULL;
+	m_pOutputY = NULL;
+}
+
+
+
+// Destructor.
+DenoiserBandY::~DenoiserBandY()
+{
+	// Free up our denoiser & buffers.
+	delete m_pMotionSearcher;
+	delete[] m_pPixels;
+	delete[] m_pOutputY;
+}
+
+
+
+// Initializer.
+void
+DenoiserBandY::Init (Status_t &a_reStatus, int a_nFrames, int a_nTop,
+	int a_nRows)
+{
+	int nInterlace;
+		// The number of fields in a frame.
+
+	// Make sure they didn't start us off with an error.
+	assert (a_reStatus == g_kNoError);
+
+	// Store the band's extent.
+	m_nTop = a_nTop;
+	m_nRows = a_nRows;
+	m_nPixels = g_nWidthY * a_nRows;
+
+	// Allocate space for input and output.
+	nInterlace = (denoiser.interlaced != 0) ? 2 : 1;
+	m_pPixels = new MotionSearcherY::Pixel_t [m_nPixels];
+	m_pOutputY = new uint8_t [nInterlace * m_nPixels];
+	if (m_pPixels == NULL || m_pOutputY == NULL)
+	{
+		a_reStatus = g_kOutOfMemory;
+		return;
+	}
+
+	// Set up the denoiser.
+	m_pMotionSearcher = new_motion_searcher_y (choose_regions
+		(g_nWidthY, a_nRows, denoiser.radiusY));
+	if (m_pMotionSearcher == NULL)
+	{
+		a_reStatus = g_kOutOfMemory;
+		return;
+	}
+	m_pMotionSearcher->Init (a_reStatus, a_nFrames, g_nWidthY, a_nRows,
+		denoiser.radiusY, denoiser.radiusY,
+		denoiser.zThresholdY, denoiser.thresholdY,
+		denoiser.matchCountThrottle, denoiser.matchSizeThrottle);
+
+	// The bands' statistics are printed together, one line per frame.
+	m_pMotionSearcher->SetPrintPixelStats (false);
+}
+
+
+
+// Denoise this band of the given frame.
+int
+DenoiserBandY::DenoiseFrame (const uint8_t *a_pInputY)
+{
+	Status_t eStatus;
+		// An error that may occur.
+	const MotionSearcherY::ReferenceFrame_t *pFrameY;
+		// Denoised field data, ready for output.
+	int nInterlace, nField, nRow;
+		// The number of fields in a frame, the current field, and the
+		// frame row that corresponds to a field row.
+	int i, x, y;
+		// Used to loop through pixels.
+
+	// No errors yet.
+	eStatus = g_kNoError;
+
+	// No output frames have been received yet.
+	pFrameY = NULL;
+
+	// No statistics yet.
+	m_oPixelStats = PixelStats();
+
+	// If it's time to purge, do so.
+	{
+		extern int frame;
+		if (frame % denoiser.frames == 0)
+			m_pMotionSearcher->Purge();
+	}
+
+	// Denoise each field in turn.  (A non-interlaced frame is one
+	// field.)  Field-row y is frame row (y * nInterlace + nField),
+	// adjusted for the type of interlacing.
+	nInterlace = (denoiser.interlaced != 0) ? 2 : 1;
+	for (nField = 0; nField < nInterlace; ++nField)
+	{
+		int nMask = ((denoiser.interlaced == 2) ? 1 : 0) ^ nField;
+
+		// Get any field that's ready for output.
+		pFrameY = (a_pInputY == NULL)
+			? m_pMotionSearcher->GetRemainingFrames()
+			: m_pMotionSearcher->GetFrameReadyForOutput();
+
+		// Output it.
+		if (pFrameY != NULL)
+		{
+			for (i = 0, y = 0; y < m_nRows; ++y)
+			{
+				nRow = y * nInterlace + nMask;
+				for (x = 0; x < g_nWidthY; ++x, ++i)
+				{
+					const PixelY &rY = pFrameY->GetValue (i);
+					m_pOutputY[nRow * g_nWidthY + x] = rY[0];
+				}
+			}
+		}
+
+		// If there's no more input, there's nothing to add.
+		if (a_pInputY == NULL)
+			continue;
+
+		// Convert the input field into the format needed by the
+		// denoiser.
+		for (i = 0, y = m_nTop; y < m_nTop + m_nRows; ++y)
+		{
+			nRow = y * nInterlace + nMask;
+			for (x = 0; x < g_nWidthY; ++x, ++i)
+				m_pPixels[i] = PixelY (a_pInputY + (nRow * g_nWidthY + x));
+		}
+		assert (i == m_nPixels);
+
+		// Pass the field to the denoiser.
+		m_pMotionSearcher->AddFrame (eStatus, m_pPixels);
+		if (eStatus != g_kNoError)
+			return -1;
+		m_pMotionSearcher->AddPixelStats (m_oPixelStats);
+	}
+
+	// Return whether there was an output frame this time.
+	return (pFrameY != NULL) ? 0 : 1;
+}
+
+
+
+// The DenoiserThreadBandY class.
+
+
+
+// Default constructor.
+DenoiserThreadBandY::DenoiserThreadBandY()
+{
+	// No band or input buffer yet.
+	m_pBand = NULL;
+	m_pInputY = NULL;
+}
+
+
+
+// Destructor.
+DenoiserThreadBandY::~DenoiserThreadBandY()
+{
+	// Nothing to do.
+}
+
+
+
+// Initialize.  Set up all private thread data and start the
+// worker thread.
+void
+DenoiserThreadBandY::Initialize (DenoiserBandY *a_pBand)
+{
+	// Make sure they gave us a band.
+	assert (a_pBand != NULL);
+
+	// Store the band.
+	m_pBand = a_pBand;
+
+	// Let the base class initialize itself.
+	BaseClass::Initialize();
+}
+
+
+
+// Add a frame to the denoiser.
+void
+DenoiserThreadBandY::AddFrame (const uint8_t *a_pInputY)
+{
+	// Get exclusive access.
+	Lock();
+
+	// Store the parameters.  (A null input frame means that the end
+	// of input has been reached.)
+	m_pInputY = a_pInputY;
+
+	// Signal the availability of input.
+	BaseClass::AddFrame();
+
+	// Release exclusive access.
+	Unlock();
+}
+
+
+
+// Get the next denoised band, if any.
+int
+DenoiserThreadBandY::WaitForAddFrame (void)
+{
+	// Get exclusive access.
+	Lock();
+
+	// Wait for the current frame to finish denoising.
+	BaseClass::WaitForAddFrame();
+
+	// We're done denoising this frame.
+	m_pInputY = NULL;
+
+	// Release exclusive access.
+	Unlock();
+
+	// Let our caller know if there's another band.
+	return m_nWorkRetval;
+}
+
+
+
+// Denoise the current frame.
+int
+DenoiserThreadBandY::Work (void)
+{
+	// Make sure we have a band to denoise.
+	assert (m_pBand != NULL);
+
+	// Denoise the current frame.
+	return m_pBand->DenoiseFrame (m_pInputY);
+}
+
+
+
 // The ReadWriteThread class.
 
 
@@ -24,6 +24,11 @@ int newdenoise_init (int a_nFrames, int a_nWidthY, int a_nHeightY,
 	int a_nOutputFD, const y4m_stream_info_t *a_pStreamInfo,
 	y4m_frame_info_t *a_pFrameInfo);
 
+/* Look up a region implementation by name, for the "regions" field of
+   the denoiser configuration.
+   Returns -1 if there's no such region implementation. */
+int newdenoise_region_policy (const char *a_pszName);
+
 /* Shutdown the new denoiser.
    Returns 0 if successful, -1 if there was some problem. */
 int newdenoise_shutdown (void);
@@ -71,6 +76,8 @@ typedef struct DNSR_GLOBAL
 	int matchCountThrottle;	/* match throttle on count */
 	int matchSizeThrottle;	/* match throttle on size */
 	int threads;			/* bit 0=rw only, bit 1=color in parallel */
+	int bands;				/* # of intensity bands denoised in parallel */
+	int regions;			/* region implementation, 0 == auto */
 	struct
 	{
 		int w, h;			/* width/height of intensity frame */
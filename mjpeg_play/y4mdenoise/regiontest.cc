@@ -1,16 +1,244 @@
 #include "config.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
 #include <assert.h>
 #include "SetRegion2D.hh"
+#include "RegionPolicy.hh"
 
 // This file (C) 2004-2009 Steven Boswell.  All rights reserved.
 // Released to the public under the GNU General Public License v2.
 // See the file COPYING for more information.
 
+// Usage: regiontest
+//            Test set-region operations, printing the results.
+//        regiontest width height [iterations]
+//            Time union, subtract, and flood-fill on frames of the given
+//            size, for each region implementation the motion-searcher
+//            can choose between.
+
 // The type of region we're testing.
 typedef SetRegion2D<int16_t,int32_t> Region;
 struct Extent { int16_t m_nY; int16_t m_nXStart; int16_t m_nXEnd; };
 
+// The region implementations being timed.
+typedef SetRegion2D<int16_t,int32_t,
+		SetRegionImp<int16_t,int32_t,true>::Imp_t>
+	VectorRegion;
+typedef SetRegion2D<int16_t,int32_t,
+		SetRegionImp<int16_t,int32_t,false>::Imp_t>
+	SkipListRegion;
+typedef BitmapRegion2D<int16_t,int32_t> BitmapRegion;
+
+
+
+// A pseudo-random number generator, so that every region
+// implementation sees the same extents.
+class Random
+{
+public:
+	explicit Random (unsigned long a_nSeed) : m_nState (a_nSeed) {}
+	int Next (int a_nRange)
+		{ m_nState = m_nState * 1103515245 + 12345;
+			return (int) ((m_nState >> 16) % a_nRange); }
+private:
+	unsigned long m_nState;
+};
+
+
+
+// A flood-fill that finds one blob of a fixed pattern.
+template <class REGION>
+class BenchFloodFillControl : public FloodFillControlAdapter<REGION>
+{
+private:
+	typedef FloodFillControlAdapter<REGION> BaseClass;
+		// Keep track of who our base class is.
+public:
+	template <class ALLOCATOR>
+	BenchFloodFillControl (ALLOCATOR &a_rAllocator, int16_t a_nWidth,
+			int16_t a_nHeight)
+		: BaseClass (a_rAllocator), m_nWidth (a_nWidth),
+		m_nHeight (a_nHeight) {}
+
+	bool ShouldUseExtent (typename BaseClass::Extent &a_rExtent)
+	{
+		// Clip the extent to the frame.
+		if (a_rExtent.m_tnY < 0 || a_rExtent.m_tnY >= m_nHeight
+		|| a_rExtent.m_tnXStart >= m_nWidth || a_rExtent.m_tnXEnd <= 0)
+			return false;
+		if (a_rExtent.m_tnXStart < 0)
+			a_rExtent.m_tnXStart = 0;
+		if (a_rExtent.m_tnXEnd > m_nWidth)
+			a_rExtent.m_tnXEnd = m_nWidth;
+		return true;
+	}
+
+	bool IsPointInRegion (int16_t a_nX, int16_t a_nY)
+	{
+		// Diagonal bands, broken up by a coarse checkerboard, so that
+		// the blob has plenty of ragged edges.
+		return ((a_nX + a_nY) & 15) < 11
+			|| (((a_nX >> 5) ^ (a_nY >> 5)) & 1) == 0;
+	}
+
+private:
+	int16_t m_nWidth, m_nHeight;
+		// The size of the frame.
+};
+
+
+
+// Time union, subtract, and flood-fill operations on one region
+// implementation.  Returns 0 if successful, 1 if there was an error.
+template <class REGION, class ALLOCATOR>
+int
+BenchRegion (const char *a_pszName, ALLOCATOR &a_rAllocator,
+	int16_t a_nWidth, int16_t a_nHeight, int a_nIterations)
+{
+	Status_t eStatus;
+		// An error that may occur.
+	RegionAdapter<REGION> oRegion (a_rAllocator);
+		// The region being exercised.
+	BenchFloodFillControl<REGION> oControl (a_rAllocator, a_nWidth,
+			a_nHeight);
+		// Describes the flood-fill.
+	clock_t tStart;
+	double fUnion, fSubtract, fFloodFill;
+		// Time spent on each kind of operation.
+	long nPoints;
+		// The total size of the results, to check that every
+		// implementation did the same thing.
+	int i, nY, nExtent;
+		// Used to loop through iterations, rows, and extents.
+
+	// No errors yet.
+	eStatus = g_kNoError;
+
+	// Initialize.
+	oRegion.Init (eStatus, a_nWidth, a_nHeight);
+	if (eStatus != g_kNoError)
+		{ printf ("%s: Init() failed\n", a_pszName); return 1; }
+	oControl.Init (eStatus, a_nWidth, a_nHeight);
+	if (eStatus != g_kNoError)
+		{ printf ("%s: flood-fill Init() failed\n", a_pszName);
+			return 1; }
+
+	fUnion = fSubtract = fFloodFill = 0.0;
+	nPoints = 0;
+	for (i = 0; i < a_nIterations; ++i)
+	{
+		Random oRandom (i + 1);
+			// The extents to add/subtract.
+
+		// Build up a region out of many small extents.
+		tStart = clock();
+		oRegion.Clear();
+		for (nY = 0; nY < a_nHeight; ++nY)
+		{
+			for (nExtent = 0; nExtent < a_nWidth / 16; ++nExtent)
+			{
+				int16_t nX = oRandom.Next (a_nWidth - 8);
+				oRegion.Union (eStatus, nY, nX,
+					nX + 1 + oRandom.Next (8));
+				if (eStatus != g_kNoError)
+					{ printf ("%s: Union() failed\n", a_pszName);
+						return 1; }
+			}
+		}
+		fUnion += (double) (clock() - tStart);
+		nPoints += oRegion.NumberOfPoints();
+
+		// Punch holes in it.
+		tStart = clock();
+		for (nY = 0; nY < a_nHeight; ++nY)
+		{
+			for (nExtent = 0; nExtent < a_nWidth / 32; ++nExtent)
+			{
+				int16_t nX = oRandom.Next (a_nWidth - 4);
+				oRegion.Subtract (eStatus, nY, nX,
+					nX + 1 + oRandom.Next (4));
+				if (eStatus != g_kNoError)
+					{ printf ("%s: Subtract() failed\n", a_pszName);
+						return 1; }
+			}
+		}
+		fSubtract += (double) (clock() - tStart);
+		nPoints += oRegion.NumberOfPoints();
+
+		// Flood-fill a blob, starting from a pixel-group.
+		tStart = clock();
+		oRegion.Clear();
+		nY = oRandom.Next (a_nHeight - 2) & ~1;
+		nExtent = oRandom.Next (a_nWidth - 4) & ~3;
+		oRegion.Merge (eStatus, nY, nExtent, nExtent + 4);
+		if (eStatus == g_kNoError)
+			oRegion.Merge (eStatus, nY + 1, nExtent, nExtent + 4);
+		if (eStatus == g_kNoError)
+			oRegion.FloodFill (eStatus, oControl, false, true);
+		if (eStatus != g_kNoError)
+			{ printf ("%s: FloodFill() failed\n", a_pszName);
+				return 1; }
+		fFloodFill += (double) (clock() - tStart);
+		nPoints += oRegion.NumberOfPoints();
+	}
+	oRegion.Clear();
+	oControl.Purge();
+
+	// Print the results, in milliseconds per iteration.
+	printf ("%-10s union %9.3f  subtract %9.3f  flood-fill %9.3f"
+			"  (%ld points)\n", a_pszName,
+		1000.0 * fUnion / CLOCKS_PER_SEC / a_nIterations,
+		1000.0 * fSubtract / CLOCKS_PER_SEC / a_nIterations,
+		1000.0 * fFloodFill / CLOCKS_PER_SEC / a_nIterations,
+		nPoints);
+	return 0;
+}
+
+
+
+// Time every region implementation.
+int
+Bench (int16_t a_nWidth, int16_t a_nHeight, int a_nIterations)
+{
+	Status_t eStatus;
+		// An error that may occur.
+
+	// No errors yet.
+	eStatus = g_kNoError;
+
+	printf ("%dx%d, %d iterations, times in ms per iteration:\n",
+		a_nWidth, a_nHeight, a_nIterations);
+
+	{
+		VectorRegion::Allocator oAllocator (1048576);
+		InitRegionAllocator (eStatus, oAllocator);
+		if (eStatus != g_kNoError)
+			{ printf ("Allocator Init() failed\n"); return 1; }
+		if (BenchRegion<VectorRegion> ("vector", oAllocator, a_nWidth,
+				a_nHeight, a_nIterations) != 0)
+			return 1;
+	}
+	{
+		SkipListRegion::Allocator oAllocator (1048576);
+		InitRegionAllocator (eStatus, oAllocator);
+		if (eStatus != g_kNoError)
+			{ printf ("Allocator Init() failed\n"); return 1; }
+		if (BenchRegion<SkipListRegion> ("skiplist", oAllocator,
+				a_nWidth, a_nHeight, a_nIterations) != 0)
+			return 1;
+	}
+	{
+		VectorRegion::Allocator oAllocator (1048576);
+		if (BenchRegion<BitmapRegion> ("bitmap", oAllocator, a_nWidth,
+				a_nHeight, a_nIterations) != 0)
+			return 1;
+	}
+
+	// All done.
+	return 0;
+}
+
 void
 PrintRegion (const Region &a_rRegion)
 {
@@ -35,12 +263,24 @@ PrintRegion (const Region &a_rRegion)
 }
 
 int
-main (void)
+main (int argc, char **argv)
 {
 	Status_t eStatus;
 		// An error that may occur.
 	Region oSrcRegion, oTestRegion;
 		// Regions being exercised.
+
+	// If they gave a frame size, time the region implementations.
+	if (argc == 3 || argc == 4)
+	{
+		int nWidth = atoi (argv[1]);
+		int nHeight = atoi (argv[2]);
+		int nIterations = (argc == 4) ? atoi (argv[3]) : 10;
+		if (nWidth < 16 || nWidth > 16384 || nHeight < 4
+			|| nHeight > 16384 || nIterations < 1)
+			{ printf ("Bad frame size or iteration count\n"); return 1; }
+		return Bench (nWidth, nHeight, nIterations);
+	}
 	
 	// No errors yet.
 	eStatus = g_kNoError;
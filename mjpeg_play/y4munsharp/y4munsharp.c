@@ -41,20 +41,85 @@
 #include <unistd.h>
 #include <string.h>
 #include <stdio.h>
+#include <pthread.h>
 #include <yuv4mpeg.h>
+#include <mjpeg_logging.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #define MAX(a,b) ((a) >= (b) ? (a) : (b))
-#define ROUND(x) ((int) ((x) + 0.5))
+#define MIN(a,b) ((a) <= (b) ? (a) : (b))
+
+#define	ROUND(x) ((int) ((x) + 0.5))
+
+#define	BLUR_SHIFT	22	/* fixed point blur weights sum to 1 << 22 */
+#define	BLUR_SPLIT	11	/* SSE2: weights split in 11 bit halves */
+#define	MAX_THREADS	32
+
+typedef struct
+	{
+	int	length;		/* number of taps */
+	double	*matrix;	/* the convolution matrix */
+	int	*weight;	/* the taps, summing to 1 << BLUR_SHIFT */
+	int	slack;		/* max. error of a fixed point sum */
+#if defined(__SSE2__)
+	__m128i	*hi, *lo;	/* halves of taps 2i and 2i+1 in each 32 bit lane */
+#endif
+	} kernel_t;
+
+typedef struct
+	{
+	u_char	*in, *rows, *out;	/* input, rows blurred, output */
+	int	width, height;
+	kernel_t *kernel;
+	int	adjust[511];	/* sharpening, indexed by input-blurred+255 */
+	int	low, high;	/* output limits */
+	} plane_t;
+
+enum	{ STAGE_ROWS, STAGE_COLUMNS };
+
+typedef struct
+	{
+	int	idx;		/* plane number */
+	int	top, bottom;
+	} band_job_t;
+
+typedef struct
+	{
+	pthread_t threads[MAX_THREADS];
+	pthread_mutex_t lock;
+	pthread_cond_t work_cond;
+	pthread_cond_t done_cond;
+
+	int	stage;
+	band_job_t *jobs;
+	int	njobs;
+	int	next_job;	/* next job to hand out */
+	int	pending;	/* jobs not yet finished */
+	int	band_rows[3];	/* rows per band, per plane */
+	int	quit;
+	} blur_pool_t;
 
 void usage(char *);
 void y4munsharp(void);
-static void get_column(u_char *, u_char *, int, int);
-static void put_column(u_char *, u_char *, int, int);
-static void blur_line (double *, double *, int, u_char *, u_char *, int );
-static double *gen_lookup_table (double *, int);
+static void set_plane(plane_t *, u_char *, u_char *, u_char *, int, int,
+		kernel_t *, double, int, int, int);
+static void blur_rows(plane_t *, int, int);
+static void blur_columns(plane_t *, int, int);
+static void merge_row(plane_t *, int);
+static void blur_row(kernel_t *, u_char *, u_char *, int);
+static void blur_taps(const double *, int, const u_char *, int, u_char *, int);
+static void blur_span(kernel_t *, const u_char *, int, u_char *, int);
+static int blur_exact(kernel_t *, const u_char *, int);
+static void blur_pool_init(void);
+static void blur_pool_free(void);
+static void run_stage(int);
+static void gen_kernel(double *, int, kernel_t *);
 static int gen_convolve_matrix(double, double **);
 
-	u_char	*i_yuv[3], *o_yuv[3], *cur_col, *dest_col, *cur_row, *dest_row;
+	u_char	*i_yuv[3], *o_yuv[3], *r_yuv[3];
 
 	double	y_radius = 2.0, y_amount = 0.30;
 	double	uv_radius = -1.0, uv_amount;
@@ -62,7 +127,12 @@ static int gen_convolve_matrix(double, double **);
 
 	int	interlaced, ywidth, uvwidth, yheight, uvheight, ylen, uvlen;
 	int	cmatrix_y_len, cmatrix_uv_len;
-	double	*cmatrix_y, *cmatrix_uv, *ctable_y, *ctable_uv;
+	double	*cmatrix_y, *cmatrix_uv;
+	kernel_t kernel_y, kernel_uv;
+
+	plane_t	planes[3];
+	int	nplanes, nthreads = 0;
+	blur_pool_t pool;
 
 	int	lowy = 16, highy = 235, lowuv = 16, highuv = 240;
 
@@ -80,7 +150,7 @@ main(int argc, char **argv)
 	y4m_init_stream_info(&istream);
 	y4m_init_frame_info(&iframe);
 
-	while	((c = getopt(argc, argv, "L:C:hv:N")) != EOF)
+	while	((c = getopt(argc, argv, "L:C:hv:NT:")) != EOF)
 		{
 		switch	(c)
 			{
@@ -106,6 +176,11 @@ main(int argc, char **argv)
 					usage(argv[0]);
 					}
 				break;
+			case	'T':
+				nthreads = atoi(optarg);
+				if	(nthreads < 0 || nthreads > MAX_THREADS)
+					mjpeg_error_exit1("-T 0..%d", MAX_THREADS);
+				break;
 			case	'v':
 				verbose = atoi(optarg);
 				if	(verbose < 0 || verbose > 2)
@@ -158,14 +233,10 @@ main(int argc, char **argv)
 	o_yuv[1] = (u_char *)malloc(uvlen);
 	o_yuv[2] = (u_char *)malloc(uvlen);
 
-/*
- * general purpose row/column scratch buffers.  Slightly over allocated to
- * simplify life.
-*/
-	cur_col = (u_char *)malloc(MAX(ywidth, yheight));
-	dest_col = (u_char *)malloc(MAX(ywidth, yheight));
-	cur_row = (u_char *)malloc(MAX(ywidth, yheight));
-	dest_row = (u_char *)malloc(MAX(ywidth, yheight));
+/* Row blurred planes, the input to the column blur */
+	r_yuv[0] = (u_char *)malloc(ylen);
+	r_yuv[1] = (u_char *)malloc(uvlen);
+	r_yuv[2] = (u_char *)malloc(uvlen);
 
 /*
  * Generate the convolution matrices.  The generation routine allocates the
@@ -173,8 +244,24 @@ main(int argc, char **argv)
 */
 	cmatrix_y_len = gen_convolve_matrix(y_radius, &cmatrix_y);
 	cmatrix_uv_len = gen_convolve_matrix(uv_radius, &cmatrix_uv);
-	ctable_y = gen_lookup_table(cmatrix_y, cmatrix_y_len);
-	ctable_uv = gen_lookup_table(cmatrix_uv, cmatrix_uv_len);
+	gen_kernel(cmatrix_y, cmatrix_y_len, &kernel_y);
+	gen_kernel(cmatrix_uv, cmatrix_uv_len, &kernel_uv);
+
+	set_plane(&planes[0], i_yuv[0], r_yuv[0], o_yuv[0], ywidth, yheight,
+		&kernel_y, y_amount, y_threshold, lowy, highy);
+	nplanes = 1;
+	if	(uv_radius != -1.0)
+		{
+		set_plane(&planes[1], i_yuv[1], r_yuv[1], o_yuv[1], uvwidth,
+			uvheight, &kernel_uv, uv_amount, uv_threshold,
+			lowuv, highuv);
+		set_plane(&planes[2], i_yuv[2], r_yuv[2], o_yuv[2], uvwidth,
+			uvheight, &kernel_uv, uv_amount, uv_threshold,
+			16, highuv);
+		nplanes = 3;
+		}
+	if	(nthreads > 0)
+		blur_pool_init();
 
 	y4m_init_stream_info(&ostream);
 	y4m_copy_stream_info(&ostream, &istream);
@@ -200,6 +287,8 @@ main(int argc, char **argv)
 			break;
 			}
 		}
+	if	(nthreads > 0)
+		blur_pool_free();
 	y4m_fini_frame_info(&iframe);
 	y4m_fini_stream_info(&istream);
 	y4m_fini_stream_info(&ostream);
@@ -210,331 +299,448 @@ main(int argc, char **argv)
  * Uses the globals defined above - probably not the best practice in the world
  * but beats passing a jillion arguments or going to the effort of 
  * encapsulation.
+ *
+ * Each plane is blurred in two passes:  the rows of the input into the 
+ * r_yuv planes, then the columns of those into the output planes, which are
+ * merged with the input as they are finished.  Both passes work on a band of
+ * rows [top,bottom) so that, with -T, the bands can be handed out to threads.
 */
 
 void y4munsharp(void)
 	{
-	int	i, row, col, diff, value;
-	u_char	*i_ptr, *o_ptr;
-
-	mjpeg_debug("Blurring Luma rows frame %d", frameno);
+	int	i;
 
-	for	(row = 0; row < yheight; row++)
+	mjpeg_debug("Sharpening frame %d", frameno);
+	if	(nthreads > 0)
 		{
-		blur_line(ctable_y, cmatrix_y, cmatrix_y_len, 
-			&i_yuv[0][row * ywidth],
-			&o_yuv[0][row * ywidth],
-			ywidth);
+		run_stage(STAGE_ROWS);
+		run_stage(STAGE_COLUMNS);
 		}
-
-	if	(uv_radius != -1.0)
+	else
 		{
-		mjpeg_debug("Blurring Chroma rows frame %d", frameno);
-		for	(row = 0; row < uvheight; row++)
-			{
-			blur_line(ctable_uv, cmatrix_uv, cmatrix_uv_len,
-				&i_yuv[1][row * uvwidth],
-				&o_yuv[1][row * uvwidth],
-				uvwidth);
-			blur_line(ctable_uv, cmatrix_uv, cmatrix_uv_len,
-				&i_yuv[2][row * uvwidth],
-				&o_yuv[2][row * uvwidth],
-				uvwidth);
-			}
+		for	(i = 0; i < nplanes; i++)
+			blur_rows(&planes[i], 0, planes[i].height);
+		for	(i = 0; i < nplanes; i++)
+			blur_columns(&planes[i], 0, planes[i].height);
 		}
-	else
+
+	if	(nplanes == 1)
 		{
 		memcpy(o_yuv[1], i_yuv[1], uvlen);
 		memcpy(o_yuv[2], i_yuv[2], uvlen);
 		}
+	}
+
+static void
+set_plane(plane_t *p, u_char *in, u_char *rows, u_char *out, int width,
+	int height, kernel_t *kernel, double amount, int threshold,
+	int low, int high)
+	{
+	int	diff;
+
+	p->in = in;
+	p->rows = rows;
+	p->out = out;
+	p->width = width;
+	p->height = height;
+	p->kernel = kernel;
+	p->low = low;
+	p->high = high;
 
-	mjpeg_debug("Blurring Luma columns frame %d", frameno);
-	for	(col = 0; col < ywidth; col++)
-		{
 /*
- * Do the entire frame if progressive, otherwise this does the only
- * the first field.
+ * The sharpened value is the input plus 'amount' times its difference from
+ * the blurred value, truncated.  The input is a whole number, so that is the
+ * input plus the floor of the product (less a rounding hair) for every 
+ * difference.
 */
-		get_column(&o_yuv[0][col], cur_col,
-			interlaced ? 2 * ywidth : ywidth,
-			interlaced ? yheight / 2 : yheight);
-		blur_line(ctable_y, cmatrix_y, cmatrix_y_len,
-			cur_col,
-			dest_col,
-			interlaced ? yheight / 2 : yheight);
-		put_column(dest_col, &o_yuv[0][col],
-			interlaced ? 2 * ywidth : ywidth,
-			interlaced ? yheight / 2 : yheight);
+	for	(diff = -255; diff <= 255; diff++)
+		{
+		if	(abs(2 * diff) < threshold)
+			p->adjust[diff + 255] = 0;
+		else
+			p->adjust[diff + 255] = floor(amount * diff + 1e-9);
+		}
+	}
+
+static void
+blur_rows(plane_t *p, int top, int bottom)
+	{
+	int	row;
+
+	for	(row = top; row < bottom; row++)
+		blur_row(p->kernel, &p->in[row * p->width],
+			&p->rows[row * p->width], p->width);
+	}
 
 /*
- * If interlaced now process the second field (data source is offset 
- * by 'ywidth').
+ * Blur the columns of rows [top,bottom) of the row-blurred plane into the 
+ * output, then merge them with the input.  Interlaced fields are blurred
+ * separately:  a row only draws on the other rows of its own field.
 */
+static void
+blur_columns(plane_t *p, int top, int bottom)
+	{
+	kernel_t *k = p->kernel;
+	int	mid = k->length / 2;
+	int	w = p->width;
+	int	row, i, n, j0, j1, step;
+	u_char	*base, *dest;
+
+	for	(row = top; row < bottom; row++)
+		{
+		dest = &p->out[row * w];
 		if	(interlaced)
 			{
-			get_column(&o_yuv[0][col + ywidth], cur_col,
-				2 * ywidth,
-				yheight / 2);
-			blur_line(ctable_y, cmatrix_y, cmatrix_y_len,
-				cur_col,
-				dest_col,
-				interlaced ? yheight / 2 : yheight);
-			put_column(dest_col, &o_yuv[0][col + ywidth],
-				2 * ywidth,
-				yheight / 2);
+			i = row / 2;
+			n = p->height / 2;
+			step = 2 * w;
+			base = &p->rows[(row & 1) * w];
+			}
+		else
+			{
+			i = row;
+			n = p->height;
+			step = w;
+			base = p->rows;
 			}
-		}
-
-	if	(uv_radius == -1)
-		goto merging;
 
-	mjpeg_debug("Blurring chroma columns frame %d", frameno);
-	for	(col = 0; col < uvwidth; col++)
-		{
-/* U */
-		get_column(&o_yuv[1][col], cur_col,
-			interlaced ? 2 * uvwidth : uvwidth,
-			interlaced ? uvheight / 2 : uvheight);
-		blur_line(ctable_uv, cmatrix_uv, cmatrix_uv_len,
-			cur_col,
-			dest_col,
-			interlaced ? uvheight / 2 : uvheight);
-		put_column(dest_col, &o_yuv[1][col],
-			interlaced ? 2 * uvwidth : uvwidth,
-			interlaced ? uvheight / 2 : uvheight);
-		if	(interlaced)
+		if	(i >= n)
 			{
-			get_column(&o_yuv[1][col + uvwidth], cur_col,
-				2 * uvwidth,
-				uvheight / 2);
-			blur_line(ctable_uv, cmatrix_uv, cmatrix_uv_len,
-				cur_col,
-				dest_col,
-				interlaced ? uvheight / 2 : uvheight);
-			put_column(dest_col, &o_yuv[1][col + uvwidth],
-				2 * uvwidth,
-				uvheight / 2);
+/* the odd last line of an interlaced frame belongs to neither field */
+			memcpy(dest, &p->rows[row * w], w);
 			}
-/* V */
-		get_column(&o_yuv[2][col], cur_col,
-			interlaced ? 2 * uvwidth : uvwidth,
-			interlaced ? uvheight / 2 : uvheight);
-		blur_line(ctable_uv, cmatrix_uv, cmatrix_uv_len,
-			cur_col,
-			dest_col,
-			interlaced ? uvheight / 2 : uvheight);
-		put_column(dest_col, &o_yuv[2][col],
-			interlaced ? 2 * uvwidth : uvwidth,
-			interlaced ? uvheight / 2 : uvheight);
-		if	(interlaced)
+		else
 			{
-			get_column(&o_yuv[2][col + uvwidth], cur_col,
-				2 * uvwidth,
-				uvheight / 2);
-			blur_line(ctable_uv, cmatrix_uv, cmatrix_uv_len,
-				cur_col,
-				dest_col,
-				interlaced ? uvheight / 2 : uvheight);
-			put_column(dest_col, &o_yuv[2][col + uvwidth],
-				2 * uvwidth,
-				uvheight / 2);
+/* near the top and bottom only the taps that fall inside the field are used */
+			j0 = MAX(0, mid - i);
+			j1 = MIN(k->length, n - i + mid);
+			base += (i - mid + j0) * step;
+			if	(j0 == 0 && j1 == k->length)
+				blur_span(k, base, step, dest, w);
+			else
+				blur_taps(k->matrix + j0, j1 - j0, base, step,
+					dest, w);
 			}
+		merge_row(p, row);
 		}
-merging:
-	mjpeg_debug("Merging luma frame %d", frameno);
-	for	(row = 0, i_ptr = i_yuv[0], o_ptr = o_yuv[0]; row < yheight; row++)
+	}
+
+static void
+merge_row(plane_t *p, int row)
+	{
+	int	i, value;
+	u_char	*i_ptr = &p->in[row * p->width];
+	u_char	*o_ptr = &p->out[row * p->width];
+
+	for	(i = 0; i < p->width; i++, i_ptr++, o_ptr++)
 		{
-		for	(i = 0; i < ywidth; i++, i_ptr++, o_ptr++)
-			{
-			diff = *i_ptr - *o_ptr;
-			if	(abs(2 * diff) < y_threshold)
-				diff = 0;
-			value = *i_ptr + (y_amount * diff);
+		value = *i_ptr + p->adjust[*i_ptr - *o_ptr + 255];
 /*
- * For video the limits are 16 and 235 for the luma rather than 0 and 255!
+ * For video the limits are 16 and 235 for the luma (16 and 240 for the 
+ * chroma) rather than 0 and 255!
 */
-			if	(value < lowy)
-				value = lowy;
-			else if	(value > highy)
-				value = highy;
-			*o_ptr = value;
-			}
+		if	(value < p->low)
+			value = p->low;
+		else if	(value > p->high)
+			value = p->high;
+		*o_ptr = value;
 		}
+	}
 
-	if	(uv_radius == -1.0)
-		goto done;
+/*
+ * Blur one line of 'width' pixels.  At the ends only the available pixels
+ * are used, and their weights are scaled to one.
+*/
+static void
+blur_row(kernel_t *k, u_char *src, u_char *dest, int width)
+	{
+	int	mid = k->length / 2;
+	int	lead = MIN(mid, width);
+	int	tail = MAX(lead, width - mid);
+	int	x, j0, j1;
 
-	mjpeg_debug("Merging chroma frame %d", frameno);
-	for	(row = 0, i_ptr = i_yuv[1], o_ptr = o_yuv[1]; row < uvheight; row++)
+	for	(x = 0; x < width; x++)
 		{
-		for	(i = 0; i < uvwidth; i++, i_ptr++, o_ptr++)
+		if	(x == lead && tail > lead)
 			{
-			diff = *i_ptr - *o_ptr;
-			if	(abs(2 * diff) < uv_threshold)
-				diff = 0;
-			value = *i_ptr + (uv_amount * diff);
+			blur_span(k, src, 1, dest + lead, tail - lead);
+			x = tail - 1;
+			continue;
+			}
+		j0 = MAX(0, mid - x);
+		j1 = MIN(k->length, width - x + mid);
+		blur_taps(k->matrix + j0, j1 - j0, src + x - mid + j0, 1,
+			dest + x, 1);
+		}
+	}
+
 /*
- * For video the limits are 16 and 240 for the chroma rather than 0 and 255!
+ * dest[x] = sum of matrix[j] * src[x + j * step] over the taps, scaled by the
+ * sum of the matrix entries, for x in [0,n).  Used where the kernel doesn't
+ * fit.  This is the GIMP's edge computation, in double precision.
 */
-			if	(value < lowuv)
-				value = lowuv;
-			else if	(value > highuv)
-				value = highuv;
-			*o_ptr = value;
-			}
+static void
+blur_taps(const double *matrix, int taps, const u_char *src, int step,
+	u_char *dest, int n)
+	{
+	int	x, j;
+	double	scale = 0, sum;
+
+	for	(j = 0; j < taps; j++)
+		scale += matrix[j];
+	for	(x = 0; x < n; x++)
+		{
+		sum = 0;
+		for	(j = 0; j < taps; j++)
+			sum += src[x + j * step] * matrix[j];
+		dest[x] = ROUND(sum / scale);
 		}
-	for	(row = 0, i_ptr = i_yuv[2], o_ptr = o_yuv[2]; row < uvheight; row++)
+	}
+
+/*
+ * One output of the whole kernel in double precision, summed in the same
+ * order as the GIMP's blur so the rounding comes out the same.
+*/
+static int
+blur_exact(kernel_t *k, const u_char *s, int step)
+	{
+	int	j;
+	double	sum = 0;
+
+	for	(j = 0; j < k->length; j++, s += step)
+		sum += k->matrix[j] * (double)*s;
+	return(ROUND(sum));
+	}
+
+/*
+ * As blur_taps() with the whole kernel, in fixed point.  The rows blur is the
+ * case step == 1 and the columns blur step == the line stride:  either way 16
+ * consecutive outputs come from 16 consecutive pixels at each tap, so (with
+ * SSE2) they are computed at once, two taps at a time.
+ *
+ * A fixed point sum is within k->slack of the exact one.  The few that are
+ * that close to a rounding boundary are redone by blur_exact(), so that the
+ * result is the same as the double precision blur's.
+*/
+static void
+blur_span(kernel_t *k, const u_char *src, int step, u_char *dest, int n)
+	{
+	int	x = 0, j, sum;
+	const int mask = (1 << BLUR_SHIFT) - 1;
+	const u_char *s;
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i half = _mm_set1_epi32(1 << (BLUR_SHIFT - 1));
+	const __m128i fraction = _mm_set1_epi32(mask);
+	const __m128i slack = _mm_set1_epi32(k->slack);
+	const __m128i near = _mm_set1_epi32(2 * k->slack + 1);
+	__m128i	a, b, alo, ahi, blo, bhi, wh, wl, p;
+	__m128i	s0, s1, s2, s3, l0, l1, l2, l3;
+	int	i, close;
+
+	for	(; x + 16 <= n; x += 16)
 		{
-		for	(i = 0; i < uvwidth; i++, i_ptr++, o_ptr++)
+		s0 = s1 = s2 = s3 = zero;
+		l0 = l1 = l2 = l3 = zero;
+		for	(j = 0, s = src + x; j < k->length; j += 2, s += 2 * step)
 			{
-			diff = *i_ptr - *o_ptr;
-			if	(abs(2 * diff) < uv_threshold)
-				diff = 0;
-			value = *i_ptr + (uv_amount * diff);
+			a = _mm_loadu_si128((const __m128i *)s);
+			if	(j + 1 < k->length)
+				b = _mm_loadu_si128((const __m128i *)(s + step));
+			else
+				b = zero;
+			wh = k->hi[j / 2];
+			wl = k->lo[j / 2];
+			alo = _mm_unpacklo_epi8(a, zero);
+			ahi = _mm_unpackhi_epi8(a, zero);
+			blo = _mm_unpacklo_epi8(b, zero);
+			bhi = _mm_unpackhi_epi8(b, zero);
+			p = _mm_unpacklo_epi16(alo, blo);
+			s0 = _mm_add_epi32(s0, _mm_madd_epi16(p, wh));
+			l0 = _mm_add_epi32(l0, _mm_madd_epi16(p, wl));
+			p = _mm_unpackhi_epi16(alo, blo);
+			s1 = _mm_add_epi32(s1, _mm_madd_epi16(p, wh));
+			l1 = _mm_add_epi32(l1, _mm_madd_epi16(p, wl));
+			p = _mm_unpacklo_epi16(ahi, bhi);
+			s2 = _mm_add_epi32(s2, _mm_madd_epi16(p, wh));
+			l2 = _mm_add_epi32(l2, _mm_madd_epi16(p, wl));
+			p = _mm_unpackhi_epi16(ahi, bhi);
+			s3 = _mm_add_epi32(s3, _mm_madd_epi16(p, wh));
+			l3 = _mm_add_epi32(l3, _mm_madd_epi16(p, wl));
+			}
+		s0 = _mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(s0, BLUR_SPLIT),
+				l0), half);
+		s1 = _mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(s1, BLUR_SPLIT),
+				l1), half);
+		s2 = _mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(s2, BLUR_SPLIT),
+				l2), half);
+		s3 = _mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(s3, BLUR_SPLIT),
+				l3), half);
+
+/* flag the sums within slack of a multiple of 1 << BLUR_SHIFT */
+		l0 = _mm_cmplt_epi32(_mm_and_si128(_mm_add_epi32(s0, slack),
+				fraction), near);
+		l1 = _mm_cmplt_epi32(_mm_and_si128(_mm_add_epi32(s1, slack),
+				fraction), near);
+		l2 = _mm_cmplt_epi32(_mm_and_si128(_mm_add_epi32(s2, slack),
+				fraction), near);
+		l3 = _mm_cmplt_epi32(_mm_and_si128(_mm_add_epi32(s3, slack),
+				fraction), near);
+		close = _mm_movemask_epi8(_mm_packs_epi16(
+				_mm_packs_epi32(l0, l1), _mm_packs_epi32(l2, l3)));
+
+		s0 = _mm_packs_epi32(_mm_srai_epi32(s0, BLUR_SHIFT),
+				     _mm_srai_epi32(s1, BLUR_SHIFT));
+		s2 = _mm_packs_epi32(_mm_srai_epi32(s2, BLUR_SHIFT),
+				     _mm_srai_epi32(s3, BLUR_SHIFT));
+		_mm_storeu_si128((__m128i *)(dest + x), _mm_packus_epi16(s0, s2));
+
+		for	(i = 0; close != 0; i++, close >>= 1)
+			if	(close & 1)
+				dest[x + i] = blur_exact(k, src + x + i, step);
+		}
+#endif
+	for	(; x < n; x++)
+		{
+		sum = 1 << (BLUR_SHIFT - 1);
+		for	(j = 0, s = src + x; j < k->length; j++, s += step)
+			sum += k->weight[j] * *s;
+		if	(((sum + k->slack) & mask) <= 2 * k->slack)
+			dest[x] = blur_exact(k, src + x, step);
+		else
+			dest[x] = sum >> BLUR_SHIFT;
+		}
+	}
+
+/***********************************************************
+ * Threads                                                 *
+ ***********************************************************/
+
 /*
- * For video the limits are 16 and 240 for the chroma rather than 0 and 255!
+ * With -T each pass is cut into bands of rows, and the bands of all the
+ * planes being processed are handed to a pool of worker threads.  The main
+ * thread waits for the rows pass to finish before starting the columns pass,
+ * which reads rows outside its own band.
 */
-			if	(value < 16)
-				value = 16;
-			else if	(value > highuv)
-				value = highuv;
-			*o_ptr = value;
+
+static void
+run_band(int stage, band_job_t *job)
+	{
+	plane_t	*p = &planes[job->idx];
+
+	if	(stage == STAGE_ROWS)
+		blur_rows(p, job->top, job->bottom);
+	else
+		blur_columns(p, job->top, job->bottom);
+	}
+
+static void *
+blur_worker(void *arg)
+	{
+	band_job_t *job;
+
+	for	(;;)
+		{
+		pthread_mutex_lock(&pool.lock);
+		while	(pool.next_job == pool.njobs && !pool.quit)
+			pthread_cond_wait(&pool.work_cond, &pool.lock);
+		if	(pool.quit)
+			{
+			pthread_mutex_unlock(&pool.lock);
+			return(NULL);
 			}
+		job = &pool.jobs[pool.next_job++];
+		pthread_mutex_unlock(&pool.lock);
+
+		run_band(pool.stage, job);
+
+		pthread_mutex_lock(&pool.lock);
+		if	(--pool.pending == 0)
+			pthread_cond_signal(&pool.done_cond);
+		pthread_mutex_unlock(&pool.lock);
 		}
-done:
-	return;
 	}
 
-void
-get_column(u_char *in, u_char *out, int stride, int numrows)
+static void
+blur_pool_init(void)
 	{
-	int	i;
+	int	i, rows, maxjobs = 0;
 
-	for	(i = 0; i < numrows; i++)
+/* aim for two bands per thread in the luma plane */
+	for	(i = 0; i < nplanes; i++)
 		{
-		*out++ = *in;
-		in += stride;
+		rows = (ylen / (nthreads * 2) + planes[i].width - 1) /
+			planes[i].width;
+		pool.band_rows[i] = MAX(rows, 1);
+		maxjobs += (planes[i].height + pool.band_rows[i] - 1) /
+			pool.band_rows[i];
 		}
+	pool.jobs = (band_job_t *)malloc(maxjobs * sizeof (band_job_t));
+	if	(pool.jobs == NULL)
+		mjpeg_error_exit1("Out of memory - malloc failed");
+
+	pthread_mutex_init(&pool.lock, NULL);
+	pthread_cond_init(&pool.work_cond, NULL);
+	pthread_cond_init(&pool.done_cond, NULL);
+	for	(i = 0; i < nthreads; i++)
+		if	(pthread_create(&pool.threads[i], NULL, blur_worker, NULL) != 0)
+			mjpeg_error_exit1("Could not create blur thread");
 	}
 
-void
-put_column(u_char *in, u_char *out, int stride, int numrows)
+static void
+blur_pool_free(void)
 	{
 	int	i;
 
-	for	(i = 0; i < numrows; i++)
+	pthread_mutex_lock(&pool.lock);
+	pool.quit = 1;
+	pthread_cond_broadcast(&pool.work_cond);
+	pthread_mutex_unlock(&pool.lock);
+	for	(i = 0; i < nthreads; i++)
+		pthread_join(pool.threads[i], NULL);
+
+	pthread_mutex_destroy(&pool.lock);
+	pthread_cond_destroy(&pool.work_cond);
+	pthread_cond_destroy(&pool.done_cond);
+	free(pool.jobs);
+	}
+
+/* Run one pass over the bands of every plane, and wait for it to finish. */
+static void
+run_stage(int stage)
+	{
+	int	i, y, rows, h;
+	band_job_t *job;
+
+	pthread_mutex_lock(&pool.lock);
+	pool.stage = stage;
+	pool.njobs = pool.next_job = 0;
+	for	(i = 0; i < nplanes; i++)
 		{
-		*out = *in++;
-		out += stride;
+		h = planes[i].height;
+		rows = pool.band_rows[i];
+		for	(y = 0; y < h; y += rows)
+			{
+			job = &pool.jobs[pool.njobs++];
+			job->idx = i;
+			job->top = y;
+			job->bottom = MIN(y + rows, h);
+			}
 		}
+	pool.pending = pool.njobs;
+	pthread_cond_broadcast(&pool.work_cond);
+	while	(pool.pending > 0)
+		pthread_cond_wait(&pool.done_cond, &pool.lock);
+	pthread_mutex_unlock(&pool.lock);
 	}
 
 /* 
- * The blur_line(), gen_convolve_matrix() and gen_lookup_table() functions 
- * were lifted almost intact from the GIMP unsharp plugin.  malloc was used 
- * instead of g_new() and the style was cleaned up a little but the logic 
- * was left untouched.
+ * The gen_convolve_matrix() function was lifted almost intact from the GIMP
+ * unsharp plugin (as was the blur, since rewritten in fixed point).  malloc
+ * was used instead of g_new() and the style was cleaned up a little but the
+ * logic was left untouched.
 */
 
-/* this function is written as if it is blurring a column at a time,
- * even though it can operate on rows, too.  There is no difference
- * in the processing of the lines, at least to the blur_line function.
-*/
-static void
-blur_line (double *ctable, double *cmatrix, int cmatrix_length,
-	   u_char  *cur_col, u_char  *dest_col, int y)
-  {
-  double scale, sum, *cmatrix_p, *ctable_p;
-  int i=0, j=0, row, cmatrix_middle = cmatrix_length/2;
-  u_char  *cur_col_p, *cur_col_p1, *dest_col_p;
-
-  /* this first block is the same as the non-optimized version --
-   * it is only used for very small pictures, so speed isn't a
-   * big concern.
-   */
-  if (cmatrix_length > y)
-     {
-     for (row = 0; row < y ; row++)
-	 {
-	 scale=0;
-	  /* find the scale factor */
-	 for  (j = 0; j < y ; j++)
-	      {
-	      /* if the index is in bounds, add it to the scale counter */
-	      if  ((j + cmatrix_length/2 - row >= 0) &&
-		   (j + cmatrix_length/2 - row < cmatrix_length))
-		  scale += cmatrix[j + cmatrix_length/2 - row];
-	      }
-	  for  (i = 0; i< 1; i++)
-	       {
-	       sum = 0;
-	       for  (j = 0; j < y; j++)
-                    {
-		    if  ((j >= row - cmatrix_length/2) &&
-		         (j <= row + cmatrix_length/2))
-		    	sum += cur_col[j + i] * cmatrix[j];
-		    }
-	        dest_col[row + i] = (u_char) ROUND (sum / scale);
-	        }
-	   }
-      }
-  else
-      {
-      /* for the edge condition, we only use available info and scale to one */
-      for (row = 0; row < cmatrix_middle; row++)
-	  {
-	  /* find scale factor */
-	  scale=0;
-	  for  (j = cmatrix_middle - row; j<cmatrix_length; j++)
-	       scale += cmatrix[j];
-	  for  (i = 0; i < 1; i++)
-	       {
-	       sum = 0;
-	       for  (j = cmatrix_middle - row; j<cmatrix_length; j++)
-		    sum += cur_col[(row + j-cmatrix_middle) + i] * cmatrix[j];
-	        dest_col[row + i] = (u_char) ROUND (sum / scale);
-	       }
-	   }
-      /* go through each pixel in each col */
-      dest_col_p = dest_col + row;
-      for  (; row < y-cmatrix_middle; row++)
-	   {
-	   cur_col_p = (row - cmatrix_middle) + cur_col;
-	   for  (i = 0; i < 1; i++)
-	        {
-	        sum = 0;
-	        cmatrix_p = cmatrix;
-	        cur_col_p1 = cur_col_p;
-	        ctable_p = ctable;
-	        for  (j = cmatrix_length; j>0; j--)
-		     {
-		     sum += *(ctable_p + *cur_col_p1);
-		     cur_col_p1 += 1;
-		     ctable_p += 256;
-		     }
-	        cur_col_p++;
-	        *(dest_col_p++) = ROUND (sum);
-	        }
-	    }
-	
-      /* for the edge condition, we only use available info, and scale to one */
-       for  (; row < y; row++)
-	    {
-	    /* find scale factor */
-	    scale=0;
-	    for  (j = 0; j< y-row + cmatrix_middle; j++)
-	         scale += cmatrix[j];
-	    for  (i = 0; i < 1; i++)
-	         {
-	         sum = 0;
-	         for  (j = 0; j<y-row + cmatrix_middle; j++)
-		      sum += cur_col[(row + j-cmatrix_middle) + i] * cmatrix[j];
-	         dest_col[row + i] = (u_char) ROUND (sum / scale);
-	         }
-	    }
-      }
-  }
-
 /*
  * generates a 1-D convolution matrix to be used for each pass of 
  * a two-pass gaussian blur.  Returns the length of the matrix.
@@ -608,35 +814,57 @@ gen_convolve_matrix(double radius, double **cmatrix_p)
 	return(matrix_length);
 	}
 
-/* generates a lookup table for every possible product of 0-255 and
-   each value in the convolution matrix.  The returned array is
-   indexed first by matrix position, then by input multiplicand (?) value.
+/* converts a convolution matrix to fixed point weights summing to exactly
+   1 << BLUR_SHIFT (the rounding error is put on the center tap), works out
+   how far a fixed point sum can be from the exact one, and, for SSE2, splits
+   the weights in halves packed in pairs for _mm_madd_epi16.
 */
-static double *
-gen_lookup_table(double *cmatrix, int cmatrix_length)
+static void
+gen_kernel(double *cmatrix, int cmatrix_length, kernel_t *k)
 	{
-	int i, j;
-	double* lookup_table = (double *)malloc(sizeof (double) * cmatrix_length * 256);
-	double* lookup_table_p = lookup_table, *cmatrix_p = cmatrix;
+	int i, w0, w1, sum = 0;
+	double err = 0;
 
-	for	(i=0; i<cmatrix_length; i++)
+	k->length = cmatrix_length;
+	k->matrix = cmatrix;
+	k->weight = (int *)calloc(cmatrix_length, sizeof (int));
+	for	(i = 0; i < cmatrix_length; i++)
+		{
+		k->weight[i] = floor(cmatrix[i] * (1 << BLUR_SHIFT) + 0.5);
+		sum += k->weight[i];
+		}
+	k->weight[cmatrix_length / 2] += (1 << BLUR_SHIFT) - sum;
+
+/* with pixels up to 255, plus a little for the rounding of the double sum */
+	for	(i = 0; i < cmatrix_length; i++)
+		err += fabs(k->weight[i] - cmatrix[i] * (1 << BLUR_SHIFT));
+	k->slack = ceil(255 * err) + 4;
+#if defined(__SSE2__)
+	k->hi = (__m128i *)malloc(sizeof (__m128i) * (cmatrix_length + 1) / 2);
+	k->lo = (__m128i *)malloc(sizeof (__m128i) * (cmatrix_length + 1) / 2);
+	for	(i = 0; i < cmatrix_length; i += 2)
 		{
-		for	(j=0; j<256; j++)
-	  		*(lookup_table_p++) = *cmatrix_p * (double)j;
-		cmatrix_p++;
+		w0 = k->weight[i];
+		w1 = (i + 1 < cmatrix_length) ? k->weight[i + 1] : 0;
+		k->hi[i / 2] = _mm_set1_epi32((w0 >> BLUR_SPLIT) |
+			(w1 >> BLUR_SPLIT) << 16);
+		k->lo[i / 2] = _mm_set1_epi32((w0 & ((1 << BLUR_SPLIT) - 1)) |
+			(w1 & ((1 << BLUR_SPLIT) - 1)) << 16);
 		}
-	return(lookup_table);
+#endif
 	}
 
 void usage(char *pgm)
 	{
-	fprintf(stderr, "%s: usage: [-v 0|1|2] [-N] [-L radius,amount,threshold] [-C radius,amount,threshold]\n", pgm);
+	fprintf(stderr, "%s: usage: [-v 0|1|2] [-N] [-T num] [-L radius,amount,threshold] [-C radius,amount,threshold]\n", pgm);
 	fprintf(stderr, "%s:\tradius and amount are floating point numbers\n",
 		pgm);
 	fprintf(stderr, "%s:\tthreshold is integer.\n", pgm);
 	fprintf(stderr, "%s:\tdefault for -L is 2.0,0.3,4\n", pgm);
 	fprintf(stderr, "%s:\tchroma not filtered UNLESS -C used, no default\n",
 		pgm);
+	fprintf(stderr, "%s:-T num: blur with num threads, 0..%d (default: 0)\n",
+		pgm, MAX_THREADS);
 	fprintf(stderr, "%s:-v verbose 0=quiet 1=normal 2=debug (default: 1)\n", pgm);
 	fprintf(stderr, "%s:-N disables the Y' 16-235 clip/core\n", pgm);
 	fprintf(stderr, "%s:   disables the CbCr 16-240 clip/core\n", pgm);
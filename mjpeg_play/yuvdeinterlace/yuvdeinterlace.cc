@@ -22,6 +22,9 @@
 #include "mjpeg_logging.h"
 #include "cpu_accel.h"
 #include "motionsearch.h"
+#include "motionfield.h"
+#include <fcntl.h>
+#include <unistd.h>
 
 #ifdef __GNUC__
 #define RESTRICT __restrict__
@@ -78,6 +81,12 @@ public:
 
   int_least16_t (* RESTRICT motion[2])[2];
 
+  // motion vectors imported from an earlier stage (-i), and the
+  // number of the frame being reconstructed
+  int seeds_fd;
+  int seed_frame;
+  mjpeg_motionfield_t seeds;
+
   void initialize_memory (int w, int h, int cw, int ch)
   {
     int luma_size;
@@ -127,6 +136,8 @@ public:
   {
     both_fields = 0;
     just_anti_alias = 0;
+    seeds_fd = -1;
+    seed_frame = -1;
   }
 
   ~deinterlacer ()
@@ -152,7 +163,56 @@ public:
 
     free (motion[0]);
     free (motion[1]);
-    
+
+    if (seeds_fd >= 0)
+      {
+	close (seeds_fd);
+	mjpeg_motionfield_fini (&seeds);
+      }
+  }
+
+  void open_seeds (const char *name)
+  {
+    int err;
+
+    if ((seeds_fd = open (name, O_RDONLY)) < 0)
+      mjpeg_error_exit1 ("Couldn't open %s", name);
+    if ((err = mjpeg_motionfield_read_header (seeds_fd, &seeds)) != Y4M_OK)
+      mjpeg_error_exit1 ("Couldn't read motion field header: %s", y4m_strerr (err));
+  }
+
+  void read_seeds (int frame)
+  {
+    int err;
+
+    seed_frame = frame;
+    if (seeds_fd < 0)
+      return;
+    err = mjpeg_motionfield_read_frame (seeds_fd, &seeds, frame);
+    if (err != Y4M_OK && err != Y4M_ERR_EOF)
+      {
+	mjpeg_warn ("Motion field unreadable (%s), ignoring the rest", y4m_strerr (err));
+	close (seeds_fd);
+	mjpeg_motionfield_fini (&seeds);
+	seeds_fd = -1;
+      }
+  }
+
+  // The imported vector of the block at x,y of a w*h plane.  It spans a
+  // frame, so halve it for the field-to-field search; return false if
+  // there is none or it points out of the plane.
+  bool seed_vector (int w, int h, int x, int y, int_fast16_t &dx, int_fast16_t &dy)
+  {
+    const int16_t *v;
+
+    if (seeds_fd < 0)
+      return false;
+    v = mjpeg_motionfield_get (&seeds, seed_frame, (x + 4) * width / w, (y + 4) * height / h);
+    if (v == NULL)
+      return false;
+    dx = v[0] * w / width / 2;
+    dy = v[1] * h / height / 4 * 2;
+    return x + dx >= 0 && x + dx <= w - 16 && y + dy >= 0 && y + dy <= h - 16;
   }
 
   void temporal_reconstruct_frame (uint8_t * RESTRICT out, const uint8_t * const in, uint8_t * RESTRICT in0, const uint8_t * const in1, int w, int h, int field, int_least16_t (* RESTRICT lvxy)[2])
@@ -436,6 +496,19 @@ public:
 		}
 	    }
 
+	  // check the vector imported from an earlier stage
+	  if (min > 512)
+	    if (seed_vector (w, h, x, y, dx, dy))
+	      {
+		sad = psad_00 (scratch + x + y * w, out + (x + dx) + (y + dy) * w, w, 16, min);
+		if (sad < min)
+		  {
+		    min = sad;
+		    vx = dx;
+		    vy = dy;
+		  }
+	      }
+
 	  // search for a better one...
 	  px = vx;
 	  py = vy;
@@ -918,6 +991,7 @@ int
 main (int argc, char *argv[])
 {
   int frame = 0;
+  int tag = -1;
   int errno = 0;
   int ss_h, ss_v;
 
@@ -931,7 +1005,7 @@ main (int argc, char *argv[])
   mjpeg_info( "       Motion-Compensating-Deinterlacer");
   mjpeg_info("-------------------------------------------------");
 
-  while ((c = getopt (argc, argv, "hvds:t:a")) != -1)
+  while ((c = getopt (argc, argv, "hvds:t:ai:")) != -1)
     {
       switch (c)
 	{
@@ -950,6 +1024,9 @@ main (int argc, char *argv[])
 	    mjpeg_info(" -s [n=0/1] forces field-order in case of misflagged streams");
 	    mjpeg_info("    -s0 is bottom-field-first");
 	    mjpeg_info("    -s1 is top-field-first");
+	    mjpeg_info(" -i file reads motion vectors written by an earlier");
+	    mjpeg_info("    stage (e.g. yuvdenoise -q -e file) and uses them");
+	    mjpeg_info("    as an extra starting point for the motion search");
 	    exit (0);
 	    break;
 	  }
@@ -976,6 +1053,11 @@ main (int argc, char *argv[])
 	    mjpeg_info("motion-threshold not used");
 	    break;
 	  }
+	case 'i':
+	  {
+	    YUVdeint.open_seeds (optarg);
+	    break;
+	  }
 	case 's':
 	  {
 	    YUVdeint.field_order = atoi (optarg);
@@ -1093,6 +1175,10 @@ main (int argc, char *argv[])
 					    &YUVdeint.Y4MStream.istreaminfo,
 					    &YUVdeint.Y4MStream.iframeinfo, YUVdeint.inframe)))
     {
+      // the frame reconstructed is the one read before this
+      YUVdeint.read_seeds (tag);
+      tag = mjpeg_motionfield_frame_tag (&YUVdeint.Y4MStream.iframeinfo, frame);
+
       if (!YUVdeint.just_anti_alias)
 	YUVdeint.deinterlace_motion_compensated (frame);
       else
@@ -1100,6 +1186,7 @@ main (int argc, char *argv[])
       frame++;
     }
 
+  YUVdeint.read_seeds (tag);
   if (!YUVdeint.just_anti_alias)
     YUVdeint.deinterlace_motion_compensated (-frame);
 
@@ -21,12 +21,17 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <limits.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "config.h"
 #include "mjpeg_types.h"
 #include "yuv4mpeg.h"
 #include "mjpeg_logging.h"
 #include "cpu_accel.h"
 #include "motionsearch.h"
+#include "motionfield.h"
 
 #if defined(__SSE3__)
 # include <pmmintrin.h>
@@ -44,6 +49,7 @@ int cheight = 0;
 int input_chroma_subsampling = 0;
 int input_interlaced = 0;
 int hq_mode = 0;
+int threads = 0;
 
 int renoise_Y=0;
 int renoise_U=0;
@@ -72,13 +78,17 @@ uint8_t *frame4[3];
 uint8_t *frame5[3];
 uint8_t *frame6[3];
 uint8_t *frame7[3];
+uint8_t *nextframe[3];
 
 uint8_t *scratchplane1;
 uint8_t *scratchplane2;
+uint8_t *scratch1[3];
+uint8_t *scratch2[3];
 uint8_t *outframe[3];
 
 int buff_offset;
 int buff_size;
+int frame_size;
 
 uint16_t transform_L16[256];
 uint8_t transform_G8[65536];
@@ -87,27 +97,46 @@ uint8_t transform_G8[65536];
  * helper-functions                                        *
  ***********************************************************/
 
-static void (*filter_plane_median)(uint8_t *, int, int, int);
-static void (*temporal_filter_planes)(int, int, int, int);
+/* All the filters work on a band of rows [top,bottom) of a plane, so that
+ * several threads can share a plane.  Each reads only its source and
+ * writes only its own band of the destination.  The SSE2 filters step
+ * through the plane 14 or 4 pixels at a time, so their bands start on a
+ * multiple of both; that way a band produces exactly the pixels (and the
+ * overshoot past the end of the plane) that a whole-plane pass does. */
 
+#define BAND_ALIGN 28
 
-void
-gauss_filter_plane (uint8_t * frame, int w, int h, int t)
+static inline int
+band_offset (int w, int h, int y)
 {
-int i;
-int v;
-uint8_t * src = frame;
-uint8_t * dst = scratchplane1;
+  return (y >= h) ? w * h : (y * w) / BAND_ALIGN * BAND_ALIGN;
+}
+
+static void (*filter_band_median1)(uint8_t *, uint8_t *, int, int, int, int, int);
+static void (*filter_band_median2)(uint8_t *, uint8_t *, int, int, int, int, int);
+static void (*temporal_filter_planes)(int, int, int, int, int, int);
 
-if(t==0) return;
 
+static void
+gauss_filter_pad (uint8_t * src, int w, int h)
+{
 memcpy ( src-w*2, src, w );
 memcpy ( src-w  , src, w );
 
 memcpy ( src+(w*h)  , src+(w*h)-w, w );
 memcpy ( src+(w*h)+w, src+(w*h)-w, w );
+}
 
-for(i=0;i<(w*h);i++)
+static void
+gauss_filter_band (uint8_t * frame, uint8_t * scratch, int w, int t,
+	int top, int bottom)
+{
+int i;
+int v;
+uint8_t * src = frame + top*w;
+uint8_t * dst = scratch + top*w;
+
+for(i=top*w;i<bottom*w;i++)
 	{
 
 	v  = *(src    -2)*1;
@@ -138,14 +167,260 @@ for(i=0;i<(w*h);i++)
 	dst++;
 	src++;
 	}
+}
+
+void
+gauss_filter_plane (uint8_t * frame, int w, int h, int t)
+{
+if(t==0) return;
+
+gauss_filter_pad ( frame, w, h );
+gauss_filter_band ( frame, scratchplane1, w, t, 0, h );
 
 memcpy ( frame,scratchplane1,w*h );
 }
 
+/* Motion search for the motion-compensating temporal filter.
+ *
+ * Every 16x16 block of frame4 is matched against the three frames before
+ * and after it.  The search runs coarse to fine with the machinery in
+ * utils/motionsearch.c, which mpeg2enc uses too: an exhaustive search of
+ * the 4x4 subsampled planes, refined on the 2x2 subsampled planes and
+ * then to the nearest pixel.  Its result competes with a few predicted
+ * vectors: the block's vector from the previous frame, its left
+ * neighbour's, and (for the farther frames) the nearer frame's vector,
+ * as is and extrapolated, and the vector imported with -i.  The vectors
+ * of a block row depend only on
+ * that row and the previous frame, so bands of rows can be searched by
+ * different threads.
+ *
+ * The subsampled planes are made once per frame, when it's read, and
+ * are kept behind the frame's own buffer, so they rotate with it. */
+
+me_result_s *mc_vectors[3];
+me_result_s *mc_vectors_prev[3];
+
+/* Motion fields shared with the other stages of a pipeline: -e writes
+ * the luma vectors of every frame to a sidecar stream, -i reads another
+ * stage's and uses them as one more predictor.  frame_tags[] holds the
+ * frame numbers of frame1 ... frame4, which tie them to the frames. */
+int mf_out_fd = -1;
+int mf_in_fd = -1;
+int mf_tag_frames = 0;
+mjpeg_motionfield_t mf_out;
+mjpeg_motionfield_t mf_in;
+int frame_tags[4] = { -1, -1, -1, -1 };
+
+static int
+mc_pyramid_rows (int h)
+{
+  return (h + 15) & ~15;
+}
+
+/* psubsample_image() handles 8 pixels of a line at a time. */
+static int
+mc_pyramid_ok (int w, int h)
+{
+  return (w % 8) == 0 && w >= 16 && h >= 16;
+}
+
+static uint8_t *
+mc_pyramid (uint8_t *plane)
+{
+  return plane - buff_offset + buff_size;
+}
+
+/* The size of the subsampled planes kept behind every frame buffer
+ * (plus slack for the subsampled searches to overshoot into). */
+static int
+mc_pyramid_size (void)
+{
+  return lwidth * mc_pyramid_rows (lheight) * 21 / 16 + lwidth * 2;
+}
+
+void
+subsample_plane (uint8_t *plane, int w, int h)
+{
+  uint8_t *p = mc_pyramid (plane);
+  int rows = mc_pyramid_rows (h);
+  int y;
+
+  if (!mc_pyramid_ok (w, h))
+    return;
+
+  // subsample a copy that's padded to whole blocks
+  memcpy (p, plane, w * h);
+  for (y = h; y < rows; y++)
+    memcpy (p + y * w, plane + (h - 1) * w, w);
+  psubsample_image (p, w, p + w * rows, p + w * rows + w * rows / 4);
+}
+
+/* Find the best match for the block at x,y of ref in org, among the
+ * predicted vectors and within MC_RADIUS of the best of them. */
+#define MC_RADIUS 8
+
+static me_result_s
+mc_search (uint8_t *ref, uint8_t *org, int w, int h, int x, int y,
+	   int *px, int *py, int npred)
+{
+  me_result_set sub44set, sub22set;
+  me_result_s best, one;
+  uint8_t *blk = ref + x + y * w;
+  uint8_t *s22org, *s44org, *s22ref, *s44ref;
+  int ilow, jlow, ihigh, jhigh, sad0, sad, k, sx, sy, rows;
+
+  ihigh = w - 16;
+  jhigh = h - 16;
+
+  sad0 = sad = psad_00 (org + x + y * w, blk, w, 16, INT_MAX);
+  best.x = best.y = 0;
+
+  for (k = 0; k < npred; k++)
+    {
+      if ((px[k] == 0 && py[k] == 0)
+	  || x + px[k] < 0 || x + px[k] > ihigh
+	  || y + py[k] < 0 || y + py[k] > jhigh)
+	continue;
+      sx = psad_00 (org + (x + px[k]) + (y + py[k]) * w, blk, w, 16, sad);
+      if (sx < sad)
+	{
+	  sad = sx;
+	  best.x = px[k];
+	  best.y = py[k];
+	}
+    }
+
+  if (mc_pyramid_ok (w, h))
+    {
+      // the 4x4 subsampled search has to start on a multiple of 4
+      sx = x + (best.x & ~3);
+      sy = y + (best.y & ~3);
+      ilow = (sx - MC_RADIUS < 0) ? 0 : sx - MC_RADIUS;
+      jlow = (sy - MC_RADIUS < 0) ? 0 : sy - MC_RADIUS;
+      ihigh = (sx + MC_RADIUS > ihigh) ? ihigh : sx + MC_RADIUS;
+      jhigh = (sy + MC_RADIUS > jhigh) ? jhigh : sy + MC_RADIUS;
+
+      rows = mc_pyramid_rows (h);
+      s22org = mc_pyramid (org) + w * rows;
+      s44org = s22org + w * rows / 4;
+      s22ref = mc_pyramid (ref) + w * rows;
+      s44ref = s22ref + w * rows / 4;
+
+      pbuild_sub44_mests (&sub44set, ilow, jlow, ihigh, jhigh, x, y, sad0,
+			  s44org, s44ref + (x >> 2) + (y >> 2) * (w / 4),
+			  w / 4, 4, 2);
+      pbuild_sub22_mests (&sub44set, &sub22set, x, y, ihigh, jhigh, sad0,
+			  s22org, s22ref + (x >> 1) + (y >> 1) * (w / 2),
+			  w / 2, 8, 3);
+      one = best;
+      pfind_best_one_pel (&sub22set, org, blk, x, y, ihigh, jhigh, w, 16,
+			  &one);
+      if (sub22set.len > 0)
+	{
+	  sx = psad_00 (org + (x + one.x) + (y + one.y) * w, blk, w, 16, sad);
+	  if (sx < sad)
+	    {
+	      sad = sx;
+	      best = one;
+	    }
+	}
+    }
+  else
+    {
+      // no subsampled planes; search the neighbourhood of the best guess
+      int cx = best.x, cy = best.y;
+
+      for (sy = cy - 4; sy < cy + 4; sy++)
+	for (sx = cx - 4; sx < cx + 4; sx++)
+	  {
+	    if (x + sx < 0 || x + sx > ihigh || y + sy < 0 || y + sy > jhigh)
+	      continue;
+	    k = psad_00 (org + (x + sx) + (y + sy) * w, blk, w, 16, sad);
+	    if (k < sad)
+	      {
+		sad = k;
+		best.x = sx;
+		best.y = sy;
+	      }
+	  }
+    }
+
+  best.weight = (sad > 0xffff) ? 0xffff : sad;
+  return best;
+}
+
+/* The imported vector of the block at x,y of plane idx, scaled to the
+ * plane.  Returns 0 if there isn't one for frame4. */
+static int
+mc_seed (int w, int h, int x, int y, int *sx, int *sy)
+{
+  const int16_t *v;
+
+  if (mf_in_fd < 0)
+    return 0;
+  v = mjpeg_motionfield_get (&mf_in, frame_tags[3],
+			     x * lwidth / w, y * lheight / h);
+  if (v == NULL)
+    return 0;
+  *sx = v[0] * w / lwidth;
+  *sy = v[1] * h / lheight;
+  return 1;
+}
+
+/* Search the block at x,y of frame4 in the frames around it.  The
+ * vectors are stored in the order frame3, frame2, frame1, frame5,
+ * frame6, frame7, i.e. nearest first in either direction. */
+static void
+mc_search_block (int idx, int w, int h, int x, int y, me_result_s *vec,
+		 me_result_s *prev)
+{
+  uint8_t *f[6] = {
+    frame3[idx], frame2[idx], frame1[idx], frame5[idx], frame6[idx], frame7[idx]
+  };
+  int px[5], py[5];
+  int k, n, dist, seed, sx, sy;
+
+  seed = mc_seed (w, h, x, y, &sx, &sy);
+
+  for (k = 0; k < 6; k++)
+    {
+      dist = k % 3 + 1;
+      n = 0;
+
+      // the same block in the previous frame
+      px[n] = prev[k].x;
+      py[n++] = prev[k].y;
+
+      // the block to the left
+      if (x > 0)
+	{
+	  px[n] = vec[k - 6].x;
+	  py[n++] = vec[k - 6].y;
+	}
+
+      // the nearer frame, assuming constant motion
+      if (dist > 1)
+	{
+	  px[n] = vec[k - 1].x;
+	  py[n++] = vec[k - 1].y;
+	  px[n] = vec[k - 1].x * dist / (dist - 1);
+	  py[n++] = vec[k - 1].y * dist / (dist - 1);
+	}
+
+      // the imported vector points to the previous frame (frame5)
+      if (seed && dist == 1)
+	{
+	  px[n] = (k == 3) ? sx : -sx;
+	  py[n++] = (k == 3) ? sy : -sy;
+	}
+
+      vec[k] = mc_search (frame4[idx], f[k], w, h, x, y, px, py, n);
+    }
+}
+
 void
-temporal_filter_planes_MC (int idx, int w, int h, int t)
+temporal_filter_planes_MC (int idx, int w, int h, int t, int top, int bottom)
 {
-  uint32_t sad,min;
   uint32_t r, c, m;
   int32_t d;
   int x,y,sx,sy;
@@ -157,6 +432,8 @@ temporal_filter_planes_MC (int idx, int w, int h, int t)
   int x5,y5;
   int x6,y6;
   int x7,y7;
+  int bw = (w + 15) / 16;
+  me_result_s *vec;
 
   uint8_t *f1 = frame1[idx];
   uint8_t *f2 = frame2[idx];
@@ -171,110 +448,25 @@ temporal_filter_planes_MC (int idx, int w, int h, int t)
 
   if (t == 0)			// shortcircuit filter if t = 0...
     {
-      memcpy (of, f4, w * h);
+      memcpy (of + top * w, f4 + top * w, (bottom - top) * w);
       return;
     }
 #endif
 
-      for (y = 0; y < h; y+=16)
+      // bands start on a block-row, i.e. top is a multiple of 16
+      for (y = top; y < bottom; y+=16)
       for (x = 0; x < w; x+=16)
 	{
 
-	// find best matching 16x16 block for f3
-	min=psad_00 ( f4+(x)+(y)*w,f3+(x)+(y)*w,w,16,0x00ffffff );
-	x3=y3=0;
-	for (sy=-4; sy < 4; sy++)
-	for (sx=-4; sx < 4; sx++)
-	{
-		sad  = psad_00 ( f4+(x)+(y)*w,f3+(x+sx)+(y+sy)*w,w,16,0x00ffffff );
-		sad += psad_00 ( f4+(x+8)+(y)*w,f3+(x+sx+8)+(y+sy)*w,w,16,0x00ffffff );
-		if(sad<min)
-		{
-		x3 = sx;
-		y3 = sy;
-		min = sad;
-		}
-	}
-
-	// find best matching 16x16 block for f5
-	min=psad_00 ( f4+(x)+(y)*w,f5+(x)+(y)*w,w,16,0x00ffffff );
-	x5=y5=0;
-	for (sy=-4; sy < 4; sy++)
-	for (sx=-4; sx < 4; sx++)
-	{
-		sad  = psad_00 ( f4+(x)+(y)*w,f5+(x+sx)+(y+sy)*w,w,16,0x00ffffff );
-		sad += psad_00 ( f4+(x+8)+(y)*w,f5+(x+sx+8)+(y+sy)*w,w,16,0x00ffffff );
-		if(sad<min)
-		{
-		x5 = sx;
-		y5 = sy;
-		min = sad;
-		}
-	}
-
-	// find best matching 16x16 block for f2
-	min=psad_00 ( f4+(x)+(y)*w,f2+(x)+(y)*w,w,16,0x00ffffff );
-	x2=y2=0;
-	for (sy=(y3-4); sy < (y3+4); sy++)
-	for (sx=(x3-4); sx < (x3+4); sx++)
-	{
-		sad  = psad_00 ( f4+(x)+(y)*w,f2+(x+sx)+(y+sy)*w,w,16,0x00ffffff );
-		sad += psad_00 ( f4+(x+8)+(y)*w,f2+(x+sx+8)+(y+sy)*w,w,16,0x00ffffff );
-		if(sad<min)
-		{
-		x2 = sx;
-		y2 = sy;
-		min = sad;
-		}
-	}
-
-	// find best matching 16x16 block for f6
-	min=psad_00 ( f4+(x)+(y)*w,f6+(x)+(y)*w,w,16,0x00ffffff );
-	x6=y6=0;
-	for (sy=(y5-4); sy < (y5+4); sy++)
-	for (sx=(x5-4); sx < (x5+4); sx++)
-	{
-		sad  = psad_00 ( f4+(x)+(y)*w,f6+(x+sx)+(y+sy)*w,w,16,0x00ffffff );
-		sad += psad_00 ( f4+(x+8)+(y)*w,f6+(x+sx+8)+(y+sy)*w,w,16,0x00ffffff );
-		if(sad<min)
-		{
-		x6 = sx;
-		y6 = sy;
-		min = sad;
-		}
-	}
-
-	// find best matching 16x16 block for f2
-	min=psad_00 ( f4+(x)+(y)*w,f1+(x)+(y)*w,w,16,0x00ffffff );
-	x1=y1=0;
-	for (sy=(y2-4); sy < (y2+4); sy++)
-	for (sx=(x2-4); sx < (x2+4); sx++)
-	{
-		sad  = psad_00 ( f4+(x)+(y)*w,f1+(x+sx)+(y+sy)*w,w,16,0x00ffffff );
-		sad += psad_00 ( f4+(x+8)+(y)*w,f1+(x+sx+8)+(y+sy)*w,w,16,0x00ffffff );
-		if(sad<min)
-		{
-		x1 = sx;
-		y1 = sy;
-		min = sad;
-		}
-	}
-
-	// find best matching 16x16 block for f7
-	min=psad_00 ( f4+(x)+(y)*w,f7+(x)+(y)*w,w,16,0x00ffffff );
-	x7=y7=0;
-	for (sy=(y6-4); sy < (y6+4); sy++)
-	for (sx=(x6-4); sx < (x6+4); sx++)
-	{
-		sad  = psad_00 ( f4+(x)+(y)*w,f7+(x+sx)+(y+sy)*w,w,16,0x00ffffff );
-		sad += psad_00 ( f4+(x+8)+(y)*w,f7+(x+sx+8)+(y+sy)*w,w,16,0x00ffffff );
-		if(sad<min)
-		{
-		x7 = sx;
-		y7 = sy;
-		min = sad;
-		}
-	}
+	vec = mc_vectors[idx] + ((y / 16) * bw + x / 16) * 6;
+	mc_search_block (idx, w, h, x, y, vec,
+			 mc_vectors_prev[idx] + ((y / 16) * bw + x / 16) * 6);
+	x3 = vec[0].x; y3 = vec[0].y;
+	x2 = vec[1].x; y2 = vec[1].y;
+	x1 = vec[2].x; y1 = vec[2].y;
+	x5 = vec[3].x; y5 = vec[3].y;
+	x6 = vec[4].x; y6 = vec[4].y;
+	x7 = vec[5].x; y7 = vec[5].y;
 
 	for (sy=0; sy < 16; sy++)
 	for (sx=0; sx < 16; sx++)
@@ -312,7 +504,7 @@ temporal_filter_planes_MC (int idx, int w, int h, int t)
 		v /= 16;
 
 		// add weighted and translated but non-filtered test-pixel
-		d = t - r-v;
+		d = t - abs(r-v);
 		d = d<0? 0:d;
 	  	c += d;
           	m += *(f1+(x+sx+x1)+(y+sy+y1)*w)*d;
@@ -334,7 +526,7 @@ temporal_filter_planes_MC (int idx, int w, int h, int t)
 		v /= 16;
 
 		// add weighted and translated but non-filtered test-pixel
-		d = t - r-v;
+		d = t - abs(r-v);
 		d = d<0? 0:d;
 	  	c += d;
           	m += *(f2+(x+sx+x2)+(y+sy+y2)*w)*d;
@@ -356,7 +548,7 @@ temporal_filter_planes_MC (int idx, int w, int h, int t)
 		v /= 16;
 
 		// add weighted and translated but non-filtered test-pixel
-		d = t - r-v;
+		d = t - abs(r-v);
 		d = d<0? 0:d;
 	  	c += d;
           	m += *(f3+(x+sx+x3)+(y+sy+y3)*w)*d;
@@ -378,7 +570,7 @@ temporal_filter_planes_MC (int idx, int w, int h, int t)
 		v /= 16;
 
 		// add weighted and translated but non-filtered test-pixel
-		d = t - r-v;
+		d = t - abs(r-v);
 		d = d<0? 0:d;
 	  	c += d;
           	m += *(f5+(x+sx+x5)+(y+sy+y5)*w)*d;
@@ -400,7 +592,7 @@ temporal_filter_planes_MC (int idx, int w, int h, int t)
 		v /= 16;
 
 		// add weighted and translated but non-filtered test-pixel
-		d = t - r-v;
+		d = t - abs(r-v);
 		d = d<0? 0:d;
 	  	c += d;
           	m += *(f6+(x+sx+x6)+(y+sy+y6)*w)*d;
@@ -422,7 +614,7 @@ temporal_filter_planes_MC (int idx, int w, int h, int t)
 		v /= 16;
 
 		// add weighted and translated but non-filtered test-pixel
-		d = t - r-v;
+		d = t - abs(r-v);
 		d = d<0? 0:d;
 	  	c += d;
           	m += *(f7+(x+sx+x7)+(y+sy+y7)*w)*d;
@@ -501,20 +693,23 @@ static inline __m128i tf1(const __m128i mask, const __m128i l0, const __m128i vt
 }
 
 /* 8 times as fast on x86_64, 2.2 times as fast on i686 */
-void temporal_filter_planes_sse2(int idx, int w, int h, int t)
+void temporal_filter_planes_sse2(int idx, int w, int h, int t, int top, int bottom)
 {
 	int x, k;
+	int begin = band_offset(w, h, top);
+	int end = band_offset(w, h, bottom);
 	
-	uint8_t *f4 = frame4[idx];
-	uint8_t *of = outframe[idx];
+	uint8_t *f4 = frame4[idx] + begin;
+	uint8_t *of = outframe[idx] + begin;
 	
 	uint8_t *f[6] = {
-		frame3[idx], frame2[idx], frame1[idx], frame5[idx], frame6[idx], frame7[idx]
+		frame3[idx] + begin, frame2[idx] + begin, frame1[idx] + begin,
+		frame5[idx] + begin, frame6[idx] + begin, frame7[idx] + begin
 	};
 	
 	if (t == 0)			// shortcircuit filter if t = 0...
 	{
-		memcpy (of, f4, w * h);
+		memcpy (of, f4, end - begin);
 		return;
 	}
 	
@@ -560,7 +755,7 @@ void temporal_filter_planes_sse2(int idx, int w, int h, int t)
 	_MM_SET_ROUNDING_MODE(_MM_ROUND_NEAREST);
 #endif
 	
-	for (x = 0; x < (w * h); x+=14)
+	for (x = begin; x < end; x+=14)
 	{
 		vt = _mm_loadu_si128((__m128i *)(f4 - 1 - w));
 		vc = _mm_loadu_si128((__m128i *)(f4 - 1    ));
@@ -653,35 +848,45 @@ void temporal_filter_planes_sse2(int idx, int w, int h, int t)
 		/* 7 words r0 interleaved with 7 words r1, all converted to bytes */
 		r0 = _mm_packus_epi16(_mm_unpacklo_epi16(r0, r1), _mm_unpackhi_epi16(r0, r1));
 		/* write 16, but the 2 bytes overlap will be overwritten by the next pass */
-		_mm_storeu_si128((__m128i *)of, r0);
+		if (bottom < h && x + 16 > end)
+		{
+			/* ...unless the next pass belongs to another band */
+			uint8_t tail[16];
+			_mm_storeu_si128((__m128i *)tail, r0);
+			memcpy(of, tail, end - x);
+		}
+		else
+			_mm_storeu_si128((__m128i *)of, r0);
 		of += 14;
 	}
 	_mm_empty();
 }
 #endif
 
-void temporal_filter_planes_p (int idx, int w, int h, int t)
+void temporal_filter_planes_p (int idx, int w, int h, int t, int top, int bottom)
 {
 	uint32_t r, c, m;
 	int32_t d;
 	int x;
-
-	uint8_t *f1 = frame1[idx];
-	uint8_t *f2 = frame2[idx];
-	uint8_t *f3 = frame3[idx];
-	uint8_t *f4 = frame4[idx];
-	uint8_t *f5 = frame5[idx];
-	uint8_t *f6 = frame6[idx];
-	uint8_t *f7 = frame7[idx];
-	uint8_t *of = outframe[idx];
+	int begin = band_offset(w, h, top);
+	int end = band_offset(w, h, bottom);
+
+	uint8_t *f1 = frame1[idx] + begin;
+	uint8_t *f2 = frame2[idx] + begin;
+	uint8_t *f3 = frame3[idx] + begin;
+	uint8_t *f4 = frame4[idx] + begin;
+	uint8_t *f5 = frame5[idx] + begin;
+	uint8_t *f6 = frame6[idx] + begin;
+	uint8_t *f7 = frame7[idx] + begin;
+	uint8_t *of = outframe[idx] + begin;
 
 	if (t == 0)			// shortcircuit filter if t = 0...
 	{
-		memcpy (of, f4, w * h);
+		memcpy (of, f4, end - begin);
 		return;
 	}
 
-	for (x = 0; x < (w * h); x++)
+	for (x = begin; x < end; x++)
 	{
 		r  = *(f4-1-w);
 		r += *(f4  -w)*2;
@@ -808,24 +1013,21 @@ void temporal_filter_planes_p (int idx, int w, int h, int t)
 
 #if defined(__SSE2__)
 /* 4 to 5 times faster */
-void filter_plane_median_sse2(uint8_t *plane, int w, int h, int level)
+void filter_band_median1_sse2(uint8_t *plane, uint8_t *scratch, int w, int h, int level, int top, int bottom)
 	{
 	int i;
+	int begin = band_offset(w, h, top);
+	int end = band_offset(w, h, bottom) + (bottom >= h);
 	uint8_t * p;
 	uint8_t * d;
-#if !defined(__SSE3__)
-	int	avg, cnt;
-#endif
 
-	if (level==0)
-		return;
 	p = plane;
-	d = scratchplane1;
+	d = scratch;
 
 	// remove strong outliers from the image. An outlier is a pixel which lies outside
 	// of max-thres and min+thres of the surrounding pixels. This should not cause blurring
 	// and it should leave an evenly spread noise-floor to the image.
-	for (i=0; i<=(w*h); i+=14)
+	for (i=begin; i<end; i+=14)
 		{
 		__m128i t, c, b, min, max, minmin, maxmax;
 		
@@ -848,25 +1050,37 @@ void filter_plane_median_sse2(uint8_t *plane, int w, int h, int level)
 		c = _mm_max_epu8(min, _mm_min_epu8(max, _mm_srli_si128(c, 1)));
 		/* write 14 valid pixels, the 2 remaining bytes are overwritten subsequently
 		 * or lie outside the frame area */
-		_mm_storeu_si128((__m128i *)&d[i], c);
+		if (bottom < h && i + 16 > end)
+			{
+			/* ...unless the next pass belongs to another band */
+			uint8_t tail[16];
+			_mm_storeu_si128((__m128i *)tail, c);
+			memcpy(&d[i], tail, end - i);
+			}
+		else
+			_mm_storeu_si128((__m128i *)&d[i], c);
 		}
-	
+	_mm_empty();
+	}
+
+void filter_band_median2_sse2(uint8_t *scratch, uint8_t *out, int w, int h, int level, int top, int bottom)
+	{
+	int i;
+	int begin = band_offset(w, h, top);
+	int end = band_offset(w, h, bottom) + (bottom >= h);
+	uint8_t * p;
+	uint8_t * d;
+#if !defined(__SSE3__)
+	int	avg, cnt;
+#endif
+
 	// in the second stage we try to average similar spatial pixels, only. This, like
 	// a median, should also not reduce sharpness but flatten the noisefloor. This
 	// part is quite similar to what 2dclean/yuvmedianfilter do. But because of the
 	// different weights given to the pixels it is less aggressive...
 
-	p = scratchplane1;
-	d = scratchplane2;
-	
-	// this filter needs values outside of the imageplane, so we just copy the first line 
-	// and the last line into the out-of-range area...
-	
-	memcpy ( p-w  , p, w );
-	memcpy ( p-w*2, p, w );
-	
-	memcpy ( p+(w*h)  , p+(w*h)-w, w );
-	memcpy ( p+(w*h)+w, p+(w*h)-w, w );
+	p = scratch + begin;
+	d = out + begin;
 	
 	__m128i lvl = _mm_set1_epi16(level);
 	
@@ -874,7 +1088,7 @@ void filter_plane_median_sse2(uint8_t *plane, int w, int h, int level)
 	_MM_SET_ROUNDING_MODE(_MM_ROUND_NEAREST);
 #endif
 	
-	for (i=0; i<=(w*h); i+=4)
+	for (i=begin; i<end; i+=4)
 		{
 		uint64_t k0, k1, k2, k3, k6;
 		__m128i c0, c1, v[4], t[4], e[4], a[4];
@@ -1079,32 +1293,26 @@ void filter_plane_median_sse2(uint8_t *plane, int w, int h, int level)
 		p += 4;
 		}
 	_mm_empty();
-	
-	memcpy(plane,scratchplane2,w*h);
 	}
 #endif
 
-void filter_plane_median_p ( uint8_t * plane, int w, int h, int level)
+void filter_band_median1_p ( uint8_t * plane, uint8_t * scratch, int w, int h, int level, int top, int bottom)
 {
 	int i;
 	int min;
 	int max;
-	int avg;
-	int cnt;
-	int c;
-	int e;
+	int begin = band_offset(w, h, top);
+	int end = band_offset(w, h, bottom) + (bottom >= h);
 	uint8_t * p;
 	uint8_t * d;
 
-	if(level==0) return;
-
-	p = plane;
-	d = scratchplane1;
+	p = plane + begin;
+	d = scratch + begin;
 
 	// remove strong outliers from the image. An outlier is a pixel which lies outside
 	// of max-thres and min+thres of the surrounding pixels. This should not cause blurring
 	// and it should leave an evenly spread noise-floor to the image.
-	for(i=0;i<=(w*h);i++)
+	for(i=begin;i<end;i++)
 	{
 	// reset min/max-filter
 	min=255;
@@ -1147,25 +1355,29 @@ void filter_plane_median_p ( uint8_t * plane, int w, int h, int level)
 	d++;
 	p++;
 	}
+}
+
+void filter_band_median2_p ( uint8_t * scratch, uint8_t * out, int w, int h, int level, int top, int bottom)
+{
+	int i;
+	int avg;
+	int cnt;
+	int c;
+	int e;
+	int begin = band_offset(w, h, top);
+	int end = band_offset(w, h, bottom) + (bottom >= h);
+	uint8_t * p;
+	uint8_t * d;
 
 	// in the second stage we try to average similar spatial pixels, only. This, like
 	// a median, should also not reduce sharpness but flatten the noisefloor. This
 	// part is quite similar to what 2dclean/yuvmedianfilter do. But because of the
 	// different weights given to the pixels it is less aggressive...
 
-	p = scratchplane1;
-	d = scratchplane2;
-
-	// this filter needs values outside of the imageplane, so we just copy the first line 
-	// and the last line into the out-of-range area...
+	p = scratch + begin;
+	d = out + begin;
 
-	memcpy ( p-w  , p, w );
-	memcpy ( p-w*2, p, w );
-
-	memcpy ( p+(w*h)  , p+(w*h)-w, w );
-	memcpy ( p+(w*h)+w, p+(w*h)-w, w );
-
-	for(i=0;i<=(w*h);i++)
+	for(i=begin;i<end;i++)
 	{
 		avg=*(p)*level*2;
 		cnt=level;
@@ -1319,16 +1531,433 @@ void filter_plane_median_p ( uint8_t * plane, int w, int h, int level)
 		d++;
 		p++;
 	}
+}
+
+static void
+filter_median_pad (uint8_t * p, int w, int h)
+{
+	// the second stage needs values outside of the imageplane, so we just copy the
+	// first line and the last line into the out-of-range area. Its 5x5 neighbourhood
+	// wraps around the ends of the lines, so the corner pixels reach a third line out.
+
+	memcpy ( p-w  , p, w );
+	memcpy ( p-w*2, p, w );
+	memcpy ( p-w*3, p, w );
+
+	memcpy ( p+(w*h)    , p+(w*h)-w, w );
+	memcpy ( p+(w*h)+w  , p+(w*h)-w, w );
+	memcpy ( p+(w*h)+w*2, p+(w*h)-w, w );
+}
+
+void filter_plane_median ( uint8_t * plane, int w, int h, int level)
+{
+	if(level==0) return;
+
+	filter_band_median1 ( plane, scratchplane1, w, h, level, 0, h );
+	filter_median_pad ( scratchplane1, w, h );
+	filter_band_median2 ( scratchplane1, scratchplane2, w, h, level, 0, h );
 
 	memcpy(plane,scratchplane2,w*h);
 }
 
+/***********************************************************
+ * Threads                                                 *
+ ***********************************************************/
+
+/* With -T, every filter stage is cut into bands of rows, and the bands
+ * of all three planes are handed to a pool of worker threads; the main
+ * thread waits for a stage to finish before starting the next one.  A
+ * reader thread fetches the next frame while the current one is being
+ * filtered.  Each plane gets its own scratch planes, so that Y, U and V
+ * can be filtered at the same time. */
+
+#define MAX_THREADS 32
+
+enum { STAGE_GAUSS, STAGE_MEDIAN1, STAGE_MEDIAN2, STAGE_COPY1, STAGE_COPY2,
+       STAGE_SUBSAMPLE, STAGE_TEMPORAL };
+
+typedef struct {
+  int idx;              /* plane number */
+  uint8_t *plane;
+  int level;
+  int top, bottom;
+} band_job_t;
+
+typedef struct {
+  int nthreads;
+  pthread_t threads[MAX_THREADS];
+  pthread_mutex_t lock;
+  pthread_cond_t work_cond;
+  pthread_cond_t done_cond;
+
+  int stage;
+  band_job_t *jobs;
+  int njobs;
+  int next_job;         /* next job to hand out */
+  int pending;          /* jobs not yet finished */
+  int band_rows[3];     /* rows per band, a multiple of 16, per plane */
+  int quit;
+} filter_pool_t;
+
+typedef struct {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int fd;
+  y4m_stream_info_t *si;
+  y4m_frame_info_t *fi;
+  uint8_t *frame[3];
+  int busy;
+  int err;
+  int quit;
+} frame_reader_t;
+
+static filter_pool_t pool;
+static frame_reader_t reader;
+
+static void
+plane_size (int idx, int *w, int *h)
+{
+  *w = (idx == 0) ? lwidth : cwidth;
+  *h = (idx == 0) ? lheight : cheight;
+}
+
+static void
+run_band (int stage, band_job_t *job)
+{
+  int w, h;
+
+  plane_size (job->idx, &w, &h);
+  switch (stage)
+    {
+    case STAGE_GAUSS:
+      gauss_filter_band (job->plane, scratch1[job->idx], w, job->level,
+			 job->top, job->bottom);
+      break;
+    case STAGE_MEDIAN1:
+      filter_band_median1 (job->plane, scratch1[job->idx], w, h, job->level,
+			   job->top, job->bottom);
+      break;
+    case STAGE_MEDIAN2:
+      filter_band_median2 (scratch1[job->idx], scratch2[job->idx], w, h,
+			   job->level, job->top, job->bottom);
+      break;
+    case STAGE_COPY1:
+      memcpy (job->plane + job->top * w, scratch1[job->idx] + job->top * w,
+	      (job->bottom - job->top) * w);
+      break;
+    case STAGE_COPY2:
+      memcpy (job->plane + job->top * w, scratch2[job->idx] + job->top * w,
+	      (job->bottom - job->top) * w);
+      break;
+    case STAGE_SUBSAMPLE:
+      subsample_plane (job->plane, w, h);
+      break;
+    case STAGE_TEMPORAL:
+      if (hq_mode == 1)
+	temporal_filter_planes_MC (job->idx, w, h, job->level,
+				   job->top, job->bottom);
+      else
+	temporal_filter_planes (job->idx, w, h, job->level, job->top, job->bottom);
+      break;
+    }
+}
+
+static void *
+filter_worker (void *arg)
+{
+  band_job_t *job;
+
+  for (;;)
+    {
+      pthread_mutex_lock (&pool.lock);
+      while (pool.next_job == pool.njobs && !pool.quit)
+	pthread_cond_wait (&pool.work_cond, &pool.lock);
+      if (pool.quit)
+	{
+	  pthread_mutex_unlock (&pool.lock);
+	  return NULL;
+	}
+      job = &pool.jobs[pool.next_job++];
+      pthread_mutex_unlock (&pool.lock);
+
+      run_band (pool.stage, job);
+
+      pthread_mutex_lock (&pool.lock);
+      if (--pool.pending == 0)
+	pthread_cond_signal (&pool.done_cond);
+      pthread_mutex_unlock (&pool.lock);
+    }
+}
+
+static void
+filter_pool_init (int nthreads)
+{
+  int i, w, h, rows, maxjobs = 0;
+
+  pool.nthreads = nthreads;
+
+  /* aim for two bands per thread in the luma plane; bands are whole
+   * 16-line block-rows, as the motion-compensating filter needs */
+  for (i = 0; i < 3; i++)
+    {
+      plane_size (i, &w, &h);
+      rows = (lwidth * lheight / (nthreads * 2) + w - 1) / w;
+      rows = (rows + 15) & ~15;
+      pool.band_rows[i] = rows;
+      maxjobs += (h + rows - 1) / rows;
+    }
+  pool.jobs = (band_job_t *) malloc (maxjobs * sizeof (band_job_t));
+  if (pool.jobs == NULL)
+    mjpeg_error_exit1 ("Out of Memory - malloc failed");
+
+  pthread_mutex_init (&pool.lock, NULL);
+  pthread_cond_init (&pool.work_cond, NULL);
+  pthread_cond_init (&pool.done_cond, NULL);
+  for (i = 0; i < nthreads; i++)
+    if (pthread_create (&pool.threads[i], NULL, filter_worker, NULL) != 0)
+      mjpeg_error_exit1 ("Could not create filter thread");
+}
+
+static void
+filter_pool_free (void)
+{
+  int i;
+
+  pthread_mutex_lock (&pool.lock);
+  pool.quit = 1;
+  pthread_cond_broadcast (&pool.work_cond);
+  pthread_mutex_unlock (&pool.lock);
+  for (i = 0; i < pool.nthreads; i++)
+    pthread_join (pool.threads[i], NULL);
+
+  pthread_mutex_destroy (&pool.lock);
+  pthread_cond_destroy (&pool.work_cond);
+  pthread_cond_destroy (&pool.done_cond);
+  free (pool.jobs);
+}
+
+/* Run one stage on the planes whose level is non-zero, and wait for it
+ * to finish. */
+static void
+filter_planes_threaded (int stage, uint8_t *planes[3], int levels[3])
+{
+  int i, y, w, h, rows;
+  band_job_t *job;
+
+  pthread_mutex_lock (&pool.lock);
+  pool.stage = stage;
+  pool.njobs = pool.next_job = 0;
+  for (i = 0; i < 3; i++)
+    {
+      if (levels[i] == 0 && stage != STAGE_TEMPORAL)
+	continue;
+      plane_size (i, &w, &h);
+      // subsampling works on whole planes
+      rows = (stage == STAGE_SUBSAMPLE) ? h : pool.band_rows[i];
+      for (y = 0; y < h; y += rows)
+	{
+	  job = &pool.jobs[pool.njobs++];
+	  job->idx = i;
+	  job->plane = planes[i];
+	  job->level = levels[i];
+	  job->top = y;
+	  job->bottom = (y + rows < h) ? y + rows : h;
+	}
+    }
+  pool.pending = pool.njobs;
+  if (pool.njobs > 0)
+    {
+      pthread_cond_broadcast (&pool.work_cond);
+      while (pool.pending > 0)
+	pthread_cond_wait (&pool.done_cond, &pool.lock);
+    }
+  pthread_mutex_unlock (&pool.lock);
+}
+
+static void
+gauss_filter_planes_threaded (uint8_t *planes[3], int levels[3])
+{
+  int i, w, h;
+
+  for (i = 0; i < 3; i++)
+    if (levels[i] != 0)
+      {
+	plane_size (i, &w, &h);
+	gauss_filter_pad (planes[i], w, h);
+      }
+  filter_planes_threaded (STAGE_GAUSS, planes, levels);
+  filter_planes_threaded (STAGE_COPY1, planes, levels);
+}
+
+static void
+filter_planes_median_threaded (uint8_t *planes[3], int levels[3])
+{
+  int i, w, h;
+
+  filter_planes_threaded (STAGE_MEDIAN1, planes, levels);
+  for (i = 0; i < 3; i++)
+    if (levels[i] != 0)
+      {
+	plane_size (i, &w, &h);
+	filter_median_pad (scratch1[i], w, h);
+      }
+  filter_planes_threaded (STAGE_MEDIAN2, planes, levels);
+  filter_planes_threaded (STAGE_COPY2, planes, levels);
+}
+
+static void *
+frame_reader (void *arg)
+{
+  pthread_mutex_lock (&reader.lock);
+  for (;;)
+    {
+      while (!reader.busy && !reader.quit)
+	pthread_cond_wait (&reader.cond, &reader.lock);
+      if (reader.quit)
+	break;
+      pthread_mutex_unlock (&reader.lock);
+
+      reader.err = y4m_read_frame (reader.fd, reader.si, reader.fi,
+				   reader.frame);
+
+      pthread_mutex_lock (&reader.lock);
+      reader.busy = 0;
+      pthread_cond_broadcast (&reader.cond);
+    }
+  pthread_mutex_unlock (&reader.lock);
+  return NULL;
+}
+
+/* Start reading the next frame into the given buffers. */
+static void
+frame_reader_start (uint8_t *frame[3])
+{
+  pthread_mutex_lock (&reader.lock);
+  reader.frame[0] = frame[0];
+  reader.frame[1] = frame[1];
+  reader.frame[2] = frame[2];
+  reader.busy = 1;
+  pthread_cond_broadcast (&reader.cond);
+  pthread_mutex_unlock (&reader.lock);
+}
+
+/* Wait for the frame being read, and return the reader's status. */
+static int
+frame_reader_wait (void)
+{
+  pthread_mutex_lock (&reader.lock);
+  while (reader.busy)
+    pthread_cond_wait (&reader.cond, &reader.lock);
+  pthread_mutex_unlock (&reader.lock);
+  return reader.err;
+}
+
+static void
+frame_reader_init (int fd, y4m_stream_info_t *si, y4m_frame_info_t *fi)
+{
+  reader.fd = fd;
+  reader.si = si;
+  reader.fi = fi;
+  pthread_mutex_init (&reader.lock, NULL);
+  pthread_cond_init (&reader.cond, NULL);
+  if (pthread_create (&reader.thread, NULL, frame_reader, NULL) != 0)
+    mjpeg_error_exit1 ("Could not create reader thread");
+}
+
+static void
+frame_reader_free (void)
+{
+  frame_reader_wait ();
+  pthread_mutex_lock (&reader.lock);
+  reader.quit = 1;
+  pthread_cond_broadcast (&reader.cond);
+  pthread_mutex_unlock (&reader.lock);
+  pthread_join (reader.thread, NULL);
+  pthread_mutex_destroy (&reader.lock);
+  pthread_cond_destroy (&reader.cond);
+}
+
+/* Take the frame number of the frame just read from its XMVF tag, or
+ * count it if it hasn't got one. */
+static void
+push_frame_tag (y4m_frame_info_t *fi)
+{
+  static int count = 0;
+
+  frame_tags[3] = frame_tags[2];
+  frame_tags[2] = frame_tags[1];
+  frame_tags[1] = frame_tags[0];
+  frame_tags[0] = mjpeg_motionfield_frame_tag (fi, count++);
+}
+
+/* Read the next frame into frame1.  With threads it has been read ahead
+ * into nextframe already; swap it in and start reading the one after. */
+static int
+read_next_frame (int fd_in, y4m_stream_info_t *si, y4m_frame_info_t *fi)
+{
+  int err, i;
+  uint8_t *temp;
+
+  if (threads == 0)
+    {
+      err = y4m_read_frame (fd_in, si, fi, frame1);
+      if (err == Y4M_OK)
+	push_frame_tag (fi);
+      return err;
+    }
+
+  err = frame_reader_wait ();
+  if (err == Y4M_OK)
+    {
+      push_frame_tag (fi);
+      for (i = 0; i < 3; i++)
+	{
+	  temp = frame1[i];
+	  frame1[i] = nextframe[i];
+	  nextframe[i] = temp;
+	}
+      frame_reader_start (nextframe);
+    }
+  return err;
+}
+
+/* Write frame4's luma vectors to the previous frame, if it has one. */
+static void
+write_motion_field (void)
+{
+  me_result_s *vec = mc_vectors[0];
+  int i;
+
+  for (i = 0; i < mf_out.width * mf_out.height; i++, vec += 6)
+    {
+      mf_out.mv[i][0] = vec[3].x;
+      mf_out.mv[i][1] = vec[3].y;
+      mf_out.sad[i] = vec[3].weight;
+    }
+  mf_out.frame = frame_tags[3];
+  if (mjpeg_motionfield_write_frame (mf_out_fd, &mf_out) != Y4M_OK)
+    mjpeg_error_exit1 ("Couldn't write motion field of frame %d",
+		       mf_out.frame);
+}
+
+/* Write a frame, tagged with its number if there's a motion field. */
+static void
+write_frame (int fd, y4m_stream_info_t *si, y4m_frame_info_t *fi,
+	     uint8_t *frame[3], int tag)
+{
+  if (mf_tag_frames)
+    mjpeg_motionfield_tag_frame (fi, tag);
+  y4m_write_frame (fd, si, fi, frame);
+}
+
 /***********************************************************
  * Main Loop                                               *
  ***********************************************************/
 
 static void init_accel() {
-	filter_plane_median = filter_plane_median_p;
+	filter_band_median1 = filter_band_median1_p;
+	filter_band_median2 = filter_band_median2_p;
 	temporal_filter_planes = temporal_filter_planes_p;
 	uint32_t tmp;
 
@@ -1345,7 +1974,8 @@ static void init_accel() {
 		if ((d & (1 << 29))) {
 			/* x86_64 processor */
 			mjpeg_info("SETTING SSE2 for Median-Filter");
-			filter_plane_median = filter_plane_median_sse2;
+			filter_band_median1 = filter_band_median1_sse2;
+			filter_band_median2 = filter_band_median2_sse2;
 		}
 	}
 #endif
@@ -1359,6 +1989,8 @@ main (int argc, char *argv[])
   int fd_out = fileno(stdout);
   int err = 0;
   char *msg = NULL;
+  char *mf_out_name = NULL;
+  char *mf_in_name = NULL;
   y4m_ratio_t rx, ry;
   y4m_frame_info_t iframeinfo;
   y4m_stream_info_t istreaminfo;
@@ -1367,7 +1999,7 @@ main (int argc, char *argv[])
 
   mjpeg_info("yuvdenoise version %s", VERSION);
 
-  while ((c = getopt (argc, argv, "qhvt:g:m:M:r:G:")) != -1)
+  while ((c = getopt (argc, argv, "qhvt:g:m:M:r:G:T:e:i:")) != -1)
     {
       switch (c)
 	{
@@ -1400,6 +2032,17 @@ main (int argc, char *argv[])
   	    mjpeg_info("-r [0...255],[0...255],[0...255]");
   	    mjpeg_info("    Add some static masking noise. Might be used as an effect, too... *g*");
   	    mjpeg_info("-q  HighQuality-Mode. Warning: On almost any machine this is dead slow...");
+  	    mjpeg_info("-T [0...%d]", MAX_THREADS);
+  	    mjpeg_info("    Number of filter threads. 0 (the default) filters in the main thread only.");
+  	    mjpeg_info("    Otherwise the planes are filtered in bands by this many threads, and the");
+  	    mjpeg_info("    next frame is read while the current one is filtered.");
+  	    mjpeg_info("-e file");
+  	    mjpeg_info("    Write the motion vectors found in HQ-mode to file (or a named pipe), so");
+  	    mjpeg_info("    that later stages of the pipeline can start their search from them.");
+  	    mjpeg_info("    Output frames are tagged XMVF=n to match them with the vectors.");
+  	    mjpeg_info("-i file");
+  	    mjpeg_info("    Read the motion vectors of an earlier stage and use them as an extra");
+  	    mjpeg_info("    starting point for the HQ-mode motion search.");
 	    exit (0);
 	    break;
 	  }
@@ -1450,12 +2093,43 @@ main (int argc, char *argv[])
 	    sscanf (optarg, "%i,%i,%i", &renoise_Y, &renoise_U, &renoise_V);
 	    break;
 	  }
+	case 'T':
+	  {
+	    threads = atoi (optarg);
+	    if (threads < 0 || threads > MAX_THREADS)
+	      mjpeg_error_exit1 ("-T option requires arg 0..%d", MAX_THREADS);
+	    break;
+	  }
+	case 'e':
+	  {
+	    mf_out_name = optarg;
+	    break;
+	  }
+	case 'i':
+	  {
+	    mf_in_name = optarg;
+	    break;
+	  }
 	case '?':
 	default:
 	  exit (1);
 	}
     }
 
+  /* Open the motion field output before anything else can fail.  Its
+   * reader (e.g. yuvdeinterlace -i on a FIFO) blocks in open() until a
+   * writer shows up; once we have opened it, exiting closes it and the
+   * reader gets an end of file instead of waiting forever. */
+  if (mf_out_name != NULL)
+    {
+      mf_out_fd = open (mf_out_name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+      if (mf_out_fd < 0)
+	mjpeg_error_exit1 ("Couldn't open %s for writing", mf_out_name);
+      if (hq_mode == 0 || temp_Y_thres == 0)
+	mjpeg_error_exit1 ("-e needs HQ-mode and a luma temporal filter"
+			   " (-q -t)");
+    }
+
   mjpeg_info("Using the following thresholds/settings:");
   mjpeg_info("Gauss-Pre-Filter      [Y,U,V] : [%i,%i,%i]",
 	     gauss_Y, gauss_U, gauss_V);
@@ -1469,6 +2143,7 @@ main (int argc, char *argv[])
 	     renoise_Y, renoise_U, renoise_V);
   mjpeg_info("HQ-Mode                       : %s",
 	     (hq_mode==0? "off":"on"));
+  mjpeg_info("Threads                       : %i", threads);
 
   /* initialize stream-information */
   y4m_accept_extensions (1);
@@ -1547,33 +2222,37 @@ main (int argc, char *argv[])
     buff_offset = lwidth * 8;
     buff_size = buff_offset * 2 + lwidth * lheight;
 
-    frame1[0] = buff_offset + (uint8_t *) malloc (buff_size);
-    frame1[1] = buff_offset + (uint8_t *) malloc (buff_size);
-    frame1[2] = buff_offset + (uint8_t *) malloc (buff_size);
+    /* in HQ-mode, the subsampled planes for the motion search are kept
+     * behind each frame */
+    frame_size = buff_size + ((hq_mode == 1) ? mc_pyramid_size () : 0);
+
+    frame1[0] = buff_offset + (uint8_t *) malloc (frame_size);
+    frame1[1] = buff_offset + (uint8_t *) malloc (frame_size);
+    frame1[2] = buff_offset + (uint8_t *) malloc (frame_size);
 
-    frame2[0] = buff_offset + (uint8_t *) malloc (buff_size);
-    frame2[1] = buff_offset + (uint8_t *) malloc (buff_size);
-    frame2[2] = buff_offset + (uint8_t *) malloc (buff_size);
+    frame2[0] = buff_offset + (uint8_t *) malloc (frame_size);
+    frame2[1] = buff_offset + (uint8_t *) malloc (frame_size);
+    frame2[2] = buff_offset + (uint8_t *) malloc (frame_size);
 
-    frame3[0] = buff_offset + (uint8_t *) malloc (buff_size);
-    frame3[1] = buff_offset + (uint8_t *) malloc (buff_size);
-    frame3[2] = buff_offset + (uint8_t *) malloc (buff_size);
+    frame3[0] = buff_offset + (uint8_t *) malloc (frame_size);
+    frame3[1] = buff_offset + (uint8_t *) malloc (frame_size);
+    frame3[2] = buff_offset + (uint8_t *) malloc (frame_size);
 
-    frame4[0] = buff_offset + (uint8_t *) malloc (buff_size);
-    frame4[1] = buff_offset + (uint8_t *) malloc (buff_size);
-    frame4[2] = buff_offset + (uint8_t *) malloc (buff_size);
+    frame4[0] = buff_offset + (uint8_t *) malloc (frame_size);
+    frame4[1] = buff_offset + (uint8_t *) malloc (frame_size);
+    frame4[2] = buff_offset + (uint8_t *) malloc (frame_size);
 
-    frame5[0] = buff_offset + (uint8_t *) malloc (buff_size);
-    frame5[1] = buff_offset + (uint8_t *) malloc (buff_size);
-    frame5[2] = buff_offset + (uint8_t *) malloc (buff_size);
+    frame5[0] = buff_offset + (uint8_t *) malloc (frame_size);
+    frame5[1] = buff_offset + (uint8_t *) malloc (frame_size);
+    frame5[2] = buff_offset + (uint8_t *) malloc (frame_size);
 
-    frame6[0] = buff_offset + (uint8_t *) malloc (buff_size);
-    frame6[1] = buff_offset + (uint8_t *) malloc (buff_size);
-    frame6[2] = buff_offset + (uint8_t *) malloc (buff_size);
+    frame6[0] = buff_offset + (uint8_t *) malloc (frame_size);
+    frame6[1] = buff_offset + (uint8_t *) malloc (frame_size);
+    frame6[2] = buff_offset + (uint8_t *) malloc (frame_size);
 
-    frame7[0] = buff_offset + (uint8_t *) malloc (buff_size);
-    frame7[1] = buff_offset + (uint8_t *) malloc (buff_size);
-    frame7[2] = buff_offset + (uint8_t *) malloc (buff_size);
+    frame7[0] = buff_offset + (uint8_t *) malloc (frame_size);
+    frame7[1] = buff_offset + (uint8_t *) malloc (frame_size);
+    frame7[2] = buff_offset + (uint8_t *) malloc (frame_size);
 
     outframe[0] = buff_offset + (uint8_t *) malloc (buff_size);
     outframe[1] = buff_offset + (uint8_t *) malloc (buff_size);
@@ -1582,18 +2261,73 @@ main (int argc, char *argv[])
     scratchplane1 = buff_offset + (uint8_t *) malloc (buff_size);
     scratchplane2 = buff_offset + (uint8_t *) malloc (buff_size);
 
+    if (threads > 0)
+      {
+	/* a frame to read ahead into, and a pair of scratch planes for
+	 * each plane (the luma plane uses the ones above) */
+	nextframe[0] = buff_offset + (uint8_t *) malloc (frame_size);
+	nextframe[1] = buff_offset + (uint8_t *) malloc (frame_size);
+	nextframe[2] = buff_offset + (uint8_t *) malloc (frame_size);
+
+	scratch1[0] = scratchplane1;
+	scratch2[0] = scratchplane2;
+	scratch1[1] = buff_offset + (uint8_t *) malloc (buff_size);
+	scratch2[1] = buff_offset + (uint8_t *) malloc (buff_size);
+	scratch1[2] = buff_offset + (uint8_t *) malloc (buff_size);
+	scratch2[2] = buff_offset + (uint8_t *) malloc (buff_size);
+      }
+
+    if (hq_mode == 1)
+      for (c = 0; c < 3; c++)
+	{
+	  int w, h;
+
+	  plane_size (c, &w, &h);
+	  mc_vectors[c] = (me_result_s *) calloc (((w + 15) / 16)
+			* ((h + 15) / 16) * 6, sizeof (me_result_s));
+	  mc_vectors_prev[c] = (me_result_s *) calloc (((w + 15) / 16)
+			* ((h + 15) / 16) * 6, sizeof (me_result_s));
+	}
+
     mjpeg_info("Buffers allocated.");
   }
 
+  /* open the motion field side channels */
+  if (mf_out_name != NULL)
+    {
+      mjpeg_motionfield_init (&mf_out, lwidth, lheight, 16);
+      mf_tag_frames = 1;
+      if (mjpeg_motionfield_write_header (mf_out_fd, &mf_out) != Y4M_OK)
+	mjpeg_error_exit1 ("Couldn't write motion field header");
+    }
+  if (mf_in_name != NULL)
+    {
+      if (hq_mode == 0)
+	mjpeg_warn ("-i is only used in HQ-mode");
+      else if ((mf_in_fd = open (mf_in_name, O_RDONLY)) < 0)
+	mjpeg_error_exit1 ("Couldn't open %s", mf_in_name);
+      else if ((err = mjpeg_motionfield_read_header (mf_in_fd, &mf_in))
+	       != Y4M_OK)
+	mjpeg_error_exit1 ("Couldn't read motion field header: %s",
+			   y4m_strerr (err));
+    }
+
   /* initialize motion_library */
   init_motion_search ();
 
 	init_accel();
 
+  if (threads > 0)
+    {
+      filter_pool_init (threads);
+      frame_reader_init (fd_in, &istreaminfo, &iframeinfo);
+      frame_reader_start (nextframe);
+    }
+
   /* read every frame until the end of the input stream and process it */
-  while (Y4M_OK == (err = y4m_read_frame (fd_in,
-					    &istreaminfo,
-					    &iframeinfo, frame1)))
+  while (Y4M_OK == (err = read_next_frame (fd_in,
+					     &istreaminfo,
+					     &iframeinfo)))
     {
 
       static uint32_t frame_nr = 0;
@@ -1601,6 +2335,34 @@ main (int argc, char *argv[])
 
       frame_nr++;
 
+      if (mf_in_fd >= 0)
+	{
+	  err = mjpeg_motionfield_read_frame (mf_in_fd, &mf_in, frame_tags[3]);
+	  if (err != Y4M_OK && err != Y4M_ERR_EOF)
+	    {
+	      mjpeg_warn ("Motion field unreadable (%s), ignoring the rest",
+			  y4m_strerr (err));
+	      close (mf_in_fd);
+	      mf_in_fd = -1;
+	    }
+	}
+
+      if (threads > 0)
+	{
+	  int gauss[3] = { gauss_Y, gauss_U, gauss_V };
+	  int med_pre[3] = { med_pre_Y_thres, med_pre_U_thres, med_pre_V_thres };
+	  int temp_thres[3] = { temp_Y_thres, temp_U_thres, temp_V_thres };
+	  int med_post[3] = { med_post_Y_thres, med_post_U_thres, med_post_V_thres };
+
+	  gauss_filter_planes_threaded (frame1, gauss);
+	  filter_planes_median_threaded (frame1, med_pre);
+	  if (hq_mode == 1)
+	    filter_planes_threaded (STAGE_SUBSAMPLE, frame1, temp_thres);
+	  filter_planes_threaded (STAGE_TEMPORAL, outframe, temp_thres);
+	  filter_planes_median_threaded (outframe, med_post);
+	}
+      else
+	{
 	gauss_filter_plane (frame1[0], lwidth, lheight, gauss_Y);
 	gauss_filter_plane (frame1[1], cwidth, cheight, gauss_U);
 	gauss_filter_plane (frame1[2], cwidth, cheight, gauss_V);
@@ -1611,27 +2373,49 @@ main (int argc, char *argv[])
 
 	if(hq_mode==1)
 	{
-		temporal_filter_planes_MC (0, lwidth, lheight, temp_Y_thres);
-      		temporal_filter_planes_MC (1, cwidth, cheight, temp_U_thres);
-      		temporal_filter_planes_MC (2, cwidth, cheight, temp_V_thres);
+		if (temp_Y_thres) subsample_plane (frame1[0], lwidth, lheight);
+		if (temp_U_thres) subsample_plane (frame1[1], cwidth, cheight);
+		if (temp_V_thres) subsample_plane (frame1[2], cwidth, cheight);
+
+		temporal_filter_planes_MC (0, lwidth, lheight, temp_Y_thres, 0, lheight);
+      		temporal_filter_planes_MC (1, cwidth, cheight, temp_U_thres, 0, cheight);
+      		temporal_filter_planes_MC (2, cwidth, cheight, temp_V_thres, 0, cheight);
 	}
 	else
 	{
-		temporal_filter_planes (0, lwidth, lheight, temp_Y_thres);
-      		temporal_filter_planes (1, cwidth, cheight, temp_U_thres);
-      		temporal_filter_planes (2, cwidth, cheight, temp_V_thres);
+		temporal_filter_planes (0, lwidth, lheight, temp_Y_thres, 0, lheight);
+      		temporal_filter_planes (1, cwidth, cheight, temp_U_thres, 0, cheight);
+      		temporal_filter_planes (2, cwidth, cheight, temp_V_thres, 0, cheight);
 	}
 
 	filter_plane_median (outframe[0], lwidth, lheight, med_post_Y_thres);
 	filter_plane_median (outframe[1], cwidth, cheight, med_post_U_thres);
 	filter_plane_median (outframe[2], cwidth, cheight, med_post_V_thres);
+	}
 
       	renoise (outframe[0], lwidth, lheight, renoise_Y );
       	renoise (outframe[1], cwidth, cheight, renoise_U );
       	renoise (outframe[2], cwidth, cheight, renoise_V );
 
+      if (mf_out_fd >= 0 && frame_nr >= 5)
+	write_motion_field ();
+
       if (frame_nr >= 4)
-	y4m_write_frame (fd_out, &ostreaminfo, &oframeinfo, outframe);
+	write_frame (fd_out, &ostreaminfo, &oframeinfo, outframe,
+		     frame_tags[3]);
+
+      // this frame's motion vectors predict the next frame's
+      if (hq_mode == 1)
+	{
+	  me_result_s *v;
+
+	  for (c = 0; c < 3; c++)
+	    {
+	      v = mc_vectors_prev[c];
+	      mc_vectors_prev[c] = mc_vectors[c];
+	      mc_vectors[c] = v;
+	    }
+	}
 
       // rotate buffer pointers to rotate input-buffers
       temp[0] = frame7[0];
@@ -1667,11 +2451,26 @@ main (int argc, char *argv[])
       frame1[2] = temp[2];
 
     }
+  if (threads > 0)
+    {
+      frame_reader_free ();
+      filter_pool_free ();
+    }
+
+	// there are no vectors for the left frames; end the motion field
+	// first, so that a reader doesn't wait for them
+	if (mf_out_fd >= 0)
+	  {
+	    close (mf_out_fd);
+	    mjpeg_motionfield_fini (&mf_out);
+	    mf_out_fd = -1;
+	  }
+
 	// write out the left frames...
-	y4m_write_frame (fd_out, &ostreaminfo, &oframeinfo, frame4);
-	y4m_write_frame (fd_out, &ostreaminfo, &oframeinfo, frame3);
-	y4m_write_frame (fd_out, &ostreaminfo, &oframeinfo, frame2);
-	y4m_write_frame (fd_out, &ostreaminfo, &oframeinfo, frame1);
+	write_frame (fd_out, &ostreaminfo, &oframeinfo, frame4, frame_tags[2]);
+	write_frame (fd_out, &ostreaminfo, &oframeinfo, frame3, frame_tags[1]);
+	write_frame (fd_out, &ostreaminfo, &oframeinfo, frame2, frame_tags[0]);
+	write_frame (fd_out, &ostreaminfo, &oframeinfo, frame1, frame_tags[0] + 1);
 
   /* free allocated buffers */
   {
@@ -1710,9 +2509,33 @@ main (int argc, char *argv[])
 	free (scratchplane1 - buff_offset);
 	free (scratchplane2 - buff_offset);
 
+    if (hq_mode == 1)
+      for (c = 0; c < 3; c++)
+	{
+	  free (mc_vectors[c]);
+	  free (mc_vectors_prev[c]);
+	}
+
+    if (threads > 0)
+      {
+	free (nextframe[0] - buff_offset);
+	free (nextframe[1] - buff_offset);
+	free (nextframe[2] - buff_offset);
+
+	free (scratch1[1] - buff_offset);
+	free (scratch2[1] - buff_offset);
+	free (scratch1[2] - buff_offset);
+	free (scratch2[2] - buff_offset);
+      }
+
     mjpeg_info("Buffers freed.");
   }
 
+  if (mf_in_fd >= 0)
+    close (mf_in_fd);
+  if (mf_in_name != NULL && hq_mode == 1)
+    mjpeg_motionfield_fini (&mf_in);
+
   /* did stream end unexpectedly ? */
   if (err != Y4M_ERR_EOF)
     mjpeg_error_exit1 ("%s", y4m_strerr (err));